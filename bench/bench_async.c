@@ -0,0 +1,180 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/tcp.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+
+#include "modbus_async.h"
+#include "modbus_server_group.h"
+
+#define MAX_DEVICES 1024
+#define QTY 10
+#define RUN_NS 1000000000ull
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static int read_regs(void *arg, uint8_t unit_id, uint16_t start_addr, uint16_t qty, uint16_t *regs) {
+    (void)arg;
+    (void)unit_id;
+    for (uint16_t i = 0; i < qty; i++)
+        regs[i] = start_addr + i;
+    return 0;
+}
+
+static int connect_device(uint16_t port) {
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        perror("connect");
+        exit(1);
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return fd;
+}
+
+// The blocking master flow of sim/modbus_master_sim.c, one device after the other
+static double run_blocking(uint16_t port, int devices) {
+    static int fds[MAX_DEVICES];
+    modbus_tcp_master_ctx_st master;
+    uint8_t buf[MODBUS_TCP_MAX_ADU_SIZE];
+    uint16_t regs[QTY];
+    uint64_t done = 0;
+
+    modbus_tcp_master_ctx_init(&master, 1);
+    for (int d = 0; d < devices; d++)
+        fds[d] = connect_device(port);
+
+    uint64_t start = now_ns();
+    while (now_ns() - start < RUN_NS) {
+        for (int d = 0; d < devices; d++) {
+            uint16_t len = encode_tcp_read_request(&master, 1, 0, QTY, buf, sizeof(buf), NULL);
+            if (write(fds[d], buf, len) != len)
+                exit(1);
+            size_t got = 0, want = MODBUS_MBAP_HEADER_SIZE + 2 + QTY * 2;
+            while (got < want) {
+                ssize_t n = read(fds[d], buf + got, want - got);
+                if (n <= 0)
+                    exit(1);
+                got += (size_t)n;
+            }
+            decode_tcp_read_response(&master, buf, got, regs, QTY, NULL);
+            done++;
+        }
+    }
+    double rps = done * 1e9 / (now_ns() - start);
+
+    for (int d = 0; d < devices; d++)
+        close(fds[d]);
+    return rps;
+}
+
+typedef struct {
+    modbus_async_st *engine;
+    uint64_t done;
+    int reissue;
+} load_st;
+
+static void on_read(void *arg, uint32_t conn, int status, const uint16_t *regs) {
+    load_st *load = arg;
+    (void)regs;
+    if (status == QTY)
+        load->done++;
+    if (load->reissue)
+        modbus_async_read(load->engine, conn, 1, 0, QTY, on_read, load);
+}
+
+static double run_async(uint16_t port, modbus_async_backend_et backend, int devices, uint8_t depth,
+                        double *syscalls_per_req) {
+    modbus_async_st engine;
+    modbus_async_config_st cfg = {.max_connections = (uint32_t)devices, .backend = backend, .timeout_ms = 1000};
+    load_st load = {.engine = &engine, .reissue = 1};
+
+    if (modbus_async_init(&engine, &cfg) != 0)
+        return 0;
+
+    for (int d = 0; d < devices; d++) {
+        modbus_async_add_connection(&engine, connect_device(port), depth);
+        for (uint8_t i = 0; i < depth; i++)
+            modbus_async_read(&engine, (uint32_t)d, 1, 0, QTY, on_read, &load);
+    }
+
+    uint64_t start = now_ns();
+    while (now_ns() - start < RUN_NS)
+        modbus_async_poll(&engine, 100);
+    uint64_t elapsed = now_ns() - start;
+
+    *syscalls_per_req = (double)engine.stats.syscalls / (double)engine.stats.responses;
+    load.reissue = 0;
+    while (modbus_async_in_flight(&engine) > 0)
+        modbus_async_poll(&engine, 100);
+    modbus_async_deinit(&engine);
+    return load.done * 1e9 / elapsed;
+}
+
+int main(int argc, char **argv) {
+    static const int steps[] = {1, 16, 128, 512, 1024};
+    uint32_t shards = (argc > 1) ? (uint32_t)atoi(argv[1]) : 2;
+    modbus_server_group_st group;
+    modbus_server_config_st cfg = {
+        .bind_addr = "127.0.0.1",
+        .max_connections = MAX_DEVICES,
+        .slave_id = 1,
+        .read_cb = read_regs,
+    };
+
+    if (shards < 1 || shards > MODBUS_SERVER_GROUP_MAX_SHARDS) {
+        fprintf(stderr, "usage: %s [server_shards]\n", argv[0]);
+        return 1;
+    }
+
+    // Each device costs two descriptors in this process
+    struct rlimit lim;
+    getrlimit(RLIMIT_NOFILE, &lim);
+    lim.rlim_cur = lim.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &lim);
+
+    if (modbus_server_group_init(&group, &cfg, shards) != 0 || modbus_server_group_start(&group) != 0) {
+        perror("modbus_server_group");
+        return 1;
+    }
+
+    printf("# one master thread, %u server shards, %d registers per read\n", shards, QTY);
+    printf("# devices  %-28s %-28s %-28s\n", "blocking write+read", "async epoll (depth 8)", "async io_uring (depth 8)");
+    for (size_t s = 0; s < sizeof(steps) / sizeof(steps[0]); s++) {
+        int devices = steps[s];
+        if ((rlim_t)devices * 2 + 16 > lim.rlim_cur) {
+            printf("%9d  skipped (RLIMIT_NOFILE %llu)\n", devices, (unsigned long long)lim.rlim_cur);
+            continue;
+        }
+
+        double epoll_calls = 0, uring_calls = 0;
+        double blocking = run_blocking(group.port, devices);
+        double epoll = run_async(group.port, MODBUS_ASYNC_EPOLL, devices, 8, &epoll_calls);
+        double uring = run_async(group.port, MODBUS_ASYNC_IO_URING, devices, 8, &uring_calls);
+
+        printf("%9d  %10.0f req/s %15s %10.0f req/s %5.2f sys/req  ", devices, blocking, "", epoll, epoll_calls);
+        if (uring > 0)
+            printf("%10.0f req/s %5.2f sys/req\n", uring, uring_calls);
+        else
+            printf("unavailable\n");
+    }
+
+    modbus_server_group_deinit(&group);
+    return 0;
+}
@@ -0,0 +1,178 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include "modbus_batch.h"
+#include "modbus_server_group.h"
+
+#define QTY 10
+#define RUN_NS 1000000000ull
+#define DATAGRAMS 256
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static int read_regs(void *arg, uint8_t unit_id, uint16_t start_addr, uint16_t qty, uint16_t *regs) {
+    (void)arg;
+    (void)unit_id;
+    for (uint16_t i = 0; i < qty; i++)
+        regs[i] = start_addr + i;
+    return 0;
+}
+
+static int connect_device(uint16_t port) {
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        perror("connect");
+        exit(1);
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return fd;
+}
+
+// Windows of `depth` pipelined reads: one write() per frame, or one writev() per window
+static double run_pipeline(uint16_t port, uint8_t depth, int batched) {
+    static uint16_t regs[MODBUS_TCP_MAX_PIPELINE][QTY];
+    static uint8_t rx[8192];
+    modbus_tcp_master_ctx_st ctx;
+    modbus_batch_st batch;
+    uint64_t done = 0;
+    int fd = connect_device(port);
+
+    modbus_tcp_master_ctx_init(&ctx, depth);
+    modbus_batch_init(&batch, depth, depth * 12);
+
+    uint64_t start = now_ns();
+    while (now_ns() - start < RUN_NS) {
+        modbus_batch_reset(&batch);
+        for (uint8_t i = 0; i < depth; i++)
+            modbus_batch_add_read(&batch, &ctx, 1, i * QTY, QTY, regs[i]);
+
+        if (batched) {
+            modbus_batch_writev(&batch, fd, NULL);
+        } else {
+            for (uint32_t i = 0; i < batch.count; i++)
+                if (write(fd, batch.iov[i].iov_base, batch.iov[i].iov_len) < 0)
+                    exit(1);
+        }
+
+        size_t rx_len = 0, consumed;
+        while (batch.answered < batch.count) {
+            ssize_t n = read(fd, rx + rx_len, sizeof(rx) - rx_len);
+            if (n <= 0)
+                exit(1);
+            rx_len += (size_t)n;
+            modbus_batch_decode(&batch, &ctx, rx, rx_len, &consumed);
+            memmove(rx, rx + consumed, rx_len - consumed);
+            rx_len -= consumed;
+        }
+        done += batch.count;
+    }
+    double rps = done * 1e9 / (now_ns() - start);
+
+    modbus_batch_free(&batch);
+    close(fd);
+    return rps;
+}
+
+// Fan-out of one scan over UDP: one sendto() per device, or sendmmsg() for all of them
+static double run_datagrams(int batched) {
+    static uint16_t regs[QTY];
+    static modbus_tcp_master_ctx_st devices[DATAGRAMS];
+    static const struct sockaddr *dests[DATAGRAMS];
+    struct sockaddr_in sink_addr = {.sin_family = AF_INET, .sin_addr.s_addr = htonl(INADDR_LOOPBACK)};
+    socklen_t addr_len = sizeof(sink_addr);
+    modbus_batch_st batch;
+    static uint8_t drain[DATAGRAMS][MODBUS_TCP_MAX_ADU_SIZE];
+    static struct iovec drain_iov[DATAGRAMS];
+    static struct mmsghdr msgs[DATAGRAMS];
+    uint64_t sent = 0;
+
+    int sink = socket(AF_INET, SOCK_DGRAM, 0);
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    int big = 8 << 20;
+    setsockopt(sink, SOL_SOCKET, SO_RCVBUF, &big, sizeof(big));
+    bind(sink, (struct sockaddr *)&sink_addr, sizeof(sink_addr));
+    getsockname(sink, (struct sockaddr *)&sink_addr, &addr_len);
+
+    modbus_batch_init(&batch, DATAGRAMS, DATAGRAMS * 12);
+    for (int d = 0; d < DATAGRAMS; d++) {
+        dests[d] = (const struct sockaddr *)&sink_addr;
+        drain_iov[d] = (struct iovec){drain[d], sizeof(drain[d])};
+        msgs[d].msg_hdr = (struct msghdr){.msg_iov = &drain_iov[d], .msg_iovlen = 1};
+    }
+
+    uint64_t start = now_ns();
+    while (now_ns() - start < RUN_NS) {
+        modbus_batch_reset(&batch);
+        for (int d = 0; d < DATAGRAMS; d++) {
+            modbus_tcp_master_ctx_init(&devices[d], 1);
+            modbus_batch_add_read(&batch, &devices[d], 1, 0, QTY, regs);
+        }
+
+        if (batched) {
+            modbus_batch_sendmmsg(&batch, fd, dests, sizeof(sink_addr));
+        } else {
+            for (uint32_t i = 0; i < batch.count; i++)
+                sendto(fd, batch.iov[i].iov_base, batch.iov[i].iov_len, 0, dests[i], sizeof(sink_addr));
+        }
+        sent += batch.count;
+
+        // The sink is drained the same way in both runs
+        while (recvmmsg(sink, msgs, DATAGRAMS, MSG_DONTWAIT, NULL) > 0) {
+        }
+    }
+    double fps = sent * 1e9 / (now_ns() - start);
+
+    modbus_batch_free(&batch);
+    close(fd);
+    close(sink);
+    return fps;
+}
+
+int main(void) {
+    static const uint8_t depths[] = {1, 4, 16};
+    modbus_server_group_st group;
+    modbus_server_config_st cfg = {
+        .bind_addr = "127.0.0.1",
+        .max_connections = 16,
+        .slave_id = 1,
+        .read_cb = read_regs,
+    };
+
+    if (modbus_server_group_init(&group, &cfg, 1) != 0 || modbus_server_group_start(&group) != 0) {
+        perror("modbus_server_group");
+        return 1;
+    }
+
+    printf("# pipelined reads on one TCP connection\n");
+    printf("# depth  %-20s %-20s\n", "write() per frame", "writev() per window");
+    for (size_t i = 0; i < sizeof(depths); i++) {
+        double single = run_pipeline(group.port, depths[i], 0);
+        double batched = run_pipeline(group.port, depths[i], 1);
+        printf("%7u  %10.0f req/s     %10.0f req/s\n", depths[i], single, batched);
+    }
+    modbus_server_group_deinit(&group);
+
+    printf("# %d-device UDP fan-out\n", DATAGRAMS);
+    printf("#        %-20s %-20s\n", "sendto() per frame", "sendmmsg() per scan");
+    printf("         %10.0f frames/s  %10.0f frames/s\n", run_datagrams(0), run_datagrams(1));
+    return 0;
+}
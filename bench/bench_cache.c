@@ -0,0 +1,93 @@
+#define _POSIX_C_SOURCE 200809L
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "modbus_cache.h"
+#include "modbus_master.h"
+
+#define ITERATIONS 1000000
+#define SLAVE_ID 1
+
+static modbus_bank_st bank;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void report(const char *name, uint16_t qty, uint64_t elapsed) {
+    printf("%-28s qty=%-3u %8.1f ns/request\n", name, qty, (double)elapsed / ITERATIONS);
+}
+
+static void run(uint16_t start, uint16_t qty) {
+    modbus_slave_ctx_st slave;
+    modbus_master_ctx_st master;
+    modbus_cache_st cache;
+    uint8_t req[8], frame[MODBUS_CACHE_FRAME_SIZE];
+    uint16_t regs[MODBUS_MAX_REGS];
+    const uint8_t *cached;
+    volatile uint16_t sink = 0;
+
+    modbus_slave_ctx_init(&slave);
+    set_device_slave_id(&slave, SLAVE_ID);
+    modbus_master_ctx_init(&master);
+    encode_read_request(&master, SLAVE_ID, start, qty, req, sizeof(req));
+    modbus_cache_init(&cache, &bank, 1 << 20);
+
+    // What a poll costs without the cache: decode, snapshot, swap, CRC
+    uint64_t t0 = now_ns();
+    for (int i = 0; i < ITERATIONS; i++) {
+        uint8_t id;
+        uint16_t addr, n;
+        decode_read_request(&slave, req, sizeof(req), &id, &addr, &n);
+        modbus_bank_read(&bank, addr, n, regs);
+        sink ^= encode_read_response(&slave, id, regs, n, frame, sizeof(frame));
+    }
+    report("decode + read + encode", qty, now_ns() - t0);
+
+    t0 = now_ns();
+    for (int i = 0; i < ITERATIONS; i++) {
+        uint8_t id;
+        uint16_t addr, n;
+        decode_read_request(&slave, req, sizeof(req), &id, &addr, &n);
+        sink ^= modbus_bank_encode_read_response(&bank, &slave, id, addr, n, frame, sizeof(frame));
+    }
+    report("decode + wire shadow", qty, now_ns() - t0);
+
+    t0 = now_ns();
+    for (int i = 0; i < ITERATIONS; i++)
+        sink ^= modbus_cache_respond(&cache, &slave, req, sizeof(req), &cached);
+    report("cache, registers static", qty, now_ns() - t0);
+
+    // A producer updating the polled window every 10th request
+    uint16_t value = 0;
+    t0 = now_ns();
+    for (int i = 0; i < ITERATIONS; i++) {
+        if (i % 10 == 0) {
+            value++;
+            modbus_bank_write(&bank, start, &value, 1);
+        }
+        sink ^= modbus_cache_respond(&cache, &slave, req, sizeof(req), &cached);
+    }
+    report("cache, write every 10th", qty, now_ns() - t0);
+
+    printf("# hits %llu misses %llu stale %llu\n", (unsigned long long)cache.stats.hits,
+           (unsigned long long)cache.stats.misses, (unsigned long long)cache.stats.stale);
+    modbus_cache_deinit(&cache);
+    (void)sink;
+}
+
+int main(void) {
+    modbus_bank_init(&bank);
+    for (uint32_t addr = 0; addr < MODBUS_BANK_REGS; addr++) {
+        uint16_t value = (uint16_t)(addr * 7);
+        modbus_bank_write(&bank, (uint16_t)addr, &value, 1);
+    }
+
+    run(0, MODBUS_MAX_REGS);
+    run(100, 10);
+    return 0;
+}
@@ -0,0 +1,52 @@
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "modbus_cov.h"
+
+#define ITERATIONS 2000000
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void run(modbus_cov_engine_et engine, const uint16_t *deadband, uint16_t (*scans)[MODBUS_MAX_REGS]) {
+    static modbus_cov_block_st block;
+    modbus_cov_changes_st changes;
+    uint64_t reported = 0;
+
+    modbus_cov_set_engine(engine);
+    modbus_cov_init(&block, 0, MODBUS_MAX_REGS, deadband, true);
+    modbus_cov_update(&block, scans[0], &changes);
+
+    uint64_t start = now_ns();
+    for (uint32_t i = 0; i < ITERATIONS; i++) {
+        reported += (uint64_t)modbus_cov_update(&block, scans[i & 1], &changes);
+    }
+    uint64_t elapsed = now_ns() - start;
+
+    printf("%-8s %3u regs  %8.2f ns/scan  %6.2f changed/scan\n", modbus_cov_engine_name(engine), MODBUS_MAX_REGS,
+           (double)elapsed / ITERATIONS, (double)reported / ITERATIONS);
+}
+
+int main(void) {
+    static uint16_t scans[2][MODBUS_MAX_REGS];
+    uint16_t deadband[MODBUS_MAX_REGS];
+
+    // Noise inside the deadband everywhere, a real step on every 25th register
+    for (int i = 0; i < MODBUS_MAX_REGS; i++) {
+        deadband[i] = 8;
+        scans[0][i] = (uint16_t)(i * 100 - 6000);
+        scans[1][i] = (uint16_t)(scans[0][i] + ((i % 25 == 0) ? 50 : 3));
+    }
+
+    for (int e = MODBUS_COV_ENGINE_AUTO; e < MODBUS_COV_ENGINE_COUNT; e++) {
+        if (modbus_cov_engine_supported((modbus_cov_engine_et)e))
+            run((modbus_cov_engine_et)e, deadband, scans);
+    }
+    return 0;
+}
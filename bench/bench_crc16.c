@@ -0,0 +1,51 @@
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "modbus_crc.h"
+#include "modbus_utils.h"
+
+#define ITERATIONS 2000000
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void run(modbus_crc16_engine_et engine, const uint8_t *frame, uint16_t len) {
+    volatile uint16_t sink = 0;
+    uint32_t iterations = (engine == MODBUS_CRC16_ENGINE_BITWISE) ? ITERATIONS / 8 : ITERATIONS;
+
+    modbus_crc16_set_engine(engine);
+    modbus_crc16(frame, len); // warm up tables
+
+    uint64_t start = now_ns();
+    for (uint32_t i = 0; i < iterations; i++) {
+        sink ^= modbus_crc16(frame, len);
+    }
+    uint64_t elapsed = now_ns() - start;
+
+    double ns_per_frame = (double)elapsed / iterations;
+    printf("%-8s %4u bytes  %8.2f ns/frame  %8.1f MB/s\n", modbus_crc16_engine_name(engine), len,
+           ns_per_frame, (len * 1000.0) / ns_per_frame);
+    (void)sink;
+}
+
+int main(void) {
+    static const uint16_t sizes[] = {8, 255};
+    uint8_t frame[255];
+
+    for (size_t i = 0; i < sizeof(frame); i++)
+        frame[i] = (uint8_t)(i * 31 + 7);
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        for (int e = MODBUS_CRC16_ENGINE_AUTO; e < MODBUS_CRC16_ENGINE_COUNT; e++) {
+            if (modbus_crc16_engine_supported((modbus_crc16_engine_et)e))
+                run((modbus_crc16_engine_et)e, frame, sizes[s]);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,188 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+
+#include "modbus_server_group.h"
+#include "modbus_tcp.h"
+
+#define MAX_CLIENTS 4096
+#define SCALING_CLIENTS 256
+#define QTY 10
+#define RUN_NS 1000000000ull
+
+// Each master keeps one request in flight and sends the next one as soon as the answer is complete
+typedef struct {
+    int fd;
+    size_t pending;
+} client_st;
+
+// One load generator thread drives a slice of the connections from its own epoll loop
+typedef struct {
+    pthread_t thread;
+    client_st *clients;
+    int count;
+    uint16_t port;
+    uint64_t completed;
+    uint64_t elapsed;
+} loader_st;
+
+static uint8_t request[MODBUS_TCP_MAX_ADU_SIZE];
+static uint16_t request_len;
+static const size_t response_len = MODBUS_MBAP_HEADER_SIZE + 2 + QTY * 2;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static int read_regs(void *arg, uint8_t unit_id, uint16_t start_addr, uint16_t qty, uint16_t *regs) {
+    (void)arg;
+    (void)unit_id;
+    for (uint16_t i = 0; i < qty; i++)
+        regs[i] = start_addr + i;
+    return 0;
+}
+
+static int connect_client(uint16_t port) {
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        perror("connect");
+        exit(1);
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    return fd;
+}
+
+static void *loader_main(void *arg) {
+    loader_st *l = arg;
+    int ep = epoll_create1(0);
+    for (int i = 0; i < l->count; i++) {
+        client_st *c = &l->clients[i];
+        c->fd = connect_client(l->port);
+        c->pending = response_len;
+        struct epoll_event ev = {.events = EPOLLIN, .data.ptr = c};
+        epoll_ctl(ep, EPOLL_CTL_ADD, c->fd, &ev);
+        send(c->fd, request, request_len, 0);
+    }
+
+    struct epoll_event events[256];
+    uint8_t sink[4096];
+    uint64_t start = now_ns();
+
+    while (now_ns() - start < RUN_NS) {
+        int ready = epoll_wait(ep, events, 256, 100);
+        for (int e = 0; e < ready; e++) {
+            client_st *c = events[e].data.ptr;
+            ssize_t got = recv(c->fd, sink, sizeof(sink), MSG_DONTWAIT);
+            if (got <= 0)
+                continue;
+            c->pending -= (size_t)got;
+            if (c->pending == 0) {
+                l->completed++;
+                c->pending = response_len;
+                send(c->fd, request, request_len, 0);
+            }
+        }
+    }
+    l->elapsed = now_ns() - start;
+
+    for (int i = 0; i < l->count; i++)
+        close(l->clients[i].fd);
+    close(ep);
+    return NULL;
+}
+
+// Serve `connections` masters from `shards` event loops, with as many load generator threads
+static double run(uint32_t shards, int connections) {
+    static client_st clients[MAX_CLIENTS];
+    loader_st loaders[MODBUS_SERVER_GROUP_MAX_SHARDS];
+    modbus_server_group_st group;
+    modbus_server_config_st cfg = {
+        .bind_addr = "127.0.0.1",
+        .max_connections = MAX_CLIENTS,
+        .slave_id = 1,
+        .read_cb = read_regs,
+    };
+
+    if (modbus_server_group_init(&group, &cfg, shards) != 0 || modbus_server_group_start(&group) != 0) {
+        perror("modbus_server_group");
+        exit(1);
+    }
+
+    int per_loader = connections / (int)shards;
+    for (uint32_t i = 0; i < shards; i++) {
+        loaders[i] = (loader_st){.clients = clients + i * per_loader, .port = group.port,
+                                 .count = (i + 1 == shards) ? connections - (int)i * per_loader : per_loader};
+        pthread_create(&loaders[i].thread, NULL, loader_main, &loaders[i]);
+    }
+
+    uint64_t completed = 0, elapsed = 0;
+    for (uint32_t i = 0; i < shards; i++) {
+        pthread_join(loaders[i].thread, NULL);
+        completed += loaders[i].completed;
+        elapsed = (loaders[i].elapsed > elapsed) ? loaders[i].elapsed : elapsed;
+    }
+    modbus_server_group_deinit(&group);
+
+    return completed * 1e9 / elapsed;
+}
+
+int main(int argc, char **argv) {
+    static const int steps[] = {1, 4, 16, 64, 256, 1024, 4096};
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    uint32_t max_shards = (argc > 1) ? (uint32_t)atoi(argv[1]) : (uint32_t)cpus;
+
+    if (max_shards < 1 || max_shards > MODBUS_SERVER_GROUP_MAX_SHARDS) {
+        fprintf(stderr, "usage: %s [max_shards]\n", argv[0]);
+        return 1;
+    }
+
+    // Each connection costs two descriptors in this process
+    struct rlimit lim;
+    getrlimit(RLIMIT_NOFILE, &lim);
+    lim.rlim_cur = lim.rlim_max;
+    setrlimit(RLIMIT_NOFILE, &lim);
+
+    modbus_tcp_master_ctx_st master;
+    modbus_tcp_master_ctx_init(&master, 1);
+    request_len = encode_tcp_read_request(&master, 1, 0, QTY, request, sizeof(request), NULL);
+
+    printf("# one event loop, growing number of connections\n");
+    for (size_t s = 0; s < sizeof(steps) / sizeof(steps[0]); s++) {
+        if ((rlim_t)steps[s] * 2 + 16 > lim.rlim_cur) {
+            printf("%5d connections  skipped (RLIMIT_NOFILE %llu)\n", steps[s], (unsigned long long)lim.rlim_cur);
+            continue;
+        }
+        double rps = run(1, steps[s]);
+        printf("%5d connections  %10.0f req/s  %8.1f us/req per connection\n", steps[s], rps, steps[s] * 1e6 / rps);
+    }
+
+    printf("# %d connections, one SO_REUSEPORT shard per core (%ld online CPUs)\n", SCALING_CLIENTS, cpus);
+    double base = 0;
+    for (uint32_t shards = 1; shards <= max_shards; shards++) {
+        double rps = run(shards, SCALING_CLIENTS);
+        if (shards == 1)
+            base = rps;
+        printf("%5u shards       %10.0f req/s  speedup %5.2fx  efficiency %5.1f%%\n", shards, rps, rps / base,
+               100.0 * rps / (base * shards));
+    }
+    return 0;
+}
@@ -0,0 +1,210 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include "modbus_master.h"
+#include "modbus_server_group.h"
+#include "modbus_slave.h"
+#include "modbus_tcp.h"
+#include "modbus_utils.h"
+
+// Each microbenchmark runs ROUNDS times for ROUND_NS and keeps the fastest round
+#define ROUNDS 5
+#define ROUND_NS 20000000ull
+#define LOOPBACK_NS 1000000000ull
+#define MAX_SAMPLES (1u << 22)
+#define SLAVE_ID 1
+
+static FILE *results;
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void report(const char *benchmark, uint16_t qty, const char *metric, double value) {
+    printf("%-22s %4u  %-10s %12.2f\n", benchmark, qty, metric, value);
+    fprintf(results, "%s,%u,%s,%.2f\n", benchmark, qty, metric, value);
+}
+
+static uint16_t frame_qty;
+static uint8_t request[MODBUS_RTU_MAX_ADU_SIZE], response[MODBUS_RTU_MAX_ADU_SIZE];
+static uint16_t request_len, response_len;
+static uint16_t regs[MODBUS_MAX_REGS];
+static modbus_master_ctx_st master;
+static modbus_slave_ctx_st slave;
+static volatile uint32_t sink;
+
+static void op_crc16(void) {
+    sink += modbus_crc16(response, response_len);
+}
+
+static void op_encode_request(void) {
+    sink += encode_read_request(&master, SLAVE_ID, (uint16_t)sink & 0xFF, frame_qty, request, sizeof(request));
+}
+
+static void op_decode_request(void) {
+    uint8_t slave_id;
+    uint16_t addr, qty;
+    sink += (uint32_t)decode_read_request(&slave, request, request_len, &slave_id, &addr, &qty) + qty;
+}
+
+static void op_encode_response(void) {
+    sink += encode_read_response(&slave, SLAVE_ID, regs, frame_qty, response, sizeof(response));
+}
+
+static void op_decode_response(void) {
+    sink += (uint32_t)decode_read_response(&master, response, response_len, regs, MODBUS_MAX_REGS);
+}
+
+// Best ns/op over ROUNDS; batches of 64 calls keep clock reads out of the figure
+static double time_op(void (*op)(void)) {
+    double best = 1e18;
+    for (int r = 0; r < ROUNDS; r++) {
+        uint64_t calls = 0, start = now_ns(), elapsed;
+        do {
+            for (int i = 0; i < 64; i++)
+                op();
+            calls += 64;
+        } while ((elapsed = now_ns() - start) < ROUND_NS);
+        double ns = (double)elapsed / calls;
+        if (ns < best)
+            best = ns;
+    }
+    return best;
+}
+
+static void run_codec(void) {
+    static const uint16_t sizes[] = {1, 2, 4, 8, 16, 32, 64, 125};
+    static const struct {
+        const char *name;
+        void (*op)(void);
+    } ops[] = {
+        {"crc16", op_crc16},
+        {"encode_read_request", op_encode_request},
+        {"decode_read_request", op_decode_request},
+        {"encode_read_response", op_encode_response},
+        {"decode_read_response", op_decode_response},
+    };
+
+    modbus_master_ctx_init(&master);
+    modbus_slave_ctx_init(&slave);
+    set_device_slave_id(&slave, SLAVE_ID);
+    for (int i = 0; i < MODBUS_MAX_REGS; i++)
+        regs[i] = (uint16_t)(i * 257);
+
+    for (size_t s = 0; s < sizeof(sizes) / sizeof(sizes[0]); s++) {
+        frame_qty = sizes[s];
+        request_len = encode_read_request(&master, SLAVE_ID, 0, frame_qty, request, sizeof(request));
+        response_len = encode_read_response(&slave, SLAVE_ID, regs, frame_qty, response, sizeof(response));
+        if (request_len == 0 || response_len == 0) {
+            fprintf(stderr, "encode failed for %u registers\n", frame_qty);
+            exit(1);
+        }
+        for (size_t o = 0; o < sizeof(ops) / sizeof(ops[0]); o++)
+            report(ops[o].name, frame_qty, "ns_per_op", time_op(ops[o].op));
+    }
+}
+
+static int read_regs(void *arg, uint8_t unit_id, uint16_t start_addr, uint16_t qty, uint16_t *out) {
+    (void)arg;
+    (void)unit_id;
+    for (uint16_t i = 0; i < qty; i++)
+        out[i] = start_addr + i;
+    return 0;
+}
+
+static int cmp_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return (x > y) - (x < y);
+}
+
+// One blocking request at a time against the epoll server, timed end to end
+static void run_loopback(uint16_t port, uint16_t qty, uint32_t *samples) {
+    struct sockaddr_in addr = {.sin_family = AF_INET, .sin_port = htons(port)};
+    modbus_tcp_master_ctx_st ctx;
+    uint8_t req[MODBUS_TCP_MAX_ADU_SIZE], resp[MODBUS_TCP_MAX_ADU_SIZE];
+    uint16_t values[MODBUS_MAX_REGS];
+    uint32_t n = 0;
+
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        perror("connect");
+        exit(1);
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+    modbus_tcp_master_ctx_init(&ctx, 1);
+
+    size_t expected = MODBUS_MBAP_HEADER_SIZE + 2 + qty * 2;
+    uint64_t start = now_ns(), t0 = start;
+    while (t0 - start < LOOPBACK_NS && n < MAX_SAMPLES) {
+        uint16_t len = encode_tcp_read_request(&ctx, SLAVE_ID, 0, qty, req, sizeof(req), NULL);
+        if (write(fd, req, len) != len)
+            exit(1);
+        for (size_t got = 0; got < expected;) {
+            ssize_t r = read(fd, resp + got, expected - got);
+            if (r <= 0)
+                exit(1);
+            got += (size_t)r;
+        }
+        if (decode_tcp_response(&ctx, resp, expected, values, MODBUS_MAX_REGS, NULL) != qty)
+            exit(1);
+        uint64_t t1 = now_ns();
+        samples[n++] = (uint32_t)(t1 - t0);
+        t0 = t1;
+    }
+    close(fd);
+
+    qsort(samples, n, sizeof(*samples), cmp_u32);
+    report("loopback_tcp", qty, "req_per_s", n * 1e9 / (t0 - start));
+    report("loopback_tcp", qty, "p50_ns", samples[n / 2]);
+    report("loopback_tcp", qty, "p99_ns", samples[(uint64_t)n * 99 / 100]);
+    report("loopback_tcp", qty, "p99.9_ns", samples[(uint64_t)n * 999 / 1000]);
+}
+
+int main(int argc, char **argv) {
+    static const uint16_t loopback_sizes[] = {1, 10, 125};
+    const char *path = (argc > 1) ? argv[1] : "bench_results.csv";
+    modbus_server_group_st group;
+    modbus_server_config_st cfg = {
+        .bind_addr = "127.0.0.1",
+        .max_connections = 4,
+        .slave_id = SLAVE_ID,
+        .read_cb = read_regs,
+    };
+
+    results = fopen(path, "w");
+    if (!results) {
+        perror(path);
+        return 1;
+    }
+    fprintf(results, "benchmark,registers,metric,value\n");
+    printf("# %-20s %4s  %-10s %12s\n", "benchmark", "regs", "metric", "value");
+
+    run_codec();
+
+    uint32_t *samples = malloc(MAX_SAMPLES * sizeof(*samples));
+    if (!samples || modbus_server_group_init(&group, &cfg, 1) != 0 || modbus_server_group_start(&group) != 0) {
+        perror("loopback server");
+        return 1;
+    }
+    for (size_t s = 0; s < sizeof(loopback_sizes) / sizeof(loopback_sizes[0]); s++)
+        run_loopback(group.port, loopback_sizes[s], samples);
+    modbus_server_group_deinit(&group);
+    free(samples);
+
+    fclose(results);
+    printf("# results written to %s\n", path);
+    return 0;
+}
@@ -0,0 +1,178 @@
+#define _GNU_SOURCE
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <arpa/inet.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+
+#include "modbus_batch.h"
+#include "modbus_server_group.h"
+#include "modbus_udp.h"
+
+#define QTY 10
+#define RUN_NS 1000000000ull
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static int read_regs(void *arg, uint8_t unit_id, uint16_t start_addr, uint16_t qty, uint16_t *regs) {
+    (void)arg;
+    (void)unit_id;
+    for (uint16_t i = 0; i < qty; i++)
+        regs[i] = start_addr + i;
+    return 0;
+}
+
+static void *udp_server_thread(void *arg) {
+    modbus_udp_server_run(arg);
+    return NULL;
+}
+
+// Windows of `depth` reads on one TCP connection, sent with writev()
+static double run_tcp(uint16_t port, uint8_t depth) {
+    static uint16_t regs[MODBUS_TCP_MAX_PIPELINE][QTY];
+    static uint8_t rx[8192];
+    struct sockaddr_in addr = {.sin_family = AF_INET, .sin_port = htons(port)};
+    modbus_tcp_master_ctx_st ctx;
+    modbus_batch_st batch;
+    uint64_t done = 0;
+
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (fd < 0 || connect(fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) {
+        perror("connect");
+        exit(1);
+    }
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    modbus_tcp_master_ctx_init(&ctx, depth);
+    modbus_batch_init(&batch, depth, depth * 12);
+
+    uint64_t start = now_ns();
+    while (now_ns() - start < RUN_NS) {
+        modbus_batch_reset(&batch);
+        for (uint8_t i = 0; i < depth; i++)
+            modbus_batch_add_read(&batch, &ctx, 1, i * QTY, QTY, regs[i]);
+        modbus_batch_writev(&batch, fd, NULL);
+
+        size_t rx_len = 0, consumed;
+        while (batch.answered < batch.count) {
+            ssize_t n = read(fd, rx + rx_len, sizeof(rx) - rx_len);
+            if (n <= 0)
+                exit(1);
+            rx_len += (size_t)n;
+            modbus_batch_decode(&batch, &ctx, rx, rx_len, &consumed);
+            memmove(rx, rx + consumed, rx_len - consumed);
+            rx_len -= consumed;
+        }
+        done += batch.count;
+    }
+    double rps = done * 1e9 / (now_ns() - start);
+
+    modbus_batch_free(&batch);
+    close(fd);
+    return rps;
+}
+
+// Windows of `depth` reads to each of `devices` UDP servers, sent with sendmmsg()
+static double run_udp(modbus_udp_server_st *servers, int devices, uint8_t depth, double *per_call) {
+    static uint16_t regs[MODBUS_TCP_MAX_PIPELINE][QTY];
+    modbus_udp_master_st master;
+    modbus_batch_st batch;
+    uint64_t done = 0, lost = 0;
+
+    modbus_udp_master_init(&master, devices);
+    modbus_batch_init(&batch, devices * depth, devices * depth * 12);
+    for (int d = 0; d < devices; d++)
+        modbus_udp_master_add_device(&master, "127.0.0.1", modbus_udp_server_port(&servers[d]), depth);
+
+    uint64_t start = now_ns();
+    while (now_ns() - start < RUN_NS) {
+        modbus_batch_reset(&batch);
+        for (int d = 0; d < devices; d++)
+            for (uint8_t i = 0; i < depth; i++)
+                modbus_batch_add_read(&batch, modbus_udp_master_ctx(&master, d), 1, i * QTY, QTY, regs[i]);
+        modbus_udp_master_send(&master, &batch);
+
+        while (batch.answered < batch.count) {
+            if (modbus_udp_master_recv(&master, &batch, 100) <= 0) {
+                // A datagram was dropped: give up on the rest of the window
+                for (uint32_t i = 0; i < batch.count; i++)
+                    if (!batch.frames[i].answered)
+                        modbus_tcp_master_cancel(batch.frames[i].ctx, batch.frames[i].transaction_id);
+                lost += batch.count - batch.answered;
+                break;
+            }
+        }
+        done += batch.answered;
+    }
+    double rps = done * 1e9 / (now_ns() - start);
+    *per_call = master.stats.rx_calls ? (double)master.stats.rx_datagrams / master.stats.rx_calls : 0;
+    if (lost > 0)
+        printf("# udp: %llu requests lost\n", (unsigned long long)lost);
+
+    modbus_batch_free(&batch);
+    modbus_udp_master_deinit(&master);
+    return rps;
+}
+
+int main(void) {
+    enum { UDP_DEVICES = 16 };
+    static const uint8_t depths[] = {1, 4, 16};
+    static modbus_udp_server_st udp[UDP_DEVICES];
+    pthread_t threads[UDP_DEVICES];
+    modbus_server_group_st group;
+    modbus_server_config_st cfg = {
+        .bind_addr = "127.0.0.1",
+        .max_connections = 16,
+        .slave_id = 1,
+        .read_cb = read_regs,
+    };
+
+    if (modbus_server_group_init(&group, &cfg, 1) != 0 || modbus_server_group_start(&group) != 0) {
+        perror("modbus_server_group");
+        return 1;
+    }
+    for (int d = 0; d < UDP_DEVICES; d++) {
+        if (modbus_udp_server_init(&udp[d], &cfg) != 0) {
+            perror("modbus_udp_server_init");
+            return 1;
+        }
+        pthread_create(&threads[d], NULL, udp_server_thread, &udp[d]);
+    }
+
+    printf("# one device, reads of %d registers\n", QTY);
+    printf("# depth  %-20s %-20s %s\n", "tcp (writev)", "udp (sendmmsg)", "datagrams/recvmmsg");
+    for (size_t i = 0; i < sizeof(depths); i++) {
+        double per_call;
+        double tcp = run_tcp(group.port, depths[i]);
+        double dgram = run_udp(udp, 1, depths[i], &per_call);
+        printf("%7u  %10.0f req/s     %10.0f req/s     %5.1f\n", depths[i], tcp, dgram, per_call);
+    }
+
+    printf("# %d UDP devices on one master socket\n", UDP_DEVICES);
+    printf("# depth  %-20s %s\n", "udp (sendmmsg)", "datagrams/recvmmsg");
+    for (size_t i = 0; i < sizeof(depths); i++) {
+        double per_call;
+        double dgram = run_udp(udp, UDP_DEVICES, depths[i], &per_call);
+        printf("%7u  %10.0f req/s     %5.1f\n", depths[i], dgram, per_call);
+    }
+
+    for (int d = 0; d < UDP_DEVICES; d++) {
+        modbus_udp_server_stop(&udp[d]);
+        pthread_join(threads[d], NULL);
+        modbus_udp_server_deinit(&udp[d]);
+    }
+    modbus_server_group_deinit(&group);
+    return 0;
+}
@@ -0,0 +1,3 @@
+gcc -Iinc -I../inc -Wall -Wextra -std=c11 -O2 ../src/modbus_cache.c ../src/modbus_bank.c ../src/modbus_slave.c ../src/modbus_master.c ../src/modbus_pdu.c ../src/modbus_utils.c ../src/modbus_crc.c ../src/modbus_swap.c bench_cache.c -o bench_cache
+
+./bench_cache
@@ -0,0 +1,3 @@
+gcc -Iinc -I../inc -Wall -Wextra -std=c11 -O2 ../src/modbus_cov.c bench_cov.c -o bench_cov
+
+./bench_cov
@@ -0,0 +1,3 @@
+gcc -Iinc -I../inc -Wall -Wextra -std=c11 -O2 ../src/modbus_crc.c ../src/modbus_utils.c bench_crc16.c -o bench_crc16
+
+./bench_crc16
@@ -0,0 +1,3 @@
+gcc -Iinc -I../inc -Wall -Wextra -std=c11 -O2 -pthread ../src/modbus_udp.c ../src/modbus_batch.c ../src/modbus_server_group.c ../src/modbus_server.c ../src/modbus_host.c ../src/modbus_bank.c ../src/modbus_tcp.c ../src/modbus_stream.c ../src/modbus_slave.c ../src/modbus_pdu.c ../src/modbus_utils.c ../src/modbus_crc.c ../src/modbus_swap.c ../src/modbus_stats.c ../src/modbus_trace.c bench_udp.c -o bench_udp
+
+./bench_udp "$@"
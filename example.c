@@ -8,6 +8,11 @@
 int main(void)
 {
     uint8_t buffer[256] = {0};
+    modbus_master_ctx_st master_ctx;
+    modbus_slave_ctx_st slave_ctx;
+
+    modbus_master_ctx_init(&master_ctx);
+    modbus_slave_ctx_init(&slave_ctx);
 
     printf("=== Modbus Example ===\n");
 
@@ -16,9 +21,9 @@ int main(void)
     uint16_t req_qty = 2;
     uint8_t slave_id = 1;
 
-    set_device_slave_id(slave_id);
+    set_device_slave_id(&slave_ctx, slave_id);
 
-    uint16_t frame_len = encode_read_request(slave_id, req_addr, req_qty, buffer, sizeof(buffer));
+    uint16_t frame_len = encode_read_request(&master_ctx, slave_id, req_addr, req_qty, buffer, sizeof(buffer));
     if (frame_len == 0)
     {
         printf("[ERROR] Failed to create Modbus Read Request\n");
@@ -36,7 +41,7 @@ int main(void)
     uint16_t recv_req_addr = 0;
     uint16_t recv_req_qty = 0;
     uint8_t recv_slave_id = 0;
-    int err = decode_read_request(buffer, sizeof(buffer), &recv_slave_id, &recv_req_addr, &recv_req_qty);
+    int err = decode_read_request(&slave_ctx, buffer, sizeof(buffer), &recv_slave_id, &recv_req_addr, &recv_req_qty);
     if (err != 0)
     {
         printf("[ERROR] Failed to decode Modbus Read Request: %d\n", err);
@@ -50,7 +55,7 @@ int main(void)
     memset(buffer, 0, sizeof(buffer));
     uint16_t regs[2] = {0x03E8, 0x1388};
 
-    frame_len = encode_read_response(slave_id, regs, 2, buffer, sizeof(buffer));
+    frame_len = encode_read_response(&slave_ctx, slave_id, regs, 2, buffer, sizeof(buffer));
     if (frame_len == 0)
     {
         printf("[ERROR] Failed to create Modbus Read Response\n");
@@ -66,7 +71,7 @@ int main(void)
 
     // --- Decode the Read Response ---
     uint16_t read_regs[2] = {0};
-    int ret = decode_read_response(buffer, sizeof(buffer), read_regs, 2);
+    int ret = decode_read_response(&master_ctx, buffer, sizeof(buffer), read_regs, 2);
 
     if (ret < 0)
     {
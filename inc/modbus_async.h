@@ -0,0 +1,258 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "modbus_defines.h"
+#include "modbus_stats.h"
+#include "modbus_stream.h"
+#include "modbus_tcp.h"
+
+/**
+ * @file modbus_async.h
+ * @brief Asynchronous Modbus TCP master for many devices from one thread.
+ *
+ * Requests are encoded into the transmit buffer of their connection as
+ * soon as they are issued and the call returns at once. Each call to
+ * modbus_async_poll() then hands all queued bytes to the kernel (one send
+ * per connection, whatever the number of requests queued on it), waits
+ * for completions, reassembles responses in place and reports every
+ * decoded response through the callback given with its request.
+ *
+ * Two backends share this API:
+ *   - io_uring: every connection keeps one receive armed; sends and
+ *     receives of all connections are submitted and reaped with a single
+ *     io_uring_enter() per poll. The ring is set up with raw system calls.
+ *   - epoll: non-blocking sockets with edge-triggered readiness, used when
+ *     io_uring is unavailable (old kernel, seccomp) or requested.
+ *
+ * Up to MODBUS_TCP_MAX_PIPELINE requests may be in flight per connection,
+ * so a few hundred devices keep thousands of transactions outstanding.
+ * An engine is not thread-safe: create and poll it on one thread, and
+ * run one engine per thread.
+ */
+
+/** @brief Receive ring capacity per connection, in bytes */
+#define MODBUS_ASYNC_RX_CAPACITY 4096
+
+/** @brief Transmit buffer size per connection: a full pipeline of the largest requests */
+#define MODBUS_ASYNC_TX_SIZE (MODBUS_TCP_MAX_PIPELINE * MODBUS_TCP_MAX_ADU_SIZE)
+
+/** @brief Largest number of connections per engine (the io_uring sizes its rings for two operations each) */
+#define MODBUS_ASYNC_MAX_CONNECTIONS 16384
+
+/** @brief Completion status: no response within the configured timeout */
+#define MODBUS_ASYNC_TIMEOUT (-9)
+
+/** @brief Completion status: the connection was closed or failed */
+#define MODBUS_ASYNC_CLOSED (-10)
+
+/**
+ * @brief I/O backend.
+ */
+typedef enum modbus_async_backend_e
+{
+    MODBUS_ASYNC_AUTO = 0,  /**< io_uring if the kernel allows it, else epoll */
+    MODBUS_ASYNC_IO_URING,  /**< io_uring only */
+    MODBUS_ASYNC_EPOLL      /**< epoll only */
+} modbus_async_backend_et;
+
+/**
+ * @brief Completion callback.
+ *
+ * @param arg User argument given with the request
+ * @param conn Connection the request was sent on
+ * @param status Number of registers read (0 for writes), a decode_tcp_response() error code,
+ *               MODBUS_ASYNC_TIMEOUT or MODBUS_ASYNC_CLOSED
+ * @param regs Register values, host order (NULL unless status > 0)
+ *
+ * The callback may issue new requests.
+ */
+typedef void (*modbus_async_done_fn)(void *arg, uint32_t conn, int status, const uint16_t *regs);
+
+/**
+ * @brief Engine configuration.
+ */
+typedef struct modbus_async_config_s
+{
+    uint32_t max_connections;        /**< Number of connection slots (1..MODBUS_ASYNC_MAX_CONNECTIONS) */
+    modbus_async_backend_et backend; /**< I/O backend */
+    uint32_t timeout_ms;             /**< Response timeout per request (0 = none) */
+    modbus_stats_shard_st *stats;    /**< Frame, error and latency counters of this thread (NULL = off) */
+} modbus_async_config_st;
+
+/**
+ * @brief One outstanding request.
+ */
+typedef struct modbus_async_call_s
+{
+    bool in_use;             /**< Slot holds an unanswered request */
+    uint16_t transaction_id; /**< Transaction ID of the request */
+    modbus_async_done_fn cb; /**< Completion callback */
+    void *arg;               /**< User argument for cb */
+    uint64_t deadline_ns;    /**< CLOCK_MONOTONIC time the request times out at */
+    uint64_t issued_ns;      /**< CLOCK_MONOTONIC time the request was issued (kept with stats only) */
+} modbus_async_call_st;
+
+/**
+ * @brief One device connection.
+ */
+typedef struct modbus_async_conn_s
+{
+    int fd;                          /**< Connected socket, owned by the engine */
+    bool failed;                     /**< Closed by the peer or failed; no more requests */
+    bool queued;                     /**< On the engine's list of connections with bytes to send */
+    bool writable;                   /**< epoll: socket accepted the last send completely */
+    bool recv_armed;                 /**< io_uring: a receive is in flight */
+    bool send_armed;                 /**< io_uring: a send is in flight */
+    size_t tx_len;                   /**< Unsent bytes at the start of tx */
+    modbus_tcp_master_ctx_st master; /**< Transaction IDs of the pipeline */
+    modbus_async_call_st calls[MODBUS_TCP_MAX_PIPELINE]; /**< Callbacks of the outstanding requests */
+    modbus_stream_st rx;             /**< Receive reassembler */
+    uint8_t rx_storage[MODBUS_STREAM_STORAGE_SIZE(MODBUS_ASYNC_RX_CAPACITY)]; /**< Receive ring */
+    uint8_t tx[MODBUS_ASYNC_TX_SIZE]; /**< Requests not yet sent */
+} modbus_async_conn_st;
+
+/**
+ * @brief io_uring rings mapped from the kernel.
+ */
+typedef struct modbus_async_uring_s
+{
+    int fd;                    /**< Ring file descriptor */
+    void *ring_map;            /**< Submission and completion rings, one mapping */
+    size_t ring_map_size;      /**< Size of ring_map */
+    void *sqes;                /**< Submission queue entries */
+    size_t sqes_size;          /**< Size of sqes */
+    uint32_t *sq_head;         /**< Kernel-owned submission head */
+    uint32_t *sq_tail;         /**< Submission tail */
+    uint32_t *sq_array;        /**< Submission index array */
+    uint32_t sq_mask;          /**< Submission ring mask */
+    uint32_t sq_entries;       /**< Submission ring size */
+    uint32_t *cq_head;         /**< Completion head */
+    uint32_t *cq_tail;         /**< Kernel-owned completion tail */
+    void *cqes;                /**< Completion queue entries */
+    uint32_t cq_mask;          /**< Completion ring mask */
+    uint32_t to_submit;        /**< Entries prepared since the last io_uring_enter() */
+} modbus_async_uring_st;
+
+/**
+ * @brief Engine counters.
+ */
+typedef struct modbus_async_stats_s
+{
+    uint64_t requests;  /**< Requests issued */
+    uint64_t responses; /**< Responses matched to a request */
+    uint64_t timeouts;  /**< Requests expired */
+    uint64_t failures;  /**< Requests failed by a lost connection */
+    uint64_t syscalls;  /**< io_uring_enter(), epoll_wait(), send() and recv() calls */
+} modbus_async_stats_st;
+
+/**
+ * @brief Engine state.
+ */
+typedef struct modbus_async_s
+{
+    modbus_async_backend_et backend; /**< Backend in use (never MODBUS_ASYNC_AUTO) */
+    modbus_async_uring_st ring;      /**< io_uring backend */
+    int epoll_fd;                    /**< epoll backend */
+    modbus_async_conn_st *conns;     /**< Connection slots */
+    uint32_t max_connections;        /**< Number of slots */
+    uint32_t count;                  /**< Slots in use */
+    uint32_t *send_queue;            /**< Connections with bytes to send */
+    uint32_t send_queued;            /**< Entries in send_queue */
+    uint32_t in_flight;              /**< Requests issued and not completed */
+    uint32_t completed;              /**< Callbacks run by the current poll */
+    uint64_t timeout_ns;             /**< Response timeout (0 = none) */
+    uint64_t next_deadline_ns;       /**< Earliest deadline of an outstanding request */
+    modbus_async_stats_st stats;     /**< Counters */
+    modbus_stats_shard_st *stats_shard; /**< Detailed counters, or NULL */
+} modbus_async_st;
+
+/**
+ * @brief Create an engine.
+ *
+ * @param engine Engine to initialize
+ * @param cfg Configuration
+ * @return 0 on success, or a negative error code:
+ *         -1: Invalid arguments
+ *         -2: Requested backend unavailable
+ *         -3: Out of memory
+ */
+int modbus_async_init(modbus_async_st *engine, const modbus_async_config_st *cfg);
+
+/**
+ * @brief Close every connection and release the engine.
+ *
+ * @param engine Engine
+ *
+ * Outstanding requests are dropped without calling their callbacks.
+ */
+void modbus_async_deinit(modbus_async_st *engine);
+
+/**
+ * @brief Hand a connected TCP socket to the engine.
+ *
+ * @param engine Engine
+ * @param fd Connected socket; the engine closes it in modbus_async_deinit()
+ * @param max_outstanding Pipeline depth on this connection (1..MODBUS_TCP_MAX_PIPELINE)
+ * @return Connection index, or a negative error code:
+ *         -1: Invalid arguments
+ *         -2: No free connection slot
+ *         -3: Socket could not be registered
+ */
+int modbus_async_add_connection(modbus_async_st *engine, int fd, uint8_t max_outstanding);
+
+/**
+ * @brief Queue a request around any PDU built with the modbus_pdu_encode_*() functions.
+ *
+ * @param engine Engine
+ * @param conn Connection index
+ * @param unit_id Unit identifier
+ * @param pdu Request PDU
+ * @param pdu_len Length of the request PDU
+ * @param cb Completion callback (may be NULL)
+ * @param arg User argument for cb
+ * @return Transaction ID, or a negative error code:
+ *         -1: Invalid arguments
+ *         -2: Connection failed
+ *         -3: Pipeline full
+ *         -4: Transmit buffer full: bytes of cancelled requests are still
+ *             waiting to be sent; retry after the next modbus_async_poll()
+ *
+ * The request is sent by the next modbus_async_poll().
+ */
+int modbus_async_request(modbus_async_st *engine, uint32_t conn, uint8_t unit_id, const uint8_t *pdu,
+                         size_t pdu_len, modbus_async_done_fn cb, void *arg);
+
+/**
+ * @brief Queue a Read Holding Registers request.
+ *
+ * @param engine Engine
+ * @param conn Connection index
+ * @param unit_id Unit identifier
+ * @param addr First register address
+ * @param qty Number of registers (1..MODBUS_MAX_REGS)
+ * @param cb Completion callback (may be NULL)
+ * @param arg User argument for cb
+ * @return Transaction ID, or a negative error code as modbus_async_request()
+ */
+int modbus_async_read(modbus_async_st *engine, uint32_t conn, uint8_t unit_id, uint16_t addr, uint16_t qty,
+                      modbus_async_done_fn cb, void *arg);
+
+/**
+ * @brief Send queued requests, wait for completions and run their callbacks.
+ *
+ * @param engine Engine
+ * @param timeout_ms Longest wait for a completion (-1 = until one arrives or a request times out)
+ * @return Number of callbacks run, or -1 on error
+ */
+int modbus_async_poll(modbus_async_st *engine, int timeout_ms);
+
+/**
+ * @brief Number of requests issued and not completed.
+ *
+ * @param engine Engine
+ * @return Outstanding request count
+ */
+uint32_t modbus_async_in_flight(const modbus_async_st *engine);
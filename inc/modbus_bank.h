@@ -0,0 +1,216 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include <sys/types.h>
+
+#include "modbus_defines.h"
+#include "modbus_slave.h"
+#include "modbus_crc.h"
+
+/**
+ * @file modbus_bank.h
+ * @brief Holding-register bank shared by producer and server threads.
+ *
+ * The 65536 registers are split into cache-line-aligned segments, each with
+ * its own sequence counter (seqlock). Writers make the counter odd, update
+ * the segment and make it even again. Readers copy the registers between
+ * two reads of the counters and retry if any of them was odd or moved.
+ *
+ * Readers never write shared memory and never block writers, so any
+ * number of server threads can serve reads while field I/O threads update
+ * values. Writers to the same segment serialize on its counter.
+ *
+ * Each segment also keeps a wire-order (big-endian) shadow of its registers
+ * and the CRC of every MODBUS_BANK_CRC_BLOCK_REGS-register block of that
+ * shadow, both refreshed on write. Read responses are then built from the
+ * shadow without any byte swap, and their CRC is chained from the cached
+ * block CRCs; only partial blocks at the ends of the range are hashed.
+ */
+
+/** @brief Number of holding registers in a bank */
+#define MODBUS_BANK_REGS 65536
+
+/** @brief Registers per seqlock segment */
+#define MODBUS_BANK_SEGMENT_REGS 64
+
+/** @brief Number of segments in a bank */
+#define MODBUS_BANK_SEGMENTS (MODBUS_BANK_REGS / MODBUS_BANK_SEGMENT_REGS)
+
+/** @brief Registers covered by one cached CRC of the wire image */
+#define MODBUS_BANK_CRC_BLOCK_REGS 16
+
+/** @brief Cached CRC blocks per segment */
+#define MODBUS_BANK_SEGMENT_BLOCKS (MODBUS_BANK_SEGMENT_REGS / MODBUS_BANK_CRC_BLOCK_REGS)
+
+/** @brief Segments a read of at most MODBUS_MAX_REGS registers can touch */
+#define MODBUS_BANK_MAX_READ_SEGMENTS ((MODBUS_MAX_REGS + MODBUS_BANK_SEGMENT_REGS - 2) / MODBUS_BANK_SEGMENT_REGS + 1)
+
+/**
+ * @brief One seqlock-protected group of registers.
+ */
+typedef struct modbus_bank_segment_s
+{
+    _Alignas(MODBUS_CACHE_LINE_SIZE) _Atomic uint32_t seq; /**< Even when stable, odd while being written */
+    uint16_t regs[MODBUS_BANK_SEGMENT_REGS];                /**< Register values, host order */
+    uint8_t wire[MODBUS_BANK_SEGMENT_REGS * 2];             /**< Same registers, big-endian */
+    uint16_t block_crc[MODBUS_BANK_SEGMENT_BLOCKS];         /**< modbus_crc16_accumulate(0, block) of each wire block */
+} modbus_bank_segment_st;
+
+/**
+ * @brief Holding-register bank.
+ */
+typedef struct modbus_bank_s
+{
+    modbus_bank_segment_st segments[MODBUS_BANK_SEGMENTS]; /**< Segments in address order */
+    modbus_crc16_shift_st block_shift;                     /**< Advances a CRC over one wire block */
+} modbus_bank_st;
+
+/**
+ * @brief Zero all registers and build the CRC chaining tables.
+ *
+ * @param bank Bank to initialize
+ * @return 0 on success, -1 if bank is NULL
+ *
+ * Must not run concurrently with readers or writers.
+ */
+int modbus_bank_init(modbus_bank_st *bank);
+
+/**
+ * @brief Write a range of registers atomically.
+ *
+ * @param bank Bank
+ * @param start_addr First register address
+ * @param values Values to store, host order
+ * @param qty Number of registers (start_addr + qty <= MODBUS_BANK_REGS)
+ * @return 0 on success, or a negative error code:
+ *         -1: Invalid input pointers
+ *         -2: Invalid quantity or address range
+ *
+ * All segments touched by the range are locked in address order before any
+ * register is stored, so readers see either none or all of the update.
+ */
+int modbus_bank_write(modbus_bank_st *bank, uint16_t start_addr, const uint16_t *values, uint32_t qty);
+
+/**
+ * @brief Read a consistent snapshot of a range of registers.
+ *
+ * @param bank Bank
+ * @param start_addr First register address
+ * @param qty Number of registers (1..MODBUS_MAX_REGS)
+ * @param regs Output register values, host order
+ * @return 0 on success, or a negative error code:
+ *         -1: Invalid input pointers
+ *         -2: Invalid quantity or address range
+ */
+int modbus_bank_read(const modbus_bank_st *bank, uint16_t start_addr, uint16_t qty, uint16_t *regs);
+
+/**
+ * @brief Read a consistent snapshot of a range of registers in wire order.
+ *
+ * @param bank Bank
+ * @param start_addr First register address
+ * @param qty Number of registers (1..MODBUS_MAX_REGS)
+ * @param dst Output: qty * 2 bytes, big-endian
+ * @param crc CRC register to advance over the copied bytes (may be NULL)
+ * @return 0 on success, or a negative error code:
+ *         -1: Invalid input pointers
+ *         -2: Invalid quantity or address range
+ *
+ * The CRC is chained from the cached block CRCs taken in the same snapshot,
+ * so on return *crc equals modbus_crc16_accumulate(*crc, dst, qty * 2).
+ */
+int modbus_bank_read_wire(const modbus_bank_st *bank, uint16_t start_addr, uint16_t qty, uint8_t *dst,
+                          uint16_t *crc);
+
+/**
+ * @brief Sample the generation of every segment a range covers.
+ *
+ * @param bank Bank
+ * @param start_addr First register address
+ * @param qty Number of registers (1..MODBUS_MAX_REGS)
+ * @param gens Output: one generation per covered segment (MODBUS_BANK_MAX_READ_SEGMENTS entries)
+ * @return Number of generations stored, or a negative error code:
+ *         -1: Invalid input pointers
+ *         -2: Invalid quantity or address range
+ *
+ * A generation is the segment sequence counter, taken once no writer holds
+ * it. If a later call returns the same generations, no write has touched
+ * the range in between, so anything derived from it in the meantime is
+ * still current.
+ */
+int modbus_bank_generations(const modbus_bank_st *bank, uint16_t start_addr, uint16_t qty, uint32_t *gens);
+
+/**
+ * @brief Read callback adapter for modbus_server.
+ *
+ * @param arg Bank (modbus_bank_st *)
+ * @param unit_id Unit ID of the request (ignored)
+ * @param start_addr First register address
+ * @param qty Number of registers
+ * @param regs Output register values
+ * @return 0 on success, non-zero on error
+ */
+int modbus_bank_read_cb(void *arg, uint8_t unit_id, uint16_t start_addr, uint16_t qty, uint16_t *regs);
+
+/**
+ * @brief Write callback adapter for modbus_pdu register maps and modbus_server.
+ *
+ * @param arg Bank (modbus_bank_st *)
+ * @param unit_id Unit ID of the request (ignored)
+ * @param start_addr First register address
+ * @param qty Number of registers
+ * @param values Values to store, host order
+ * @return 0 on success, non-zero on error
+ */
+int modbus_bank_write_cb(void *arg, uint8_t unit_id, uint16_t start_addr, uint16_t qty, const uint16_t *values);
+
+/**
+ * @brief Wire-order read callback adapter for modbus_server.
+ *
+ * @param arg Bank (modbus_bank_st *)
+ * @param unit_id Unit ID of the request (ignored)
+ * @param start_addr First register address
+ * @param qty Number of registers
+ * @param dst Output: qty * 2 bytes, big-endian
+ * @return 0 on success, non-zero on error
+ */
+int modbus_bank_read_wire_cb(void *arg, uint8_t unit_id, uint16_t start_addr, uint16_t qty, uint8_t *dst);
+
+/**
+ * @brief Encode a Read Holding Registers response from a bank snapshot.
+ *
+ * @param bank Bank
+ * @param ctx Slave context
+ * @param slave_id Modbus slave ID (1..247)
+ * @param start_addr First register address
+ * @param qty Number of registers (1..MODBUS_MAX_REGS)
+ * @param buffer Output buffer to store the encoded response
+ * @param bufsize Size of the output buffer
+ * @return Length of the encoded response in bytes (including CRC), or 0 on failure
+ *
+ * Produces the same frame as encode_read_response() on the same values, but
+ * copies the payload from the wire shadow and chains the cached block CRCs.
+ */
+uint16_t modbus_bank_encode_read_response(const modbus_bank_st *bank, const modbus_slave_ctx_st *ctx,
+                                          uint8_t slave_id, uint16_t start_addr, uint16_t qty,
+                                          uint8_t *buffer, size_t bufsize);
+
+/**
+ * @brief Send a Read Holding Registers RTU response with a single write().
+ *
+ * @param bank Bank
+ * @param fd File descriptor (socket, serial port)
+ * @param slave_id Modbus slave ID (1..247)
+ * @param start_addr First register address
+ * @param qty Number of registers (1..MODBUS_MAX_REGS)
+ * @return Number of bytes written, or -1 on error
+ *
+ * The shadow cannot be handed to the kernel in place: a writer may change
+ * it while the syscall runs. Since the seqlock snapshot copies the payload
+ * anyway, it is copied next to the header and the chained CRC and sent in
+ * one write(), which is cheaper than a three-iovec writev() at these sizes.
+ */
+ssize_t modbus_bank_send_read_response(const modbus_bank_st *bank, int fd, uint8_t slave_id,
+                                       uint16_t start_addr, uint16_t qty);
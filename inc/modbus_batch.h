@@ -0,0 +1,200 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include "modbus_tcp.h"
+#include "modbus_trace.h"
+
+/**
+ * @file modbus_batch.h
+ * @brief Batched Modbus TCP requests with scatter/gather submission.
+ *
+ * A batch encodes many requests back to back into one arena and keeps an
+ * iovec per frame. Each frame records the master context it was encoded
+ * on, so one batch can pipeline on a single connection or fan a scan out
+ * to many devices:
+ *   - modbus_batch_writev() sends every frame of one context (or all of
+ *     them) on a stream socket with one writev() per IOV_MAX frames;
+ *   - modbus_batch_sendmmsg() sends every frame as its own datagram, each
+ *     to its own destination if needed, with one sendmmsg() per
+ *     IOV_MAX frames.
+ *
+ * modbus_batch_decode() then takes whatever the socket returned (several
+ * concatenated ADUs, or one datagram) and validates every complete
+ * response in it against its frame, writing the registers straight into
+ * the destination given when the request was added.
+ *
+ * The batch only borrows the master contexts: it does not cancel the
+ * transactions of unanswered frames on reset.
+ *
+ * With modbus_batch_trace(), every answered frame leaves a trace record:
+ * encode time from the add call, send time from the send call, the
+ * receive and read times given by modbus_batch_trace_rx() for the bytes
+ * decoded next, and the time its response was decoded.
+ */
+
+/**
+ * @brief One request of a batch.
+ */
+typedef struct modbus_batch_frame_s
+{
+    modbus_tcp_master_ctx_st *ctx; /**< Context the request was encoded on */
+    uint16_t transaction_id;       /**< Transaction ID of the request */
+    uint16_t *regs;                /**< Destination of the registers read (NULL for writes) */
+    uint16_t regs_len;             /**< Capacity of regs */
+    bool answered;                 /**< A response was matched to this frame */
+    int status;                    /**< decode_tcp_response() result, valid once answered */
+} modbus_batch_frame_st;
+
+struct mmsghdr;
+
+/**
+ * @brief Batch of encoded requests.
+ */
+typedef struct modbus_batch_s
+{
+    uint8_t *arena;                /**< Encoded frames, back to back */
+    size_t arena_size;             /**< Size of arena */
+    size_t arena_used;             /**< Bytes of arena holding frames */
+    struct iovec *iov;             /**< One entry per frame, into arena */
+    struct iovec *gather;          /**< Scratch for modbus_batch_writev() */
+    struct mmsghdr *msgs;          /**< Scratch for modbus_batch_sendmmsg() */
+    modbus_batch_frame_st *frames; /**< One entry per frame */
+    uint32_t capacity;             /**< Largest number of frames */
+    uint32_t count;                /**< Frames added */
+    uint32_t answered;             /**< Frames with a matched response */
+    uint32_t cursor;               /**< Where the next response is looked for first */
+    modbus_trace_ring_st *trace;   /**< Ring answered frames are traced into (NULL = off) */
+    modbus_trace_record_st *traces; /**< Trace record in progress, one per frame */
+    uint64_t received_ns;          /**< Kernel receive time of the bytes decoded next */
+    uint64_t read_ns;              /**< Time the read call returned the bytes decoded next */
+} modbus_batch_st;
+
+/**
+ * @brief Allocate a batch.
+ *
+ * @param batch Batch to initialize
+ * @param capacity Largest number of frames (1..UINT16_MAX)
+ * @param arena_size Bytes for the encoded frames (a Read Holding Registers request takes 12)
+ * @return 0 on success, or a negative error code:
+ *         -1: Invalid arguments
+ *         -3: Out of memory
+ */
+int modbus_batch_init(modbus_batch_st *batch, uint32_t capacity, size_t arena_size);
+
+/**
+ * @brief Release a batch.
+ *
+ * @param batch Batch
+ */
+void modbus_batch_free(modbus_batch_st *batch);
+
+/**
+ * @brief Drop all frames, keeping the storage.
+ *
+ * @param batch Batch
+ */
+void modbus_batch_reset(modbus_batch_st *batch);
+
+/**
+ * @brief Trace every answered frame into a ring.
+ *
+ * @param batch Batch
+ * @param ring Ring of the thread that uses the batch (NULL = stop tracing)
+ * @return 0 on success, or a negative error code:
+ *         -1: Invalid arguments
+ *         -3: Out of memory
+ *
+ * Frames already added are not traced.
+ */
+int modbus_batch_trace(modbus_batch_st *batch, modbus_trace_ring_st *ring);
+
+/**
+ * @brief Stamp the bytes about to be passed to modbus_batch_decode().
+ *
+ * @param batch Batch
+ * @param msg Header returned by recvmsg() or recvmmsg(), for its receive timestamp (NULL = none)
+ * @param read_ns modbus_trace_now_ns() taken when the read call returned
+ *
+ * Does nothing unless the batch is traced.
+ */
+void modbus_batch_trace_rx(modbus_batch_st *batch, const struct msghdr *msg, uint64_t read_ns);
+
+/**
+ * @brief Encode a request around any PDU built with the modbus_pdu_encode_*() functions.
+ *
+ * @param batch Batch
+ * @param ctx Master context of the device
+ * @param unit_id Unit identifier
+ * @param pdu Request PDU
+ * @param pdu_len Length of the request PDU
+ * @param regs Destination of the registers read (may be NULL for writes)
+ * @param regs_len Capacity of regs
+ * @return Index of the frame, or a negative error code:
+ *         -1: Invalid arguments
+ *         -2: Batch full (frames or arena)
+ *         -3: Request rejected by encode_tcp_request() (invalid PDU or pipeline full)
+ */
+int modbus_batch_add_request(modbus_batch_st *batch, modbus_tcp_master_ctx_st *ctx, uint8_t unit_id,
+                             const uint8_t *pdu, size_t pdu_len, uint16_t *regs, uint16_t regs_len);
+
+/**
+ * @brief Encode a Read Holding Registers request.
+ *
+ * @param batch Batch
+ * @param ctx Master context of the device
+ * @param unit_id Unit identifier
+ * @param addr First register address
+ * @param qty Number of registers (1..MODBUS_MAX_REGS)
+ * @param regs Destination of the registers, at least qty entries
+ * @return Index of the frame, or a negative error code as modbus_batch_add_request()
+ */
+int modbus_batch_add_read(modbus_batch_st *batch, modbus_tcp_master_ctx_st *ctx, uint8_t unit_id, uint16_t addr,
+                          uint16_t qty, uint16_t *regs);
+
+/**
+ * @brief Send the frames of one context on a stream socket.
+ *
+ * @param batch Batch
+ * @param fd Connected socket (blocking or not)
+ * @param ctx Send only the frames encoded on this context (NULL = every frame)
+ * @return Number of bytes sent, or -1 on error
+ *
+ * Returns once every byte is queued in the kernel, waiting for room on a
+ * non-blocking socket.
+ */
+ssize_t modbus_batch_writev(modbus_batch_st *batch, int fd, const modbus_tcp_master_ctx_st *ctx);
+
+/**
+ * @brief Send every frame as one datagram.
+ *
+ * @param batch Batch
+ * @param fd Datagram socket
+ * @param dests Destination of each frame, indexed like the frames (NULL for a connected socket)
+ * @param dest_len Size of each destination address
+ * @return Number of frames sent, or -1 on error
+ */
+int modbus_batch_sendmmsg(modbus_batch_st *batch, int fd, const struct sockaddr *const *dests, socklen_t dest_len);
+
+/**
+ * @brief Validate every complete response in a buffer.
+ *
+ * @param batch Batch
+ * @param ctx Master context the responses belong to (the connection they came from)
+ * @param buffer Received bytes: concatenated ADUs, or one datagram
+ * @param len Number of bytes
+ * @param consumed Output: bytes used, excluding an incomplete ADU at the end (may be NULL)
+ * @return Number of responses matched to a frame of this batch, or -1 on invalid arguments
+ *
+ * Each matched frame gets answered set and status set to the
+ * decode_tcp_response() result: the register count, 0 for writes, or a
+ * negative error code (-8 for an exception). Responses that match no
+ * unanswered frame of ctx are skipped. An invalid MBAP header means the
+ * stream lost its framing: the walk stops and the rest counts as consumed.
+ */
+int modbus_batch_decode(modbus_batch_st *batch, modbus_tcp_master_ctx_st *ctx, const uint8_t *buffer, size_t len,
+                        size_t *consumed);
@@ -0,0 +1,126 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "modbus_bank.h"
+#include "modbus_slave.h"
+
+/**
+ * @file modbus_cache.h
+ * @brief Cache of encoded Read Holding Registers responses.
+ *
+ * Masters such as HMIs and historians poll the same few windows over and
+ * over. The cache keeps the fully encoded RTU response for each
+ * (unit, start address, quantity) key, together with the generations of
+ * the bank segments it was built from. A lookup hashes the key, compares
+ * the generations with the live ones and hands out the stored frame; only
+ * when a writer has touched one of the segments is the frame rebuilt.
+ *
+ * The table is direct-mapped with a power-of-two number of slots sized
+ * from a byte budget at init; a colliding key replaces the previous one.
+ * A cache is not thread-safe: give each serving thread its own.
+ */
+
+/** @brief Largest RTU Read Holding Registers response: header, 125 registers, CRC */
+#define MODBUS_CACHE_FRAME_SIZE (3 + MODBUS_MAX_REGS * 2 + 2)
+
+/** @brief Upper bound on the number of slots */
+#define MODBUS_CACHE_MAX_SLOTS (1u << 20)
+
+/**
+ * @brief One cached response.
+ */
+typedef struct modbus_cache_entry_s
+{
+    uint64_t key;                                  /**< (unit << 32) | (start << 16) | qty; 0 = empty */
+    uint32_t gens[MODBUS_BANK_MAX_READ_SEGMENTS];  /**< Generations of the covered segments at encode time */
+    uint16_t request_crc;                          /**< CRC of the request that produced the entry */
+    uint16_t len;                                  /**< Length of frame in bytes */
+    uint8_t frame[MODBUS_CACHE_FRAME_SIZE];        /**< Encoded RTU response, CRC included */
+} modbus_cache_entry_st;
+
+/**
+ * @brief Cache counters.
+ */
+typedef struct modbus_cache_stats_s
+{
+    uint64_t hits;      /**< Lookups answered from a stored frame */
+    uint64_t misses;    /**< Lookups that had to encode (stale + evictions + cold) */
+    uint64_t stale;     /**< Misses on a stored key whose registers were written since */
+    uint64_t evictions; /**< Misses that replaced a different key in the slot */
+} modbus_cache_stats_st;
+
+/**
+ * @brief Response cache in front of a register bank.
+ */
+typedef struct modbus_cache_s
+{
+    const modbus_bank_st *bank;     /**< Register source */
+    modbus_cache_entry_st *entries; /**< Slots, capacity entries */
+    uint32_t capacity;              /**< Number of slots (power of two) */
+    uint32_t mask;                  /**< capacity - 1 */
+    modbus_cache_stats_st stats;    /**< Counters */
+} modbus_cache_st;
+
+/**
+ * @brief Allocate a cache within a memory budget.
+ *
+ * @param cache Cache to initialize
+ * @param bank Register source (must outlive the cache)
+ * @param max_bytes Upper bound on the memory used by the slots
+ * @return 0 on success, or a negative error code:
+ *         -1: Invalid input pointers
+ *         -2: Budget smaller than one slot
+ *         -3: Out of memory
+ *
+ * The number of slots is the largest power of two that fits max_bytes,
+ * capped at MODBUS_CACHE_MAX_SLOTS.
+ */
+int modbus_cache_init(modbus_cache_st *cache, const modbus_bank_st *bank, size_t max_bytes);
+
+/**
+ * @brief Release the slots.
+ *
+ * @param cache Cache
+ */
+void modbus_cache_deinit(modbus_cache_st *cache);
+
+/**
+ * @brief Drop every stored frame. Counters are kept.
+ *
+ * @param cache Cache
+ */
+void modbus_cache_clear(modbus_cache_st *cache);
+
+/**
+ * @brief Get the response for an already decoded request.
+ *
+ * @param cache Cache
+ * @param slave_id Modbus slave ID (0..247)
+ * @param start_addr First register address
+ * @param qty Number of registers (1..MODBUS_MAX_REGS)
+ * @param frame Output: the encoded RTU response, valid until the next call on this cache
+ * @return Length of the response in bytes, or 0 on failure
+ */
+uint16_t modbus_cache_get(modbus_cache_st *cache, uint8_t slave_id, uint16_t start_addr, uint16_t qty,
+                          const uint8_t **frame);
+
+/**
+ * @brief Answer a raw RTU Read Holding Registers request.
+ *
+ * @param cache Cache
+ * @param ctx Slave context holding the device slave ID
+ * @param request Incoming RTU request frame
+ * @param len Length of the request in bytes
+ * @param frame Output: the encoded RTU response, valid until the next call on this cache
+ * @return Length of the response in bytes, or 0 if the request is rejected or broadcast
+ *
+ * A broadcast (slave ID 0) is never answered, like in modbus_slave_handle_request().
+ * A request whose bytes (CRC included) match a stored entry was already
+ * validated by decode_read_request() when the entry was made, so a hit
+ * skips decoding and costs one hash probe and a generation check. Misses
+ * go through decode_read_request() and the bank encoder.
+ */
+uint16_t modbus_cache_respond(modbus_cache_st *cache, const modbus_slave_ctx_st *ctx, const uint8_t *request,
+                              size_t len, const uint8_t **frame);
@@ -0,0 +1,129 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "modbus_defines.h"
+
+/**
+ * @file modbus_cov.h
+ * @brief Change-of-value and deadband detection on decoded register blocks.
+ *
+ * A block keeps the last published value of every register of one read
+ * request. Each new scan is compared with it a vector at a time: a
+ * register has changed when it differs from its published value by more
+ * than its absolute deadband (0 = any change). The result is a bitmap
+ * and a list of the changed indices, so publishing (MQTT, historian) only
+ * touches what moved, typically a few registers out of 125.
+ *
+ * Only changed registers become the new published values. A value that
+ * drifts inside its deadband scan after scan is therefore still reported
+ * once the drift exceeds the deadband.
+ *
+ * Signed blocks compare registers as int16_t, so -1 and 0 are one apart,
+ * not 65535. All engines give bit-identical results; they only differ in
+ * speed.
+ */
+
+/** @brief 64-bit words of a change bitmap for the largest block */
+#define MODBUS_COV_BITMAP_WORDS ((MODBUS_MAX_REGS + 63) / 64)
+
+/**
+ * @brief Available comparison implementations.
+ */
+typedef enum modbus_cov_engine_e
+{
+    MODBUS_COV_ENGINE_AUTO = 0, /**< Pick the widest supported vector engine */
+    MODBUS_COV_ENGINE_SCALAR,   /**< Portable one-register-at-a-time comparison */
+    MODBUS_COV_ENGINE_SSE2,     /**< 8 registers per compare (x86-64) */
+    MODBUS_COV_ENGINE_AVX2,     /**< 16 registers per compare (x86-64) */
+    MODBUS_COV_ENGINE_NEON,     /**< 8 registers per compare (AArch64) */
+    MODBUS_COV_ENGINE_COUNT
+} modbus_cov_engine_et;
+
+/**
+ * @brief Published values of one request block.
+ */
+typedef struct modbus_cov_block_s
+{
+    uint16_t start_addr;                /**< Address of regs[0] */
+    uint16_t qty;                       /**< Registers in the block (1..MODBUS_MAX_REGS) */
+    bool is_signed;                     /**< Compare as int16_t */
+    bool primed;                        /**< published holds a scan */
+    uint16_t published[MODBUS_MAX_REGS]; /**< Last value reported for each register */
+    uint16_t deadband[MODBUS_MAX_REGS];  /**< Absolute deadband of each register (0 = any change) */
+} modbus_cov_block_st;
+
+/**
+ * @brief Registers that changed in one scan.
+ */
+typedef struct modbus_cov_changes_s
+{
+    uint64_t bitmap[MODBUS_COV_BITMAP_WORDS]; /**< Bit i set: register start_addr + i changed */
+    uint8_t index[MODBUS_MAX_REGS];           /**< Indices of the changed registers, ascending */
+    uint16_t count;                           /**< Entries in index */
+} modbus_cov_changes_st;
+
+/**
+ * @brief Select the comparison engine.
+ *
+ * @param engine Engine to use
+ * @return 0 on success, -1 if the engine is unknown or not supported by this CPU
+ */
+int modbus_cov_set_engine(modbus_cov_engine_et engine);
+
+/**
+ * @brief Get the currently selected comparison engine.
+ *
+ * @return Selected engine (MODBUS_COV_ENGINE_AUTO by default)
+ */
+modbus_cov_engine_et modbus_cov_get_engine(void);
+
+/**
+ * @brief Check whether an engine can run on this build and CPU.
+ *
+ * @param engine Engine to check
+ * @return true if the engine can be selected
+ */
+bool modbus_cov_engine_supported(modbus_cov_engine_et engine);
+
+/**
+ * @brief Get a short printable name for an engine.
+ *
+ * @param engine Engine
+ * @return Static string, "unknown" for invalid values
+ */
+const char *modbus_cov_engine_name(modbus_cov_engine_et engine);
+
+/**
+ * @brief Initialize a block with no published values yet.
+ *
+ * @param block Block to initialize
+ * @param start_addr Address of the first register, as in the read request
+ * @param qty Number of registers (1..MODBUS_MAX_REGS)
+ * @param deadband Absolute deadband of each register, qty entries (NULL = report any change)
+ * @param is_signed Compare registers as int16_t instead of uint16_t
+ * @return 0 on success, or -1 on invalid arguments
+ */
+int modbus_cov_init(modbus_cov_block_st *block, uint16_t start_addr, uint16_t qty, const uint16_t *deadband,
+                    bool is_signed);
+
+/**
+ * @brief Compare a scan with the published values and publish what changed.
+ *
+ * @param block Block
+ * @param regs New values, qty entries, as filled by the read response decoder
+ * @param changes Output: changed registers
+ * @return Number of changed registers, or -1 on invalid arguments
+ *
+ * The first scan of a block reports every register.
+ */
+int modbus_cov_update(modbus_cov_block_st *block, const uint16_t *regs, modbus_cov_changes_st *changes);
+
+/**
+ * @brief Forget the published values: the next scan reports every register.
+ *
+ * @param block Block
+ */
+void modbus_cov_reset(modbus_cov_block_st *block);
@@ -0,0 +1,157 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+/**
+ * @file modbus_crc.h
+ * @brief Modbus RTU CRC16 engines with runtime implementation selection.
+ *
+ * All engines compute the same CRC (polynomial 0xA001 reflected, no final XOR)
+ * and only differ in speed. The active engine is used by modbus_crc16().
+ */
+
+/** @brief Initial value of the Modbus RTU CRC16 register */
+#define MODBUS_CRC16_INIT 0xFFFF
+
+/**
+ * @brief Available CRC16 implementations.
+ */
+typedef enum modbus_crc16_engine_e
+{
+    MODBUS_CRC16_ENGINE_AUTO = 0, /**< Pick the fastest supported engine per buffer length */
+    MODBUS_CRC16_ENGINE_BITWISE,  /**< Reference implementation, one bit per step */
+    MODBUS_CRC16_ENGINE_TABLE,    /**< One 256-entry table lookup per byte */
+    MODBUS_CRC16_ENGINE_SLICE8,   /**< Slicing-by-8, eight bytes per step */
+    MODBUS_CRC16_ENGINE_SLICE16,  /**< Slicing-by-16, sixteen bytes per step */
+    MODBUS_CRC16_ENGINE_CLMUL,    /**< PCLMULQDQ folding (x86-64 only) */
+    MODBUS_CRC16_ENGINE_COUNT
+} modbus_crc16_engine_et;
+
+/**
+ * @brief Select the CRC16 engine used by modbus_crc16().
+ *
+ * @param engine Engine to use
+ * @return 0 on success, -1 if the engine is unknown or not supported by this CPU
+ */
+int modbus_crc16_set_engine(modbus_crc16_engine_et engine);
+
+/**
+ * @brief Get the currently selected CRC16 engine.
+ *
+ * @return Selected engine (MODBUS_CRC16_ENGINE_AUTO by default)
+ */
+modbus_crc16_engine_et modbus_crc16_get_engine(void);
+
+/**
+ * @brief Check whether an engine can run on this build and CPU.
+ *
+ * @param engine Engine to check
+ * @return true if the engine can be selected
+ */
+bool modbus_crc16_engine_supported(modbus_crc16_engine_et engine);
+
+/**
+ * @brief Get a short printable name for an engine.
+ *
+ * @param engine Engine
+ * @return Static string, "unknown" for invalid values
+ */
+const char *modbus_crc16_engine_name(modbus_crc16_engine_et engine);
+
+/**
+ * @brief Feed bytes into a raw CRC16 register using the selected engine.
+ *
+ * @param crc Current CRC register value (MODBUS_CRC16_INIT for a new frame)
+ * @param buf Pointer to the data buffer
+ * @param len Length of the data buffer in bytes
+ * @return Updated CRC register value
+ *
+ * Returns @p crc unchanged when @p buf is NULL or @p len is 0.
+ */
+uint16_t modbus_crc16_accumulate(uint16_t crc, const uint8_t *buf, size_t len);
+
+/**
+ * @brief Streaming CRC16 context, fed with bytes as they arrive.
+ */
+typedef struct modbus_crc16_ctx_s
+{
+    uint16_t crc; /**< Running CRC register */
+} modbus_crc16_ctx_st;
+
+/**
+ * @brief Start a new CRC16 computation.
+ *
+ * @param ctx Context to initialize
+ */
+void modbus_crc16_init(modbus_crc16_ctx_st *ctx);
+
+/**
+ * @brief Feed bytes into a CRC16 context.
+ *
+ * @param ctx Context started with modbus_crc16_init()
+ * @param buf Pointer to the next bytes of the frame
+ * @param len Number of bytes
+ *
+ * Chunks may have any size; the result only depends on the byte sequence.
+ */
+void modbus_crc16_update(modbus_crc16_ctx_st *ctx, const uint8_t *buf, size_t len);
+
+/**
+ * @brief Get the CRC16 of all bytes fed so far.
+ *
+ * @param ctx Context
+ * @return 16-bit CRC value, 0xFFFF if no bytes were fed
+ *
+ * The context is left untouched and can keep receiving bytes.
+ */
+uint16_t modbus_crc16_final(const modbus_crc16_ctx_st *ctx);
+
+/**
+ * @brief Combine the CRCs of two adjacent blocks without reading their bytes.
+ *
+ * @param crc_a CRC16 of block A
+ * @param crc_b CRC16 of block B
+ * @param len_b Length of block B in bytes
+ * @return CRC16 of A followed by B
+ *
+ * Both CRCs must be complete Modbus CRC16 values (starting from 0xFFFF).
+ * Runs in O(log len_b).
+ */
+uint16_t modbus_crc16_combine(uint16_t crc_a, uint16_t crc_b, size_t len_b);
+
+/**
+ * @brief Precomputed operator that advances a CRC register over a fixed number of bytes.
+ *
+ * Advancing over len bytes is multiplication by x^(8 * len) modulo P, which is
+ * linear in the register bits, so it reduces to two table lookups.
+ */
+typedef struct modbus_crc16_shift_s
+{
+    uint16_t lo[256]; /**< Contribution of the low register byte */
+    uint16_t hi[256]; /**< Contribution of the high register byte */
+} modbus_crc16_shift_st;
+
+/**
+ * @brief Build the shift operator for blocks of @p len bytes.
+ *
+ * @param op Operator to build
+ * @param len Block length in bytes
+ */
+void modbus_crc16_shift_init(modbus_crc16_shift_st *op, size_t len);
+
+/**
+ * @brief Advance a CRC register over a block whose zero-init CRC is known.
+ *
+ * @param op Operator built for the block length
+ * @param crc CRC register before the block
+ * @param block_crc0 modbus_crc16_accumulate(0, block, len)
+ * @return CRC register after the block, equal to modbus_crc16_accumulate(crc, block, len)
+ *
+ * Lets callers cache per-block CRCs and chain them in O(1) per block.
+ */
+static inline uint16_t modbus_crc16_shift(const modbus_crc16_shift_st *op, uint16_t crc, uint16_t block_crc0)
+{
+    return op->lo[crc & 0xFF] ^ op->hi[crc >> 8] ^ block_crc0;
+}
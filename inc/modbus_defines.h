@@ -17,8 +17,59 @@
 /** @brief Modbus broadcast slave ID (0) */
 #define BROADCAST_SLAVE_ID 0
 
-/**
- * @note Additional function codes can be added here as needed, for example:
- *       #define MODBUS_WRITE_SINGLE_REG 0x06
- *       #define MODBUS_WRITE_MULTIPLE_REGS 0x10
- */
+/** @brief Modbus TCP protocol identifier carried in every MBAP header */
+#define MODBUS_TCP_PROTOCOL_ID 0x0000
+
+/** @brief Modbus TCP unit ID used when the unit identifier is not significant */
+#define MODBUS_TCP_UNIT_ID_IGNORED 0xFF
+
+/** @brief Size of the MBAP header in bytes, unit ID included */
+#define MODBUS_MBAP_HEADER_SIZE 7
+
+/** @brief Maximum size of a Modbus TCP ADU (MBAP header + 253-byte PDU) */
+#define MODBUS_TCP_MAX_ADU_SIZE 260
+
+/** @brief Maximum number of outstanding requests per Modbus TCP master context */
+#define MODBUS_TCP_MAX_PIPELINE 16
+
+/** @brief Cache line size used to keep data written by different threads apart */
+#define MODBUS_CACHE_LINE_SIZE 64
+
+/** @brief Modbus function code for "Read Input Registers" */
+#define MODBUS_READ_INPUT_REG 0x04
+
+/** @brief Modbus function code for "Write Single Register" */
+#define MODBUS_WRITE_SINGLE_REG 0x06
+
+/** @brief Modbus function code for "Write Multiple Registers" */
+#define MODBUS_WRITE_MULTIPLE_REGS 0x10
+
+/** @brief Modbus function code for "Read/Write Multiple Registers" */
+#define MODBUS_READ_WRITE_MULTIPLE_REGS 0x17
+
+/** @brief Set in the function code of an exception response */
+#define MODBUS_EXCEPTION_FLAG 0x80
+
+/** @brief Maximum number of registers in a Write Multiple Registers request */
+#define MODBUS_MAX_WRITE_REGS 123
+
+/** @brief Maximum number of registers written by a Read/Write Multiple Registers request */
+#define MODBUS_MAX_RW_WRITE_REGS 121
+
+/** @brief Maximum size of a Modbus PDU (function code + data) */
+#define MODBUS_MAX_PDU_SIZE 253
+
+/** @brief Maximum size of a Modbus RTU ADU (slave ID + 253-byte PDU + CRC) */
+#define MODBUS_RTU_MAX_ADU_SIZE 256
+
+/** @brief Exception code: function code not supported */
+#define MODBUS_EX_ILLEGAL_FUNCTION 0x01
+
+/** @brief Exception code: register range not served */
+#define MODBUS_EX_ILLEGAL_DATA_ADDRESS 0x02
+
+/** @brief Exception code: malformed request or quantity out of range */
+#define MODBUS_EX_ILLEGAL_DATA_VALUE 0x03
+
+/** @brief Exception code: the register source failed */
+#define MODBUS_EX_SLAVE_DEVICE_FAILURE 0x04
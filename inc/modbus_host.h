@@ -0,0 +1,162 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "modbus_defines.h"
+#include "modbus_bank.h"
+#include "modbus_pdu.h"
+#include "modbus_slave.h"
+
+/**
+ * @file modbus_host.h
+ * @brief Many slave units behind one server.
+ *
+ * A host serves up to MODBUS_MAX_SLAVES unit IDs from one process: a
+ * protocol converter that presents dozens of virtual devices behind one
+ * IP address runs one host, one event loop and one set of connection
+ * buffers instead of one server per unit. Each unit has its own register
+ * sources, typically its own modbus_bank.
+ *
+ * A request finds its unit in O(1): the unit ID byte indexes a 256-entry
+ * table of slots into a dense unit array, so the table stays in a few
+ * cache lines and only the unit actually addressed is touched.
+ *
+ * The TCP and UDP servers take a host in their configuration. On RTU,
+ * modbus_host_handle_rtu_request() stands in for
+ * modbus_slave_handle_request(): a broadcast write goes to every unit.
+ */
+
+/**
+ * @brief Read callback that writes register values in wire order.
+ *
+ * Same contract as modbus_server_read_wire_fn.
+ */
+typedef int (*modbus_host_read_wire_fn)(void *arg, uint8_t unit_id, uint16_t start_addr, uint16_t qty,
+                                        uint8_t *dst);
+
+/**
+ * @brief One unit of a host.
+ */
+typedef struct modbus_host_unit_s
+{
+    modbus_register_map_st map;         /**< Register sources for the dispatcher */
+    modbus_host_read_wire_fn read_wire; /**< Read Holding Registers in wire order (NULL = map.read_holding) */
+} modbus_host_unit_st;
+
+/**
+ * @brief Units served by one process.
+ */
+typedef struct modbus_host_s
+{
+    uint8_t slot[256];          /**< Unit ID -> index into units + 1 (0 = not served) */
+    modbus_host_unit_st *units; /**< Units, in the order they were added */
+    uint32_t count;             /**< Units added */
+    uint32_t capacity;          /**< Size of units */
+} modbus_host_st;
+
+/**
+ * @brief Unit that a unit ID addresses.
+ *
+ * @param host Host
+ * @param unit_id Unit ID byte of the request
+ * @return Unit, or NULL if the host does not serve this ID
+ */
+static inline const modbus_host_unit_st *modbus_host_unit(const modbus_host_st *host, uint8_t unit_id)
+{
+    uint8_t slot = host->slot[unit_id];
+    return slot ? &host->units[slot - 1] : NULL;
+}
+
+/**
+ * @brief Allocate room for the units.
+ *
+ * @param host Host to initialize
+ * @param max_units Largest number of units (1..MODBUS_MAX_SLAVES)
+ * @return 0 on success, or a negative error code:
+ *         -1: Invalid arguments
+ *         -2: Out of memory
+ */
+int modbus_host_init(modbus_host_st *host, uint32_t max_units);
+
+/**
+ * @brief Release the units.
+ *
+ * @param host Host
+ */
+void modbus_host_free(modbus_host_st *host);
+
+/**
+ * @brief Serve a unit ID.
+ *
+ * @param host Host
+ * @param unit_id Unit ID (1..MODBUS_MAX_SLAVES)
+ * @param map Register sources of the unit (copied)
+ * @param read_wire Read Holding Registers in wire order, called with map->arg (NULL = none)
+ * @return Index of the unit, or a negative error code:
+ *         -1: Invalid arguments
+ *         -2: Host full
+ *         -3: Unit ID already served
+ *
+ * Units are added before any server uses the host; the table is then only read.
+ */
+int modbus_host_add_unit(modbus_host_st *host, uint8_t unit_id, const modbus_register_map_st *map,
+                         modbus_host_read_wire_fn read_wire);
+
+/**
+ * @brief Serve a unit ID from its own register bank.
+ *
+ * @param host Host
+ * @param unit_id Unit ID (1..MODBUS_MAX_SLAVES)
+ * @param bank Holding registers of the unit, read in wire order and writable
+ * @return Index of the unit, or a negative error code as modbus_host_add_unit()
+ */
+int modbus_host_add_bank(modbus_host_st *host, uint8_t unit_id, modbus_bank_st *bank);
+
+/**
+ * @brief Let a second ID address an existing unit.
+ *
+ * @param host Host
+ * @param alias_id Extra ID, any value not served yet (such as MODBUS_TCP_UNIT_ID_IGNORED)
+ * @param unit_id Unit already served
+ * @return 0 on success, or a negative error code:
+ *         -1: Invalid arguments, or unit_id is not served
+ *         -3: alias_id already served
+ *
+ * An alias of BROADCAST_SLAVE_ID only matters on TCP and UDP, where unit 0
+ * is an ordinary address; on RTU a broadcast always goes to every unit.
+ */
+int modbus_host_alias(modbus_host_st *host, uint8_t alias_id, uint8_t unit_id);
+
+/**
+ * @brief Answer a request PDU with a unit's register sources.
+ *
+ * @param unit Unit the request addresses
+ * @param unit_id Unit ID byte of the request
+ * @param req Request PDU (function code first)
+ * @param req_len Length of the request PDU
+ * @param resp Output response PDU, at least MODBUS_MAX_PDU_SIZE bytes
+ * @return Length of the response PDU (normal or exception), or -1 on invalid arguments
+ *
+ * Read Holding Registers goes to read_wire when the unit has one, so the
+ * values land in resp without a copy; everything else, and units without
+ * read_wire, go through modbus_pdu_dispatch(). Both paths answer bad
+ * requests and failed sources with the same exceptions.
+ */
+int modbus_host_dispatch(const modbus_host_unit_st *unit, uint8_t unit_id, const uint8_t *req, size_t req_len,
+                         uint8_t *resp);
+
+/**
+ * @brief Answer any supported RTU request for the unit it addresses.
+ *
+ * @param host Host
+ * @param buffer Incoming RTU request frame
+ * @param bufsize Size of the incoming buffer
+ * @param response Output buffer, at least MODBUS_RTU_MAX_ADU_SIZE bytes
+ * @param respsize Size of the output buffer
+ * @return Length of the response frame, 0 for a broadcast (executed by
+ *         every unit, never answered), or a negative error code as
+ *         modbus_slave_handle_request(); -4 means no unit has this ID
+ */
+int modbus_host_handle_rtu_request(const modbus_host_st *host, const uint8_t *buffer, size_t bufsize,
+                                   uint8_t *response, size_t respsize);
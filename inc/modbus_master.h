@@ -1,10 +1,33 @@
 #pragma once
 
 #include <stdint.h>
+#include <stddef.h>
+
+#include "modbus_pdu.h"
+
+/**
+ * @brief Modbus master transaction state.
+ *
+ * One context per bus (or per connection). Contexts share nothing, so
+ * different threads can run their own conversations without locking.
+ */
+typedef struct modbus_master_ctx_s
+{
+    uint8_t last_request_slave_id; /**< Slave expected to answer the last encoded request */
+    uint8_t last_request[MODBUS_PDU_REQUEST_HEADER_SIZE]; /**< Leading PDU bytes the answer must match */
+} modbus_master_ctx_st;
+
+/**
+ * @brief Initialize a master context.
+ *
+ * @param ctx Context to initialize
+ */
+void modbus_master_ctx_init(modbus_master_ctx_st *ctx);
 
 /**
  * @brief Encode a Modbus Read Holding Registers request.
  *
+ * @param ctx Master context, records the slave expected to answer
  * @param slave_id Modbus slave ID (1..247)
  * @param addr Starting register address
  * @param qty Number of registers to read
@@ -15,11 +38,12 @@
  * This function validates the input parameters and fills the buffer with the
  * Modbus RTU request frame, including CRC.
  */
-uint16_t encode_read_request(uint8_t slave_id, uint16_t addr, uint16_t qty, uint8_t *buffer, size_t bufsize);
+uint16_t encode_read_request(modbus_master_ctx_st *ctx, uint8_t slave_id, uint16_t addr, uint16_t qty, uint8_t *buffer, size_t bufsize);
 
 /**
  * @brief Decode a Modbus Read Holding Registers response.
  *
+ * @param ctx Master context used to encode the matching request
  * @param buffer Buffer containing the response
  * @param bufsize Size of the buffer
  * @param regs Output array to store decoded register values
@@ -36,4 +60,39 @@ uint16_t encode_read_request(uint8_t slave_id, uint16_t addr, uint16_t qty, uint
  * The function validates the response header, checks CRC, and converts
  * register values from big-endian to host byte order.
  */
-int decode_read_response(uint8_t *buffer, size_t bufsize, uint16_t *regs, uint8_t regs_len);
\ No newline at end of file
+int decode_read_response(const modbus_master_ctx_st *ctx, const uint8_t *buffer, size_t bufsize, uint16_t *regs, uint8_t regs_len);
+
+/**
+ * @brief Encode an RTU request around any PDU built with the modbus_pdu_encode_*() functions.
+ *
+ * @param ctx Master context, records the slave and the request fields the answer must echo
+ * @param slave_id Modbus slave ID (0..247)
+ * @param pdu Request PDU
+ * @param pdu_len Length of the request PDU
+ * @param buffer Output buffer to store the encoded request
+ * @param bufsize Size of the output buffer
+ * @return Length of the encoded request in bytes, or 0 on failure
+ */
+uint16_t encode_rtu_request(modbus_master_ctx_st *ctx, uint8_t slave_id, const uint8_t *pdu, size_t pdu_len,
+                            uint8_t *buffer, size_t bufsize);
+
+/**
+ * @brief Decode the RTU response to the last request encoded on this context.
+ *
+ * @param ctx Master context used to encode the matching request
+ * @param buffer Buffer containing the response
+ * @param bufsize Size of the buffer
+ * @param regs Output register values for reads (may be NULL for writes)
+ * @param regs_len Length of the output array
+ * @return Number of registers read (0 for writes), or a negative error code:
+ *         -1: Invalid input pointers
+ *         -2: Slave ID mismatch
+ *         -3: Function code mismatch
+ *         -4: Byte count or echoed address, value or quantity does not match the request
+ *         -5: Buffer too small
+ *         -6: Output array too small
+ *         -7: CRC mismatch
+ *         -8: Exception response; the exception code is buffer[2]
+ */
+int decode_rtu_response(const modbus_master_ctx_st *ctx, const uint8_t *buffer, size_t bufsize, uint16_t *regs,
+                        uint16_t regs_len);
@@ -0,0 +1,188 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "modbus_defines.h"
+
+/**
+ * @file modbus_pdu.h
+ * @brief Transport-independent Modbus PDUs and a function-code dispatcher.
+ *
+ * A PDU is the function code followed by its data; RTU wraps it with the
+ * slave ID and a CRC, TCP with the MBAP header. Everything here works on
+ * bare PDUs so both transports share one implementation.
+ *
+ * Slave side, modbus_pdu_dispatch() looks the function code up in a table
+ * of handlers and answers from a register map. Supported:
+ *   - 0x03 Read Holding Registers
+ *   - 0x04 Read Input Registers
+ *   - 0x06 Write Single Register
+ *   - 0x10 Write Multiple Registers
+ *   - 0x17 Read/Write Multiple Registers (write first, then read)
+ * Unsupported codes and malformed requests get an exception response.
+ *
+ * Master side, the encoders build request PDUs and
+ * modbus_pdu_decode_response() checks an answer against its request.
+ */
+
+/** @brief Leading request bytes (function code and two 16-bit fields) a response is checked against */
+#define MODBUS_PDU_REQUEST_HEADER_SIZE 5
+
+/**
+ * @brief Register read callback.
+ *
+ * @param arg User argument from the register map
+ * @param unit_id Unit ID of the request
+ * @param start_addr First register address
+ * @param qty Number of registers (1..MODBUS_MAX_REGS)
+ * @param regs Output register values, host order
+ * @return 0 on success, non-zero on failure
+ */
+typedef int (*modbus_read_regs_fn)(void *arg, uint8_t unit_id, uint16_t start_addr, uint16_t qty, uint16_t *regs);
+
+/**
+ * @brief Register write callback.
+ *
+ * @param arg User argument from the register map
+ * @param unit_id Unit ID of the request
+ * @param start_addr First register address
+ * @param qty Number of registers (1..MODBUS_MAX_WRITE_REGS)
+ * @param values Values to store, host order
+ * @return 0 on success, non-zero on failure
+ */
+typedef int (*modbus_write_regs_fn)(void *arg, uint8_t unit_id, uint16_t start_addr, uint16_t qty,
+                                    const uint16_t *values);
+
+/**
+ * @brief Register sources served by the dispatcher.
+ *
+ * A NULL callback makes the function codes that need it answer with
+ * MODBUS_EX_ILLEGAL_FUNCTION. A callback failure is reported as
+ * MODBUS_EX_SLAVE_DEVICE_FAILURE.
+ */
+typedef struct modbus_register_map_s
+{
+    modbus_read_regs_fn read_holding;   /**< 0x03, and the read half of 0x17 */
+    modbus_read_regs_fn read_input;     /**< 0x04 */
+    modbus_write_regs_fn write_holding; /**< 0x06, 0x10, and the write half of 0x17 */
+    void *arg;                          /**< User argument passed to every callback */
+} modbus_register_map_st;
+
+/**
+ * @brief Answer a request PDU.
+ *
+ * @param map Register sources
+ * @param unit_id Unit ID of the request, passed to the callbacks
+ * @param req Request PDU
+ * @param req_len Length of the request PDU
+ * @param resp Output response PDU, at least MODBUS_MAX_PDU_SIZE bytes
+ * @return Length of the response PDU (normal or exception), or -1 on invalid arguments
+ */
+int modbus_pdu_dispatch(const modbus_register_map_st *map, uint8_t unit_id, const uint8_t *req, size_t req_len,
+                        uint8_t *resp);
+
+/**
+ * @brief Length of a request PDU from its first bytes.
+ *
+ * @param pdu First bytes of the PDU
+ * @param avail Number of bytes available
+ * @return PDU length, 0 if more bytes are needed to tell, or -1 for an unsupported function code
+ */
+int modbus_pdu_request_length(const uint8_t *pdu, size_t avail);
+
+/**
+ * @brief Length of a response PDU from its first bytes.
+ *
+ * @param pdu First bytes of the PDU
+ * @param avail Number of bytes available
+ * @return PDU length, 0 if more bytes are needed to tell, or -1 for an unsupported function code
+ */
+int modbus_pdu_response_length(const uint8_t *pdu, size_t avail);
+
+/**
+ * @brief Encode a Read Holding Registers or Read Input Registers request.
+ *
+ * @param function_code MODBUS_READ_HOLDING_REG or MODBUS_READ_INPUT_REG
+ * @param addr First register address
+ * @param qty Number of registers (1..MODBUS_MAX_REGS)
+ * @param pdu Output buffer
+ * @param size Size of the output buffer
+ * @return PDU length, or 0 on failure
+ */
+uint16_t modbus_pdu_encode_read(uint8_t function_code, uint16_t addr, uint16_t qty, uint8_t *pdu, size_t size);
+
+/**
+ * @brief Encode a Write Single Register request.
+ *
+ * @param addr Register address
+ * @param value Value to store
+ * @param pdu Output buffer
+ * @param size Size of the output buffer
+ * @return PDU length, or 0 on failure
+ */
+uint16_t modbus_pdu_encode_write_single(uint16_t addr, uint16_t value, uint8_t *pdu, size_t size);
+
+/**
+ * @brief Encode a Write Multiple Registers request.
+ *
+ * @param addr First register address
+ * @param values Values to store, host order
+ * @param qty Number of registers (1..MODBUS_MAX_WRITE_REGS)
+ * @param pdu Output buffer
+ * @param size Size of the output buffer
+ * @return PDU length, or 0 on failure
+ */
+uint16_t modbus_pdu_encode_write_multiple(uint16_t addr, const uint16_t *values, uint16_t qty, uint8_t *pdu,
+                                          size_t size);
+
+/**
+ * @brief Encode a Read/Write Multiple Registers request.
+ *
+ * @param read_addr First register to read
+ * @param read_qty Number of registers to read (1..MODBUS_MAX_REGS)
+ * @param write_addr First register to write
+ * @param values Values to store, host order
+ * @param write_qty Number of registers to write (1..MODBUS_MAX_RW_WRITE_REGS)
+ * @param pdu Output buffer
+ * @param size Size of the output buffer
+ * @return PDU length, or 0 on failure
+ *
+ * The slave performs the write before the read, so a setpoint and the
+ * status it produces travel in one round trip.
+ */
+uint16_t modbus_pdu_encode_read_write(uint16_t read_addr, uint16_t read_qty, uint16_t write_addr,
+                                      const uint16_t *values, uint16_t write_qty, uint8_t *pdu, size_t size);
+
+/**
+ * @brief Number of registers a request asks for, as its response must echo them.
+ *
+ * @param pdu Request PDU
+ * @param len Length of the request PDU
+ * @return Read quantity for 0x03, 0x04 and 0x17, write quantity for 0x06 and 0x10, or 0 if unsupported
+ */
+uint16_t modbus_pdu_request_qty(const uint8_t *pdu, size_t len);
+
+/**
+ * @brief Decode a response PDU against the request it answers.
+ *
+ * @param req Request PDU, or at least its first MODBUS_PDU_REQUEST_HEADER_SIZE bytes
+ * @param req_len Length of req
+ * @param pdu Response PDU
+ * @param len Length of the response PDU
+ * @param regs Output register values for reads (may be NULL for writes)
+ * @param regs_len Length of the output array
+ * @return Number of registers read (0 for writes), or a negative error code:
+ *         -1: Invalid input pointers
+ *         -3: Function code mismatch
+ *         -4: Byte count or echoed address, value or quantity does not match the request
+ *         -5: PDU too short
+ *         -6: Output array too small
+ *         -8: Exception response; the exception code is pdu[1]
+ *
+ * Write responses must echo the request's address and value (0x06) or
+ * address and quantity (0x10), so a response to some other write is not
+ * taken as confirmation of this one.
+ */
+int modbus_pdu_decode_response(const uint8_t *req, size_t req_len, const uint8_t *pdu, size_t len, uint16_t *regs,
+                               uint16_t regs_len);
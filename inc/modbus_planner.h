@@ -0,0 +1,126 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "modbus_master.h"
+
+/**
+ * @file modbus_planner.h
+ * @brief Read planner that coalesces scattered points into few requests.
+ *
+ * A tag database addresses single holding registers spread over many
+ * units. Polling them one request each wastes a round trip per point; on
+ * a 19200 baud RS-485 line the request, the response header and CRC and
+ * the two inter-frame silences cost about 11.5 ms plus the slave's
+ * turnaround, while an unwanted register inside a larger read costs
+ * 1.15 ms. A max_gap around 10 is a reasonable start at that speed.
+ *
+ * The planner sorts the points by (unit, address) and cuts the sorted run
+ * into reads. A read is closed when the unit changes, when the next point
+ * is more than max_gap unused registers away, or when including it would
+ * exceed MODBUS_MAX_REGS. Within each stretch bounded by unit changes and
+ * gaps, taking the longest read that fits from the lowest point onwards
+ * is optimal, so the plan has the fewest requests the gap limit allows.
+ *
+ * After a response, the decoded registers are scattered back into the
+ * points of that read. Rebuild the plan when the point list changes.
+ */
+
+/**
+ * @brief One register of interest.
+ */
+typedef struct modbus_point_s
+{
+    uint8_t unit_id; /**< Slave that holds the register (1..MODBUS_MAX_SLAVES) */
+    uint16_t addr;   /**< Holding register address */
+    uint16_t value;  /**< Last value read, written by the scatter step */
+} modbus_point_st;
+
+/**
+ * @brief One planned Read Holding Registers request.
+ */
+typedef struct modbus_planned_read_s
+{
+    uint8_t unit_id;     /**< Slave to read from */
+    uint16_t start_addr; /**< First register, the lowest point address */
+    uint16_t qty;        /**< Number of registers, up to the highest point address */
+    uint32_t first;      /**< First index into the plan's order array */
+    uint32_t count;      /**< Number of points served by this read */
+} modbus_planned_read_st;
+
+/**
+ * @brief Set of reads covering a point list.
+ */
+typedef struct modbus_read_plan_s
+{
+    modbus_point_st *points;       /**< Caller's points (must outlive the plan) */
+    uint32_t *order;               /**< Point indices sorted by (unit, address) */
+    modbus_planned_read_st *reads; /**< Planned reads, in (unit, address) order */
+    size_t read_count;             /**< Number of planned reads */
+} modbus_read_plan_st;
+
+/**
+ * @brief Plan the reads for a point list.
+ *
+ * @param plan Plan to build
+ * @param points Points to cover; their values are updated by the scatter step
+ * @param count Number of points
+ * @param max_gap Largest run of unused registers a read may carry between two points
+ * @return Number of planned reads, or a negative error code:
+ *         -1: Invalid input pointers
+ *         -2: A point has an invalid unit ID, or count does not fit 32 bits
+ *         -3: Out of memory
+ *
+ * Several points may share an address; they all receive its value.
+ */
+int modbus_read_plan_build(modbus_read_plan_st *plan, modbus_point_st *points, size_t count, uint16_t max_gap);
+
+/**
+ * @brief Release the plan.
+ *
+ * @param plan Plan
+ */
+void modbus_read_plan_free(modbus_read_plan_st *plan);
+
+/**
+ * @brief Copy the registers of a read into its points.
+ *
+ * @param plan Plan
+ * @param index Index of the read in plan->reads
+ * @param regs Decoded registers, regs[0] is the read's start address
+ * @param qty Number of decoded registers
+ * @return Number of points updated, or a negative error code:
+ *         -1: Invalid input pointers or index
+ *         -2: qty differs from the planned read
+ *
+ * Use it with any transport, e.g. after decode_tcp_read_response().
+ */
+int modbus_read_plan_scatter(const modbus_read_plan_st *plan, size_t index, const uint16_t *regs, uint16_t qty);
+
+/**
+ * @brief Encode the RTU request of a planned read.
+ *
+ * @param plan Plan
+ * @param index Index of the read in plan->reads
+ * @param ctx Master context, records the slave expected to answer
+ * @param buffer Output buffer
+ * @param bufsize Size of the output buffer
+ * @return Length of the encoded request in bytes, or 0 on failure
+ */
+uint16_t modbus_read_plan_encode(const modbus_read_plan_st *plan, size_t index, modbus_master_ctx_st *ctx,
+                                 uint8_t *buffer, size_t bufsize);
+
+/**
+ * @brief Decode the RTU response of a planned read and scatter it into its points.
+ *
+ * @param plan Plan
+ * @param index Index of the read in plan->reads
+ * @param ctx Master context used to encode the request
+ * @param buffer Buffer containing the response
+ * @param bufsize Size of the buffer
+ * @return Number of points updated, a decode_read_response() error code (-1..-7),
+ *         or -8 if the response carries a different number of registers than planned
+ */
+int modbus_read_plan_decode(const modbus_read_plan_st *plan, size_t index, const modbus_master_ctx_st *ctx,
+                            const uint8_t *buffer, size_t bufsize);
@@ -0,0 +1,161 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "modbus_defines.h"
+#include "modbus_stream.h"
+
+/**
+ * @file modbus_rtu.h
+ * @brief Modbus RTU transport on a serial line (termios).
+ *
+ * The character time follows from the baud rate and the character format
+ * (start bit, 8 data bits, parity bit, stop bits). From it come the two
+ * RTU silences: t1.5, the longest gap allowed between the characters of a
+ * frame, and t3.5, the silence that ends a frame. Above 19200 baud both are
+ * fixed at 750 us and 1750 us, as the serial line specification requires.
+ *
+ * Received frames end as soon as the function code and byte count say they
+ * are complete; frames whose length cannot be told end after t3.5 of
+ * silence, measured with a timerfd. A new frame is sent exactly t3.5 after
+ * the end of the previous one on the line (or after the turnaround delay
+ * following a broadcast), never after a fixed sleep, so the bus carries
+ * frames back to back.
+ *
+ * The time a frame occupies the line is computed from its length, not read
+ * back from the driver: modbus_rtu_send() returns when the last character
+ * has left, and a received frame ends no earlier than its first character
+ * plus the time of the rest. This also keeps the timing right on a
+ * pseudo-terminal, which moves bytes instantly whatever its baud rate.
+ *
+ * One modbus_rtu_st per line, used by one thread.
+ */
+
+/** @brief Inter-character timeout above 19200 baud, in nanoseconds */
+#define MODBUS_RTU_T15_FIXED_NS 750000u
+
+/** @brief Inter-frame delay above 19200 baud, in nanoseconds */
+#define MODBUS_RTU_T35_FIXED_NS 1750000u
+
+/**
+ * @brief Line settings.
+ */
+typedef struct modbus_rtu_config_s
+{
+    uint32_t baud;                 /**< Baud rate, one of the standard termios rates (1200..921600) */
+    char parity;                   /**< 'E' (Modbus default), 'O' or 'N' */
+    uint8_t stop_bits;             /**< 1 or 2 */
+    modbus_stream_mode_et rx_mode; /**< MODBUS_STREAM_RTU_RESPONSE on a master, MODBUS_STREAM_RTU_REQUEST on a slave */
+    uint32_t response_timeout_us;  /**< modbus_rtu_transact(): wait for the first byte of the answer (0 = forever) */
+    uint32_t turnaround_us;        /**< modbus_rtu_transact(): silence kept after a broadcast */
+} modbus_rtu_config_st;
+
+/**
+ * @brief Line counters.
+ */
+typedef struct modbus_rtu_stats_s
+{
+    uint64_t frames_sent;     /**< Frames written */
+    uint64_t frames_received; /**< Frames returned by modbus_rtu_recv() */
+    uint64_t timeouts;        /**< Receives that saw no byte before their timeout */
+    uint64_t char_gaps;       /**< Gaps longer than t1.5 inside a received frame */
+    uint64_t dropped_bytes;   /**< Bytes received behind a complete frame, or flushed before a send */
+    uint64_t busy_ns;         /**< Time the line carried the frames sent and received */
+} modbus_rtu_stats_st;
+
+/**
+ * @brief Serial line state.
+ */
+typedef struct modbus_rtu_s
+{
+    int fd;                        /**< Serial line, non-blocking, owned by the transport */
+    int timer_fd;                  /**< timerfd for the response timeout and the t3.5 silence */
+    modbus_stream_mode_et rx_mode; /**< Framing of received frames */
+    uint64_t char_ns;              /**< Time of one character on the line */
+    uint64_t t15_ns;               /**< Longest gap inside a frame */
+    uint64_t t35_ns;               /**< Silence between frames */
+    uint32_t response_timeout_us;  /**< See modbus_rtu_config_st */
+    uint64_t turnaround_ns;        /**< See modbus_rtu_config_st */
+    uint64_t line_idle_ns;         /**< CLOCK_MONOTONIC time the last frame on the line ended */
+    bool flush_input;              /**< Discard stale input before the next send (after a timeout) */
+    modbus_rtu_stats_st stats;     /**< Counters */
+} modbus_rtu_st;
+
+/**
+ * @brief Open and configure a serial device.
+ *
+ * @param rtu Transport to initialize
+ * @param path Device path, e.g. /dev/ttyUSB0
+ * @param cfg Line settings
+ * @return 0 on success, or a negative error code:
+ *         -1: Invalid arguments
+ *         -2: Device could not be opened
+ *         -3: Line settings rejected by the device
+ *         -4: Timer could not be created
+ */
+int modbus_rtu_open(modbus_rtu_st *rtu, const char *path, const modbus_rtu_config_st *cfg);
+
+/**
+ * @brief Configure an already open serial line or pseudo-terminal.
+ *
+ * @param rtu Transport to initialize
+ * @param fd Open descriptor; the transport owns it from now on, even on failure
+ * @param cfg Line settings
+ * @return 0 on success, or a negative error code as modbus_rtu_open()
+ *
+ * The line is set to raw 8-bit characters with the given baud rate,
+ * parity and stop bits, and made non-blocking.
+ */
+int modbus_rtu_init(modbus_rtu_st *rtu, int fd, const modbus_rtu_config_st *cfg);
+
+/**
+ * @brief Close the line and the timer.
+ *
+ * @param rtu Transport
+ */
+void modbus_rtu_close(modbus_rtu_st *rtu);
+
+/**
+ * @brief Send one frame as soon as the line has been silent for t3.5.
+ *
+ * @param rtu Transport
+ * @param frame Complete RTU frame, CRC included
+ * @param len Length of the frame
+ * @return 0 once the last character has left, or a negative error code:
+ *         -1: Invalid arguments
+ *         -2: Write error
+ */
+int modbus_rtu_send(modbus_rtu_st *rtu, const uint8_t *frame, size_t len);
+
+/**
+ * @brief Receive one frame.
+ *
+ * @param rtu Transport
+ * @param buf Output buffer, at least MODBUS_RTU_MAX_ADU_SIZE bytes for any frame
+ * @param size Size of the output buffer
+ * @param timeout_us Wait for the first byte (0 = wait forever)
+ * @return Frame length, 0 if no byte arrived in time, or a negative error code:
+ *         -1: Invalid arguments
+ *         -2: Read error or line hung up
+ *         -3: Frame longer than the buffer (the line is resynchronized on the next t3.5)
+ *
+ * A frame ends when its framing rule says it is complete, or after t3.5
+ * of silence. The CRC is left to the decoder.
+ */
+int modbus_rtu_recv(modbus_rtu_st *rtu, uint8_t *buf, size_t size, uint32_t timeout_us);
+
+/**
+ * @brief Send a request and receive its answer; matches modbus_transact_fn.
+ *
+ * @param arg Transport (modbus_rtu_st *)
+ * @param request Encoded RTU request
+ * @param len Length of the request
+ * @param response Output buffer for the response
+ * @param size Size of the output buffer
+ * @return Length of the response, 0 on timeout or after a broadcast, or negative on error
+ *
+ * Pass { modbus_rtu_transact, &rtu } as the transport of a scheduler.
+ */
+int modbus_rtu_transact(void *arg, const uint8_t *request, size_t len, uint8_t *response, size_t size);
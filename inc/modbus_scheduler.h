@@ -0,0 +1,207 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdatomic.h>
+
+#include "modbus_master.h"
+#include "modbus_cov.h"
+
+/**
+ * @file modbus_scheduler.h
+ * @brief Earliest-deadline-first polling scheduler for one RTU bus.
+ *
+ * A scan group is one Read Holding Registers window on one slave, polled
+ * every period. Each period releases the group once; the poll is due by
+ * the end of that period. A bus carries one transaction at a time, so the
+ * scheduler picks, among the released groups, the one whose deadline is
+ * earliest, and runs it to completion on the transport. Equal deadlines
+ * go to the higher priority, then to the group added first.
+ *
+ * Fast groups have near deadlines and win the bus over slow ones without
+ * any tuning, and a slow group holds the bus for one transaction at most.
+ * A group never builds a backlog: if a whole period passed without it
+ * being served, the missed releases are counted as skipped and dropped
+ * instead of being replayed back to back.
+ *
+ * A group given a min and a max period adapts its period to how often its
+ * registers actually change. A poll that returns new values halves the
+ * period, down to the min. A poll that returns the same values stretches
+ * it by half, up to the max. The period settles where about one poll in
+ * three sees a change: a block that changes every cycle is polled at its
+ * min period, and a block that changes once an hour at its max.
+ * The bus time that quiet blocks no longer take is left to the busy
+ * ones, whose nearer deadlines win it under earliest-deadline-first.
+ *
+ * Per group the scheduler records release jitter (how long after its
+ * release a poll started) and overruns (polls that finished after their
+ * deadline). The transport and the clock are callbacks, so tests drive
+ * the scheduler against a simulated bus and clock.
+ */
+
+/**
+ * @brief Run one request/response exchange on the bus.
+ *
+ * @param arg User argument from the transport
+ * @param request Encoded RTU request
+ * @param len Length of the request
+ * @param response Output buffer for the response
+ * @param size Size of the output buffer
+ * @return Length of the response, 0 on timeout, or negative on error
+ */
+typedef int (*modbus_transact_fn)(void *arg, const uint8_t *request, size_t len, uint8_t *response, size_t size);
+
+/**
+ * @brief Bus transport used by the scheduler.
+ */
+typedef struct modbus_transport_s
+{
+    modbus_transact_fn transact; /**< Blocking exchange, bounded by the transport's own timeout */
+    void *arg;                   /**< User argument passed to transact */
+} modbus_transport_st;
+
+/**
+ * @brief Time source used by the scheduler.
+ *
+ * A zeroed clock (both callbacks NULL) uses CLOCK_MONOTONIC and nanosleep().
+ */
+typedef struct modbus_clock_s
+{
+    uint64_t (*now_us)(void *arg);            /**< Current time in microseconds */
+    void (*sleep_us)(void *arg, uint64_t us); /**< Wait for the given time */
+    void *arg;                                /**< User argument passed to both callbacks */
+} modbus_clock_st;
+
+struct modbus_scan_group_s;
+
+/**
+ * @brief Callback for a successful poll.
+ *
+ * @param arg User argument from the group configuration
+ * @param group Group that was polled
+ * @param regs Register values, host order
+ * @param qty Number of registers
+ */
+typedef void (*modbus_scan_data_fn)(void *arg, const struct modbus_scan_group_s *group, const uint16_t *regs,
+                                    uint16_t qty);
+
+/**
+ * @brief Scan group configuration.
+ */
+typedef struct modbus_scan_group_config_s
+{
+    uint8_t unit_id;             /**< Slave to poll (1..MODBUS_MAX_SLAVES) */
+    uint16_t start_addr;         /**< First register */
+    uint16_t qty;                /**< Number of registers (1..MODBUS_MAX_REGS) */
+    uint32_t period_us;          /**< Poll period, also the relative deadline; first period if adaptive */
+    uint32_t min_period_us;      /**< Shortest adaptive period (0 with max_period_us 0 = fixed period) */
+    uint32_t max_period_us;      /**< Longest adaptive period */
+    uint8_t priority;            /**< Tie-break between equal deadlines, higher first */
+    modbus_scan_data_fn on_data; /**< Called with the registers of each successful poll (may be NULL) */
+    void *arg;                   /**< User argument passed to on_data */
+} modbus_scan_group_config_st;
+
+/**
+ * @brief Schedule adherence of a group.
+ */
+typedef struct modbus_scan_stats_s
+{
+    uint64_t polls;         /**< Transactions run */
+    uint64_t failures;      /**< Transactions that timed out, failed or returned a bad response */
+    uint64_t changes;       /**< Successful polls of an adaptive group that returned new values */
+    uint64_t overruns;      /**< Transactions that finished after their deadline */
+    uint64_t skipped;       /**< Releases dropped because a whole period passed unserved */
+    uint64_t jitter_sum_us; /**< Sum of release-to-start delays, for the mean */
+    uint32_t jitter_max_us; /**< Largest release-to-start delay */
+} modbus_scan_stats_st;
+
+/**
+ * @brief Scan group state.
+ */
+typedef struct modbus_scan_group_s
+{
+    modbus_scan_group_config_st cfg; /**< Configuration */
+    uint64_t release_us;             /**< Start of the current period */
+    uint64_t deadline_us;            /**< End of the current period */
+    uint32_t period_us;              /**< Current period */
+    modbus_cov_block_st cov;         /**< Values of the last poll (adaptive groups only) */
+    modbus_scan_stats_st stats;      /**< Counters */
+} modbus_scan_group_st;
+
+/**
+ * @brief Scheduler for one bus.
+ */
+typedef struct modbus_scheduler_s
+{
+    modbus_scan_group_st *groups;  /**< Caller storage, capacity entries */
+    uint32_t capacity;             /**< Number of group slots */
+    uint32_t count;                /**< Number of groups added */
+    modbus_transport_st transport; /**< Bus */
+    modbus_clock_st clock;         /**< Time source */
+    modbus_master_ctx_st master;   /**< Master context of the bus */
+    atomic_bool stop;              /**< Set by modbus_scheduler_stop() */
+} modbus_scheduler_st;
+
+/**
+ * @brief Initialize a scheduler.
+ *
+ * @param sched Scheduler to initialize
+ * @param groups Storage for the groups (must outlive the scheduler)
+ * @param capacity Number of entries in groups
+ * @param transport Bus transport
+ * @param clock Time source, or NULL for CLOCK_MONOTONIC
+ * @return 0 on success, or -1 on invalid arguments
+ */
+int modbus_scheduler_init(modbus_scheduler_st *sched, modbus_scan_group_st *groups, uint32_t capacity,
+                          const modbus_transport_st *transport, const modbus_clock_st *clock);
+
+/**
+ * @brief Add a scan group, first released now.
+ *
+ * @param sched Scheduler
+ * @param cfg Group configuration
+ * @return Index of the group, or a negative error code:
+ *         -1: Invalid input pointers
+ *         -2: Invalid configuration (including an adaptive range that does not hold period_us)
+ *         -3: No free group slot
+ */
+int modbus_scheduler_add(modbus_scheduler_st *sched, const modbus_scan_group_config_st *cfg);
+
+/**
+ * @brief Run the most urgent released group, if any.
+ *
+ * @param sched Scheduler
+ * @param wait_us Output: when nothing is released, the time until the next release (may be NULL)
+ * @return Index of the group polled, -1 on invalid arguments, or -2 if no group is released yet
+ */
+int modbus_scheduler_poll(modbus_scheduler_st *sched, uint64_t *wait_us);
+
+/**
+ * @brief Poll groups until the given time or until stopped.
+ *
+ * @param sched Scheduler
+ * @param until_us Clock time to return at
+ * @return Number of transactions run, or -1 on invalid arguments
+ *
+ * Sleeps on the scheduler's clock between releases.
+ */
+int64_t modbus_scheduler_run(modbus_scheduler_st *sched, uint64_t until_us);
+
+/**
+ * @brief Make modbus_scheduler_run() return after the current transaction.
+ *
+ * @param sched Scheduler
+ *
+ * Safe to call from another thread, from an on_data callback or from a
+ * signal handler. A run that is sleeping returns when the sleep ends.
+ */
+void modbus_scheduler_stop(modbus_scheduler_st *sched);
+
+/**
+ * @brief Current time on the scheduler's clock.
+ *
+ * @param sched Scheduler
+ * @return Time in microseconds
+ */
+uint64_t modbus_scheduler_now(const modbus_scheduler_st *sched);
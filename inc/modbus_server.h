@@ -0,0 +1,218 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdatomic.h>
+
+#include "modbus_defines.h"
+#include "modbus_slave.h"
+#include "modbus_host.h"
+#include "modbus_stream.h"
+#include "modbus_pdu.h"
+#include "modbus_stats.h"
+
+/**
+ * @file modbus_server.h
+ * @brief Single-threaded Modbus TCP slave server for many concurrent masters.
+ *
+ * The server runs a non-blocking, edge-triggered epoll loop. Connections are
+ * taken from a pool allocated once at init, each with its own receive ring
+ * (a modbus_stream in TCP mode) and transmit buffer, so serving a request
+ * never allocates. Pipelined requests are answered in arrival order.
+ *
+ * Register values come from a read callback, so the server does not own
+ * any register storage. A wire-order callback may be given instead: it
+ * writes big-endian bytes straight into the transmit buffer, so a source
+ * that keeps a wire image (modbus_bank) is served without any byte swap.
+ *
+ * Read Holding Registers takes that direct path; every other function code
+ * goes through the modbus_pdu dispatcher, with writes enabled by write_cb.
+ *
+ * A server answers for one unit ID, or for every unit of a modbus_host:
+ * the unit ID of each request then selects its register sources.
+ */
+
+/** @brief Default listen backlog */
+#define MODBUS_SERVER_DEFAULT_BACKLOG 1024
+
+/** @brief Receive ring capacity per connection, in bytes */
+#define MODBUS_SERVER_RX_CAPACITY 1024
+
+/** @brief Transmit buffer size per connection, in bytes */
+#define MODBUS_SERVER_TX_SIZE 2048
+
+/**
+ * @brief Read callback that supplies register values for a request.
+ *
+ * @param arg User argument from the configuration
+ * @param unit_id Unit ID of the request
+ * @param start_addr Starting register address
+ * @param qty Number of registers (1..MODBUS_MAX_REGS)
+ * @param regs Output register values, in host order
+ * @return 0 on success, or non-zero to answer Slave Device Failure (0x04)
+ */
+typedef int (*modbus_server_read_fn)(void *arg, uint8_t unit_id, uint16_t start_addr, uint16_t qty,
+                                     uint16_t *regs);
+
+/**
+ * @brief Read callback that writes register values in wire order.
+ *
+ * @param arg User argument from the configuration
+ * @param unit_id Unit ID of the request
+ * @param start_addr Starting register address
+ * @param qty Number of registers (1..MODBUS_MAX_REGS)
+ * @param dst Output: qty * 2 bytes, big-endian, inside the transmit buffer
+ * @return 0 on success, or non-zero to answer Slave Device Failure (0x04)
+ */
+typedef int (*modbus_server_read_wire_fn)(void *arg, uint8_t unit_id, uint16_t start_addr, uint16_t qty,
+                                          uint8_t *dst);
+
+/**
+ * @brief Server configuration.
+ */
+typedef struct modbus_server_config_s
+{
+    const char *bind_addr;          /**< IPv4 address to bind (NULL = any) */
+    uint16_t port;                  /**< TCP port (0 = pick an ephemeral port) */
+    int backlog;                    /**< Listen backlog (0 = MODBUS_SERVER_DEFAULT_BACKLOG) */
+    uint32_t max_connections;       /**< Size of the connection pool */
+    bool reuse_port;                /**< Set SO_REUSEPORT so several servers can share the port */
+    const modbus_host_st *host;     /**< Units served (NULL = the single unit below); must outlive the server */
+    uint8_t slave_id;               /**< Unit ID served by this device (1..MODBUS_MAX_SLAVES) */
+    modbus_server_read_fn read_cb;  /**< Register source (host order) */
+    modbus_server_read_wire_fn read_wire_cb; /**< Register source (wire order); used instead of read_cb if set */
+    modbus_read_regs_fn read_input_cb;   /**< Input registers for 0x04 (NULL = not supported) */
+    modbus_write_regs_fn write_cb;       /**< Holding register sink for 0x06, 0x10 and 0x17 (NULL = read-only) */
+    void *read_arg;                 /**< User argument passed to every callback */
+    modbus_stats_st *stats;         /**< Frame and error counters (NULL = off) */
+    uint32_t stats_shard;           /**< Shard of stats this server records into */
+} modbus_server_config_st;
+
+/**
+ * @brief Server counters.
+ *
+ * Written only by the thread running the server, with relaxed atomic
+ * stores (see modbus_stats_add()), so another thread may read them with
+ * relaxed loads while it runs.
+ */
+typedef struct modbus_server_stats_s
+{
+    uint64_t accepted;  /**< Connections accepted into the pool */
+    uint64_t rejected;  /**< Connections closed because the pool was empty */
+    uint64_t closed;    /**< Pooled connections closed */
+    uint64_t requests;  /**< Requests answered */
+    uint64_t exceptions; /**< Requests answered with an exception response */
+    uint64_t errors;    /**< Requests dropped (not for a served unit, or not one valid ADU) */
+    uint64_t rx_bytes;  /**< Bytes received */
+    uint64_t tx_bytes;  /**< Bytes sent */
+} modbus_server_stats_st;
+
+/**
+ * @brief One pooled client connection.
+ */
+typedef struct modbus_server_conn_s
+{
+    int fd;                                   /**< Socket, or -1 when the slot is free */
+    bool readable;                            /**< Socket may have unread bytes (edge-triggered) */
+    uint32_t next_free;                       /**< Next free slot when on the free list */
+    size_t tx_len;                            /**< Bytes queued in tx */
+    modbus_stream_st rx;                      /**< Receive reassembler */
+    uint8_t rx_storage[MODBUS_STREAM_STORAGE_SIZE(MODBUS_SERVER_RX_CAPACITY)]; /**< Receive ring */
+    uint8_t tx[MODBUS_SERVER_TX_SIZE];        /**< Pending responses */
+} modbus_server_conn_st;
+
+/**
+ * @brief Server state.
+ */
+typedef struct modbus_server_s
+{
+    int listen_fd;                  /**< Listening socket */
+    int epoll_fd;                   /**< Event loop */
+    int wake_fd;                    /**< eventfd used by modbus_server_stop() */
+    atomic_bool stop;               /**< Set to leave modbus_server_run() */
+    const modbus_host_st *host;     /**< Units served: the configured host, or single */
+    modbus_host_st single;          /**< The one unit of slave_id, when no host is configured */
+    modbus_server_conn_st *conns;   /**< Connection pool */
+    uint32_t max_connections;       /**< Pool size */
+    uint32_t free_head;             /**< First free pool slot */
+    uint32_t active;                /**< Connections currently open */
+    modbus_server_stats_st stats;   /**< Counters */
+    modbus_stats_shard_st *stats_shard; /**< Detailed counters, or NULL */
+} modbus_server_st;
+
+/**
+ * @brief Create the listening socket, the event loop and the connection pool.
+ *
+ * @param srv Server to initialize
+ * @param cfg Configuration
+ * @return 0 on success, or a negative error code:
+ *         -1: Invalid arguments (including a stats_shard that stats does not have,
+ *             or no host, read_cb or read_wire_cb)
+ *         -2: Out of memory
+ *         -3: Socket, bind or listen failed
+ *         -4: epoll or eventfd setup failed
+ *
+ * Without a host, the server answers slave_id, and also unit IDs 0 and
+ * MODBUS_TCP_UNIT_ID_IGNORED, from the callbacks.
+ */
+int modbus_server_init(modbus_server_st *srv, const modbus_server_config_st *cfg);
+
+/**
+ * @brief Units a server configuration serves.
+ *
+ * Shared by the TCP and UDP servers.
+ *
+ * @param cfg Configuration
+ * @param single Host built from the callbacks when cfg->host is NULL
+ *               (release with modbus_host_free(); zeroed otherwise)
+ * @param host Output: cfg->host, or single
+ * @return 0 on success, or a negative error code:
+ *         -1: Invalid arguments
+ *         -2: Out of memory
+ */
+int modbus_server_config_units(const modbus_server_config_st *cfg, modbus_host_st *single,
+                               const modbus_host_st **host);
+
+/**
+ * @brief Release the sockets and the connection pool.
+ *
+ * @param srv Server
+ */
+void modbus_server_deinit(modbus_server_st *srv);
+
+/**
+ * @brief Port the server is listening on.
+ *
+ * @param srv Server
+ * @return Port in host order, or 0 on error
+ *
+ * Useful when the server was configured with port 0.
+ */
+uint16_t modbus_server_port(const modbus_server_st *srv);
+
+/**
+ * @brief Run one iteration of the event loop.
+ *
+ * @param srv Server
+ * @param timeout_ms epoll_wait timeout (-1 = wait forever)
+ * @return Number of events handled, or -1 on error
+ */
+int modbus_server_poll(modbus_server_st *srv, int timeout_ms);
+
+/**
+ * @brief Run the event loop until modbus_server_stop() is called.
+ *
+ * @param srv Server
+ * @return 0 when stopped, or -1 on error
+ */
+int modbus_server_run(modbus_server_st *srv);
+
+/**
+ * @brief Ask modbus_server_run() to return.
+ *
+ * @param srv Server
+ *
+ * Safe to call from another thread or from a signal handler.
+ */
+void modbus_server_stop(modbus_server_st *srv);
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <stdint.h>
+#include <pthread.h>
+
+#include "modbus_defines.h"
+#include "modbus_server.h"
+
+/**
+ * @file modbus_server_group.h
+ * @brief Shared-nothing Modbus TCP server: one event loop per core.
+ *
+ * Every shard is a complete modbus_server with its own listening socket
+ * bound to the same port with SO_REUSEPORT, so the kernel spreads incoming
+ * connections across shards. Shards share no mutable state: each has its
+ * own connection pool and counters, on its own cache lines, and runs on
+ * its own thread pinned to one CPU.
+ *
+ * All shards call the same read callback concurrently. The callback must
+ * therefore be safe to call from several threads without a lock, for
+ * example by reading a seqlock-protected register bank.
+ */
+
+/** @brief Maximum number of shards in a group */
+#define MODBUS_SERVER_GROUP_MAX_SHARDS 256
+
+/**
+ * @brief One event loop of a group.
+ */
+typedef struct modbus_server_shard_s
+{
+    _Alignas(MODBUS_CACHE_LINE_SIZE) modbus_server_st server; /**< Shard server and its counters */
+    pthread_t thread;                                          /**< Thread running the event loop */
+    int cpu;                                                   /**< CPU the thread is pinned to, or -1 */
+    int result;                                                /**< modbus_server_run() return value */
+} modbus_server_shard_st;
+
+/**
+ * @brief Group of SO_REUSEPORT shards.
+ */
+typedef struct modbus_server_group_s
+{
+    modbus_server_shard_st *shards; /**< Shard array, cache-line aligned */
+    uint32_t count;                 /**< Number of shards */
+    uint32_t running;               /**< Number of threads started */
+    uint16_t port;                  /**< Port shared by all shards */
+} modbus_server_group_st;
+
+/**
+ * @brief Create the shards and their listening sockets.
+ *
+ * @param g Group to initialize
+ * @param cfg Per-shard configuration (max_connections is per shard; reuse_port is forced on)
+ * @param shards Number of shards (0 = one per online CPU)
+ * @return 0 on success, or a negative error code:
+ *         -1: Invalid arguments
+ *         -2: Out of memory
+ *         -3: A shard failed to initialize
+ *
+ * With cfg->port 0, the first shard picks an ephemeral port and the others
+ * bind the same one. With cfg->stats set, shard i records into stats
+ * shard cfg->stats_shard + i, so the stats set needs one shard per server.
+ */
+int modbus_server_group_init(modbus_server_group_st *g, const modbus_server_config_st *cfg, uint32_t shards);
+
+/**
+ * @brief Start one thread per shard.
+ *
+ * @param g Group
+ * @return 0 on success, -1 if a thread could not be created (started shards keep running)
+ *
+ * Shard i is pinned to CPU i when there are no more shards than online CPUs.
+ */
+int modbus_server_group_start(modbus_server_group_st *g);
+
+/**
+ * @brief Stop every shard and wait for its thread.
+ *
+ * @param g Group
+ */
+void modbus_server_group_stop(modbus_server_group_st *g);
+
+/**
+ * @brief Release all shards. Stops them first if they are running.
+ *
+ * @param g Group
+ */
+void modbus_server_group_deinit(modbus_server_group_st *g);
+
+/**
+ * @brief Sum the counters of all shards.
+ *
+ * @param g Group
+ * @param total Output totals
+ *
+ * Safe to call while the group runs: the shards store their counters
+ * with relaxed atomic stores and they are read with relaxed loads, so no
+ * counter is torn, though the totals may mix counts from slightly
+ * different moments. Exact once the group is stopped.
+ */
+void modbus_server_group_stats(const modbus_server_group_st *g, modbus_server_stats_st *total);
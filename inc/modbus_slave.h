@@ -3,9 +3,30 @@
 #include <stdint.h>
 #include <stddef.h>
 
+#include "modbus_pdu.h"
+
+/**
+ * @brief Modbus slave device state.
+ *
+ * One context per served bus or device. Contexts share nothing, so
+ * different threads can serve their own buses without locking.
+ */
+typedef struct modbus_slave_ctx_s
+{
+    uint8_t device_slave_id; /**< Slave ID this device answers to (0 = not configured) */
+} modbus_slave_ctx_st;
+
+/**
+ * @brief Initialize a slave context with no slave ID configured.
+ *
+ * @param ctx Context to initialize
+ */
+void modbus_slave_ctx_init(modbus_slave_ctx_st *ctx);
+
 /**
  * @brief Encode a Modbus Read Holding Registers response frame.
  *
+ * @param ctx Slave context
  * @param slave_id Modbus slave ID (1..247)
  * @param regs Array of register values to include in response
  * @param qty Number of registers to include (must be <= MODBUS_MAX_REGS)
@@ -16,13 +37,14 @@
  * This function validates the input parameters, converts registers to big-endian
  * format, and appends the CRC16 checksum at the end of the frame.
  */
-uint16_t encode_read_response(uint8_t slave_id,
+uint16_t encode_read_response(const modbus_slave_ctx_st *ctx, uint8_t slave_id,
                               const uint16_t *regs, uint16_t qty,
                               uint8_t *buffer, size_t bufsize);
 
 /**
  * @brief Decode a Modbus Read Holding Registers request.
  *
+ * @param ctx Slave context holding the device slave ID
  * @param buffer Pointer to the incoming Modbus request frame
  * @param bufsize Size of the incoming buffer
  * @param slave_id Pointer to store the decoded slave ID
@@ -33,15 +55,40 @@ uint16_t encode_read_response(uint8_t slave_id,
  * This function validates the Modbus request frame, checks the CRC,
  * ensures the slave ID and quantity are valid, and outputs the decoded values.
  */
-int decode_read_request(uint8_t *buffer, size_t bufsize, uint8_t *slave_id, uint16_t *start_addr, uint16_t *qty);
+int decode_read_request(const modbus_slave_ctx_st *ctx, const uint8_t *buffer, size_t bufsize, uint8_t *slave_id, uint16_t *start_addr, uint16_t *qty);
+
+/**
+ * @brief Answer any supported RTU request through the function-code dispatcher.
+ *
+ * @param ctx Slave context holding the device slave ID
+ * @param map Register sources
+ * @param buffer Incoming RTU request frame
+ * @param bufsize Size of the incoming buffer
+ * @param response Output buffer, at least MODBUS_RTU_MAX_ADU_SIZE bytes
+ * @param respsize Size of the output buffer
+ * @return Length of the response frame, 0 if the request was a broadcast
+ *         (executed, never answered), or a negative error code:
+ *         -1: Invalid input pointers or response buffer too small
+ *         -2: Frame incomplete
+ *         -4: Slave ID not addressed to this device
+ *         -6: CRC mismatch
+ *
+ * Requests that pass framing, addressing and CRC are always answered, with
+ * an exception response if the dispatcher rejects them. A function code
+ * without a known layout is answered with Illegal Function: its frame is
+ * taken to be the whole buffer, as delimited by the t3.5 silence on RTU.
+ */
+int modbus_slave_handle_request(const modbus_slave_ctx_st *ctx, const modbus_register_map_st *map,
+                                const uint8_t *buffer, size_t bufsize, uint8_t *response, size_t respsize);
 
 /**
  * @brief Set the Modbus slave ID for this device.
  *
+ * @param ctx Slave context to configure
  * @param slave_id Modbus slave ID (1..247)
- * @return 0 on success, -1 if the slave ID is invalid
+ * @return 0 on success, -1 if the context is NULL or the slave ID is invalid
  *
  * This function sets the slave ID that the device will respond to.
  * It validates the input to ensure it is within the allowed range.
  */
-int set_device_slave_id(uint8_t slave_id);
+int set_device_slave_id(modbus_slave_ctx_st *ctx, uint8_t slave_id);
@@ -0,0 +1,142 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "modbus_defines.h"
+#include "modbus_bank.h"
+
+/**
+ * @file modbus_sniff.h
+ * @brief Passive RTU bus listener that keeps a mirror of the slaves' registers.
+ *
+ * On a shared RS-485 line every node sees every frame. A sniffer never
+ * transmits: it splits the traffic into frames, pairs each request with
+ * the response that follows it, and applies every confirmed transaction
+ * to a register mirror. A historian then reads the mirror, with no polls
+ * of its own added to the line.
+ *
+ * Frames are delimited by their structure (function code and byte count,
+ * as modbus_stream does) and by timing: a silence of t3.5 ends any frame,
+ * and bytes that cannot start a frame are dropped up to the next such
+ * silence. A frame that follows a request and carries the same address
+ * and function code (or its exception) is parsed as its response; anything
+ * else is a new request. A request left without a response for the
+ * response timeout is given up.
+ *
+ * Each watched unit mirrors into modbus_banks, so readers on other threads
+ * get consistent snapshots without locks, and a mirror can be served again
+ * through a modbus_host. Frames addressed to units that are not watched
+ * are skipped on the address byte: only their length is worked out, their
+ * CRC is never computed.
+ *
+ * Mirrored function codes: 0x03 and 0x04 responses, and the writes of
+ * 0x06, 0x10 and 0x17 once the slave has acknowledged them (broadcast
+ * writes are applied to every watched unit). Other function codes are
+ * skipped at the next silence.
+ *
+ * One sniffer per line, fed by one thread.
+ */
+
+/** @brief Bytes buffered while a frame is incomplete */
+#define MODBUS_SNIFF_BUFFER_SIZE (2 * MODBUS_RTU_MAX_ADU_SIZE)
+
+/**
+ * @brief Mirror of one unit.
+ */
+typedef struct modbus_sniff_unit_s
+{
+    modbus_bank_st *holding; /**< Holding registers, or NULL */
+    modbus_bank_st *input;   /**< Input registers, or NULL */
+    uint64_t transactions;   /**< Transactions applied to the mirror */
+    uint64_t updated_ns;     /**< Time the last one completed (0 = never) */
+} modbus_sniff_unit_st;
+
+/**
+ * @brief Sniffer counters.
+ */
+typedef struct modbus_sniff_stats_s
+{
+    uint64_t frames;        /**< Frames delimited, watched or not */
+    uint64_t filtered;      /**< Frames skipped on the address byte, without a CRC check */
+    uint64_t transactions;  /**< Request/response pairs applied to a mirror */
+    uint64_t broadcasts;    /**< Broadcast writes applied to every mirror */
+    uint64_t exceptions;    /**< Requests answered with an exception */
+    uint64_t unanswered;    /**< Requests given up: no response before the next request or the timeout */
+    uint64_t mismatches;    /**< Responses that do not match their request (byte count, echo) */
+    uint64_t crc_errors;    /**< Frames of watched units with a bad CRC */
+    uint64_t dropped_bytes; /**< Bytes that could not be framed */
+} modbus_sniff_stats_st;
+
+/**
+ * @brief Sniffer state.
+ */
+typedef struct modbus_sniff_s
+{
+    modbus_sniff_unit_st units[256];             /**< Mirrors by address byte; no banks = not watched */
+    uint32_t watched;                            /**< Units with a mirror */
+    uint64_t t35_ns;                             /**< Silence that ends a frame (0 = frame on structure alone) */
+    uint64_t response_timeout_ns;                /**< Longest wait for a response (0 = until the next request) */
+    uint64_t last_rx_ns;                         /**< Arrival time of the last bytes fed */
+    bool resync;                                 /**< Dropping bytes up to the next silence */
+    bool pending;                                /**< A request is waiting for its response */
+    uint8_t request[MODBUS_RTU_MAX_ADU_SIZE];    /**< That request (address and function code only if not watched) */
+    size_t request_len;                          /**< Length of the request */
+    uint64_t request_ns;                         /**< Time the request was complete */
+    uint8_t buf[MODBUS_SNIFF_BUFFER_SIZE];       /**< Bytes of frames not complete yet */
+    size_t len;                                  /**< Bytes in buf */
+    modbus_sniff_stats_st stats;                 /**< Counters */
+} modbus_sniff_st;
+
+/**
+ * @brief Initialize a sniffer that watches no unit yet.
+ *
+ * @param sniff Sniffer to initialize
+ * @param t35_ns Silence that ends a frame, such as modbus_rtu_st.t35_ns of the
+ *               line (0 = no timing: frames are split on their structure alone)
+ * @param response_timeout_us Longest time a slave takes to answer (0 = wait for the next request)
+ * @return 0 on success, -1 if sniff is NULL
+ */
+int modbus_sniff_init(modbus_sniff_st *sniff, uint64_t t35_ns, uint32_t response_timeout_us);
+
+/**
+ * @brief Mirror a unit.
+ *
+ * @param sniff Sniffer
+ * @param unit_id Unit ID (1..MODBUS_MAX_SLAVES)
+ * @param holding Mirror of its holding registers (NULL = not mirrored)
+ * @param input Mirror of its input registers (NULL = not mirrored)
+ * @return 0 on success, or -1 on invalid arguments (including two NULL banks)
+ *
+ * Banks are initialized by the caller and must outlive the sniffer. Only
+ * the sniffer writes to them; any thread may read them. Watching a unit
+ * again replaces its banks.
+ */
+int modbus_sniff_watch(modbus_sniff_st *sniff, uint8_t unit_id, modbus_bank_st *holding, modbus_bank_st *input);
+
+/**
+ * @brief Feed bytes received from the line.
+ *
+ * @param sniff Sniffer
+ * @param buf Bytes, in line order
+ * @param len Number of bytes
+ * @param now_ns CLOCK_MONOTONIC time they were received, in nanoseconds
+ * @return Number of transactions applied to a mirror, or -1 on invalid arguments
+ *
+ * Feed each read from the line as it returns, with its own time: the
+ * silences between reads are what end frames of unknown length.
+ */
+int modbus_sniff_feed(modbus_sniff_st *sniff, const uint8_t *buf, size_t len, uint64_t now_ns);
+
+/**
+ * @brief Wait for bytes on a line and feed them.
+ *
+ * @param sniff Sniffer
+ * @param fd Serial line opened listen-only, such as modbus_rtu_st.fd (never sent on)
+ * @param timeout_ms Longest wait for the first byte (-1 = forever)
+ * @return Number of transactions applied to a mirror (0 on timeout), or a negative error code:
+ *         -1: Invalid arguments
+ *         -2: Read error or line hung up
+ */
+int modbus_sniff_poll(modbus_sniff_st *sniff, int fd, int timeout_ms);
@@ -0,0 +1,238 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "modbus_defines.h"
+
+/**
+ * @file modbus_stats.h
+ * @brief Per-thread frame counters and latency histograms.
+ *
+ * Each thread records into its own shard: counters by function code, by
+ * unit ID and by decoder error code, plus a latency histogram. A shard is
+ * only ever written by one thread, so recording is a plain increment with
+ * no lock and no atomic read-modify-write, and shards are padded to whole
+ * cache lines so two threads never write the same line.
+ *
+ * Counters are stored with relaxed atomic stores, so another thread may
+ * call modbus_stats_aggregate() at any time and sum the shards: the totals
+ * are exact once the writers are idle, and never torn while they run.
+ *
+ * The histogram is log-linear, as in HdrHistogram: values below
+ * MODBUS_STATS_HIST_SUB_BUCKETS get their own bucket, and every power of
+ * two above that is split into MODBUS_STATS_HIST_SUB_BUCKETS buckets, so
+ * any recorded value is known to within 1/16 (6.25 %) whatever its size.
+ */
+
+/** @brief Number of error codes counted per side: codes -1 .. -(MODBUS_STATS_ERROR_CODES - 1) */
+#define MODBUS_STATS_ERROR_CODES 16
+
+/** @brief Buckets per power of two in a histogram */
+#define MODBUS_STATS_HIST_SUB_BUCKETS 16
+
+/** @brief log2(MODBUS_STATS_HIST_SUB_BUCKETS) */
+#define MODBUS_STATS_HIST_SUB_BITS 4
+
+/** @brief Values of 2^MODBUS_STATS_HIST_MAX_BITS ns (about 18 minutes) or more go to the last bucket */
+#define MODBUS_STATS_HIST_MAX_BITS 40
+
+/** @brief Number of buckets in a histogram */
+#define MODBUS_STATS_HIST_BUCKETS \
+    (MODBUS_STATS_HIST_SUB_BUCKETS * (MODBUS_STATS_HIST_MAX_BITS - MODBUS_STATS_HIST_SUB_BITS + 1))
+
+/**
+ * @brief Which decoder returned an error code.
+ */
+typedef enum modbus_stats_side_e
+{
+    MODBUS_STATS_MASTER = 0, /**< Response decoders (decode_read_response(), decode_tcp_response(), ...) */
+    MODBUS_STATS_SLAVE,      /**< Request decoders (decode_read_request(), decode_tcp_read_request(), ...) */
+    MODBUS_STATS_SIDES
+} modbus_stats_side_et;
+
+/**
+ * @brief Log-linear latency histogram, in nanoseconds.
+ */
+typedef struct modbus_stats_histogram_s
+{
+    uint64_t count;                              /**< Values recorded */
+    uint64_t sum_ns;                             /**< Sum of the values */
+    uint64_t max_ns;                             /**< Largest value */
+    uint64_t buckets[MODBUS_STATS_HIST_BUCKETS]; /**< Values per bucket */
+} modbus_stats_histogram_st;
+
+/**
+ * @brief Counters of one thread.
+ */
+typedef struct modbus_stats_shard_s
+{
+    _Alignas(MODBUS_CACHE_LINE_SIZE) uint64_t frames_by_function[256]; /**< Frames by function code */
+    uint64_t frames_by_unit[256];                                       /**< Frames by unit ID */
+    uint64_t errors_by_unit[256];                                       /**< Decode errors by unit ID */
+    uint64_t errors[MODBUS_STATS_SIDES][MODBUS_STATS_ERROR_CODES];      /**< Decode errors by side and -code */
+    modbus_stats_histogram_st latency;                                  /**< Request latency */
+} modbus_stats_shard_st;
+
+/**
+ * @brief Set of shards, one per recording thread.
+ */
+typedef struct modbus_stats_s
+{
+    modbus_stats_shard_st *shards; /**< Shard array, cache-line aligned */
+    uint32_t count;                /**< Number of shards */
+} modbus_stats_st;
+
+/**
+ * @brief Add to a counter of a shard owned by the calling thread.
+ *
+ * @param counter Counter
+ * @param n Amount to add
+ */
+static inline void modbus_stats_add(uint64_t *counter, uint64_t n)
+{
+    __atomic_store_n(counter, __atomic_load_n(counter, __ATOMIC_RELAXED) + n, __ATOMIC_RELAXED);
+}
+
+/**
+ * @brief Count one frame.
+ *
+ * @param shard Shard of the calling thread (NULL = statistics off)
+ * @param unit_id Unit ID (or slave ID) of the frame
+ * @param function_code Function code of the frame, exception flag included
+ */
+static inline void modbus_stats_frame(modbus_stats_shard_st *shard, uint8_t unit_id, uint8_t function_code)
+{
+    if (shard)
+    {
+        modbus_stats_add(&shard->frames_by_function[function_code], 1);
+        modbus_stats_add(&shard->frames_by_unit[unit_id], 1);
+    }
+}
+
+/**
+ * @brief Count one decoder error.
+ *
+ * @param shard Shard of the calling thread (NULL = statistics off)
+ * @param side Which decoder returned the code
+ * @param unit_id Unit ID of the frame, when known
+ * @param code Negative error code; codes beyond the table are counted as the last one
+ */
+static inline void modbus_stats_error(modbus_stats_shard_st *shard, modbus_stats_side_et side, uint8_t unit_id,
+                                      int code)
+{
+    if (shard && (code < 0))
+    {
+        int index = (-code < MODBUS_STATS_ERROR_CODES) ? -code : MODBUS_STATS_ERROR_CODES - 1;
+        modbus_stats_add(&shard->errors[side][index], 1);
+        modbus_stats_add(&shard->errors_by_unit[unit_id], 1);
+    }
+}
+
+/**
+ * @brief Histogram bucket of a value.
+ *
+ * @param value_ns Value
+ * @return Bucket index (0..MODBUS_STATS_HIST_BUCKETS - 1)
+ */
+static inline uint32_t modbus_stats_bucket(uint64_t value_ns)
+{
+    if (value_ns < MODBUS_STATS_HIST_SUB_BUCKETS)
+    {
+        return (uint32_t)value_ns;
+    }
+    if (value_ns >= (1ull << MODBUS_STATS_HIST_MAX_BITS))
+    {
+        return MODBUS_STATS_HIST_BUCKETS - 1;
+    }
+
+    // The top MODBUS_STATS_HIST_SUB_BITS + 1 bits pick the bucket
+    uint32_t exponent = 63u - (uint32_t)__builtin_clzll(value_ns);
+    uint32_t mantissa = (uint32_t)(value_ns >> (exponent - MODBUS_STATS_HIST_SUB_BITS));
+    return (exponent - MODBUS_STATS_HIST_SUB_BITS + 1) * MODBUS_STATS_HIST_SUB_BUCKETS + mantissa -
+           MODBUS_STATS_HIST_SUB_BUCKETS;
+}
+
+/**
+ * @brief Record one latency.
+ *
+ * @param shard Shard of the calling thread (NULL = statistics off)
+ * @param value_ns Latency in nanoseconds
+ */
+static inline void modbus_stats_latency(modbus_stats_shard_st *shard, uint64_t value_ns)
+{
+    if (shard)
+    {
+        modbus_stats_histogram_st *h = &shard->latency;
+        modbus_stats_add(&h->buckets[modbus_stats_bucket(value_ns)], 1);
+        modbus_stats_add(&h->count, 1);
+        modbus_stats_add(&h->sum_ns, value_ns);
+        if (value_ns > h->max_ns)
+        {
+            __atomic_store_n(&h->max_ns, value_ns, __ATOMIC_RELAXED);
+        }
+    }
+}
+
+/**
+ * @brief Allocate zeroed shards.
+ *
+ * @param stats Set to initialize
+ * @param shards Number of shards, one per recording thread (1..1024)
+ * @return 0 on success, or a negative error code:
+ *         -1: Invalid arguments
+ *         -2: Out of memory
+ */
+int modbus_stats_init(modbus_stats_st *stats, uint32_t shards);
+
+/**
+ * @brief Release the shards.
+ *
+ * @param stats Set
+ */
+void modbus_stats_free(modbus_stats_st *stats);
+
+/**
+ * @brief Shard for one thread.
+ *
+ * @param stats Set
+ * @param index Shard index
+ * @return Shard, or NULL if there is no such shard
+ */
+modbus_stats_shard_st *modbus_stats_shard(modbus_stats_st *stats, uint32_t index);
+
+/**
+ * @brief Sum every shard.
+ *
+ * @param stats Set
+ * @param total Output: sum of the counters, merged histogram
+ *
+ * May run while other threads record; see the file comment.
+ */
+void modbus_stats_aggregate(const modbus_stats_st *stats, modbus_stats_shard_st *total);
+
+/**
+ * @brief Zero every shard.
+ *
+ * @param stats Set
+ *
+ * Only safe while no thread records.
+ */
+void modbus_stats_reset(modbus_stats_st *stats);
+
+/**
+ * @brief Smallest value of the bucket a histogram index stands for.
+ *
+ * @param bucket Bucket index
+ * @return Lowest value, in nanoseconds, that lands in this bucket
+ */
+uint64_t modbus_stats_bucket_floor(uint32_t bucket);
+
+/**
+ * @brief Value below which a fraction of the recorded latencies fall.
+ *
+ * @param h Histogram
+ * @param quantile Fraction, 0.0 .. 1.0 (0.99 for p99)
+ * @return Upper bound of the bucket holding that rank (never above max_ns), or 0 if empty
+ */
+uint64_t modbus_stats_percentile(const modbus_stats_histogram_st *h, double quantile);
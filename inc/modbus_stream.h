@@ -0,0 +1,125 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "modbus_defines.h"
+
+/**
+ * @file modbus_stream.h
+ * @brief Zero-copy frame reassembler for byte streams (TCP sockets, UARTs).
+ *
+ * Bytes are appended in chunks of any size to a fixed-size ring buffer and
+ * complete frames are handed out in place. Frame boundaries come from the
+ * function code and byte count (RTU) or from the MBAP length (TCP).
+ *
+ * The first MODBUS_STREAM_MIRROR_SIZE bytes of the ring are mirrored right
+ * after its end, so a frame that wraps around is still contiguous in memory
+ * and never needs to be copied out.
+ */
+
+/** @brief Extra storage needed after the ring to keep wrapped frames contiguous */
+#define MODBUS_STREAM_MIRROR_SIZE MODBUS_TCP_MAX_ADU_SIZE
+
+/** @brief Storage size needed for a ring of @p capacity bytes */
+#define MODBUS_STREAM_STORAGE_SIZE(capacity) ((capacity) + MODBUS_STREAM_MIRROR_SIZE)
+
+/**
+ * @brief Framing rule used to split the stream.
+ */
+typedef enum modbus_stream_mode_e
+{
+    MODBUS_STREAM_RTU_REQUEST = 0, /**< RTU frames sent by a master */
+    MODBUS_STREAM_RTU_RESPONSE,    /**< RTU frames sent by a slave */
+    MODBUS_STREAM_TCP              /**< MBAP ADUs, either direction */
+} modbus_stream_mode_et;
+
+/**
+ * @brief Stream reassembler state.
+ */
+typedef struct modbus_stream_s
+{
+    uint8_t *data;              /**< Ring storage followed by the mirror area */
+    size_t capacity;            /**< Ring size in bytes */
+    size_t read_pos;            /**< Ring index of the first unconsumed byte */
+    size_t count;               /**< Unconsumed bytes in the ring */
+    modbus_stream_mode_et mode; /**< Framing rule */
+    uint32_t dropped_bytes;     /**< Bytes skipped while resynchronizing on garbage */
+} modbus_stream_st;
+
+/**
+ * @brief Initialize a stream reassembler on caller-provided storage.
+ *
+ * @param s Stream to initialize
+ * @param mode Framing rule
+ * @param storage Storage of MODBUS_STREAM_STORAGE_SIZE(capacity) bytes
+ * @param storage_size Size of @p storage in bytes
+ * @return 0 on success, -1 on invalid arguments or storage too small
+ *         (the ring must hold at least one maximum-size frame)
+ */
+int modbus_stream_init(modbus_stream_st *s, modbus_stream_mode_et mode, uint8_t *storage, size_t storage_size);
+
+/**
+ * @brief Drop all buffered bytes.
+ *
+ * @param s Stream
+ */
+void modbus_stream_reset(modbus_stream_st *s);
+
+/**
+ * @brief Get the contiguous free region to receive into directly.
+ *
+ * @param s Stream
+ * @param avail Output: number of bytes that can be written at the returned pointer
+ * @return Write pointer, or NULL if the ring is full
+ *
+ * Typical use is read(fd, ptr, avail) followed by modbus_stream_commit().
+ * The region may be shorter than the total free space when it reaches the
+ * end of the ring; call again after committing to get the rest.
+ */
+uint8_t *modbus_stream_write_ptr(modbus_stream_st *s, size_t *avail);
+
+/**
+ * @brief Publish bytes written through modbus_stream_write_ptr().
+ *
+ * @param s Stream
+ * @param len Number of bytes written
+ * @return 0 on success, -1 if @p len exceeds the region returned by write_ptr
+ */
+int modbus_stream_commit(modbus_stream_st *s, size_t len);
+
+/**
+ * @brief Copy a chunk of bytes into the stream.
+ *
+ * @param s Stream
+ * @param buf Bytes to append
+ * @param len Number of bytes
+ * @return Number of bytes accepted (less than @p len when the ring is full)
+ */
+size_t modbus_stream_feed(modbus_stream_st *s, const uint8_t *buf, size_t len);
+
+/**
+ * @brief Extract the next complete frame, in place.
+ *
+ * @param s Stream
+ * @param frame Output: pointer to the first byte of the frame inside the ring
+ * @return Frame length in bytes, 0 if no complete frame is buffered yet,
+ *         or -1 on invalid arguments
+ *
+ * The frame is consumed. Its bytes stay valid until the next write into
+ * the stream (write_ptr/commit or feed). Bytes that cannot start a frame
+ * (unknown function code, invalid byte count or MBAP header) are skipped
+ * one at a time and counted in dropped_bytes.
+ */
+int modbus_stream_next_frame(modbus_stream_st *s, const uint8_t **frame);
+
+/**
+ * @brief Compute the length of the frame starting at @p buf.
+ *
+ * @param mode Framing rule
+ * @param buf First bytes of the frame
+ * @param avail Number of bytes available at @p buf
+ * @return Frame length, 0 if more bytes are needed to tell,
+ *         or -1 if these bytes cannot start a frame
+ */
+int modbus_frame_length(modbus_stream_mode_et mode, const uint8_t *buf, size_t avail);
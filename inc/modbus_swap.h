@@ -0,0 +1,102 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "modbus_crc.h"
+
+/**
+ * @file modbus_swap.h
+ * @brief Register block conversion between host order and Modbus wire order
+ *        (big-endian), optionally fused with the CRC16 pass.
+ *
+ * All engines produce bit-identical output; they only differ in speed.
+ */
+
+/**
+ * @brief Available register conversion implementations.
+ */
+typedef enum modbus_swap_engine_e
+{
+    MODBUS_SWAP_ENGINE_AUTO = 0, /**< Pick the widest supported vector engine */
+    MODBUS_SWAP_ENGINE_SCALAR,   /**< Portable one-register-at-a-time conversion */
+    MODBUS_SWAP_ENGINE_SSSE3,    /**< 8 registers per PSHUFB (x86-64) */
+    MODBUS_SWAP_ENGINE_AVX2,     /**< 16 registers per VPSHUFB (x86-64) */
+    MODBUS_SWAP_ENGINE_NEON,     /**< 8 registers per VREV16 (ARM) */
+    MODBUS_SWAP_ENGINE_COUNT
+} modbus_swap_engine_et;
+
+/**
+ * @brief Select the conversion engine.
+ *
+ * @param engine Engine to use
+ * @return 0 on success, -1 if the engine is unknown or not supported by this CPU
+ */
+int modbus_swap_set_engine(modbus_swap_engine_et engine);
+
+/**
+ * @brief Get the currently selected conversion engine.
+ *
+ * @return Selected engine (MODBUS_SWAP_ENGINE_AUTO by default)
+ */
+modbus_swap_engine_et modbus_swap_get_engine(void);
+
+/**
+ * @brief Check whether an engine can run on this build and CPU.
+ *
+ * @param engine Engine to check
+ * @return true if the engine can be selected
+ */
+bool modbus_swap_engine_supported(modbus_swap_engine_et engine);
+
+/**
+ * @brief Get a short printable name for an engine.
+ *
+ * @param engine Engine
+ * @return Static string, "unknown" for invalid values
+ */
+const char *modbus_swap_engine_name(modbus_swap_engine_et engine);
+
+/**
+ * @brief Convert host-order registers to wire order.
+ *
+ * @param dst Output buffer of at least qty * 2 bytes (no alignment required)
+ * @param regs Registers in host byte order
+ * @param qty Number of registers
+ */
+void modbus_regs_to_be(uint8_t *dst, const uint16_t *regs, size_t qty);
+
+/**
+ * @brief Convert wire-order registers to host order.
+ *
+ * @param regs Output array of at least qty entries
+ * @param src Input buffer of qty * 2 bytes (no alignment required)
+ * @param qty Number of registers
+ */
+void modbus_regs_from_be(uint16_t *regs, const uint8_t *src, size_t qty);
+
+/**
+ * @brief Convert host-order registers to wire order and feed the wire bytes
+ *        into a CRC16 context in the same sweep.
+ *
+ * @param dst Output buffer of at least qty * 2 bytes
+ * @param regs Registers in host byte order
+ * @param qty Number of registers
+ * @param crc CRC context updated with the written bytes
+ *
+ * The block is processed in L1-sized chunks: each chunk is converted and
+ * checksummed while it is still hot, so every byte is fetched from memory once.
+ */
+void modbus_regs_to_be_crc(uint8_t *dst, const uint16_t *regs, size_t qty, modbus_crc16_ctx_st *crc);
+
+/**
+ * @brief Convert wire-order registers to host order and feed the wire bytes
+ *        into a CRC16 context in the same sweep.
+ *
+ * @param regs Output array of at least qty entries
+ * @param src Input buffer of qty * 2 bytes
+ * @param qty Number of registers
+ * @param crc CRC context updated with the read bytes
+ */
+void modbus_regs_from_be_crc(uint16_t *regs, const uint8_t *src, size_t qty, modbus_crc16_ctx_st *crc);
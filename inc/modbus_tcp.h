@@ -0,0 +1,220 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+
+#include "modbus_defines.h"
+#include "modbus_pdu.h"
+#include "modbus_slave.h"
+
+/**
+ * @file modbus_tcp.h
+ * @brief Modbus TCP (MBAP) framing and a pipelining master.
+ *
+ * A Modbus TCP ADU is the 7-byte MBAP header followed by the PDU. There is
+ * no CRC: TCP guarantees integrity, and responses are matched to requests
+ * by transaction ID, so several requests can be in flight on one connection.
+ */
+
+/**
+ * @brief One outstanding Modbus TCP request.
+ */
+typedef struct modbus_tcp_transaction_s
+{
+    bool in_use;             /**< Slot holds an unanswered request */
+    uint16_t transaction_id; /**< Transaction ID sent in the request */
+    uint8_t unit_id;         /**< Unit expected to answer */
+    uint8_t request[MODBUS_PDU_REQUEST_HEADER_SIZE]; /**< Leading PDU bytes the answer must match */
+} modbus_tcp_transaction_st;
+
+/**
+ * @brief Modbus TCP master state for one connection.
+ */
+typedef struct modbus_tcp_master_ctx_s
+{
+    uint16_t next_transaction_id;                                /**< Transaction ID for the next request */
+    uint8_t max_outstanding;                                     /**< Pipeline depth limit */
+    uint8_t outstanding;                                         /**< Requests currently in flight */
+    modbus_tcp_transaction_st pending[MODBUS_TCP_MAX_PIPELINE]; /**< In-flight requests */
+} modbus_tcp_master_ctx_st;
+
+/**
+ * @brief Encode an MBAP header.
+ *
+ * @param transaction_id Transaction identifier
+ * @param unit_id Unit identifier
+ * @param pdu_len Length of the PDU that follows the header
+ * @param buffer Output buffer
+ * @param bufsize Size of the output buffer
+ * @return MODBUS_MBAP_HEADER_SIZE on success, or 0 on failure
+ */
+uint16_t encode_mbap_header(uint16_t transaction_id, uint8_t unit_id, uint16_t pdu_len,
+                            uint8_t *buffer, size_t bufsize);
+
+/**
+ * @brief Decode and validate an MBAP header.
+ *
+ * @param buffer Buffer starting with an MBAP header
+ * @param bufsize Number of valid bytes in the buffer
+ * @param transaction_id Output transaction identifier (may be NULL)
+ * @param unit_id Output unit identifier (may be NULL)
+ * @param pdu_len Output PDU length (may be NULL)
+ * @return Total ADU length (header + PDU) on success, or a negative error code:
+ *         -1: Invalid input pointer
+ *         -2: Buffer shorter than the MBAP header
+ *         -3: Protocol identifier is not Modbus
+ *         -4: Length field out of range
+ *
+ * The ADU length lets a caller split a TCP byte stream into frames; the PDU
+ * itself does not need to be complete in the buffer.
+ */
+int decode_mbap_header(const uint8_t *buffer, size_t bufsize,
+                       uint16_t *transaction_id, uint8_t *unit_id, uint16_t *pdu_len);
+
+/**
+ * @brief Initialize a Modbus TCP master context.
+ *
+ * @param ctx Context to initialize
+ * @param max_outstanding Maximum number of requests in flight (1..MODBUS_TCP_MAX_PIPELINE)
+ * @return 0 on success, -1 on invalid arguments
+ */
+int modbus_tcp_master_ctx_init(modbus_tcp_master_ctx_st *ctx, uint8_t max_outstanding);
+
+/**
+ * @brief Number of requests sent and not yet answered or cancelled.
+ *
+ * @param ctx Master context
+ * @return Outstanding request count
+ */
+uint8_t modbus_tcp_master_outstanding(const modbus_tcp_master_ctx_st *ctx);
+
+/**
+ * @brief Forget an outstanding request, e.g. after a timeout.
+ *
+ * @param ctx Master context
+ * @param transaction_id Transaction to cancel
+ * @return 0 on success, -1 if no such transaction is outstanding
+ */
+int modbus_tcp_master_cancel(modbus_tcp_master_ctx_st *ctx, uint16_t transaction_id);
+
+/**
+ * @brief Encode a Modbus TCP Read Holding Registers request.
+ *
+ * @param ctx Master context, records the outstanding transaction
+ * @param unit_id Unit identifier
+ * @param addr Starting register address
+ * @param qty Number of registers to read
+ * @param buffer Output buffer to store the encoded request
+ * @param bufsize Size of the output buffer
+ * @param transaction_id Output transaction ID assigned to the request (may be NULL)
+ * @return Length of the encoded request in bytes, or 0 on failure
+ *         (invalid parameters or pipeline full)
+ */
+uint16_t encode_tcp_read_request(modbus_tcp_master_ctx_st *ctx, uint8_t unit_id, uint16_t addr, uint16_t qty,
+                                 uint8_t *buffer, size_t bufsize, uint16_t *transaction_id);
+
+/**
+ * @brief Decode a Modbus TCP Read Holding Registers response.
+ *
+ * @param ctx Master context holding the outstanding requests
+ * @param buffer Buffer containing the response ADU
+ * @param bufsize Size of the buffer
+ * @param regs Output array to store decoded register values
+ * @param regs_len Length of the output array
+ * @param transaction_id Output transaction ID of the response (may be NULL)
+ * @return Number of registers decoded on success, or a negative error code:
+ *         -1: Invalid input pointers
+ *         -2: No outstanding request with this transaction ID and unit ID
+ *         -3: Function code mismatch
+ *         -4: Byte count does not match the request
+ *         -5: Buffer too small
+ *         -6: Output array too small
+ *         -7: Invalid MBAP header
+ *
+ * Once a complete response is matched to its request the transaction is
+ * released, whether or not the rest of the response is valid. A partial
+ * ADU returns -5 and keeps the transaction, so the call can be retried
+ * once the rest has arrived.
+ */
+int decode_tcp_read_response(modbus_tcp_master_ctx_st *ctx, const uint8_t *buffer, size_t bufsize,
+                             uint16_t *regs, uint8_t regs_len, uint16_t *transaction_id);
+
+/**
+ * @brief Encode a Modbus TCP request around any PDU built with the modbus_pdu_encode_*() functions.
+ *
+ * @param ctx Master context, records the outstanding transaction
+ * @param unit_id Unit identifier
+ * @param pdu Request PDU
+ * @param pdu_len Length of the request PDU
+ * @param buffer Output buffer to store the encoded request
+ * @param bufsize Size of the output buffer
+ * @param transaction_id Output transaction ID assigned to the request (may be NULL)
+ * @return Length of the encoded request in bytes, or 0 on failure
+ *         (invalid parameters or pipeline full)
+ */
+uint16_t encode_tcp_request(modbus_tcp_master_ctx_st *ctx, uint8_t unit_id, const uint8_t *pdu, size_t pdu_len,
+                            uint8_t *buffer, size_t bufsize, uint16_t *transaction_id);
+
+/**
+ * @brief Decode the Modbus TCP response to any request encoded on this context.
+ *
+ * @param ctx Master context holding the outstanding requests
+ * @param buffer Buffer containing the response ADU
+ * @param bufsize Size of the buffer
+ * @param regs Output register values for reads (may be NULL for writes)
+ * @param regs_len Length of the output array
+ * @param transaction_id Output transaction ID of the response (may be NULL)
+ * @return Number of registers read (0 for writes), or a negative error code:
+ *         -1: Invalid input pointers
+ *         -2: No outstanding request with this transaction ID and unit ID
+ *         -3: Function code mismatch
+ *         -4: Byte count or echoed address, value or quantity does not match the request
+ *         -5: Buffer too small
+ *         -6: Output array too small
+ *         -7: Invalid MBAP header
+ *         -8: Exception response; the exception code follows the function code
+ *
+ * Like decode_tcp_read_response(), the transaction is released once a
+ * complete response is matched; a partial ADU returns -5 and keeps it.
+ */
+int decode_tcp_response(modbus_tcp_master_ctx_st *ctx, const uint8_t *buffer, size_t bufsize, uint16_t *regs,
+                        uint16_t regs_len, uint16_t *transaction_id);
+
+/**
+ * @brief Decode a Modbus TCP Read Holding Registers request.
+ *
+ * @param ctx Slave context holding the device slave ID
+ * @param buffer Pointer to the incoming request ADU
+ * @param bufsize Size of the incoming buffer
+ * @param transaction_id Output transaction ID to echo in the response
+ * @param unit_id Output unit identifier to echo in the response
+ * @param start_addr Output starting register address
+ * @param qty Output quantity of registers
+ * @return 0 on success, or a negative error code:
+ *         -1: Invalid input pointers
+ *         -2: Buffer too small or invalid MBAP header
+ *         -3: Invalid quantity or address range
+ *         -4: Unit ID not addressed to this device
+ *         -5: Function code not supported
+ *
+ * The unit ID is accepted when it matches the device slave ID, is the
+ * broadcast ID, or is MODBUS_TCP_UNIT_ID_IGNORED.
+ */
+int decode_tcp_read_request(const modbus_slave_ctx_st *ctx, const uint8_t *buffer, size_t bufsize,
+                            uint16_t *transaction_id, uint8_t *unit_id, uint16_t *start_addr, uint16_t *qty);
+
+/**
+ * @brief Encode a Modbus TCP Read Holding Registers response.
+ *
+ * @param ctx Slave context
+ * @param transaction_id Transaction ID copied from the request
+ * @param unit_id Unit ID copied from the request
+ * @param regs Array of register values to include in response
+ * @param qty Number of registers to include (must be <= MODBUS_MAX_REGS)
+ * @param buffer Output buffer to store the encoded response
+ * @param bufsize Size of the output buffer
+ * @return Length of the encoded response in bytes, or 0 on failure
+ */
+uint16_t encode_tcp_read_response(const modbus_slave_ctx_st *ctx, uint16_t transaction_id, uint8_t unit_id,
+                                  const uint16_t *regs, uint16_t qty, uint8_t *buffer, size_t bufsize);
@@ -0,0 +1,240 @@
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+#include <sys/socket.h>
+#include <time.h>
+
+#include "modbus_defines.h"
+#include "modbus_stats.h"
+
+/**
+ * @file modbus_trace.h
+ * @brief Per-transaction latency tracing into per-thread rings.
+ *
+ * A trace record follows one transaction through the master: when the
+ * request was encoded, when the send call returned, when the kernel
+ * received the response (a software receive timestamp, SO_TIMESTAMPNS),
+ * when the read call returned it, and when the response was decoded.
+ * The differences tell where a slow poll spent its time: on the wire and
+ * in the slave, in the socket queue, or in our own code.
+ *
+ * Kernel receive timestamps are taken on CLOCK_REALTIME, so every stage
+ * is stamped on that clock too. A stage that was not taken is 0.
+ *
+ * Each thread appends to its own ring, which overwrites its oldest
+ * records when full. Every slot carries a sequence number that is odd
+ * while the slot is written, so another thread may copy records out with
+ * modbus_trace_read() or modbus_trace_collect() at any time: a record
+ * being overwritten is skipped, never returned torn, and the writer never
+ * waits for the reader.
+ */
+
+/** @brief Largest number of records in one ring */
+#define MODBUS_TRACE_MAX_CAPACITY (1u << 24)
+
+/** @brief Control buffer size for a receive timestamp (either SCM_TIMESTAMPNS or SCM_TIMESTAMPING) */
+#define MODBUS_TRACE_CMSG_SIZE CMSG_SPACE(3 * sizeof(struct timespec))
+
+/**
+ * @brief Points in the life of a transaction.
+ */
+typedef enum modbus_trace_stage_e
+{
+    MODBUS_TRACE_ENCODED = 0, /**< Request encoded */
+    MODBUS_TRACE_SENT,        /**< Send call returned */
+    MODBUS_TRACE_RECEIVED,    /**< Kernel software receive timestamp of the response */
+    MODBUS_TRACE_READ,        /**< Read call returned the response */
+    MODBUS_TRACE_DECODED,     /**< Response decoded */
+    MODBUS_TRACE_STAGES
+} modbus_trace_stage_et;
+
+/**
+ * @brief Intervals between two stages, as reported by modbus_trace_collect().
+ */
+typedef enum modbus_trace_span_e
+{
+    MODBUS_TRACE_SPAN_SUBMIT = 0, /**< Encoded to sent: batching and the send call */
+    MODBUS_TRACE_SPAN_WIRE,       /**< Sent to received: network, slave, and the kernel receive path */
+    MODBUS_TRACE_SPAN_QUEUE,      /**< Received to read: socket queue and wakeup */
+    MODBUS_TRACE_SPAN_DECODE,     /**< Read to decoded */
+    MODBUS_TRACE_SPAN_TOTAL,      /**< Encoded to decoded */
+    MODBUS_TRACE_SPANS
+} modbus_trace_span_et;
+
+/**
+ * @brief One traced transaction.
+ */
+typedef struct modbus_trace_record_s
+{
+    uint64_t ns[MODBUS_TRACE_STAGES]; /**< CLOCK_REALTIME of each stage, in ns (0 = not taken) */
+    uint16_t transaction_id;          /**< Transaction ID of the request */
+    uint8_t unit_id;                  /**< Unit ID of the request */
+    uint8_t function_code;            /**< Function code of the request */
+    int32_t status;                   /**< Decoder result (register count, 0, or a negative error code) */
+} modbus_trace_record_st;
+
+/** @brief Size of a record in 64-bit words */
+#define MODBUS_TRACE_RECORD_WORDS (sizeof(modbus_trace_record_st) / sizeof(uint64_t))
+
+_Static_assert(sizeof(modbus_trace_record_st) % sizeof(uint64_t) == 0, "records are copied word by word");
+
+/**
+ * @brief One ring slot.
+ */
+typedef struct modbus_trace_slot_s
+{
+    uint64_t seq;                              /**< 2 * (record number + 1) when complete, odd while written */
+    uint64_t words[MODBUS_TRACE_RECORD_WORDS]; /**< The record */
+} modbus_trace_slot_st;
+
+/**
+ * @brief Ring of one thread.
+ */
+typedef struct modbus_trace_ring_s
+{
+    _Alignas(MODBUS_CACHE_LINE_SIZE) uint64_t head; /**< Records written so far */
+    uint32_t mask;                                  /**< Capacity - 1 */
+    modbus_trace_slot_st *slots;                    /**< Capacity slots */
+} modbus_trace_ring_st;
+
+/**
+ * @brief Set of rings, one per tracing thread.
+ */
+typedef struct modbus_trace_s
+{
+    modbus_trace_ring_st *rings; /**< Ring array, cache-line aligned */
+    uint32_t count;              /**< Number of rings */
+} modbus_trace_st;
+
+/**
+ * @brief Stage-by-stage latency breakdown.
+ */
+typedef struct modbus_trace_breakdown_s
+{
+    modbus_stats_histogram_st spans[MODBUS_TRACE_SPANS]; /**< One histogram per span */
+    uint64_t records;                                    /**< Records folded in */
+    uint64_t lost;                                       /**< Records overwritten before they were collected */
+} modbus_trace_breakdown_st;
+
+/**
+ * @brief Append a record to a ring owned by the calling thread.
+ *
+ * @param ring Ring of the calling thread (NULL = tracing off)
+ * @param record Record to append
+ */
+static inline void modbus_trace_record(modbus_trace_ring_st *ring, const modbus_trace_record_st *record)
+{
+    if (!ring)
+    {
+        return;
+    }
+
+    uint64_t n = ring->head;
+    modbus_trace_slot_st *slot = &ring->slots[n & ring->mask];
+    uint64_t words[MODBUS_TRACE_RECORD_WORDS];
+    __builtin_memcpy(words, record, sizeof(words));
+
+    // Odd sequence first, so a reader that sees the old even value after copying knows it raced
+    __atomic_store_n(&slot->seq, 2 * n + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    for (size_t i = 0; i < MODBUS_TRACE_RECORD_WORDS; i++)
+    {
+        __atomic_store_n(&slot->words[i], words[i], __ATOMIC_RELAXED);
+    }
+    __atomic_store_n(&slot->seq, 2 * n + 2, __ATOMIC_RELEASE);
+    __atomic_store_n(&ring->head, n + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Allocate empty rings.
+ *
+ * @param trace Set to initialize
+ * @param rings Number of rings, one per tracing thread (1..1024)
+ * @param capacity Records per ring, a power of two (2..MODBUS_TRACE_MAX_CAPACITY)
+ * @return 0 on success, or a negative error code:
+ *         -1: Invalid arguments
+ *         -2: Out of memory
+ */
+int modbus_trace_init(modbus_trace_st *trace, uint32_t rings, uint32_t capacity);
+
+/**
+ * @brief Release the rings.
+ *
+ * @param trace Set
+ */
+void modbus_trace_free(modbus_trace_st *trace);
+
+/**
+ * @brief Ring for one thread.
+ *
+ * @param trace Set
+ * @param index Ring index
+ * @return Ring, or NULL if there is no such ring
+ */
+modbus_trace_ring_st *modbus_trace_ring(modbus_trace_st *trace, uint32_t index);
+
+/**
+ * @brief Current time on the clock of the kernel receive timestamps.
+ *
+ * @return CLOCK_REALTIME in nanoseconds
+ */
+uint64_t modbus_trace_now_ns(void);
+
+/**
+ * @brief Ask the kernel to timestamp every packet a socket receives.
+ *
+ * @param fd Socket
+ * @return 0 on success, or -1 if the socket refused SO_TIMESTAMPNS
+ *
+ * The timestamp is taken in software when the packet reaches the socket
+ * layer; read it back with recvmsg() and modbus_trace_rx_timestamp().
+ * Packets already queued when this is called have none.
+ */
+int modbus_trace_enable_rx_timestamps(int fd);
+
+/**
+ * @brief Receive timestamp of a message returned by recvmsg() or recvmmsg().
+ *
+ * @param msg Message header, with a control buffer of at least MODBUS_TRACE_CMSG_SIZE
+ * @return CLOCK_REALTIME in nanoseconds, or 0 if the message carries no timestamp
+ *
+ * On a stream socket this is the timestamp of the data the call returned.
+ */
+uint64_t modbus_trace_rx_timestamp(const struct msghdr *msg);
+
+/**
+ * @brief Copy out the records of a ring written since a cursor.
+ *
+ * @param ring Ring, possibly still being written by its owner
+ * @param cursor In: number of the first record wanted (0 at start); out: number of the next one
+ * @param out Output records, oldest first
+ * @param max Capacity of out
+ * @return Number of records copied
+ *
+ * Records overwritten before they could be copied are skipped: the cursor
+ * moves past them, so the caller sees them as the cursor advancing by
+ * more than the return value.
+ */
+uint32_t modbus_trace_read(const modbus_trace_ring_st *ring, uint64_t *cursor, modbus_trace_record_st *out,
+                           uint32_t max);
+
+/**
+ * @brief Add the spans of one record to a breakdown.
+ *
+ * @param breakdown Breakdown
+ * @param record Record; a span with either end not taken is left out
+ */
+void modbus_trace_breakdown_add(modbus_trace_breakdown_st *breakdown, const modbus_trace_record_st *record);
+
+/**
+ * @brief Fold everything written to the rings since the last call into a breakdown.
+ *
+ * @param trace Set, possibly still being written
+ * @param cursors One cursor per ring, zeroed before the first call
+ * @param breakdown Breakdown to add to (zero it to start afresh)
+ * @return Number of records folded in, or -1 on invalid arguments
+ *
+ * Safe to call from a monitoring thread while traffic runs.
+ */
+int64_t modbus_trace_collect(const modbus_trace_st *trace, uint64_t *cursors, modbus_trace_breakdown_st *breakdown);
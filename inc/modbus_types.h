@@ -19,4 +19,14 @@ typedef struct read_holding_registers_header_response_s
     uint8_t function_code; /**< Function code in response */
     uint8_t byte_count;    /**< Number of bytes in the payload */
 } read_holding_registers_header_response_st;
-#pragma pack(pop)
\ No newline at end of file
+#pragma pack(pop)
+
+#pragma pack(push, 1)
+typedef struct mbap_header_s
+{
+    uint16_t transaction_id; /**< Transaction identifier (big-endian) */
+    uint16_t protocol_id;    /**< Protocol identifier, always 0 (big-endian) */
+    uint16_t length;         /**< Number of following bytes, unit ID included (big-endian) */
+    uint8_t unit_id;         /**< Unit identifier */
+} mbap_header_st;
+#pragma pack(pop)
@@ -0,0 +1,230 @@
+#pragma once
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdatomic.h>
+#include <netinet/in.h>
+
+#include "modbus_defines.h"
+#include "modbus_batch.h"
+#include "modbus_server.h"
+#include "modbus_tcp.h"
+
+/**
+ * @file modbus_udp.h
+ * @brief Modbus over UDP: a slave server and a master for many devices.
+ *
+ * Modbus UDP carries exactly one MBAP-framed ADU per datagram, the same
+ * frame as Modbus TCP but without a byte stream to reassemble. Both sides
+ * move datagrams in bursts: recvmmsg() fills up to MODBUS_UDP_BURST
+ * receive slots per call, every datagram is decoded in place in its slot
+ * with the modbus_tcp and modbus_pdu frame functions, and the answers (or
+ * requests) go out with one sendmmsg() per MODBUS_UDP_BURST datagrams.
+ *
+ * The master registers each device by address, with its own master
+ * context. Responses are matched first to the device they came from (a
+ * hash of the source address), then to the request by transaction ID, so
+ * a lost or late datagram never completes another device's request.
+ * Requests are encoded with modbus_batch on the context returned by
+ * modbus_udp_master_ctx(), and the registers land where the batch said.
+ *
+ * A batch traced with modbus_batch_trace() gets the full stage breakdown:
+ * the first traced send turns on kernel receive timestamps for the master
+ * socket, and each response is stamped with its datagram's timestamp.
+ *
+ * UDP neither retransmits nor orders: a request without an answer stays
+ * unanswered in its batch, and the caller cancels its transaction with
+ * modbus_tcp_master_cancel() when it gives up.
+ */
+
+/** @brief Datagrams per recvmmsg() or sendmmsg() call */
+#define MODBUS_UDP_BURST 64
+
+/**
+ * @brief Burst buffers, allocated once at init.
+ */
+typedef struct modbus_udp_ring_s modbus_udp_ring_st;
+
+/**
+ * @brief UDP counters.
+ */
+typedef struct modbus_udp_stats_s
+{
+    uint64_t rx_datagrams; /**< Datagrams received */
+    uint64_t tx_datagrams; /**< Datagrams sent */
+    uint64_t rx_calls;     /**< recvmmsg() calls that returned datagrams */
+    uint64_t tx_calls;     /**< sendmmsg() calls that sent datagrams */
+    uint64_t requests;     /**< Server: requests answered; master: responses matched */
+    uint64_t exceptions;   /**< Server: requests answered with an exception response */
+    uint64_t errors;       /**< Datagrams dropped: truncated, not one valid ADU, or not for this unit */
+    uint64_t unknown;      /**< Master: datagrams from no registered device, or matching no request */
+} modbus_udp_stats_st;
+
+/**
+ * @brief Modbus UDP slave server.
+ */
+typedef struct modbus_udp_server_s
+{
+    int fd;                         /**< Bound datagram socket */
+    int wake_fd;                    /**< eventfd used by modbus_udp_server_stop() */
+    atomic_bool stop;               /**< Set to leave modbus_udp_server_run() */
+    const modbus_host_st *host;     /**< Units served: the configured host, or single */
+    modbus_host_st single;          /**< The one unit of slave_id, when no host is configured */
+    modbus_udp_ring_st *ring;       /**< Burst buffers */
+    modbus_udp_stats_st stats;      /**< Counters */
+    modbus_stats_shard_st *stats_shard; /**< Detailed counters, or NULL */
+} modbus_udp_server_st;
+
+/**
+ * @brief One device polled by a UDP master.
+ */
+typedef struct modbus_udp_device_s
+{
+    struct sockaddr_in addr;       /**< Where the device listens */
+    modbus_tcp_master_ctx_st ctx;  /**< Outstanding requests of this device */
+} modbus_udp_device_st;
+
+/**
+ * @brief Modbus UDP master.
+ */
+typedef struct modbus_udp_master_s
+{
+    int fd;                        /**< Datagram socket, unconnected */
+    modbus_udp_device_st *devices; /**< Registered devices */
+    uint32_t device_count;         /**< Devices registered */
+    uint32_t device_capacity;      /**< Size of devices */
+    uint32_t *table;               /**< Address hash: device index + 1, 0 = empty */
+    uint32_t table_mask;           /**< Table size - 1 (a power of two, at least twice device_capacity) */
+    modbus_udp_ring_st *ring;      /**< Burst buffers */
+    modbus_udp_stats_st stats;     /**< Counters */
+    bool rx_timestamps;            /**< Kernel receive timestamps are on (see modbus_trace.h) */
+} modbus_udp_master_st;
+
+/**
+ * @brief Bind the server socket and allocate its burst buffers.
+ *
+ * @param srv Server to initialize
+ * @param cfg Same configuration as the TCP server; port is the UDP port,
+ *            backlog, max_connections and reuse_port are ignored
+ * @return 0 on success, or a negative error code:
+ *         -1: Invalid arguments (including a stats_shard that stats does not have)
+ *         -2: Out of memory
+ *         -3: Socket or bind failed
+ *         -4: eventfd setup failed
+ *
+ * Read Holding Registers is answered from the unit's wire-order source when
+ * it has one, straight into the transmit slot; every other request goes
+ * through the dispatcher. Units are picked as by the TCP server.
+ */
+int modbus_udp_server_init(modbus_udp_server_st *srv, const modbus_server_config_st *cfg);
+
+/**
+ * @brief Close the sockets and release the burst buffers.
+ *
+ * @param srv Server
+ */
+void modbus_udp_server_deinit(modbus_udp_server_st *srv);
+
+/**
+ * @brief Port the server is bound to.
+ *
+ * @param srv Server
+ * @return Port in host order, or 0 on error
+ */
+uint16_t modbus_udp_server_port(const modbus_udp_server_st *srv);
+
+/**
+ * @brief Wait for requests, then answer every queued datagram.
+ *
+ * @param srv Server
+ * @param timeout_ms Longest wait for the first datagram (-1 = forever)
+ * @return Number of requests answered, or -1 on error
+ *
+ * Bursts are received and answered until the socket is empty, so one call
+ * drains whatever arrived while the previous burst was being answered.
+ */
+int modbus_udp_server_poll(modbus_udp_server_st *srv, int timeout_ms);
+
+/**
+ * @brief Serve requests until modbus_udp_server_stop() is called.
+ *
+ * @param srv Server
+ * @return 0 when stopped, or -1 on error
+ */
+int modbus_udp_server_run(modbus_udp_server_st *srv);
+
+/**
+ * @brief Ask modbus_udp_server_run() to return.
+ *
+ * @param srv Server
+ *
+ * Safe to call from another thread or from a signal handler.
+ */
+void modbus_udp_server_stop(modbus_udp_server_st *srv);
+
+/**
+ * @brief Open the master socket and allocate room for the devices.
+ *
+ * @param m Master to initialize
+ * @param max_devices Largest number of devices (1..UINT16_MAX)
+ * @return 0 on success, or a negative error code:
+ *         -1: Invalid arguments
+ *         -2: Out of memory
+ *         -3: Socket failed
+ */
+int modbus_udp_master_init(modbus_udp_master_st *m, uint32_t max_devices);
+
+/**
+ * @brief Close the socket and release the devices and burst buffers.
+ *
+ * @param m Master
+ */
+void modbus_udp_master_deinit(modbus_udp_master_st *m);
+
+/**
+ * @brief Register a device.
+ *
+ * @param m Master
+ * @param ip IPv4 address of the device, dotted
+ * @param port UDP port of the device
+ * @param max_outstanding Pipeline depth for this device (1..MODBUS_TCP_MAX_PIPELINE)
+ * @return Device index, or a negative error code:
+ *         -1: Invalid arguments
+ *         -2: No room for another device
+ *         -3: A device with this address is already registered
+ */
+int modbus_udp_master_add_device(modbus_udp_master_st *m, const char *ip, uint16_t port, uint8_t max_outstanding);
+
+/**
+ * @brief Master context of a device, to encode its requests on.
+ *
+ * @param m Master
+ * @param device Device index
+ * @return Context, or NULL if there is no such device
+ */
+modbus_tcp_master_ctx_st *modbus_udp_master_ctx(modbus_udp_master_st *m, uint32_t device);
+
+/**
+ * @brief Send every frame of a batch to the device it was encoded for.
+ *
+ * @param m Master
+ * @param batch Frames encoded on contexts of this master
+ * @return Number of datagrams sent, or a negative error code:
+ *         -1: Invalid arguments, or sendmmsg() failed
+ *         -2: A frame was encoded on a context that is not one of this master's devices
+ */
+int modbus_udp_master_send(modbus_udp_master_st *m, modbus_batch_st *batch);
+
+/**
+ * @brief Receive responses and complete the frames they answer.
+ *
+ * @param m Master
+ * @param batch Batch the requests were sent from
+ * @param timeout_ms Longest wait for the first datagram (-1 = forever)
+ * @return Number of frames completed, 0 on timeout, or -1 on error
+ *
+ * Waits for one datagram, then reads bursts until the socket is empty.
+ * Completed frames get answered and status set as by modbus_batch_decode().
+ */
+int modbus_udp_master_recv(modbus_udp_master_st *m, modbus_batch_st *batch, int timeout_ms);
@@ -5,6 +5,7 @@
 #include <stddef.h> // for size_t
 
 #include "modbus_defines.h"
+#include "modbus_crc.h"
 
 /**
  * @brief Convert a 16-bit integer from host byte order to big-endian (Modbus network order)
@@ -12,7 +13,7 @@
  * @param x 16-bit integer in host byte order
  * @return uint16_t in big-endian order
  */
-#define MODBUS_HTONS(x) (((uint16_t)(x) >> 8) | ((uint16_t)(x) << 8))
+#define MODBUS_HTONS(x) ((uint16_t)(((uint16_t)(x) >> 8) | ((uint16_t)(x) << 8)))
 
 /**
  * @brief Convert a 32-bit integer from host byte order to big-endian (Modbus network order)
@@ -34,6 +35,7 @@
  *
  * This function implements the standard Modbus RTU CRC16 algorithm.
  * It can be used for both requests and responses to ensure data integrity.
+ * The computation runs on the engine selected with modbus_crc16_set_engine().
  */
 uint16_t modbus_crc16(const uint8_t *buf, uint16_t len);
 
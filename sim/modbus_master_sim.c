@@ -1,20 +1,65 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
+#include <time.h>
 #include <unistd.h>
 #include <arpa/inet.h>
 
-#include "modbus_master.h"
+#include "modbus_batch.h"
+#include "modbus_stats.h"
+#include "modbus_tcp.h"
+#include "modbus_trace.h"
 #include "modbus_utils.h"
 
 #define PORT 5020
-#define BUFFER_SIZE 256
+#define RX_CAPACITY 4096
+#define PIPELINE_DEPTH 4
+#define WINDOWS 10000
+#define TRACE_CAPACITY 4096
+#define EXPORT_EVERY 500
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+// Count the frames answered since the last call; their latency runs from when the window was sent
+static void record_answers(modbus_stats_shard_st *shard, const modbus_batch_st *batch, bool *recorded, uint64_t sent_ns) {
+    uint64_t now = now_ns();
+    for (uint32_t i = 0; i < batch->count; i++) {
+        const modbus_batch_frame_st *f = &batch->frames[i];
+        if (!f->answered || recorded[i])
+            continue;
+        recorded[i] = true;
+        modbus_stats_frame(shard, 1, (f->status == -8) ? (MODBUS_READ_HOLDING_REG | MODBUS_EXCEPTION_FLAG) : MODBUS_READ_HOLDING_REG);
+        modbus_stats_error(shard, MODBUS_STATS_MASTER, 1, f->status);
+        modbus_stats_latency(shard, now - sent_ns);
+    }
+}
+
+static void print_span(const char *name, const modbus_stats_histogram_st *h) {
+    printf("[MASTER]   %-7s p50 %8llu ns, p99 %8llu ns (%llu samples)\n", name,
+           (unsigned long long)modbus_stats_percentile(h, 0.50),
+           (unsigned long long)modbus_stats_percentile(h, 0.99), (unsigned long long)h->count);
+}
 
 int main() {
     int sockfd;
     struct sockaddr_in servaddr;
-    uint8_t buffer[BUFFER_SIZE];
+    modbus_tcp_master_ctx_st ctx;
+    modbus_stats_st stats;
+    modbus_trace_st trace;
+    static modbus_trace_breakdown_st breakdown;
+    uint64_t trace_cursor = 0;
+
+    modbus_tcp_master_ctx_init(&ctx, PIPELINE_DEPTH);
+    if (modbus_stats_init(&stats, 1) != 0) { perror("modbus_stats_init"); return -1; }
+    modbus_stats_shard_st *shard = modbus_stats_shard(&stats, 0);
+    if (modbus_trace_init(&trace, 1, TRACE_CAPACITY) != 0) { perror("modbus_trace_init"); return -1; }
 
     sockfd = socket(AF_INET, SOCK_STREAM, 0);
     if (sockfd < 0) { perror("socket"); return -1; }
@@ -26,28 +71,90 @@ int main() {
     if (connect(sockfd, (struct sockaddr*)&servaddr, sizeof(servaddr)) < 0) {
         perror("connect"); return -1;
     }
+    if (modbus_trace_enable_rx_timestamps(sockfd) != 0)
+        perror("SO_TIMESTAMPNS");
 
-    uint16_t start_addr = 100;
     uint16_t qty = 5;
-    uint16_t frame_len = encode_read_request(1, start_addr, qty, buffer, BUFFER_SIZE);
+    static uint16_t window_regs[PIPELINE_DEPTH][MODBUS_MAX_REGS];
+    static uint8_t rx[RX_CAPACITY];
+    modbus_batch_st batch;
+    if (modbus_batch_init(&batch, PIPELINE_DEPTH, PIPELINE_DEPTH * MODBUS_TCP_MAX_ADU_SIZE) != 0) {
+        perror("modbus_batch_init"); return -1;
+    }
+    modbus_batch_trace(&batch, modbus_trace_ring(&trace, 0));
+    union {
+        struct cmsghdr align;
+        uint8_t buf[MODBUS_TRACE_CMSG_SIZE];
+    } control;
+
+    // Nothing is printed per request: the counters and the histogram are read once at the end
+    uint64_t start = now_ns();
+    for (int w = 0; w < WINDOWS; w++) {
+        bool recorded[PIPELINE_DEPTH] = {false};
+
+        // Encode the whole window into one batch and send it with a single writev()
+        modbus_batch_reset(&batch);
+        for (int i = 0; i < PIPELINE_DEPTH; i++)
+            modbus_batch_add_read(&batch, &ctx, 1, 100 + (i * qty), qty, window_regs[i]);
+        uint64_t sent_ns = now_ns();
+        if (modbus_batch_writev(&batch, sockfd, &ctx) < 0) { perror("writev"); return -1; }
 
-    write(sockfd, buffer, frame_len);
-    printf("[MASTER] Sent request: start=%u qty=%u\n", start_addr, qty);
+        // Responses are matched by transaction ID; one read may carry several ADUs
+        size_t rx_len = 0;
+        while (modbus_tcp_master_outstanding(&ctx) > 0) {
+            // recvmsg() rather than read(), for the kernel receive timestamp of the bytes
+            struct iovec iov = {.iov_base = rx + rx_len, .iov_len = sizeof(rx) - rx_len};
+            struct msghdr msg = {.msg_iov = &iov, .msg_iovlen = 1,
+                                 .msg_control = control.buf, .msg_controllen = sizeof(control.buf)};
+            ssize_t n = recvmsg(sockfd, &msg, 0);
+            if (n <= 0) { perror("recvmsg"); return -1; }
+            modbus_batch_trace_rx(&batch, &msg, modbus_trace_now_ns());
+            rx_len += n;
 
-    ssize_t n = read(sockfd, buffer, BUFFER_SIZE);
-    if (n <= 0) { perror("read"); return -1; }
+            size_t consumed;
+            if (modbus_batch_decode(&batch, &ctx, rx, rx_len, &consumed) > 0)
+                record_answers(shard, &batch, recorded, sent_ns);
+            memmove(rx, rx + consumed, rx_len - consumed);
+            rx_len -= consumed;
+        }
 
-    uint16_t read_regs[MODBUS_MAX_REGS];
-    int ret = decode_read_response(buffer, n, read_regs, qty);
-    if (ret < 0) {
-        printf("[MASTER] Failed to decode response (ret=%d)\n", ret);
-        return -1;
+        // Export while polling goes on, as a monitoring thread would, before the ring wraps
+        if ((w % EXPORT_EVERY) == EXPORT_EVERY - 1)
+            modbus_trace_collect(&trace, &trace_cursor, &breakdown);
     }
+    double elapsed_s = (now_ns() - start) / 1e9;
 
-    printf("[MASTER] Received %d registers:\n", ret);
-    for (int i = 0; i < ret; i++)
-        printf("  Reg[%d] = %u\n", i, read_regs[i]);
+    modbus_stats_shard_st total;
+    modbus_stats_aggregate(&stats, &total);
+    printf("[MASTER] %llu requests in %.2f s (%.0f req/s), pipeline depth %d\n",
+           (unsigned long long)total.latency.count, elapsed_s, total.latency.count / elapsed_s, PIPELINE_DEPTH);
+    for (int fc = 0; fc < 256; fc++)
+        if (total.frames_by_function[fc])
+            printf("[MASTER]   function 0x%02X: %llu frames\n", fc, (unsigned long long)total.frames_by_function[fc]);
+    for (int code = 1; code < MODBUS_STATS_ERROR_CODES; code++)
+        if (total.errors[MODBUS_STATS_MASTER][code])
+            printf("[MASTER]   error -%d: %llu\n", code, (unsigned long long)total.errors[MODBUS_STATS_MASTER][code]);
+    printf("[MASTER] latency p50 %llu ns, p99 %llu ns, p99.9 %llu ns, max %llu ns\n",
+           (unsigned long long)modbus_stats_percentile(&total.latency, 0.50),
+           (unsigned long long)modbus_stats_percentile(&total.latency, 0.99),
+           (unsigned long long)modbus_stats_percentile(&total.latency, 0.999),
+           (unsigned long long)total.latency.max_ns);
+    modbus_trace_collect(&trace, &trace_cursor, &breakdown);
+    printf("[MASTER] traced %llu transactions (%llu lost), by stage:\n",
+           (unsigned long long)breakdown.records, (unsigned long long)breakdown.lost);
+    print_span("submit", &breakdown.spans[MODBUS_TRACE_SPAN_SUBMIT]);
+    print_span("wire", &breakdown.spans[MODBUS_TRACE_SPAN_WIRE]);
+    print_span("queue", &breakdown.spans[MODBUS_TRACE_SPAN_QUEUE]);
+    print_span("decode", &breakdown.spans[MODBUS_TRACE_SPAN_DECODE]);
+    print_span("total", &breakdown.spans[MODBUS_TRACE_SPAN_TOTAL]);
+    printf("[MASTER] Last window, first read: ");
+    for (int r = 0; r < qty; r++)
+        printf("%u ", window_regs[0][r]);
+    printf("\n");
 
+    modbus_batch_free(&batch);
+    modbus_stats_free(&stats);
+    modbus_trace_free(&trace);
     close(sockfd);
     return 0;
 }
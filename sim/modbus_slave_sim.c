@@ -1,66 +1,98 @@
+#define _POSIX_C_SOURCE 200809L
+
 #include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
 #include <stdint.h>
-#include <unistd.h>
-#include <arpa/inet.h>
+#include <signal.h>
+#include <pthread.h>
+#include <time.h>
 
-#include "modbus_slave.h"
-#include "modbus_utils.h"
+#include "modbus_server.h"
+#include "modbus_bank.h"
+#include "modbus_host.h"
+#include "modbus_stats.h"
 
 #define PORT 5020
-#define BUFFER_SIZE 256
-
-int main() {
-    int sockfd, connfd;
-    struct sockaddr_in servaddr, cliaddr;
-    socklen_t len = sizeof(cliaddr);
-    uint8_t buffer[BUFFER_SIZE];
-
-    // Set device slave ID
-    set_device_slave_id(1);
+#define MAX_CONNECTIONS 1024
+#define COUNTER_ADDR 0
+#define COUNTER_REGS 8
+#define UNITS 4
 
-    sockfd = socket(AF_INET, SOCK_STREAM, 0);
-    if (sockfd < 0) { perror("socket"); return -1; }
+static modbus_server_st server;
+static modbus_bank_st banks[UNITS];
+static modbus_host_st host;
+static modbus_stats_st stats;
+static volatile sig_atomic_t running = 1;
 
-    servaddr.sin_family = AF_INET;
-    servaddr.sin_addr.s_addr = INADDR_ANY;
-    servaddr.sin_port = htons(PORT);
+// Field I/O stand-in: updates a block of counters in every unit while the server reads the banks
+static void *producer_main(void *arg) {
+    (void)arg;
+    struct timespec period = {0, 100 * 1000 * 1000};
+    uint16_t values[COUNTER_REGS];
 
-    if (bind(sockfd, (struct sockaddr*)&servaddr, sizeof(servaddr)) < 0) {
-        perror("bind"); return -1;
+    for (uint16_t tick = 0; running; tick++) {
+        for (int u = 0; u < UNITS; u++) {
+            for (int i = 0; i < COUNTER_REGS; i++)
+                values[i] = tick + i + u * 1000;
+            modbus_bank_write(&banks[u], COUNTER_ADDR, values, COUNTER_REGS);
+        }
+        nanosleep(&period, NULL);
     }
+    return NULL;
+}
 
-    listen(sockfd, 1);
-    printf("[SLAVE] Listening on port %d...\n", PORT);
-
-    connfd = accept(sockfd, (struct sockaddr*)&cliaddr, &len);
-    if (connfd < 0) { perror("accept"); return -1; }
+static void on_signal(int sig) {
+    (void)sig;
+    running = 0;
+    modbus_server_stop(&server);
+}
 
-    while (1) {
-        ssize_t n = read(connfd, buffer, BUFFER_SIZE);
-        if (n <= 0) break;
+int main() {
+    modbus_server_config_st cfg = {
+        .port = PORT,
+        .max_connections = MAX_CONNECTIONS,
+        .host = &host,
+        .stats = &stats,
+    };
 
-        uint8_t slave_id;
-        uint16_t start_addr, qty;
-        int ret = decode_read_request(buffer, n, &slave_id, &start_addr, &qty);
-        if (ret != 0) {
-            printf("[SLAVE] Invalid request (ret=%d)\n", ret);
-            continue;
+    // Units 1..UNITS, each with its own bank; static registers hold their own address as dummy data
+    if (modbus_host_init(&host, UNITS) != 0) { perror("modbus_host_init"); return -1; }
+    for (int u = 0; u < UNITS; u++) {
+        modbus_bank_init(&banks[u]);
+        for (uint32_t addr = 0; addr < MODBUS_BANK_REGS; addr++) {
+            uint16_t value = (uint16_t)addr;
+            modbus_bank_write(&banks[u], (uint16_t)addr, &value, 1);
         }
+        modbus_host_add_bank(&host, (uint8_t)(u + 1), &banks[u]);
+    }
 
-        printf("[SLAVE] Received request: start=%u qty=%u\n", start_addr, qty);
+    if (modbus_stats_init(&stats, 1) != 0) { perror("modbus_stats_init"); return -1; }
+    if (modbus_server_init(&server, &cfg) != 0) { perror("modbus_server_init"); return -1; }
 
-        uint16_t regs[MODBUS_MAX_REGS];
-        for (int i = 0; i < qty; i++)
-            regs[i] = start_addr + i; // dummy data
+    signal(SIGINT, on_signal);
+    signal(SIGTERM, on_signal);
 
-        uint16_t resp_len = encode_read_response(slave_id, regs, qty, buffer, BUFFER_SIZE);
-        write(connfd, buffer, resp_len);
-        printf("[SLAVE] Sent response (%u bytes)\n", resp_len);
-    }
+    pthread_t producer;
+    pthread_create(&producer, NULL, producer_main, NULL);
+    printf("[SLAVE] Listening on port %d (up to %d masters), units 1..%d, counters at %d..%d\n", PORT,
+           MAX_CONNECTIONS, UNITS, COUNTER_ADDR, COUNTER_ADDR + COUNTER_REGS - 1);
+
+    modbus_server_run(&server);
+
+    running = 0;
+    pthread_join(producer, NULL);
+    printf("[SLAVE] %llu requests from %llu connections\n", (unsigned long long)server.stats.requests,
+           (unsigned long long)server.stats.accepted);
 
-    close(connfd);
-    close(sockfd);
+    modbus_stats_shard_st total;
+    modbus_stats_aggregate(&stats, &total);
+    for (int fc = 0; fc < 256; fc++)
+        if (total.frames_by_function[fc])
+            printf("[SLAVE]   function 0x%02X: %llu frames\n", fc, (unsigned long long)total.frames_by_function[fc]);
+    for (int code = 1; code < MODBUS_STATS_ERROR_CODES; code++)
+        if (total.errors[MODBUS_STATS_SLAVE][code])
+            printf("[SLAVE]   error -%d: %llu\n", code, (unsigned long long)total.errors[MODBUS_STATS_SLAVE][code]);
+    modbus_server_deinit(&server);
+    modbus_host_free(&host);
+    modbus_stats_free(&stats);
     return 0;
 }
@@ -1,3 +1,3 @@
-gcc -Iinc -I../inc -Wall -Wextra -std=c11 -g ../src/modbus_master.c ../src/modbus_utils.c modbus_master_sim.c -o master_sim
+gcc -Iinc -I../inc -Wall -Wextra -std=c11 -g ../src/modbus_batch.c ../src/modbus_stats.c ../src/modbus_trace.c ../src/modbus_tcp.c ../src/modbus_stream.c ../src/modbus_slave.c ../src/modbus_pdu.c ../src/modbus_utils.c ../src/modbus_crc.c ../src/modbus_swap.c modbus_master_sim.c -o master_sim
 
 ./master_sim
@@ -1,3 +1,3 @@
-gcc -Iinc -I../inc -Wall -Wextra -std=c11 -g ../src/modbus_slave.c ../src/modbus_utils.c modbus_slave_sim.c -o slave_sim
+gcc -Iinc -I../inc -Wall -Wextra -std=c11 -g -pthread ../src/modbus_bank.c ../src/modbus_server.c ../src/modbus_host.c ../src/modbus_stats.c ../src/modbus_tcp.c ../src/modbus_stream.c ../src/modbus_slave.c ../src/modbus_pdu.c ../src/modbus_utils.c ../src/modbus_crc.c ../src/modbus_swap.c modbus_slave_sim.c -o slave_sim
 
 ./slave_sim
\ No newline at end of file
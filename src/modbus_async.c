@@ -0,0 +1,915 @@
+/**
+ * @file modbus_async.c
+ * @brief Asynchronous Modbus TCP master on io_uring, with an epoll fallback.
+ *
+ * The io_uring backend talks to the kernel through io_uring_setup() and
+ * io_uring_enter() directly, since no liburing is assumed. Both rings come
+ * from one mapping (IORING_FEAT_SINGLE_MMAP) and waits use an explicit
+ * timeout argument (IORING_FEAT_EXT_ARG); kernels without either fall
+ * back to epoll. The submission index array is filled once with the
+ * identity, so preparing an entry is one store and a tail update.
+ *
+ * Each connection has at most one receive and one send in flight, so the
+ * rings, sized for two entries per connection, can never overflow. A send
+ * covers the bytes queued when it was prepared; requests issued meanwhile
+ * are appended behind them and go out with the next send.
+ */
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/io_uring.h>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+
+#include "modbus_async.h"
+#include "modbus_pdu.h"
+
+/** @brief user_data of a receive completion: (conn << 1) | OP_RECV */
+#define OP_RECV 0u
+
+/** @brief user_data of a send completion: (conn << 1) | OP_SEND */
+#define OP_SEND 1u
+
+/** @brief Events fetched per epoll_wait() */
+#define EPOLL_BATCH 256
+
+/**
+ * @brief CLOCK_MONOTONIC in nanoseconds.
+ */
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief Map the rings of a new io_uring sized for max_connections.
+ *
+ * @return 0 on success, -1 if io_uring is unavailable or lacks a needed feature
+ */
+static int uring_init(modbus_async_uring_st *ring, uint32_t max_connections)
+{
+    uint32_t entries = 1;
+    while (entries < 2 * max_connections)
+    {
+        entries *= 2;
+    }
+
+    // Only this thread submits, and completions are processed when it waits
+    struct io_uring_params p;
+    memset(&p, 0, sizeof(p));
+    p.flags = IORING_SETUP_SINGLE_ISSUER | IORING_SETUP_DEFER_TASKRUN;
+    int fd = (int)syscall(__NR_io_uring_setup, entries, &p);
+    if ((fd < 0) && (errno == EINVAL))
+    {
+        memset(&p, 0, sizeof(p));
+        fd = (int)syscall(__NR_io_uring_setup, entries, &p);
+    }
+    if (fd < 0)
+    {
+        return -1;
+    }
+
+    if (!(p.features & IORING_FEAT_SINGLE_MMAP) || !(p.features & IORING_FEAT_EXT_ARG))
+    {
+        close(fd);
+        return -1;
+    }
+
+    size_t sq_size = p.sq_off.array + p.sq_entries * sizeof(uint32_t);
+    size_t cq_size = p.cq_off.cqes + p.cq_entries * sizeof(struct io_uring_cqe);
+    ring->ring_map_size = (sq_size > cq_size) ? sq_size : cq_size;
+    ring->ring_map = mmap(NULL, ring->ring_map_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                          IORING_OFF_SQ_RING);
+    if (ring->ring_map == MAP_FAILED)
+    {
+        close(fd);
+        return -1;
+    }
+
+    ring->sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+    ring->sqes = mmap(NULL, ring->sqes_size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd,
+                      IORING_OFF_SQES);
+    if (ring->sqes == MAP_FAILED)
+    {
+        munmap(ring->ring_map, ring->ring_map_size);
+        close(fd);
+        return -1;
+    }
+
+    uint8_t *base = ring->ring_map;
+    ring->fd = fd;
+    ring->sq_head = (uint32_t *)(base + p.sq_off.head);
+    ring->sq_tail = (uint32_t *)(base + p.sq_off.tail);
+    ring->sq_array = (uint32_t *)(base + p.sq_off.array);
+    ring->sq_mask = *(uint32_t *)(base + p.sq_off.ring_mask);
+    ring->sq_entries = p.sq_entries;
+    ring->cq_head = (uint32_t *)(base + p.cq_off.head);
+    ring->cq_tail = (uint32_t *)(base + p.cq_off.tail);
+    ring->cqes = base + p.cq_off.cqes;
+    ring->cq_mask = *(uint32_t *)(base + p.cq_off.ring_mask);
+    ring->to_submit = 0;
+
+    for (uint32_t i = 0; i < p.sq_entries; i++)
+    {
+        ring->sq_array[i] = i;
+    }
+    return 0;
+}
+
+/**
+ * @brief Unmap the rings and close the io_uring, cancelling whatever is in flight.
+ */
+static void uring_deinit(modbus_async_uring_st *ring)
+{
+    if (ring->fd < 0)
+    {
+        return;
+    }
+
+    munmap(ring->sqes, ring->sqes_size);
+    munmap(ring->ring_map, ring->ring_map_size);
+    close(ring->fd);
+    ring->fd = -1;
+}
+
+/**
+ * @brief Prepare one submission entry.
+ *
+ * @return true if the entry was queued
+ */
+static bool uring_prep(modbus_async_uring_st *ring, uint8_t opcode, int fd, void *buf, size_t len,
+                       uint64_t user_data)
+{
+    uint32_t tail = *ring->sq_tail;
+    uint32_t head = __atomic_load_n(ring->sq_head, __ATOMIC_ACQUIRE);
+    if (tail - head >= ring->sq_entries)
+    {
+        return false;
+    }
+
+    struct io_uring_sqe *sqe = &((struct io_uring_sqe *)ring->sqes)[tail & ring->sq_mask];
+    memset(sqe, 0, sizeof(*sqe));
+    sqe->opcode = opcode;
+    sqe->fd = fd;
+    sqe->addr = (uint64_t)(uintptr_t)buf;
+    sqe->len = (uint32_t)len;
+    sqe->msg_flags = MSG_NOSIGNAL;
+    sqe->user_data = user_data;
+
+    __atomic_store_n(ring->sq_tail, tail + 1, __ATOMIC_RELEASE);
+    ring->to_submit++;
+    return true;
+}
+
+/**
+ * @brief Release a call and run its callback.
+ */
+static void complete_call(modbus_async_st *engine, uint32_t index, modbus_async_call_st *call, int status,
+                          const uint16_t *regs)
+{
+    modbus_async_done_fn cb = call->cb;
+    void *arg = call->arg;
+
+    call->in_use = false;
+    engine->in_flight--;
+    engine->completed++;
+    if (cb)
+    {
+        cb(arg, index, status, regs);
+    }
+}
+
+/**
+ * @brief Find the call waiting for a transaction ID.
+ */
+static modbus_async_call_st *find_call(modbus_async_conn_st *conn, uint16_t transaction_id)
+{
+    for (uint32_t i = 0; i < MODBUS_TCP_MAX_PIPELINE; i++)
+    {
+        if (conn->calls[i].in_use && (conn->calls[i].transaction_id == transaction_id))
+        {
+            return &conn->calls[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Stop using a connection and fail its outstanding requests.
+ */
+static void fail_connection(modbus_async_st *engine, uint32_t index)
+{
+    modbus_async_conn_st *conn = &engine->conns[index];
+    if (conn->failed)
+    {
+        return;
+    }
+
+    // Set first, so callbacks issuing new requests on this connection are refused
+    conn->failed = true;
+    conn->tx_len = 0;
+    if (engine->backend == MODBUS_ASYNC_EPOLL)
+    {
+        epoll_ctl(engine->epoll_fd, EPOLL_CTL_DEL, conn->fd, NULL);
+    }
+
+    for (uint32_t i = 0; i < MODBUS_TCP_MAX_PIPELINE; i++)
+    {
+        if (conn->calls[i].in_use)
+        {
+            modbus_tcp_master_cancel(&conn->master, conn->calls[i].transaction_id);
+            engine->stats.failures++;
+            complete_call(engine, index, &conn->calls[i], MODBUS_ASYNC_CLOSED, NULL);
+        }
+    }
+}
+
+/**
+ * @brief Decode every complete response in the receive ring.
+ */
+static void deliver_responses(modbus_async_st *engine, uint32_t index)
+{
+    modbus_async_conn_st *conn = &engine->conns[index];
+    uint16_t regs[MODBUS_MAX_REGS];
+    const uint8_t *frame;
+    int len;
+
+    while ((len = modbus_stream_next_frame(&conn->rx, &frame)) > 0)
+    {
+        uint16_t transaction_id;
+        uint8_t unit_id = frame[MODBUS_MBAP_HEADER_SIZE - 1];
+        uint8_t outstanding = modbus_tcp_master_outstanding(&conn->master);
+        int status = decode_tcp_response(&conn->master, frame, (size_t)len, regs, MODBUS_MAX_REGS,
+                                         &transaction_id);
+
+        modbus_stats_frame(engine->stats_shard, unit_id, frame[MODBUS_MBAP_HEADER_SIZE]);
+        if (status < 0)
+        {
+            modbus_stats_error(engine->stats_shard, MODBUS_STATS_MASTER, unit_id, status);
+        }
+
+        // Unknown or already expired transactions are dropped; a matched one completes whatever its status
+        if (modbus_tcp_master_outstanding(&conn->master) == outstanding)
+        {
+            continue;
+        }
+
+        modbus_async_call_st *call = find_call(conn, transaction_id);
+        if (call)
+        {
+            if (engine->stats_shard)
+            {
+                modbus_stats_latency(engine->stats_shard, now_ns() - call->issued_ns);
+            }
+            engine->stats.responses++;
+            complete_call(engine, index, call, status, (status > 0) ? regs : NULL);
+        }
+    }
+}
+
+/**
+ * @brief Fail the requests whose deadline passed.
+ */
+static void expire_calls(modbus_async_st *engine)
+{
+    if ((engine->timeout_ns == 0) || (engine->in_flight == 0))
+    {
+        engine->next_deadline_ns = UINT64_MAX;
+        return;
+    }
+
+    uint64_t now = now_ns();
+    if (now < engine->next_deadline_ns)
+    {
+        return;
+    }
+
+    // Callbacks issuing new requests lower next_deadline_ns as they go
+    uint64_t next = UINT64_MAX;
+    engine->next_deadline_ns = UINT64_MAX;
+    for (uint32_t c = 0; c < engine->count; c++)
+    {
+        modbus_async_conn_st *conn = &engine->conns[c];
+        if (modbus_tcp_master_outstanding(&conn->master) == 0)
+        {
+            continue;
+        }
+
+        for (uint32_t i = 0; i < MODBUS_TCP_MAX_PIPELINE; i++)
+        {
+            modbus_async_call_st *call = &conn->calls[i];
+            if (!call->in_use)
+            {
+                continue;
+            }
+
+            if (call->deadline_ns <= now)
+            {
+                modbus_tcp_master_cancel(&conn->master, call->transaction_id);
+                engine->stats.timeouts++;
+                complete_call(engine, c, call, MODBUS_ASYNC_TIMEOUT, NULL);
+            }
+            else if (call->deadline_ns < next)
+            {
+                next = call->deadline_ns;
+            }
+        }
+    }
+
+    if (next < engine->next_deadline_ns)
+    {
+        engine->next_deadline_ns = next;
+    }
+}
+
+/**
+ * @brief Bound a poll timeout by the next request deadline.
+ */
+static int wait_timeout_ms(const modbus_async_st *engine, int timeout_ms)
+{
+    if ((engine->timeout_ns == 0) || (engine->in_flight == 0) || (engine->next_deadline_ns == UINT64_MAX))
+    {
+        return timeout_ms;
+    }
+
+    uint64_t now = now_ns();
+    uint64_t left = (engine->next_deadline_ns > now) ? engine->next_deadline_ns - now : 0;
+    int left_ms = (int)((left + 999999u) / 1000000u);
+    return ((timeout_ms < 0) || (left_ms < timeout_ms)) ? left_ms : timeout_ms;
+}
+
+/**
+ * @brief Drop the first n bytes of the transmit buffer.
+ */
+static void consume_tx(modbus_async_conn_st *conn, size_t n)
+{
+    conn->tx_len -= n;
+    memmove(conn->tx, conn->tx + n, conn->tx_len);
+}
+
+/**
+ * @brief Put a connection on the send list.
+ */
+static void queue_send(modbus_async_st *engine, uint32_t index)
+{
+    modbus_async_conn_st *conn = &engine->conns[index];
+    if (!conn->queued)
+    {
+        conn->queued = true;
+        engine->send_queue[engine->send_queued++] = index;
+    }
+}
+
+/**
+ * @brief Post a receive into the free region of the ring.
+ */
+static bool uring_arm_recv(modbus_async_st *engine, uint32_t index)
+{
+    modbus_async_conn_st *conn = &engine->conns[index];
+    size_t avail;
+    uint8_t *dst = modbus_stream_write_ptr(&conn->rx, &avail);
+    if (!dst || !uring_prep(&engine->ring, IORING_OP_RECV, conn->fd, dst, avail,
+                            ((uint64_t)index << 1) | OP_RECV))
+    {
+        return false;
+    }
+
+    conn->recv_armed = true;
+    return true;
+}
+
+/**
+ * @brief Handle one completion.
+ */
+static void uring_complete(modbus_async_st *engine, const struct io_uring_cqe *cqe)
+{
+    uint32_t index = (uint32_t)(cqe->user_data >> 1);
+    modbus_async_conn_st *conn = &engine->conns[index];
+    int res = cqe->res;
+
+    if ((cqe->user_data & 1u) == OP_SEND)
+    {
+        conn->send_armed = false;
+        if (conn->failed)
+        {
+            return;
+        }
+        if (res < 0)
+        {
+            fail_connection(engine, index);
+            return;
+        }
+        consume_tx(conn, (size_t)res);
+        if (conn->tx_len > 0)
+        {
+            queue_send(engine, index);
+        }
+        return;
+    }
+
+    conn->recv_armed = false;
+    if (conn->failed)
+    {
+        return;
+    }
+    if ((res == -EINTR) || (res == -EAGAIN))
+    {
+        uring_arm_recv(engine, index);
+        return;
+    }
+    if (res <= 0)
+    {
+        fail_connection(engine, index);
+        return;
+    }
+
+    modbus_stream_commit(&conn->rx, (size_t)res);
+    deliver_responses(engine, index);
+    if (!conn->failed && !uring_arm_recv(engine, index))
+    {
+        fail_connection(engine, index);
+    }
+}
+
+/**
+ * @brief One io_uring poll: submit sends and receives, wait, reap.
+ */
+static int uring_poll(modbus_async_st *engine, int timeout_ms)
+{
+    modbus_async_uring_st *ring = &engine->ring;
+
+    uint32_t queued = engine->send_queued;
+    engine->send_queued = 0;
+    for (uint32_t q = 0; q < queued; q++)
+    {
+        uint32_t index = engine->send_queue[q];
+        modbus_async_conn_st *conn = &engine->conns[index];
+        conn->queued = false;
+
+        // A send in flight requeues the connection when it completes
+        if (conn->failed || conn->send_armed || (conn->tx_len == 0))
+        {
+            continue;
+        }
+        if (uring_prep(ring, IORING_OP_SEND, conn->fd, conn->tx, conn->tx_len, ((uint64_t)index << 1) | OP_SEND))
+        {
+            conn->send_armed = true;
+        }
+    }
+
+    int wait_ms = wait_timeout_ms(engine, timeout_ms);
+    struct __kernel_timespec ts = {
+        .tv_sec = (wait_ms > 0) ? wait_ms / 1000 : 0,
+        .tv_nsec = (wait_ms > 0) ? (long long)(wait_ms % 1000) * 1000000 : 0,
+    };
+    struct io_uring_getevents_arg arg = {
+        .ts = (wait_ms < 0) ? 0 : (uint64_t)(uintptr_t)&ts,
+    };
+    uint32_t min_complete = (wait_ms == 0) ? 0 : 1;
+
+    int ret = (int)syscall(__NR_io_uring_enter, ring->fd, ring->to_submit, min_complete,
+                           IORING_ENTER_GETEVENTS | IORING_ENTER_EXT_ARG, &arg, sizeof(arg));
+    engine->stats.syscalls++;
+    if (ret >= 0)
+    {
+        ring->to_submit = 0;
+    }
+    else if ((errno != ETIME) && (errno != EINTR) && (errno != EBUSY))
+    {
+        return -1;
+    }
+
+    uint32_t head = *ring->cq_head;
+    uint32_t tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+    while (head != tail)
+    {
+        const struct io_uring_cqe *cqe = &((const struct io_uring_cqe *)ring->cqes)[head & ring->cq_mask];
+        struct io_uring_cqe copy = *cqe;
+        head++;
+        __atomic_store_n(ring->cq_head, head, __ATOMIC_RELEASE);
+        uring_complete(engine, &copy);
+        tail = __atomic_load_n(ring->cq_tail, __ATOMIC_ACQUIRE);
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Send queued bytes until done or the socket would block.
+ */
+static void epoll_flush(modbus_async_st *engine, uint32_t index)
+{
+    modbus_async_conn_st *conn = &engine->conns[index];
+
+    while (!conn->failed && conn->writable && (conn->tx_len > 0))
+    {
+        ssize_t n = send(conn->fd, conn->tx, conn->tx_len, MSG_NOSIGNAL);
+        engine->stats.syscalls++;
+        if (n > 0)
+        {
+            consume_tx(conn, (size_t)n);
+        }
+        else if ((errno == EAGAIN) || (errno == EWOULDBLOCK))
+        {
+            // EPOLLOUT sets writable again and flushes the rest
+            conn->writable = false;
+        }
+        else if (errno != EINTR)
+        {
+            fail_connection(engine, index);
+        }
+    }
+}
+
+/**
+ * @brief Receive until the socket would block, answering callbacks as frames complete.
+ */
+static void epoll_drain(modbus_async_st *engine, uint32_t index)
+{
+    modbus_async_conn_st *conn = &engine->conns[index];
+
+    while (!conn->failed)
+    {
+        size_t avail;
+        uint8_t *dst = modbus_stream_write_ptr(&conn->rx, &avail);
+        if (!dst)
+        {
+            fail_connection(engine, index);
+            return;
+        }
+
+        ssize_t n = recv(conn->fd, dst, avail, 0);
+        engine->stats.syscalls++;
+        if (n > 0)
+        {
+            modbus_stream_commit(&conn->rx, (size_t)n);
+            deliver_responses(engine, index);
+            continue;
+        }
+        if ((n < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK)))
+        {
+            return;
+        }
+        if ((n < 0) && (errno == EINTR))
+        {
+            continue;
+        }
+        fail_connection(engine, index);
+    }
+}
+
+/**
+ * @brief One epoll poll: flush sends, wait, receive.
+ */
+static int epoll_poll(modbus_async_st *engine, int timeout_ms)
+{
+    uint32_t queued = engine->send_queued;
+    engine->send_queued = 0;
+    for (uint32_t q = 0; q < queued; q++)
+    {
+        uint32_t index = engine->send_queue[q];
+        engine->conns[index].queued = false;
+        epoll_flush(engine, index);
+    }
+
+    struct epoll_event events[EPOLL_BATCH];
+    int ready = epoll_wait(engine->epoll_fd, events, EPOLL_BATCH, wait_timeout_ms(engine, timeout_ms));
+    engine->stats.syscalls++;
+    if (ready < 0)
+    {
+        return (errno == EINTR) ? 0 : -1;
+    }
+
+    for (int e = 0; e < ready; e++)
+    {
+        uint32_t index = events[e].data.u32;
+        modbus_async_conn_st *conn = &engine->conns[index];
+
+        if (events[e].events & EPOLLOUT)
+        {
+            conn->writable = true;
+            epoll_flush(engine, index);
+        }
+        if (events[e].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+        {
+            epoll_drain(engine, index);
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Create an engine.
+ *
+ * @param engine Engine to initialize
+ * @param cfg Configuration
+ * @return 0 on success, or a negative error code:
+ *         -1: Invalid arguments
+ *         -2: Requested backend unavailable
+ *         -3: Out of memory
+ */
+int modbus_async_init(modbus_async_st *engine, const modbus_async_config_st *cfg)
+{
+    if (!engine || !cfg || (cfg->max_connections == 0) || (cfg->max_connections > MODBUS_ASYNC_MAX_CONNECTIONS) ||
+        (cfg->backend > MODBUS_ASYNC_EPOLL))
+    {
+        return -1;
+    }
+
+    memset(engine, 0, sizeof(*engine));
+    engine->ring.fd = -1;
+    engine->epoll_fd = -1;
+    engine->max_connections = cfg->max_connections;
+    engine->timeout_ns = (uint64_t)cfg->timeout_ms * 1000000u;
+    engine->stats_shard = cfg->stats;
+    engine->next_deadline_ns = UINT64_MAX;
+
+    engine->conns = calloc(cfg->max_connections, sizeof(*engine->conns));
+    engine->send_queue = calloc(cfg->max_connections, sizeof(*engine->send_queue));
+    if (!engine->conns || !engine->send_queue)
+    {
+        modbus_async_deinit(engine);
+        return -3;
+    }
+
+    if ((cfg->backend != MODBUS_ASYNC_EPOLL) && (uring_init(&engine->ring, cfg->max_connections) == 0))
+    {
+        engine->backend = MODBUS_ASYNC_IO_URING;
+        return 0;
+    }
+
+    if (cfg->backend == MODBUS_ASYNC_IO_URING)
+    {
+        modbus_async_deinit(engine);
+        return -2;
+    }
+
+    engine->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (engine->epoll_fd < 0)
+    {
+        modbus_async_deinit(engine);
+        return -2;
+    }
+
+    engine->backend = MODBUS_ASYNC_EPOLL;
+    return 0;
+}
+
+/**
+ * @brief Close every connection and release the engine.
+ *
+ * @param engine Engine
+ */
+void modbus_async_deinit(modbus_async_st *engine)
+{
+    if (!engine)
+    {
+        return;
+    }
+
+    // Closing the ring first cancels the operations that still point into the buffers
+    uring_deinit(&engine->ring);
+    if (engine->epoll_fd >= 0)
+    {
+        close(engine->epoll_fd);
+        engine->epoll_fd = -1;
+    }
+
+    for (uint32_t i = 0; i < engine->count; i++)
+    {
+        close(engine->conns[i].fd);
+    }
+
+    free(engine->conns);
+    free(engine->send_queue);
+    engine->conns = NULL;
+    engine->send_queue = NULL;
+    engine->count = 0;
+    engine->in_flight = 0;
+}
+
+/**
+ * @brief Hand a connected TCP socket to the engine.
+ *
+ * @param engine Engine
+ * @param fd Connected socket; the engine closes it in modbus_async_deinit()
+ * @param max_outstanding Pipeline depth on this connection (1..MODBUS_TCP_MAX_PIPELINE)
+ * @return Connection index, or a negative error code:
+ *         -1: Invalid arguments
+ *         -2: No free connection slot
+ *         -3: Socket could not be registered
+ */
+int modbus_async_add_connection(modbus_async_st *engine, int fd, uint8_t max_outstanding)
+{
+    if (!engine || !engine->conns || (fd < 0))
+    {
+        return -1;
+    }
+
+    if (engine->count == engine->max_connections)
+    {
+        return -2;
+    }
+
+    uint32_t index = engine->count;
+    modbus_async_conn_st *conn = &engine->conns[index];
+    if (modbus_tcp_master_ctx_init(&conn->master, max_outstanding) != 0)
+    {
+        return -1;
+    }
+
+    conn->fd = fd;
+    conn->failed = false;
+    conn->queued = false;
+    conn->writable = true;
+    conn->recv_armed = false;
+    conn->send_armed = false;
+    conn->tx_len = 0;
+    memset(conn->calls, 0, sizeof(conn->calls));
+    modbus_stream_init(&conn->rx, MODBUS_STREAM_TCP, conn->rx_storage, sizeof(conn->rx_storage));
+
+    if (engine->backend == MODBUS_ASYNC_EPOLL)
+    {
+        int flags = fcntl(fd, F_GETFL);
+        struct epoll_event ev = {
+            .events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET,
+            .data.u32 = index,
+        };
+        if ((flags < 0) || (fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0) ||
+            (epoll_ctl(engine->epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0))
+        {
+            return -3;
+        }
+    }
+    else if (!uring_arm_recv(engine, index))
+    {
+        return -3;
+    }
+
+    engine->count++;
+    return (int)index;
+}
+
+/**
+ * @brief Queue a request around any PDU built with the modbus_pdu_encode_*() functions.
+ *
+ * @param engine Engine
+ * @param conn Connection index
+ * @param unit_id Unit identifier
+ * @param pdu Request PDU
+ * @param pdu_len Length of the request PDU
+ * @param cb Completion callback (may be NULL)
+ * @param arg User argument for cb
+ * @return Transaction ID, or a negative error code:
+ *         -1: Invalid arguments
+ *         -2: Connection failed
+ *         -3: Pipeline full
+ *         -4: Transmit buffer full
+ */
+int modbus_async_request(modbus_async_st *engine, uint32_t conn, uint8_t unit_id, const uint8_t *pdu,
+                         size_t pdu_len, modbus_async_done_fn cb, void *arg)
+{
+    if (!engine || (conn >= engine->count) || !pdu)
+    {
+        return -1;
+    }
+
+    modbus_async_conn_st *c = &engine->conns[conn];
+    if (c->failed)
+    {
+        return -2;
+    }
+
+    if (modbus_tcp_master_outstanding(&c->master) >= c->master.max_outstanding)
+    {
+        return -3;
+    }
+
+    if (modbus_pdu_request_length(pdu, pdu_len) != (int)pdu_len)
+    {
+        return -1;
+    }
+
+    // Unsent bytes of cancelled requests still hold their place in c->tx
+    if (sizeof(c->tx) - c->tx_len < MODBUS_MBAP_HEADER_SIZE + pdu_len)
+    {
+        return -4;
+    }
+
+    modbus_async_call_st *call = NULL;
+    for (uint32_t i = 0; i < MODBUS_TCP_MAX_PIPELINE; i++)
+    {
+        if (!c->calls[i].in_use)
+        {
+            call = &c->calls[i];
+            break;
+        }
+    }
+    if (!call)
+    {
+        return -3;
+    }
+
+    uint16_t transaction_id;
+    uint16_t len = encode_tcp_request(&c->master, unit_id, pdu, pdu_len, c->tx + c->tx_len,
+                                      sizeof(c->tx) - c->tx_len, &transaction_id);
+    if (len == 0)
+    {
+        return -1;
+    }
+
+    call->in_use = true;
+    call->transaction_id = transaction_id;
+    call->cb = cb;
+    call->arg = arg;
+    if (engine->stats_shard)
+    {
+        call->issued_ns = now_ns();
+    }
+    if (engine->timeout_ns)
+    {
+        call->deadline_ns = (engine->stats_shard ? call->issued_ns : now_ns()) + engine->timeout_ns;
+        if (call->deadline_ns < engine->next_deadline_ns)
+        {
+            engine->next_deadline_ns = call->deadline_ns;
+        }
+    }
+
+    c->tx_len += len;
+    queue_send(engine, conn);
+    engine->in_flight++;
+    engine->stats.requests++;
+    return transaction_id;
+}
+
+/**
+ * @brief Queue a Read Holding Registers request.
+ *
+ * @param engine Engine
+ * @param conn Connection index
+ * @param unit_id Unit identifier
+ * @param addr First register address
+ * @param qty Number of registers (1..MODBUS_MAX_REGS)
+ * @param cb Completion callback (may be NULL)
+ * @param arg User argument for cb
+ * @return Transaction ID, or a negative error code as modbus_async_request()
+ */
+int modbus_async_read(modbus_async_st *engine, uint32_t conn, uint8_t unit_id, uint16_t addr, uint16_t qty,
+                      modbus_async_done_fn cb, void *arg)
+{
+    uint8_t pdu[5];
+    uint16_t pdu_len = modbus_pdu_encode_read(MODBUS_READ_HOLDING_REG, addr, qty, pdu, sizeof(pdu));
+    if (pdu_len == 0)
+    {
+        return -1;
+    }
+
+    return modbus_async_request(engine, conn, unit_id, pdu, pdu_len, cb, arg);
+}
+
+/**
+ * @brief Send queued requests, wait for completions and run their callbacks.
+ *
+ * @param engine Engine
+ * @param timeout_ms Longest wait for a completion (-1 = until one arrives or a request times out)
+ * @return Number of callbacks run, or -1 on error
+ */
+int modbus_async_poll(modbus_async_st *engine, int timeout_ms)
+{
+    if (!engine || !engine->conns)
+    {
+        return -1;
+    }
+
+    engine->completed = 0;
+    int ret = (engine->backend == MODBUS_ASYNC_IO_URING) ? uring_poll(engine, timeout_ms)
+                                                          : epoll_poll(engine, timeout_ms);
+    if (ret < 0)
+    {
+        return -1;
+    }
+
+    expire_calls(engine);
+    return (int)engine->completed;
+}
+
+/**
+ * @brief Number of requests issued and not completed.
+ *
+ * @param engine Engine
+ * @return Outstanding request count
+ */
+uint32_t modbus_async_in_flight(const modbus_async_st *engine)
+{
+    return engine ? engine->in_flight : 0;
+}
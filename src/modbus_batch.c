@@ -0,0 +1,464 @@
+/**
+ * @file modbus_batch.c
+ * @brief Batched Modbus TCP requests with scatter/gather submission.
+ *
+ * Frames of one context that were added one after the other sit next to
+ * each other in the arena; modbus_batch_writev() merges such runs into a
+ * single segment, so a pipeline on one connection is one contiguous write.
+ */
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <limits.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include "modbus_batch.h"
+#include "modbus_pdu.h"
+
+/**
+ * @brief Wait until a socket can take more bytes.
+ */
+static void wait_writable(int fd)
+{
+    struct pollfd pfd = {.fd = fd, .events = POLLOUT};
+    poll(&pfd, 1, -1);
+}
+
+/**
+ * @brief Find the unanswered frame of a context with a transaction ID.
+ *
+ * Responses mostly come back in request order, so the search starts
+ * right after the last match and usually ends at its first step.
+ *
+ * @return Frame index, or -1 if none
+ */
+static int find_frame(modbus_batch_st *batch, const modbus_tcp_master_ctx_st *ctx, uint16_t transaction_id)
+{
+    uint32_t i = batch->cursor;
+    for (uint32_t n = 0; n < batch->count; n++)
+    {
+        const modbus_batch_frame_st *f = &batch->frames[i];
+        uint32_t next = (i + 1 == batch->count) ? 0 : i + 1;
+        if (!f->answered && (f->ctx == ctx) && (f->transaction_id == transaction_id))
+        {
+            batch->cursor = next;
+            return (int)i;
+        }
+        i = next;
+    }
+    return -1;
+}
+
+/**
+ * @brief Stamp the send time of frames that were just sent.
+ */
+static void trace_sent(modbus_batch_st *batch, uint32_t first, uint32_t count, const modbus_tcp_master_ctx_st *ctx)
+{
+    if (!batch->trace)
+    {
+        return;
+    }
+
+    uint64_t now = modbus_trace_now_ns();
+    for (uint32_t i = first; i < first + count; i++)
+    {
+        if (!ctx || (batch->frames[i].ctx == ctx))
+        {
+            batch->traces[i].ns[MODBUS_TRACE_SENT] = now;
+        }
+    }
+}
+
+/**
+ * @brief Allocate a batch.
+ *
+ * @param batch Batch to initialize
+ * @param capacity Largest number of frames
+ * @param arena_size Bytes for the encoded frames
+ * @return 0 on success, or a negative error code
+ */
+int modbus_batch_init(modbus_batch_st *batch, uint32_t capacity, size_t arena_size)
+{
+    if (!batch || (capacity == 0) || (capacity > UINT16_MAX) || (arena_size == 0))
+    {
+        return -1;
+    }
+
+    memset(batch, 0, sizeof(*batch));
+    batch->arena = malloc(arena_size);
+    batch->iov = calloc(capacity, sizeof(*batch->iov));
+    batch->gather = calloc(capacity, sizeof(*batch->gather));
+    batch->msgs = calloc(capacity, sizeof(*batch->msgs));
+    batch->frames = calloc(capacity, sizeof(*batch->frames));
+    if (!batch->arena || !batch->iov || !batch->gather || !batch->msgs || !batch->frames)
+    {
+        modbus_batch_free(batch);
+        return -3;
+    }
+
+    batch->arena_size = arena_size;
+    batch->capacity = capacity;
+    return 0;
+}
+
+/**
+ * @brief Release a batch.
+ *
+ * @param batch Batch
+ */
+void modbus_batch_free(modbus_batch_st *batch)
+{
+    if (!batch)
+    {
+        return;
+    }
+
+    free(batch->arena);
+    free(batch->iov);
+    free(batch->gather);
+    free(batch->msgs);
+    free(batch->frames);
+    free(batch->traces);
+    memset(batch, 0, sizeof(*batch));
+}
+
+/**
+ * @brief Drop all frames, keeping the storage.
+ *
+ * @param batch Batch
+ */
+void modbus_batch_reset(modbus_batch_st *batch)
+{
+    if (!batch)
+    {
+        return;
+    }
+
+    batch->arena_used = 0;
+    batch->count = 0;
+    batch->answered = 0;
+    batch->cursor = 0;
+}
+
+/**
+ * @brief Trace every answered frame into a ring.
+ *
+ * @param batch Batch
+ * @param ring Ring of the calling thread (NULL = stop tracing)
+ * @return 0 on success, or a negative error code
+ */
+int modbus_batch_trace(modbus_batch_st *batch, modbus_trace_ring_st *ring)
+{
+    if (!batch || !batch->frames)
+    {
+        return -1;
+    }
+
+    // The records stay allocated when tracing stops, for the next time it starts
+    if (ring && !batch->traces)
+    {
+        batch->traces = calloc(batch->capacity, sizeof(*batch->traces));
+        if (!batch->traces)
+        {
+            return -3;
+        }
+    }
+
+    // Frames added untraced have no encode time: give them none at all
+    for (uint32_t i = 0; ring && (batch->trace != ring) && (i < batch->count); i++)
+    {
+        memset(&batch->traces[i], 0, sizeof(batch->traces[i]));
+    }
+    batch->trace = ring;
+    return 0;
+}
+
+/**
+ * @brief Stamp the bytes about to be passed to modbus_batch_decode().
+ *
+ * @param batch Batch
+ * @param msg Header returned by the read call (NULL = none)
+ * @param read_ns Time the read call returned
+ */
+void modbus_batch_trace_rx(modbus_batch_st *batch, const struct msghdr *msg, uint64_t read_ns)
+{
+    if (!batch || !batch->trace)
+    {
+        return;
+    }
+
+    batch->received_ns = modbus_trace_rx_timestamp(msg);
+    batch->read_ns = read_ns;
+}
+
+/**
+ * @brief Encode a request around any PDU.
+ *
+ * @param batch Batch
+ * @param ctx Master context of the device
+ * @param unit_id Unit identifier
+ * @param pdu Request PDU
+ * @param pdu_len Length of the request PDU
+ * @param regs Destination of the registers read
+ * @param regs_len Capacity of regs
+ * @return Index of the frame, or a negative error code
+ */
+int modbus_batch_add_request(modbus_batch_st *batch, modbus_tcp_master_ctx_st *ctx, uint8_t unit_id,
+                             const uint8_t *pdu, size_t pdu_len, uint16_t *regs, uint16_t regs_len)
+{
+    if (!batch || !ctx || !pdu || (pdu_len == 0) || (pdu_len > MODBUS_MAX_PDU_SIZE) || (!regs && (regs_len > 0)))
+    {
+        return -1;
+    }
+
+    size_t room = batch->arena_size - batch->arena_used;
+    if ((batch->count == batch->capacity) || (room < MODBUS_MBAP_HEADER_SIZE + pdu_len))
+    {
+        return -2;
+    }
+
+    uint16_t tid = 0;
+    uint8_t *frame = batch->arena + batch->arena_used;
+    uint16_t len = encode_tcp_request(ctx, unit_id, pdu, pdu_len, frame, room, &tid);
+    if (len == 0)
+    {
+        return -3;
+    }
+
+    uint32_t index = batch->count++;
+    batch->frames[index] = (modbus_batch_frame_st){
+        .ctx = ctx,
+        .transaction_id = tid,
+        .regs = regs,
+        .regs_len = regs_len,
+    };
+    batch->iov[index].iov_base = frame;
+    batch->iov[index].iov_len = len;
+    batch->arena_used += len;
+
+    if (batch->trace)
+    {
+        batch->traces[index] = (modbus_trace_record_st){
+            .ns[MODBUS_TRACE_ENCODED] = modbus_trace_now_ns(),
+            .transaction_id = tid,
+            .unit_id = unit_id,
+            .function_code = pdu[0],
+        };
+    }
+    return (int)index;
+}
+
+/**
+ * @brief Encode a Read Holding Registers request.
+ *
+ * @param batch Batch
+ * @param ctx Master context of the device
+ * @param unit_id Unit identifier
+ * @param addr First register address
+ * @param qty Number of registers
+ * @param regs Destination of the registers
+ * @return Index of the frame, or a negative error code
+ */
+int modbus_batch_add_read(modbus_batch_st *batch, modbus_tcp_master_ctx_st *ctx, uint8_t unit_id, uint16_t addr,
+                          uint16_t qty, uint16_t *regs)
+{
+    uint8_t pdu[5];
+
+    if (!regs || (modbus_pdu_encode_read(MODBUS_READ_HOLDING_REG, addr, qty, pdu, sizeof(pdu)) == 0))
+    {
+        return -1;
+    }
+    return modbus_batch_add_request(batch, ctx, unit_id, pdu, sizeof(pdu), regs, qty);
+}
+
+/**
+ * @brief Send the frames of one context on a stream socket.
+ *
+ * @param batch Batch
+ * @param fd Connected socket
+ * @param ctx Context whose frames are sent (NULL = every frame)
+ * @return Number of bytes sent, or -1 on error
+ */
+ssize_t modbus_batch_writev(modbus_batch_st *batch, int fd, const modbus_tcp_master_ctx_st *ctx)
+{
+    if (!batch || (fd < 0))
+    {
+        return -1;
+    }
+
+    // Gather the frames, merging those that follow each other in the arena
+    struct iovec *v = batch->gather;
+    size_t segments = 0;
+    ssize_t total = 0;
+    for (uint32_t i = 0; i < batch->count; i++)
+    {
+        if (ctx && (batch->frames[i].ctx != ctx))
+        {
+            continue;
+        }
+        const struct iovec *frame = &batch->iov[i];
+        if ((segments > 0) && ((uint8_t *)v[segments - 1].iov_base + v[segments - 1].iov_len == frame->iov_base))
+        {
+            v[segments - 1].iov_len += frame->iov_len;
+        }
+        else
+        {
+            v[segments++] = *frame;
+        }
+        total += (ssize_t)frame->iov_len;
+    }
+
+    while (segments > 0)
+    {
+        ssize_t n = writev(fd, v, (segments < IOV_MAX) ? (int)segments : IOV_MAX);
+        if (n < 0)
+        {
+            if (errno == EAGAIN)
+            {
+                wait_writable(fd);
+            }
+            else if (errno != EINTR)
+            {
+                return -1;
+            }
+            continue;
+        }
+
+        // Skip what was written, cutting into a segment the kernel took in part
+        size_t written = (size_t)n;
+        while ((segments > 0) && (written >= v->iov_len))
+        {
+            written -= v->iov_len;
+            v++;
+            segments--;
+        }
+        if (written > 0)
+        {
+            v->iov_base = (uint8_t *)v->iov_base + written;
+            v->iov_len -= written;
+        }
+    }
+    trace_sent(batch, 0, batch->count, ctx);
+    return total;
+}
+
+/**
+ * @brief Send every frame as one datagram.
+ *
+ * @param batch Batch
+ * @param fd Datagram socket
+ * @param dests Destination of each frame (NULL for a connected socket)
+ * @param dest_len Size of each destination address
+ * @return Number of frames sent, or -1 on error
+ */
+int modbus_batch_sendmmsg(modbus_batch_st *batch, int fd, const struct sockaddr *const *dests, socklen_t dest_len)
+{
+    if (!batch || (fd < 0))
+    {
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < batch->count; i++)
+    {
+        struct msghdr *h = &batch->msgs[i].msg_hdr;
+        memset(h, 0, sizeof(*h));
+        h->msg_name = dests ? (void *)dests[i] : NULL;
+        h->msg_namelen = dests ? dest_len : 0;
+        h->msg_iov = &batch->iov[i];
+        h->msg_iovlen = 1;
+    }
+
+    uint32_t sent = 0;
+    while (sent < batch->count)
+    {
+        uint32_t chunk = batch->count - sent;
+        int n = sendmmsg(fd, batch->msgs + sent, (chunk < IOV_MAX) ? chunk : IOV_MAX, 0);
+        if (n < 0)
+        {
+            if (errno == EAGAIN)
+            {
+                wait_writable(fd);
+            }
+            else if (errno != EINTR)
+            {
+                return -1;
+            }
+            continue;
+        }
+        trace_sent(batch, sent, (uint32_t)n, NULL);
+        sent += (uint32_t)n;
+    }
+    return (int)sent;
+}
+
+/**
+ * @brief Validate every complete response in a buffer.
+ *
+ * @param batch Batch
+ * @param ctx Master context the responses belong to
+ * @param buffer Received bytes
+ * @param len Number of bytes
+ * @param consumed Output: bytes used (may be NULL)
+ * @return Number of responses matched to a frame, or -1 on invalid arguments
+ */
+int modbus_batch_decode(modbus_batch_st *batch, modbus_tcp_master_ctx_st *ctx, const uint8_t *buffer, size_t len,
+                        size_t *consumed)
+{
+    if (!batch || !ctx || (!buffer && (len > 0)))
+    {
+        return -1;
+    }
+
+    size_t off = 0;
+    int matched = 0;
+    while (off < len)
+    {
+        uint16_t tid = 0;
+        int adu_len = decode_mbap_header(buffer + off, len - off, &tid, NULL, NULL);
+        if ((adu_len == -2) || ((adu_len > 0) && ((size_t)adu_len > len - off)))
+        {
+            break;
+        }
+        if (adu_len < 0)
+        {
+            // The stream lost its framing; nothing after this point can be trusted
+            off = len;
+            break;
+        }
+
+        // -2: the context has no such request for this unit, so the frame stays open
+        int index = find_frame(batch, ctx, tid);
+        if (index >= 0)
+        {
+            modbus_batch_frame_st *f = &batch->frames[index];
+            int status = decode_tcp_response(ctx, buffer + off, (size_t)adu_len, f->regs, f->regs_len, NULL);
+            if (status != -2)
+            {
+                f->status = status;
+                f->answered = true;
+                batch->answered++;
+                matched++;
+                if (batch->trace)
+                {
+                    modbus_trace_record_st *t = &batch->traces[index];
+                    t->ns[MODBUS_TRACE_RECEIVED] = batch->received_ns;
+                    t->ns[MODBUS_TRACE_READ] = batch->read_ns;
+                    t->ns[MODBUS_TRACE_DECODED] = modbus_trace_now_ns();
+                    t->status = status;
+                    modbus_trace_record(batch->trace, t);
+                }
+            }
+        }
+        off += (size_t)adu_len;
+    }
+
+    if (consumed)
+    {
+        *consumed = off;
+    }
+    return matched;
+}
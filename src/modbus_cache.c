@@ -0,0 +1,259 @@
+/**
+ * @file modbus_cache.c
+ * @brief Cache of encoded Read Holding Registers responses.
+ *
+ * An entry records the bank generations before its frame is encoded. The
+ * encoder takes its own snapshot, which can only be newer; if the recorded
+ * generations are still live at lookup, no write happened since they were
+ * sampled, so the snapshot and the live registers are the same.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "modbus_cache.h"
+#include "modbus_utils.h"
+
+/** @brief RTU Read Holding Registers request without its CRC */
+#define REQUEST_SIZE 6
+
+/** @brief 2^64 / golden ratio, for Fibonacci hashing of the key */
+#define HASH_MULTIPLIER 0x9E3779B97F4A7C15ull
+
+/**
+ * @brief Pack a request into a key. qty >= 1 keeps it non-zero.
+ */
+static inline uint64_t make_key(uint8_t slave_id, uint16_t start_addr, uint16_t qty)
+{
+    return ((uint64_t)slave_id << 32) | ((uint64_t)start_addr << 16) | qty;
+}
+
+/**
+ * @brief Slot a key maps to.
+ */
+static inline modbus_cache_entry_st *slot_for(const modbus_cache_st *cache, uint64_t key)
+{
+    return &cache->entries[(uint32_t)((key * HASH_MULTIPLIER) >> 32) & cache->mask];
+}
+
+/**
+ * @brief Check that no writer touched the entry's registers since it was encoded.
+ */
+static bool entry_current(const modbus_cache_st *cache, const modbus_cache_entry_st *entry, uint16_t start_addr,
+                          uint16_t qty)
+{
+    uint32_t gens[MODBUS_BANK_MAX_READ_SEGMENTS];
+    int n = modbus_bank_generations(cache->bank, start_addr, qty, gens);
+    return (n > 0) && (memcmp(gens, entry->gens, (size_t)n * sizeof(gens[0])) == 0);
+}
+
+/**
+ * @brief Encode a fresh frame into a slot.
+ */
+static uint16_t entry_fill(const modbus_cache_st *cache, modbus_cache_entry_st *entry, uint64_t key,
+                           uint8_t slave_id, uint16_t start_addr, uint16_t qty)
+{
+    static const modbus_slave_ctx_st ctx = {0};
+
+    entry->key = 0;
+    if (modbus_bank_generations(cache->bank, start_addr, qty, entry->gens) < 0)
+    {
+        return 0;
+    }
+
+    uint16_t len = modbus_bank_encode_read_response(cache->bank, &ctx, slave_id, start_addr, qty, entry->frame,
+                                                    sizeof(entry->frame));
+    if (len == 0)
+    {
+        return 0;
+    }
+
+    // The request CRC lets modbus_cache_respond() match raw frames without decoding them
+    uint8_t request[REQUEST_SIZE] = {
+        slave_id, MODBUS_READ_HOLDING_REG,
+        (uint8_t)(start_addr >> 8), (uint8_t)start_addr,
+        (uint8_t)(qty >> 8), (uint8_t)qty,
+    };
+    entry->request_crc = modbus_crc16(request, sizeof(request));
+    entry->len = len;
+    entry->key = key;
+    return len;
+}
+
+/**
+ * @brief Allocate a cache within a memory budget.
+ *
+ * @param cache Cache to initialize
+ * @param bank Register source (must outlive the cache)
+ * @param max_bytes Upper bound on the memory used by the slots
+ * @return 0 on success, or a negative error code:
+ *         -1: Invalid input pointers
+ *         -2: Budget smaller than one slot
+ *         -3: Out of memory
+ */
+int modbus_cache_init(modbus_cache_st *cache, const modbus_bank_st *bank, size_t max_bytes)
+{
+    if (!cache || !bank)
+    {
+        return -1;
+    }
+
+    memset(cache, 0, sizeof(*cache));
+
+    size_t slots = max_bytes / sizeof(modbus_cache_entry_st);
+    if (slots == 0)
+    {
+        return -2;
+    }
+
+    uint32_t capacity = 1;
+    while ((capacity * 2u <= slots) && (capacity < MODBUS_CACHE_MAX_SLOTS))
+    {
+        capacity *= 2;
+    }
+
+    cache->entries = calloc(capacity, sizeof(*cache->entries));
+    if (!cache->entries)
+    {
+        return -3;
+    }
+
+    cache->bank = bank;
+    cache->capacity = capacity;
+    cache->mask = capacity - 1;
+    return 0;
+}
+
+/**
+ * @brief Release the slots.
+ *
+ * @param cache Cache
+ */
+void modbus_cache_deinit(modbus_cache_st *cache)
+{
+    if (!cache)
+    {
+        return;
+    }
+
+    free(cache->entries);
+    cache->entries = NULL;
+    cache->capacity = 0;
+    cache->mask = 0;
+}
+
+/**
+ * @brief Drop every stored frame. Counters are kept.
+ *
+ * @param cache Cache
+ */
+void modbus_cache_clear(modbus_cache_st *cache)
+{
+    if (!cache || !cache->entries)
+    {
+        return;
+    }
+
+    for (uint32_t i = 0; i < cache->capacity; i++)
+    {
+        cache->entries[i].key = 0;
+    }
+}
+
+/**
+ * @brief Get the response for an already decoded request.
+ *
+ * @param cache Cache
+ * @param slave_id Modbus slave ID (0..247)
+ * @param start_addr First register address
+ * @param qty Number of registers (1..MODBUS_MAX_REGS)
+ * @param frame Output: the encoded RTU response, valid until the next call on this cache
+ * @return Length of the response in bytes, or 0 on failure
+ */
+uint16_t modbus_cache_get(modbus_cache_st *cache, uint8_t slave_id, uint16_t start_addr, uint16_t qty,
+                          const uint8_t **frame)
+{
+    if (!cache || !cache->entries || !frame)
+    {
+        return 0;
+    }
+
+    if (!is_valid_slave_id(slave_id) || !is_valid_quantity(qty) || !is_valid_address_range(start_addr, qty))
+    {
+        return 0;
+    }
+
+    uint64_t key = make_key(slave_id, start_addr, qty);
+    modbus_cache_entry_st *entry = slot_for(cache, key);
+
+    if (entry->key == key)
+    {
+        if (entry_current(cache, entry, start_addr, qty))
+        {
+            cache->stats.hits++;
+            *frame = entry->frame;
+            return entry->len;
+        }
+        cache->stats.stale++;
+    }
+    else if (entry->key != 0)
+    {
+        cache->stats.evictions++;
+    }
+    cache->stats.misses++;
+
+    uint16_t len = entry_fill(cache, entry, key, slave_id, start_addr, qty);
+    *frame = entry->frame;
+    return len;
+}
+
+/**
+ * @brief Answer a raw RTU Read Holding Registers request.
+ *
+ * @param cache Cache
+ * @param ctx Slave context holding the device slave ID
+ * @param request Incoming RTU request frame
+ * @param len Length of the request in bytes
+ * @param frame Output: the encoded RTU response, valid until the next call on this cache
+ * @return Length of the response in bytes, or 0 if the request is rejected or broadcast
+ */
+uint16_t modbus_cache_respond(modbus_cache_st *cache, const modbus_slave_ctx_st *ctx, const uint8_t *request,
+                              size_t len, const uint8_t **frame)
+{
+    if (!cache || !cache->entries || !ctx || !request || !frame)
+    {
+        return 0;
+    }
+
+    // A broadcast is never answered
+    if ((len > 0) && (request[0] == BROADCAST_SLAVE_ID))
+    {
+        return 0;
+    }
+
+    // Hit path: the bytes match a request that already passed decode_read_request()
+    if ((len >= REQUEST_SIZE + 2) && (request[1] == MODBUS_READ_HOLDING_REG) && (request[0] == ctx->device_slave_id))
+    {
+        uint16_t start_addr = (uint16_t)((request[2] << 8) | request[3]);
+        uint16_t qty = (uint16_t)((request[4] << 8) | request[5]);
+        uint16_t crc = (uint16_t)(request[6] | (request[7] << 8));
+        const modbus_cache_entry_st *entry = slot_for(cache, make_key(request[0], start_addr, qty));
+
+        if ((entry->key == make_key(request[0], start_addr, qty)) && (entry->request_crc == crc) &&
+            entry_current(cache, entry, start_addr, qty))
+        {
+            cache->stats.hits++;
+            *frame = entry->frame;
+            return entry->len;
+        }
+    }
+
+    uint8_t slave_id;
+    uint16_t start_addr;
+    uint16_t qty;
+    if (decode_read_request(ctx, request, len, &slave_id, &start_addr, &qty) != 0)
+    {
+        return 0;
+    }
+
+    return modbus_cache_get(cache, slave_id, start_addr, qty, frame);
+}
@@ -0,0 +1,349 @@
+/**
+ * @file modbus_cov.c
+ * @brief Change-of-value and deadband detection on decoded register blocks.
+ *
+ * Every engine computes the same test per register: the absolute
+ * difference between the new and the published value, taken with two
+ * saturating subtractions, must exceed the deadband. Signed blocks flip
+ * the sign bit of both operands first, which maps int16_t order onto
+ * uint16_t order without changing any difference. The vector engines only
+ * produce the change bitmap; publishing walks its set bits, so a scan
+ * with few changes costs little more than the compare.
+ */
+#include <stdatomic.h>
+#include <string.h>
+
+#include "modbus_cov.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define MODBUS_COV_HAVE_X86 1
+#else
+#define MODBUS_COV_HAVE_X86 0
+#endif
+
+#if defined(__aarch64__) && defined(__ARM_NEON)
+#include <arm_neon.h>
+#define MODBUS_COV_HAVE_NEON 1
+#else
+#define MODBUS_COV_HAVE_NEON 0
+#endif
+
+/** @brief XORed into both operands of a signed block */
+#define COV_SIGN_FLIP 0x8000u
+
+typedef void (*cov_kernel_ft)(const uint16_t *published, const uint16_t *regs, const uint16_t *deadband,
+                              uint16_t flip, size_t qty, uint64_t *bitmap);
+
+static atomic_int selected_engine = MODBUS_COV_ENGINE_AUTO;
+
+/**
+ * @brief Set the bits of registers first..qty-1 that moved past their deadband.
+ */
+static void cov_scalar_from(const uint16_t *published, const uint16_t *regs, const uint16_t *deadband, uint16_t flip,
+                            size_t first, size_t qty, uint64_t *bitmap)
+{
+    for (size_t i = first; i < qty; i++)
+    {
+        uint16_t a = regs[i] ^ flip;
+        uint16_t b = published[i] ^ flip;
+        uint16_t diff = (a > b) ? (uint16_t)(a - b) : (uint16_t)(b - a);
+        if (diff > deadband[i])
+        {
+            bitmap[i >> 6] |= 1ull << (i & 63);
+        }
+    }
+}
+
+static void cov_scalar(const uint16_t *published, const uint16_t *regs, const uint16_t *deadband, uint16_t flip,
+                       size_t qty, uint64_t *bitmap)
+{
+    cov_scalar_from(published, regs, deadband, flip, 0, qty, bitmap);
+}
+
+#if MODBUS_COV_HAVE_X86
+/**
+ * @brief SSE2 kernel: 8 registers per compare.
+ */
+__attribute__((target("sse2"))) static void cov_sse2(const uint16_t *published, const uint16_t *regs,
+                                                     const uint16_t *deadband, uint16_t flip, size_t qty,
+                                                     uint64_t *bitmap)
+{
+    const __m128i sign = _mm_set1_epi16((short)flip);
+    const __m128i zero = _mm_setzero_si128();
+    size_t i = 0;
+
+    for (; i + 8 <= qty; i += 8)
+    {
+        __m128i a = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(regs + i)), sign);
+        __m128i b = _mm_xor_si128(_mm_loadu_si128((const __m128i *)(published + i)), sign);
+        __m128i diff = _mm_or_si128(_mm_subs_epu16(a, b), _mm_subs_epu16(b, a));
+        __m128i over = _mm_subs_epu16(diff, _mm_loadu_si128((const __m128i *)(deadband + i)));
+
+        // One byte per register, then one bit per byte
+        __m128i same = _mm_packs_epi16(_mm_cmpeq_epi16(over, zero), zero);
+        uint64_t bits = ~(uint32_t)_mm_movemask_epi8(same) & 0xFFu;
+        bitmap[i >> 6] |= bits << (i & 63);
+    }
+    cov_scalar_from(published, regs, deadband, flip, i, qty, bitmap);
+}
+
+/**
+ * @brief AVX2 kernel: 16 registers per compare.
+ */
+__attribute__((target("avx2"))) static void cov_avx2(const uint16_t *published, const uint16_t *regs,
+                                                     const uint16_t *deadband, uint16_t flip, size_t qty,
+                                                     uint64_t *bitmap)
+{
+    const __m256i sign = _mm256_set1_epi16((short)flip);
+    const __m256i zero = _mm256_setzero_si256();
+    size_t i = 0;
+
+    for (; i + 16 <= qty; i += 16)
+    {
+        __m256i a = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(regs + i)), sign);
+        __m256i b = _mm256_xor_si256(_mm256_loadu_si256((const __m256i *)(published + i)), sign);
+        __m256i diff = _mm256_or_si256(_mm256_subs_epu16(a, b), _mm256_subs_epu16(b, a));
+        __m256i over = _mm256_subs_epu16(diff, _mm256_loadu_si256((const __m256i *)(deadband + i)));
+
+        // The pack works per 128-bit lane: registers 0..7 land in mask bits 0..7, 8..15 in bits 16..23
+        uint32_t mask = (uint32_t)_mm256_movemask_epi8(_mm256_packs_epi16(_mm256_cmpeq_epi16(over, zero), zero));
+        uint64_t bits = ~((mask & 0xFFu) | ((mask >> 8) & 0xFF00u)) & 0xFFFFu;
+        bitmap[i >> 6] |= bits << (i & 63);
+    }
+    // The tail is built without AVX: leave no dirty upper halves to it
+    _mm256_zeroupper();
+    cov_scalar_from(published, regs, deadband, flip, i, qty, bitmap);
+}
+#endif
+
+#if MODBUS_COV_HAVE_NEON
+/**
+ * @brief NEON kernel: 8 registers per compare.
+ */
+static void cov_neon(const uint16_t *published, const uint16_t *regs, const uint16_t *deadband, uint16_t flip,
+                     size_t qty, uint64_t *bitmap)
+{
+    static const uint16_t lane_bits[8] = {1, 2, 4, 8, 16, 32, 64, 128};
+    const uint16x8_t weights = vld1q_u16(lane_bits);
+    const uint16x8_t sign = vdupq_n_u16(flip);
+    size_t i = 0;
+
+    for (; i + 8 <= qty; i += 8)
+    {
+        uint16x8_t a = veorq_u16(vld1q_u16(regs + i), sign);
+        uint16x8_t b = veorq_u16(vld1q_u16(published + i), sign);
+        uint16x8_t changed = vcgtq_u16(vabdq_u16(a, b), vld1q_u16(deadband + i));
+        uint64_t bits = vaddvq_u16(vandq_u16(changed, weights));
+        bitmap[i >> 6] |= bits << (i & 63);
+    }
+    cov_scalar_from(published, regs, deadband, flip, i, qty, bitmap);
+}
+#endif
+
+/**
+ * @brief Resolve the selected engine to a kernel.
+ */
+static cov_kernel_ft cov_kernel(void)
+{
+    switch (modbus_cov_get_engine())
+    {
+    case MODBUS_COV_ENGINE_SCALAR:
+        return cov_scalar;
+#if MODBUS_COV_HAVE_X86
+    case MODBUS_COV_ENGINE_SSE2:
+        return cov_sse2;
+    case MODBUS_COV_ENGINE_AVX2:
+        return cov_avx2;
+#endif
+#if MODBUS_COV_HAVE_NEON
+    case MODBUS_COV_ENGINE_NEON:
+        return cov_neon;
+#endif
+    default:
+        break;
+    }
+
+#if MODBUS_COV_HAVE_X86
+    if (modbus_cov_engine_supported(MODBUS_COV_ENGINE_AVX2))
+    {
+        return cov_avx2;
+    }
+    if (modbus_cov_engine_supported(MODBUS_COV_ENGINE_SSE2))
+    {
+        return cov_sse2;
+    }
+#endif
+#if MODBUS_COV_HAVE_NEON
+    return cov_neon;
+#else
+    return cov_scalar;
+#endif
+}
+
+/**
+ * @brief Check whether an engine can run on this build and CPU.
+ *
+ * @param engine Engine to check
+ * @return true if the engine can be selected
+ */
+bool modbus_cov_engine_supported(modbus_cov_engine_et engine)
+{
+    switch (engine)
+    {
+    case MODBUS_COV_ENGINE_AUTO:
+    case MODBUS_COV_ENGINE_SCALAR:
+        return true;
+#if MODBUS_COV_HAVE_X86
+    case MODBUS_COV_ENGINE_SSE2:
+        return __builtin_cpu_supports("sse2");
+    case MODBUS_COV_ENGINE_AVX2:
+        return __builtin_cpu_supports("avx2");
+#endif
+#if MODBUS_COV_HAVE_NEON
+    case MODBUS_COV_ENGINE_NEON:
+        return true;
+#endif
+    default:
+        return false;
+    }
+}
+
+/**
+ * @brief Get a short printable name for an engine.
+ *
+ * @param engine Engine
+ * @return Static string, "unknown" for invalid values
+ */
+const char *modbus_cov_engine_name(modbus_cov_engine_et engine)
+{
+    switch (engine)
+    {
+    case MODBUS_COV_ENGINE_AUTO:
+        return "auto";
+    case MODBUS_COV_ENGINE_SCALAR:
+        return "scalar";
+    case MODBUS_COV_ENGINE_SSE2:
+        return "sse2";
+    case MODBUS_COV_ENGINE_AVX2:
+        return "avx2";
+    case MODBUS_COV_ENGINE_NEON:
+        return "neon";
+    default:
+        return "unknown";
+    }
+}
+
+/**
+ * @brief Select the comparison engine.
+ *
+ * @param engine Engine to use
+ * @return 0 on success, -1 if the engine is unknown or not supported by this CPU
+ */
+int modbus_cov_set_engine(modbus_cov_engine_et engine)
+{
+    if (!modbus_cov_engine_supported(engine))
+    {
+        return -1;
+    }
+    atomic_store_explicit(&selected_engine, (int)engine, memory_order_relaxed);
+    return 0;
+}
+
+/**
+ * @brief Get the currently selected comparison engine.
+ *
+ * @return Selected engine (MODBUS_COV_ENGINE_AUTO by default)
+ */
+modbus_cov_engine_et modbus_cov_get_engine(void)
+{
+    return (modbus_cov_engine_et)atomic_load_explicit(&selected_engine, memory_order_relaxed);
+}
+
+/**
+ * @brief Initialize a block with no published values yet.
+ *
+ * @param block Block to initialize
+ * @param start_addr Address of the first register
+ * @param qty Number of registers
+ * @param deadband Absolute deadband of each register (NULL = report any change)
+ * @param is_signed Compare registers as int16_t
+ * @return 0 on success, or -1 on invalid arguments
+ */
+int modbus_cov_init(modbus_cov_block_st *block, uint16_t start_addr, uint16_t qty, const uint16_t *deadband,
+                    bool is_signed)
+{
+    if (!block || (qty == 0) || (qty > MODBUS_MAX_REGS))
+    {
+        return -1;
+    }
+
+    memset(block, 0, sizeof(*block));
+    block->start_addr = start_addr;
+    block->qty = qty;
+    block->is_signed = is_signed;
+    if (deadband)
+    {
+        memcpy(block->deadband, deadband, qty * sizeof(uint16_t));
+    }
+    return 0;
+}
+
+/**
+ * @brief Compare a scan with the published values and publish what changed.
+ *
+ * @param block Block
+ * @param regs New values, qty entries
+ * @param changes Output: changed registers
+ * @return Number of changed registers, or -1 on invalid arguments
+ */
+int modbus_cov_update(modbus_cov_block_st *block, const uint16_t *regs, modbus_cov_changes_st *changes)
+{
+    if (!block || !regs || !changes || (block->qty == 0) || (block->qty > MODBUS_MAX_REGS))
+    {
+        return -1;
+    }
+
+    memset(changes->bitmap, 0, sizeof(changes->bitmap));
+    if (block->primed)
+    {
+        cov_kernel()(block->published, regs, block->deadband, block->is_signed ? COV_SIGN_FLIP : 0, block->qty,
+                     changes->bitmap);
+    }
+    else
+    {
+        for (size_t w = 0; w * 64 < block->qty; w++)
+        {
+            size_t left = block->qty - w * 64;
+            changes->bitmap[w] = (left >= 64) ? ~0ull : ((1ull << left) - 1);
+        }
+        block->primed = true;
+    }
+
+    // Only the changed registers are touched from here on
+    uint16_t count = 0;
+    for (size_t w = 0; w < MODBUS_COV_BITMAP_WORDS; w++)
+    {
+        for (uint64_t word = changes->bitmap[w]; word; word &= word - 1)
+        {
+            size_t i = w * 64 + (size_t)__builtin_ctzll(word);
+            changes->index[count++] = (uint8_t)i;
+            block->published[i] = regs[i];
+        }
+    }
+    changes->count = count;
+    return count;
+}
+
+/**
+ * @brief Forget the published values: the next scan reports every register.
+ *
+ * @param block Block
+ */
+void modbus_cov_reset(modbus_cov_block_st *block)
+{
+    if (block)
+    {
+        block->primed = false;
+    }
+}
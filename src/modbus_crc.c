@@ -0,0 +1,520 @@
+/**
+ * @file modbus_crc.c
+ * @brief Modbus RTU CRC16 engines: bitwise, byte table, slicing-by-8/16 and
+ *        PCLMULQDQ folding, selected at runtime.
+ *
+ * Every engine updates a raw CRC register so they can be chained freely:
+ * feeding a buffer in several pieces yields the same result as feeding it
+ * at once, whatever engines are used for the pieces.
+ */
+#include <stdatomic.h>
+
+#include "modbus_crc.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define MODBUS_CRC16_HAVE_CLMUL 1
+#else
+#define MODBUS_CRC16_HAVE_CLMUL 0
+#endif
+
+/** @brief Reflected Modbus polynomial (x^16 + x^15 + x^2 + 1) */
+#define CRC16_POLY_REFLECTED 0xA001
+
+/** @brief Minimum buffer length for which AUTO prefers the CLMUL engine */
+#define CRC16_AUTO_CLMUL_MIN 64
+
+/** @brief Byte table: CRC register contribution of one byte */
+static const uint16_t crc16_table[256] = {
+    0x0000, 0xC0C1, 0xC181, 0x0140, 0xC301, 0x03C0, 0x0280, 0xC241,
+    0xC601, 0x06C0, 0x0780, 0xC741, 0x0500, 0xC5C1, 0xC481, 0x0440,
+    0xCC01, 0x0CC0, 0x0D80, 0xCD41, 0x0F00, 0xCFC1, 0xCE81, 0x0E40,
+    0x0A00, 0xCAC1, 0xCB81, 0x0B40, 0xC901, 0x09C0, 0x0880, 0xC841,
+    0xD801, 0x18C0, 0x1980, 0xD941, 0x1B00, 0xDBC1, 0xDA81, 0x1A40,
+    0x1E00, 0xDEC1, 0xDF81, 0x1F40, 0xDD01, 0x1DC0, 0x1C80, 0xDC41,
+    0x1400, 0xD4C1, 0xD581, 0x1540, 0xD701, 0x17C0, 0x1680, 0xD641,
+    0xD201, 0x12C0, 0x1380, 0xD341, 0x1100, 0xD1C1, 0xD081, 0x1040,
+    0xF001, 0x30C0, 0x3180, 0xF141, 0x3300, 0xF3C1, 0xF281, 0x3240,
+    0x3600, 0xF6C1, 0xF781, 0x3740, 0xF501, 0x35C0, 0x3480, 0xF441,
+    0x3C00, 0xFCC1, 0xFD81, 0x3D40, 0xFF01, 0x3FC0, 0x3E80, 0xFE41,
+    0xFA01, 0x3AC0, 0x3B80, 0xFB41, 0x3900, 0xF9C1, 0xF881, 0x3840,
+    0x2800, 0xE8C1, 0xE981, 0x2940, 0xEB01, 0x2BC0, 0x2A80, 0xEA41,
+    0xEE01, 0x2EC0, 0x2F80, 0xEF41, 0x2D00, 0xEDC1, 0xEC81, 0x2C40,
+    0xE401, 0x24C0, 0x2580, 0xE541, 0x2700, 0xE7C1, 0xE681, 0x2640,
+    0x2200, 0xE2C1, 0xE381, 0x2340, 0xE101, 0x21C0, 0x2080, 0xE041,
+    0xA001, 0x60C0, 0x6180, 0xA141, 0x6300, 0xA3C1, 0xA281, 0x6240,
+    0x6600, 0xA6C1, 0xA781, 0x6740, 0xA501, 0x65C0, 0x6480, 0xA441,
+    0x6C00, 0xACC1, 0xAD81, 0x6D40, 0xAF01, 0x6FC0, 0x6E80, 0xAE41,
+    0xAA01, 0x6AC0, 0x6B80, 0xAB41, 0x6900, 0xA9C1, 0xA881, 0x6840,
+    0x7800, 0xB8C1, 0xB981, 0x7940, 0xBB01, 0x7BC0, 0x7A80, 0xBA41,
+    0xBE01, 0x7EC0, 0x7F80, 0xBF41, 0x7D00, 0xBDC1, 0xBC81, 0x7C40,
+    0xB401, 0x74C0, 0x7580, 0xB541, 0x7700, 0xB7C1, 0xB681, 0x7640,
+    0x7200, 0xB2C1, 0xB381, 0x7340, 0xB101, 0x71C0, 0x7080, 0xB041,
+    0x5000, 0x90C1, 0x9181, 0x5140, 0x9301, 0x53C0, 0x5280, 0x9241,
+    0x9601, 0x56C0, 0x5780, 0x9741, 0x5500, 0x95C1, 0x9481, 0x5440,
+    0x9C01, 0x5CC0, 0x5D80, 0x9D41, 0x5F00, 0x9FC1, 0x9E81, 0x5E40,
+    0x5A00, 0x9AC1, 0x9B81, 0x5B40, 0x9901, 0x59C0, 0x5880, 0x9841,
+    0x8801, 0x48C0, 0x4980, 0x8941, 0x4B00, 0x8BC1, 0x8A81, 0x4A40,
+    0x4E00, 0x8EC1, 0x8F81, 0x4F40, 0x8D01, 0x4DC0, 0x4C80, 0x8C41,
+    0x4400, 0x84C1, 0x8581, 0x4540, 0x8701, 0x47C0, 0x4680, 0x8641,
+    0x8201, 0x42C0, 0x4380, 0x8341, 0x4100, 0x81C1, 0x8081, 0x4040,
+};
+
+/**
+ * @brief Slicing tables: slice_table[k][n] is the CRC register contribution
+ *        of byte n followed by k zero bytes. Row 0 equals crc16_table.
+ */
+static uint16_t slice_table[16][256];
+
+/** @brief Slicing table state: 0 = empty, 1 = being built, 2 = ready */
+static atomic_int slice_table_state = 0;
+
+static atomic_int selected_engine = MODBUS_CRC16_ENGINE_AUTO;
+
+/**
+ * @brief Build the slicing tables exactly once, even with concurrent callers.
+ */
+static void slice_table_init(void)
+{
+    if (atomic_load_explicit(&slice_table_state, memory_order_acquire) == 2)
+    {
+        return;
+    }
+
+    int expected = 0;
+    if (!atomic_compare_exchange_strong(&slice_table_state, &expected, 1))
+    {
+        while (atomic_load_explicit(&slice_table_state, memory_order_acquire) != 2)
+        {
+        }
+        return;
+    }
+
+    for (int n = 0; n < 256; n++)
+    {
+        slice_table[0][n] = crc16_table[n];
+    }
+    for (int k = 1; k < 16; k++)
+    {
+        for (int n = 0; n < 256; n++)
+        {
+            uint16_t prev = slice_table[k - 1][n];
+            slice_table[k][n] = (prev >> 8) ^ crc16_table[prev & 0xFF];
+        }
+    }
+
+    atomic_store_explicit(&slice_table_state, 2, memory_order_release);
+}
+
+/**
+ * @brief Reference engine: eight shift/xor steps per byte.
+ */
+static uint16_t crc16_bitwise(uint16_t crc, const uint8_t *buf, size_t len)
+{
+    for (size_t pos = 0; pos < len; pos++)
+    {
+        crc ^= (uint16_t)buf[pos];
+        for (int i = 8; i != 0; i--)
+        {
+            if ((crc & 0x0001) != 0)
+            {
+                crc >>= 1;
+                crc ^= CRC16_POLY_REFLECTED;
+            }
+            else
+                crc >>= 1;
+        }
+    }
+    return crc;
+}
+
+/**
+ * @brief Byte table engine: one lookup per byte.
+ */
+static uint16_t crc16_bytewise(uint16_t crc, const uint8_t *buf, size_t len)
+{
+    while (len--)
+    {
+        crc = (crc >> 8) ^ crc16_table[(crc ^ *buf++) & 0xFF];
+    }
+    return crc;
+}
+
+/**
+ * @brief Slicing-by-8 engine: eight independent lookups per 8-byte step.
+ */
+static uint16_t crc16_slice8(uint16_t crc, const uint8_t *buf, size_t len)
+{
+    slice_table_init();
+
+    while (len >= 8)
+    {
+        crc ^= (uint16_t)(buf[0] | (buf[1] << 8));
+        crc = slice_table[7][crc & 0xFF] ^ slice_table[6][crc >> 8] ^
+              slice_table[5][buf[2]] ^ slice_table[4][buf[3]] ^
+              slice_table[3][buf[4]] ^ slice_table[2][buf[5]] ^
+              slice_table[1][buf[6]] ^ slice_table[0][buf[7]];
+        buf += 8;
+        len -= 8;
+    }
+    return crc16_bytewise(crc, buf, len);
+}
+
+/**
+ * @brief Slicing-by-16 engine: sixteen independent lookups per 16-byte step.
+ */
+static uint16_t crc16_slice16(uint16_t crc, const uint8_t *buf, size_t len)
+{
+    slice_table_init();
+
+    while (len >= 16)
+    {
+        crc ^= (uint16_t)(buf[0] | (buf[1] << 8));
+        crc = slice_table[15][crc & 0xFF] ^ slice_table[14][crc >> 8] ^
+              slice_table[13][buf[2]] ^ slice_table[12][buf[3]] ^
+              slice_table[11][buf[4]] ^ slice_table[10][buf[5]] ^
+              slice_table[9][buf[6]] ^ slice_table[8][buf[7]] ^
+              slice_table[7][buf[8]] ^ slice_table[6][buf[9]] ^
+              slice_table[5][buf[10]] ^ slice_table[4][buf[11]] ^
+              slice_table[3][buf[12]] ^ slice_table[2][buf[13]] ^
+              slice_table[1][buf[14]] ^ slice_table[0][buf[15]];
+        buf += 16;
+        len -= 16;
+    }
+    return crc16_slice8(crc, buf, len);
+}
+
+#if MODBUS_CRC16_HAVE_CLMUL
+/*
+ * Folding constants for the reflected domain. A 128-bit lane is moved D bits
+ * forward by multiplying its low qword by x^(D+63) mod P and its high qword by
+ * x^(D-1) mod P, both stored bit-reflected in the top 16 bits of a qword.
+ */
+#define CRC16_FOLD_128_LO 0xCCD0000000000000ULL
+#define CRC16_FOLD_128_HI 0xC100000000000000ULL
+#define CRC16_FOLD_256_LO 0xC991000000000000ULL
+#define CRC16_FOLD_256_HI 0x5001000000000000ULL
+#define CRC16_FOLD_384_LO 0xAAA4000000000000ULL
+#define CRC16_FOLD_384_HI 0xAC91000000000000ULL
+#define CRC16_FOLD_512_LO 0xC450000000000000ULL
+#define CRC16_FOLD_512_HI 0x8101000000000000ULL
+
+/**
+ * @brief Move a 128-bit lane forward by the distance encoded in @p k.
+ */
+__attribute__((target("pclmul,sse2"))) static inline __m128i crc16_fold(__m128i acc, __m128i k)
+{
+    return _mm_xor_si128(_mm_clmulepi64_si128(acc, k, 0x00),
+                         _mm_clmulepi64_si128(acc, k, 0x11));
+}
+
+/**
+ * @brief PCLMULQDQ engine: folds 64 bytes per step over four lanes, then
+ *        reduces the remaining 16-byte residue with the slicing engine.
+ */
+__attribute__((target("pclmul,sse2"))) static uint16_t crc16_clmul(uint16_t crc, const uint8_t *buf, size_t len)
+{
+    if (len < 32)
+    {
+        return crc16_slice16(crc, buf, len);
+    }
+
+    __m128i acc = _mm_xor_si128(_mm_loadu_si128((const __m128i *)buf), _mm_cvtsi32_si128(crc));
+    buf += 16;
+    len -= 16;
+
+    if (len >= 112)
+    {
+        const __m128i k512 = _mm_set_epi64x((long long)CRC16_FOLD_512_HI, (long long)CRC16_FOLD_512_LO);
+        __m128i acc1 = _mm_loadu_si128((const __m128i *)(buf + 0));
+        __m128i acc2 = _mm_loadu_si128((const __m128i *)(buf + 16));
+        __m128i acc3 = _mm_loadu_si128((const __m128i *)(buf + 32));
+        buf += 48;
+        len -= 48;
+
+        while (len >= 64)
+        {
+            acc = _mm_xor_si128(crc16_fold(acc, k512), _mm_loadu_si128((const __m128i *)(buf + 0)));
+            acc1 = _mm_xor_si128(crc16_fold(acc1, k512), _mm_loadu_si128((const __m128i *)(buf + 16)));
+            acc2 = _mm_xor_si128(crc16_fold(acc2, k512), _mm_loadu_si128((const __m128i *)(buf + 32)));
+            acc3 = _mm_xor_si128(crc16_fold(acc3, k512), _mm_loadu_si128((const __m128i *)(buf + 48)));
+            buf += 64;
+            len -= 64;
+        }
+
+        const __m128i k384 = _mm_set_epi64x((long long)CRC16_FOLD_384_HI, (long long)CRC16_FOLD_384_LO);
+        const __m128i k256 = _mm_set_epi64x((long long)CRC16_FOLD_256_HI, (long long)CRC16_FOLD_256_LO);
+        const __m128i k128 = _mm_set_epi64x((long long)CRC16_FOLD_128_HI, (long long)CRC16_FOLD_128_LO);
+        acc = _mm_xor_si128(_mm_xor_si128(crc16_fold(acc, k384), crc16_fold(acc1, k256)),
+                            _mm_xor_si128(crc16_fold(acc2, k128), acc3));
+    }
+
+    const __m128i k128 = _mm_set_epi64x((long long)CRC16_FOLD_128_HI, (long long)CRC16_FOLD_128_LO);
+    while (len >= 16)
+    {
+        acc = _mm_xor_si128(crc16_fold(acc, k128), _mm_loadu_si128((const __m128i *)buf));
+        buf += 16;
+        len -= 16;
+    }
+
+    uint8_t residue[16];
+    _mm_storeu_si128((__m128i *)residue, acc);
+    crc = crc16_slice16(0, residue, sizeof(residue));
+    return crc16_slice16(crc, buf, len);
+}
+#endif
+
+/**
+ * @brief Check whether an engine can run on this build and CPU.
+ *
+ * @param engine Engine to check
+ * @return true if the engine can be selected
+ */
+bool modbus_crc16_engine_supported(modbus_crc16_engine_et engine)
+{
+    switch (engine)
+    {
+    case MODBUS_CRC16_ENGINE_AUTO:
+    case MODBUS_CRC16_ENGINE_BITWISE:
+    case MODBUS_CRC16_ENGINE_TABLE:
+    case MODBUS_CRC16_ENGINE_SLICE8:
+    case MODBUS_CRC16_ENGINE_SLICE16:
+        return true;
+    case MODBUS_CRC16_ENGINE_CLMUL:
+#if MODBUS_CRC16_HAVE_CLMUL
+        return __builtin_cpu_supports("pclmul") && __builtin_cpu_supports("sse2");
+#else
+        return false;
+#endif
+    default:
+        return false;
+    }
+}
+
+/**
+ * @brief Get a short printable name for an engine.
+ *
+ * @param engine Engine
+ * @return Static string, "unknown" for invalid values
+ */
+const char *modbus_crc16_engine_name(modbus_crc16_engine_et engine)
+{
+    switch (engine)
+    {
+    case MODBUS_CRC16_ENGINE_AUTO:
+        return "auto";
+    case MODBUS_CRC16_ENGINE_BITWISE:
+        return "bitwise";
+    case MODBUS_CRC16_ENGINE_TABLE:
+        return "table";
+    case MODBUS_CRC16_ENGINE_SLICE8:
+        return "slice8";
+    case MODBUS_CRC16_ENGINE_SLICE16:
+        return "slice16";
+    case MODBUS_CRC16_ENGINE_CLMUL:
+        return "clmul";
+    default:
+        return "unknown";
+    }
+}
+
+/**
+ * @brief Select the CRC16 engine used by modbus_crc16().
+ *
+ * @param engine Engine to use
+ * @return 0 on success, -1 if the engine is unknown or not supported by this CPU
+ */
+int modbus_crc16_set_engine(modbus_crc16_engine_et engine)
+{
+    if (!modbus_crc16_engine_supported(engine))
+    {
+        return -1;
+    }
+    atomic_store_explicit(&selected_engine, (int)engine, memory_order_relaxed);
+    return 0;
+}
+
+/**
+ * @brief Get the currently selected CRC16 engine.
+ *
+ * @return Selected engine (MODBUS_CRC16_ENGINE_AUTO by default)
+ */
+modbus_crc16_engine_et modbus_crc16_get_engine(void)
+{
+    return (modbus_crc16_engine_et)atomic_load_explicit(&selected_engine, memory_order_relaxed);
+}
+
+/**
+ * @brief Feed bytes into a raw CRC16 register using the selected engine.
+ *
+ * @param crc Current CRC register value (MODBUS_CRC16_INIT for a new frame)
+ * @param buf Pointer to the data buffer
+ * @param len Length of the data buffer in bytes
+ * @return Updated CRC register value
+ *
+ * Returns @p crc unchanged when @p buf is NULL or @p len is 0.
+ */
+uint16_t modbus_crc16_accumulate(uint16_t crc, const uint8_t *buf, size_t len)
+{
+    if (!buf || (len == 0))
+    {
+        return crc;
+    }
+
+    switch (modbus_crc16_get_engine())
+    {
+    case MODBUS_CRC16_ENGINE_BITWISE:
+        return crc16_bitwise(crc, buf, len);
+    case MODBUS_CRC16_ENGINE_TABLE:
+        return crc16_bytewise(crc, buf, len);
+    case MODBUS_CRC16_ENGINE_SLICE8:
+        return crc16_slice8(crc, buf, len);
+    case MODBUS_CRC16_ENGINE_SLICE16:
+        return crc16_slice16(crc, buf, len);
+#if MODBUS_CRC16_HAVE_CLMUL
+    case MODBUS_CRC16_ENGINE_CLMUL:
+        return crc16_clmul(crc, buf, len);
+#endif
+    default:
+        break;
+    }
+
+#if MODBUS_CRC16_HAVE_CLMUL
+    if ((len >= CRC16_AUTO_CLMUL_MIN) && modbus_crc16_engine_supported(MODBUS_CRC16_ENGINE_CLMUL))
+    {
+        return crc16_clmul(crc, buf, len);
+    }
+#endif
+    if (len >= 16)
+    {
+        return crc16_slice16(crc, buf, len);
+    }
+    return crc16_slice8(crc, buf, len);
+}
+
+/**
+ * @brief Multiply two polynomials modulo P in the reflected domain.
+ *
+ * Bit 15 holds the x^0 coefficient, bit 0 holds x^15.
+ */
+static uint16_t crc16_multmodp(uint16_t a, uint16_t b)
+{
+    uint16_t m = 0x8000;
+    uint16_t p = 0;
+
+    for (;;)
+    {
+        if (a & m)
+        {
+            p ^= b;
+            if ((a & (m - 1)) == 0)
+            {
+                break;
+            }
+        }
+        m >>= 1;
+        b = (b & 1) ? (b >> 1) ^ CRC16_POLY_REFLECTED : (b >> 1);
+    }
+    return p;
+}
+
+/**
+ * @brief Compute x^(8 * len) modulo P in the reflected domain.
+ */
+static uint16_t crc16_x8nmodp(size_t len)
+{
+    uint16_t result = 0x8000; /* x^0 */
+    uint16_t square = 0x0080; /* x^8 */
+
+    while (len)
+    {
+        if (len & 1)
+        {
+            result = crc16_multmodp(square, result);
+        }
+        square = crc16_multmodp(square, square);
+        len >>= 1;
+    }
+    return result;
+}
+
+/**
+ * @brief Start a new CRC16 computation.
+ *
+ * @param ctx Context to initialize
+ */
+void modbus_crc16_init(modbus_crc16_ctx_st *ctx)
+{
+    if (ctx)
+    {
+        ctx->crc = MODBUS_CRC16_INIT;
+    }
+}
+
+/**
+ * @brief Feed bytes into a CRC16 context.
+ *
+ * @param ctx Context started with modbus_crc16_init()
+ * @param buf Pointer to the next bytes of the frame
+ * @param len Number of bytes
+ *
+ * Chunks may have any size; the result only depends on the byte sequence.
+ */
+void modbus_crc16_update(modbus_crc16_ctx_st *ctx, const uint8_t *buf, size_t len)
+{
+    if (ctx)
+    {
+        ctx->crc = modbus_crc16_accumulate(ctx->crc, buf, len);
+    }
+}
+
+/**
+ * @brief Get the CRC16 of all bytes fed so far.
+ *
+ * @param ctx Context
+ * @return 16-bit CRC value, 0xFFFF if no bytes were fed
+ *
+ * The context is left untouched and can keep receiving bytes.
+ */
+uint16_t modbus_crc16_final(const modbus_crc16_ctx_st *ctx)
+{
+    return ctx ? ctx->crc : MODBUS_CRC16_INIT;
+}
+
+/**
+ * @brief Combine the CRCs of two adjacent blocks without reading their bytes.
+ *
+ * @param crc_a CRC16 of block A
+ * @param crc_b CRC16 of block B
+ * @param len_b Length of block B in bytes
+ * @return CRC16 of A followed by B
+ *
+ * CRC(A || B) equals CRC(B) with the initial register value replaced by
+ * CRC(A). Since the CRC is linear, the difference is (CRC(A) ^ 0xFFFF)
+ * shifted through len_b zero bytes, i.e. multiplied by x^(8 * len_b).
+ */
+uint16_t modbus_crc16_combine(uint16_t crc_a, uint16_t crc_b, size_t len_b)
+{
+    return crc16_multmodp(crc16_x8nmodp(len_b), crc_a ^ MODBUS_CRC16_INIT) ^ crc_b;
+}
+
+/**
+ * @brief Build the shift operator for blocks of @p len bytes.
+ *
+ * @param op Operator to build
+ * @param len Block length in bytes
+ */
+void modbus_crc16_shift_init(modbus_crc16_shift_st *op, size_t len)
+{
+    if (!op)
+    {
+        return;
+    }
+
+    uint16_t xpow = crc16_x8nmodp(len);
+    for (uint32_t v = 0; v < 256; v++)
+    {
+        op->lo[v] = crc16_multmodp(xpow, (uint16_t)v);
+        op->hi[v] = crc16_multmodp(xpow, (uint16_t)(v << 8));
+    }
+}
@@ -0,0 +1,254 @@
+/**
+ * @file modbus_host.c
+ * @brief Unit table of a multi-unit slave host, and its RTU entry point.
+ *
+ * Framing, CRC and the exception rules are those of
+ * modbus_slave_handle_request(), which does the work once the unit is
+ * known; the host only picks the register sources.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "modbus_host.h"
+#include "modbus_utils.h"
+
+/** @brief Read Holding Registers request PDU: function code, address, quantity */
+#define READ_REQUEST_PDU_SIZE 5
+
+/** @brief Read response header: function code, byte count */
+#define READ_RESPONSE_PDU_HEADER_SIZE 2
+
+/**
+ * @brief Fill an exception response PDU.
+ */
+static int exception(uint8_t *resp, uint8_t function_code, uint8_t code)
+{
+    resp[0] = function_code | MODBUS_EXCEPTION_FLAG;
+    resp[1] = code;
+    return 2;
+}
+
+/**
+ * @brief Allocate room for the units.
+ *
+ * @param host Host to initialize
+ * @param max_units Largest number of units
+ * @return 0 on success, or a negative error code
+ */
+int modbus_host_init(modbus_host_st *host, uint32_t max_units)
+{
+    if (!host || (max_units == 0) || (max_units > MODBUS_MAX_SLAVES))
+    {
+        return -1;
+    }
+
+    memset(host, 0, sizeof(*host));
+    host->units = calloc(max_units, sizeof(*host->units));
+    if (!host->units)
+    {
+        return -2;
+    }
+    host->capacity = max_units;
+    return 0;
+}
+
+/**
+ * @brief Release the units.
+ *
+ * @param host Host
+ */
+void modbus_host_free(modbus_host_st *host)
+{
+    if (!host)
+    {
+        return;
+    }
+
+    free(host->units);
+    memset(host, 0, sizeof(*host));
+}
+
+/**
+ * @brief Serve a unit ID.
+ *
+ * @param host Host
+ * @param unit_id Unit ID
+ * @param map Register sources of the unit
+ * @param read_wire Read Holding Registers in wire order (NULL = none)
+ * @return Index of the unit, or a negative error code
+ */
+int modbus_host_add_unit(modbus_host_st *host, uint8_t unit_id, const modbus_register_map_st *map,
+                         modbus_host_read_wire_fn read_wire)
+{
+    if (!host || !host->units || !map || (unit_id == BROADCAST_SLAVE_ID) || (unit_id > MODBUS_MAX_SLAVES))
+    {
+        return -1;
+    }
+    if (host->count == host->capacity)
+    {
+        return -2;
+    }
+    if (host->slot[unit_id] != 0)
+    {
+        return -3;
+    }
+
+    uint32_t index = host->count++;
+    host->units[index].map = *map;
+    host->units[index].read_wire = read_wire;
+    host->slot[unit_id] = (uint8_t)(index + 1);
+    return (int)index;
+}
+
+/**
+ * @brief Serve a unit ID from its own register bank.
+ *
+ * @param host Host
+ * @param unit_id Unit ID
+ * @param bank Holding registers of the unit
+ * @return Index of the unit, or a negative error code
+ */
+int modbus_host_add_bank(modbus_host_st *host, uint8_t unit_id, modbus_bank_st *bank)
+{
+    if (!bank)
+    {
+        return -1;
+    }
+
+    modbus_register_map_st map = {
+        .read_holding = modbus_bank_read_cb,
+        .write_holding = modbus_bank_write_cb,
+        .arg = bank,
+    };
+    return modbus_host_add_unit(host, unit_id, &map, modbus_bank_read_wire_cb);
+}
+
+/**
+ * @brief Let a second ID address an existing unit.
+ *
+ * @param host Host
+ * @param alias_id Extra ID
+ * @param unit_id Unit already served
+ * @return 0 on success, or a negative error code
+ */
+int modbus_host_alias(modbus_host_st *host, uint8_t alias_id, uint8_t unit_id)
+{
+    if (!host || (host->slot[unit_id] == 0))
+    {
+        return -1;
+    }
+    if (host->slot[alias_id] != 0)
+    {
+        return -3;
+    }
+
+    host->slot[alias_id] = host->slot[unit_id];
+    return 0;
+}
+
+/**
+ * @brief Answer a request PDU with a unit's register sources.
+ *
+ * @param unit Unit the request addresses
+ * @param unit_id Unit ID byte of the request
+ * @param req Request PDU
+ * @param req_len Length of the request PDU
+ * @param resp Output response PDU
+ * @return Length of the response PDU (normal or exception), or -1 on invalid arguments
+ */
+int modbus_host_dispatch(const modbus_host_unit_st *unit, uint8_t unit_id, const uint8_t *req, size_t req_len,
+                         uint8_t *resp)
+{
+    if (!unit || !req || !resp || (req_len == 0))
+    {
+        return -1;
+    }
+    if ((req[0] != MODBUS_READ_HOLDING_REG) || !unit->read_wire)
+    {
+        return modbus_pdu_dispatch(&unit->map, unit_id, req, req_len, resp);
+    }
+
+    if (req_len != READ_REQUEST_PDU_SIZE)
+    {
+        return exception(resp, req[0], MODBUS_EX_ILLEGAL_DATA_VALUE);
+    }
+
+    uint16_t start_addr = (uint16_t)((req[1] << 8) | req[2]);
+    uint16_t qty = (uint16_t)((req[3] << 8) | req[4]);
+    if (!is_valid_quantity(qty))
+    {
+        return exception(resp, req[0], MODBUS_EX_ILLEGAL_DATA_VALUE);
+    }
+    if (!is_valid_address_range(start_addr, qty))
+    {
+        return exception(resp, req[0], MODBUS_EX_ILLEGAL_DATA_ADDRESS);
+    }
+
+    // The source writes the payload straight into the response
+    if (unit->read_wire(unit->map.arg, unit_id, start_addr, qty, resp + READ_RESPONSE_PDU_HEADER_SIZE) != 0)
+    {
+        return exception(resp, req[0], MODBUS_EX_SLAVE_DEVICE_FAILURE);
+    }
+    resp[0] = MODBUS_READ_HOLDING_REG;
+    resp[1] = (uint8_t)(qty * 2);
+    return READ_RESPONSE_PDU_HEADER_SIZE + qty * 2;
+}
+
+/**
+ * @brief Answer any supported RTU request for the unit it addresses.
+ *
+ * @param host Host
+ * @param buffer Incoming RTU request frame
+ * @param bufsize Size of the incoming buffer
+ * @param response Output buffer
+ * @param respsize Size of the output buffer
+ * @return Length of the response frame, 0 for a broadcast, or a negative error code
+ */
+int modbus_host_handle_rtu_request(const modbus_host_st *host, const uint8_t *buffer, size_t bufsize,
+                                   uint8_t *response, size_t respsize)
+{
+    if (!host || !buffer)
+    {
+        return -1;
+    }
+    if (bufsize < 2)
+    {
+        return -2;
+    }
+
+    // The context only has to accept the address: the unit was picked by the table
+    modbus_slave_ctx_st addressed = {.device_slave_id = buffer[0]};
+
+    if (buffer[0] != BROADCAST_SLAVE_ID)
+    {
+        const modbus_host_unit_st *unit = modbus_host_unit(host, buffer[0]);
+        if (!unit)
+        {
+            return -4;
+        }
+        return modbus_slave_handle_request(&addressed, &unit->map, buffer, bufsize, response, respsize);
+    }
+
+    if (host->count == 0)
+    {
+        return -4;
+    }
+
+    // The first unit validates the frame; the others then only execute it
+    int ret = modbus_slave_handle_request(&addressed, &host->units[0].map, buffer, bufsize, response, respsize);
+    if (ret != 0)
+    {
+        return ret;
+    }
+    // A function code without a known layout changes nothing, and a broadcast is never answered
+    int pdu_len = modbus_pdu_request_length(buffer + 1, bufsize - 1);
+    if (pdu_len <= 0)
+    {
+        return 0;
+    }
+    for (uint32_t u = 1; u < host->count; u++)
+    {
+        modbus_pdu_dispatch(&host->units[u].map, BROADCAST_SLAVE_ID, buffer + 1, (size_t)pdu_len, response + 1);
+    }
+    return 0;
+}
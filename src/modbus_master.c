@@ -10,15 +10,30 @@
  */
 #include <string.h>
 
-#include "modbus_slave.h"
+#include "modbus_master.h"
 #include "modbus_utils.h"
 #include "modbus_types.h"
+#include "modbus_swap.h"
 
-static uint8_t last_request_slave_id = 0;
+/**
+ * @brief Initialize a master context.
+ *
+ * @param ctx Context to initialize
+ */
+void modbus_master_ctx_init(modbus_master_ctx_st *ctx)
+{
+    if (ctx)
+    {
+        ctx->last_request_slave_id = 0;
+        memset(ctx->last_request, 0, sizeof(ctx->last_request));
+        ctx->last_request[0] = MODBUS_READ_HOLDING_REG;
+    }
+}
 
 /**
  * @brief Encode a Modbus Read Holding Registers request.
  *
+ * @param ctx Master context, records the slave expected to answer
  * @param slave_id Modbus slave ID (1..247)
  * @param addr Starting register address
  * @param qty Number of registers to read
@@ -29,10 +44,10 @@ static uint8_t last_request_slave_id = 0;
  * This function validates the input parameters and fills the buffer with the
  * Modbus RTU request frame, including CRC.
  */
-uint16_t encode_read_request(uint8_t slave_id, uint16_t addr, uint16_t qty, uint8_t *buffer, size_t bufsize)
+uint16_t encode_read_request(modbus_master_ctx_st *ctx, uint8_t slave_id, uint16_t addr, uint16_t qty, uint8_t *buffer, size_t bufsize)
 {
 
-    if ((buffer == NULL) || (bufsize < (sizeof(read_holding_registers_request_st))))
+    if ((ctx == NULL) || (buffer == NULL) || (bufsize < (sizeof(read_holding_registers_request_st))))
     {
         return 0;
     }
@@ -53,7 +68,8 @@ uint16_t encode_read_request(uint8_t slave_id, uint16_t addr, uint16_t qty, uint
     memcpy(buffer, &r, sizeof(r));
     memcpy(buffer + sizeof(r), &crc, sizeof(crc));
 
-    last_request_slave_id = slave_id;
+    ctx->last_request_slave_id = slave_id;
+    memcpy(ctx->last_request, buffer + 1, sizeof(ctx->last_request));
 
     return sizeof(r) + sizeof(crc);
 }
@@ -61,6 +77,7 @@ uint16_t encode_read_request(uint8_t slave_id, uint16_t addr, uint16_t qty, uint
 /**
  * @brief Decode a Modbus Read Holding Registers response.
  *
+ * @param ctx Master context used to encode the matching request
  * @param buffer Buffer containing the response
  * @param bufsize Size of the buffer
  * @param regs Output array to store decoded register values
@@ -75,15 +92,16 @@ uint16_t encode_read_request(uint8_t slave_id, uint16_t addr, uint16_t qty, uint
  *         -7: CRC mismatch
  *
  * The function validates the response header, checks CRC, and converts
- * register values from big-endian to host byte order.
+ * register values from big-endian to host byte order. The conversion and the
+ * checksum are done in a single sweep over the payload.
  */
-int decode_read_response(uint8_t *buffer, size_t bufsize,
+int decode_read_response(const modbus_master_ctx_st *ctx, const uint8_t *buffer, size_t bufsize,
                          uint16_t *regs, uint8_t regs_len)
 {
     static const uint8_t PACKET_HEADER_SIZE = 3;
     static const uint8_t PACKET_CRC_SIZE = 2;
 
-    if (!buffer || !regs)
+    if (!ctx || !buffer || !regs)
     {
         return -1;
     }
@@ -91,7 +109,7 @@ int decode_read_response(uint8_t *buffer, size_t bufsize,
     read_holding_registers_header_response_st resp = {0};
     memcpy(&resp, buffer, sizeof(resp));
 
-    if (resp.slave_id != last_request_slave_id)
+    if (resp.slave_id != ctx->last_request_slave_id)
     {
         return -2;
     }
@@ -118,14 +136,12 @@ int decode_read_response(uint8_t *buffer, size_t bufsize,
         return -6;
     }
 
-    for (int i = 0; i < reg_count; i++)
-    {
-        uint16_t hi = buffer[PACKET_HEADER_SIZE + (i * 2)];
-        uint16_t lo = buffer[PACKET_HEADER_SIZE + (i * 2) + 1];
-        regs[i] = (hi << 8) | lo;
-    }
+    modbus_crc16_ctx_st crc_ctx;
+    modbus_crc16_init(&crc_ctx);
+    modbus_crc16_update(&crc_ctx, buffer, PACKET_HEADER_SIZE);
+    modbus_regs_from_be_crc(regs, buffer + PACKET_HEADER_SIZE, reg_count, &crc_ctx);
 
-    uint16_t crc_calc = modbus_crc16(buffer, frame_len - PACKET_CRC_SIZE);
+    uint16_t crc_calc = modbus_crc16_final(&crc_ctx);
     uint16_t crc_recv = buffer[frame_len - 2] | (buffer[frame_len - 1] << 8);
 
     if (crc_calc != crc_recv)
@@ -135,3 +151,106 @@ int decode_read_response(uint8_t *buffer, size_t bufsize,
 
     return reg_count;
 }
+
+
+/**
+ * @brief Encode an RTU request around any PDU built with the modbus_pdu_encode_*() functions.
+ *
+ * @param ctx Master context, records the slave and the request fields the answer must echo
+ * @param slave_id Modbus slave ID (0..247)
+ * @param pdu Request PDU
+ * @param pdu_len Length of the request PDU
+ * @param buffer Output buffer to store the encoded request
+ * @param bufsize Size of the output buffer
+ * @return Length of the encoded request in bytes, or 0 on failure
+ */
+uint16_t encode_rtu_request(modbus_master_ctx_st *ctx, uint8_t slave_id, const uint8_t *pdu, size_t pdu_len,
+                            uint8_t *buffer, size_t bufsize)
+{
+    static const uint8_t PACKET_CRC_SIZE = 2;
+
+    if (!ctx || !pdu || !buffer || !is_valid_slave_id(slave_id))
+    {
+        return 0;
+    }
+
+    if ((modbus_pdu_request_length(pdu, pdu_len) != (int)pdu_len) || (bufsize < 1 + pdu_len + PACKET_CRC_SIZE))
+    {
+        return 0;
+    }
+
+    buffer[0] = slave_id;
+    memcpy(buffer + 1, pdu, pdu_len);
+    uint16_t crc = modbus_crc16(buffer, 1 + pdu_len);
+    buffer[1 + pdu_len] = (uint8_t)(crc & 0xFF);
+    buffer[1 + pdu_len + 1] = (uint8_t)(crc >> 8);
+
+    ctx->last_request_slave_id = slave_id;
+    memcpy(ctx->last_request, pdu, sizeof(ctx->last_request));
+
+    return (uint16_t)(1 + pdu_len + PACKET_CRC_SIZE);
+}
+
+/**
+ * @brief Decode the RTU response to the last request encoded on this context.
+ *
+ * @param ctx Master context used to encode the matching request
+ * @param buffer Buffer containing the response
+ * @param bufsize Size of the buffer
+ * @param regs Output register values for reads (may be NULL for writes)
+ * @param regs_len Length of the output array
+ * @return Number of registers read (0 for writes), or a negative error code:
+ *         -1: Invalid input pointers
+ *         -2: Slave ID mismatch
+ *         -3: Function code mismatch
+ *         -4: Byte count or echoed address, value or quantity does not match the request
+ *         -5: Buffer too small
+ *         -6: Output array too small
+ *         -7: CRC mismatch
+ *         -8: Exception response; the exception code is buffer[2]
+ */
+int decode_rtu_response(const modbus_master_ctx_st *ctx, const uint8_t *buffer, size_t bufsize, uint16_t *regs,
+                        uint16_t regs_len)
+{
+    static const uint8_t PACKET_CRC_SIZE = 2;
+
+    if (!ctx || !buffer)
+    {
+        return -1;
+    }
+
+    if (bufsize < 2)
+    {
+        return -5;
+    }
+
+    if (buffer[0] != ctx->last_request_slave_id)
+    {
+        return -2;
+    }
+
+    if ((buffer[1] & (uint8_t)~MODBUS_EXCEPTION_FLAG) != ctx->last_request[0])
+    {
+        return -3;
+    }
+
+    int pdu_len = modbus_pdu_response_length(buffer + 1, bufsize - 1);
+    if (pdu_len < 0)
+    {
+        return -4;
+    }
+    if ((pdu_len == 0) || (bufsize < 1 + (size_t)pdu_len + PACKET_CRC_SIZE))
+    {
+        return -5;
+    }
+
+    uint16_t crc_calc = modbus_crc16(buffer, 1 + pdu_len);
+    uint16_t crc_recv = buffer[1 + pdu_len] | (buffer[1 + pdu_len + 1] << 8);
+    if (crc_calc != crc_recv)
+    {
+        return -7;
+    }
+
+    return modbus_pdu_decode_response(ctx->last_request, sizeof(ctx->last_request), buffer + 1, pdu_len, regs,
+                                      regs_len);
+}
@@ -0,0 +1,592 @@
+/**
+ * @file modbus_pdu.c
+ * @brief Transport-independent Modbus PDUs and a function-code dispatcher.
+ *
+ * The dispatcher indexes a 256-entry table with the function code, so
+ * adding a function is one handler and one table entry. Each handler
+ * validates its own layout and either fills a normal response or an
+ * exception response; nothing is written to the register map unless the
+ * whole request is valid.
+ */
+#include <string.h>
+
+#include "modbus_pdu.h"
+#include "modbus_utils.h"
+#include "modbus_swap.h"
+
+/** @brief Read request / write single request / write echo: function, two 16-bit fields */
+#define PDU_FIXED_SIZE 5
+
+/** @brief Write Multiple Registers request up to the byte count, inclusive */
+#define PDU_WRITE_MULTIPLE_HEADER_SIZE 6
+
+/** @brief Read/Write Multiple Registers request up to the byte count, inclusive */
+#define PDU_READ_WRITE_HEADER_SIZE 10
+
+/** @brief Read response header: function code, byte count */
+#define PDU_READ_RESPONSE_HEADER_SIZE 2
+
+/** @brief Exception response: function code | 0x80, exception code */
+#define PDU_EXCEPTION_SIZE 2
+
+/**
+ * @brief Handler for one function code.
+ *
+ * @return Length of the response PDU
+ */
+typedef int (*pdu_handler_fn)(const modbus_register_map_st *map, uint8_t unit_id, const uint8_t *req, size_t len,
+                              uint8_t *resp);
+
+static inline uint16_t get_u16(const uint8_t *p)
+{
+    return (uint16_t)((p[0] << 8) | p[1]);
+}
+
+static inline void put_u16(uint8_t *p, uint16_t v)
+{
+    p[0] = (uint8_t)(v >> 8);
+    p[1] = (uint8_t)v;
+}
+
+/**
+ * @brief Fill an exception response.
+ */
+static int exception(uint8_t *resp, uint8_t function_code, uint8_t code)
+{
+    resp[0] = function_code | MODBUS_EXCEPTION_FLAG;
+    resp[1] = code;
+    return PDU_EXCEPTION_SIZE;
+}
+
+/**
+ * @brief Read registers from a source into a read response.
+ */
+static int read_response(modbus_read_regs_fn read, void *arg, uint8_t unit_id, uint8_t function_code,
+                         uint16_t addr, uint16_t qty, uint8_t *resp)
+{
+    uint16_t regs[MODBUS_MAX_REGS];
+
+    if (!is_valid_quantity(qty))
+    {
+        return exception(resp, function_code, MODBUS_EX_ILLEGAL_DATA_VALUE);
+    }
+
+    if (!is_valid_address_range(addr, qty))
+    {
+        return exception(resp, function_code, MODBUS_EX_ILLEGAL_DATA_ADDRESS);
+    }
+
+    if (read(arg, unit_id, addr, qty, regs) != 0)
+    {
+        return exception(resp, function_code, MODBUS_EX_SLAVE_DEVICE_FAILURE);
+    }
+
+    resp[0] = function_code;
+    resp[1] = (uint8_t)(qty * 2);
+    modbus_regs_to_be(resp + PDU_READ_RESPONSE_HEADER_SIZE, regs, qty);
+    return PDU_READ_RESPONSE_HEADER_SIZE + qty * 2;
+}
+
+/**
+ * @brief 0x03 Read Holding Registers.
+ */
+static int handle_read_holding(const modbus_register_map_st *map, uint8_t unit_id, const uint8_t *req, size_t len,
+                               uint8_t *resp)
+{
+    if (!map->read_holding)
+    {
+        return exception(resp, req[0], MODBUS_EX_ILLEGAL_FUNCTION);
+    }
+
+    if (len != PDU_FIXED_SIZE)
+    {
+        return exception(resp, req[0], MODBUS_EX_ILLEGAL_DATA_VALUE);
+    }
+
+    return read_response(map->read_holding, map->arg, unit_id, req[0], get_u16(req + 1), get_u16(req + 3), resp);
+}
+
+/**
+ * @brief 0x04 Read Input Registers.
+ */
+static int handle_read_input(const modbus_register_map_st *map, uint8_t unit_id, const uint8_t *req, size_t len,
+                             uint8_t *resp)
+{
+    if (!map->read_input)
+    {
+        return exception(resp, req[0], MODBUS_EX_ILLEGAL_FUNCTION);
+    }
+
+    if (len != PDU_FIXED_SIZE)
+    {
+        return exception(resp, req[0], MODBUS_EX_ILLEGAL_DATA_VALUE);
+    }
+
+    return read_response(map->read_input, map->arg, unit_id, req[0], get_u16(req + 1), get_u16(req + 3), resp);
+}
+
+/**
+ * @brief 0x06 Write Single Register. The response echoes the request.
+ */
+static int handle_write_single(const modbus_register_map_st *map, uint8_t unit_id, const uint8_t *req, size_t len,
+                               uint8_t *resp)
+{
+    if (!map->write_holding)
+    {
+        return exception(resp, req[0], MODBUS_EX_ILLEGAL_FUNCTION);
+    }
+
+    if (len != PDU_FIXED_SIZE)
+    {
+        return exception(resp, req[0], MODBUS_EX_ILLEGAL_DATA_VALUE);
+    }
+
+    uint16_t value = get_u16(req + 3);
+    if (map->write_holding(map->arg, unit_id, get_u16(req + 1), 1, &value) != 0)
+    {
+        return exception(resp, req[0], MODBUS_EX_SLAVE_DEVICE_FAILURE);
+    }
+
+    memcpy(resp, req, PDU_FIXED_SIZE);
+    return PDU_FIXED_SIZE;
+}
+
+/**
+ * @brief 0x10 Write Multiple Registers. The response echoes address and quantity.
+ */
+static int handle_write_multiple(const modbus_register_map_st *map, uint8_t unit_id, const uint8_t *req, size_t len,
+                                 uint8_t *resp)
+{
+    if (!map->write_holding)
+    {
+        return exception(resp, req[0], MODBUS_EX_ILLEGAL_FUNCTION);
+    }
+
+    if (len < PDU_WRITE_MULTIPLE_HEADER_SIZE)
+    {
+        return exception(resp, req[0], MODBUS_EX_ILLEGAL_DATA_VALUE);
+    }
+
+    uint16_t addr = get_u16(req + 1);
+    uint16_t qty = get_u16(req + 3);
+    uint8_t byte_count = req[5];
+    if ((qty == 0) || (qty > MODBUS_MAX_WRITE_REGS) || (byte_count != qty * 2) ||
+        (len != (size_t)PDU_WRITE_MULTIPLE_HEADER_SIZE + byte_count))
+    {
+        return exception(resp, req[0], MODBUS_EX_ILLEGAL_DATA_VALUE);
+    }
+
+    if (!is_valid_address_range(addr, qty))
+    {
+        return exception(resp, req[0], MODBUS_EX_ILLEGAL_DATA_ADDRESS);
+    }
+
+    uint16_t values[MODBUS_MAX_WRITE_REGS];
+    modbus_regs_from_be(values, req + PDU_WRITE_MULTIPLE_HEADER_SIZE, qty);
+    if (map->write_holding(map->arg, unit_id, addr, qty, values) != 0)
+    {
+        return exception(resp, req[0], MODBUS_EX_SLAVE_DEVICE_FAILURE);
+    }
+
+    memcpy(resp, req, PDU_FIXED_SIZE);
+    return PDU_FIXED_SIZE;
+}
+
+/**
+ * @brief 0x17 Read/Write Multiple Registers: write first, then read.
+ */
+static int handle_read_write(const modbus_register_map_st *map, uint8_t unit_id, const uint8_t *req, size_t len,
+                             uint8_t *resp)
+{
+    if (!map->read_holding || !map->write_holding)
+    {
+        return exception(resp, req[0], MODBUS_EX_ILLEGAL_FUNCTION);
+    }
+
+    if (len < PDU_READ_WRITE_HEADER_SIZE)
+    {
+        return exception(resp, req[0], MODBUS_EX_ILLEGAL_DATA_VALUE);
+    }
+
+    uint16_t read_addr = get_u16(req + 1);
+    uint16_t read_qty = get_u16(req + 3);
+    uint16_t write_addr = get_u16(req + 5);
+    uint16_t write_qty = get_u16(req + 7);
+    uint8_t byte_count = req[9];
+    if (!is_valid_quantity(read_qty) || (write_qty == 0) || (write_qty > MODBUS_MAX_RW_WRITE_REGS) ||
+        (byte_count != write_qty * 2) || (len != (size_t)PDU_READ_WRITE_HEADER_SIZE + byte_count))
+    {
+        return exception(resp, req[0], MODBUS_EX_ILLEGAL_DATA_VALUE);
+    }
+
+    if (!is_valid_address_range(read_addr, read_qty) || !is_valid_address_range(write_addr, write_qty))
+    {
+        return exception(resp, req[0], MODBUS_EX_ILLEGAL_DATA_ADDRESS);
+    }
+
+    uint16_t values[MODBUS_MAX_RW_WRITE_REGS];
+    modbus_regs_from_be(values, req + PDU_READ_WRITE_HEADER_SIZE, write_qty);
+    if (map->write_holding(map->arg, unit_id, write_addr, write_qty, values) != 0)
+    {
+        return exception(resp, req[0], MODBUS_EX_SLAVE_DEVICE_FAILURE);
+    }
+
+    return read_response(map->read_holding, map->arg, unit_id, req[0], read_addr, read_qty, resp);
+}
+
+/** @brief Handlers by function code; NULL = not supported */
+static const pdu_handler_fn handlers[256] = {
+    [MODBUS_READ_HOLDING_REG] = handle_read_holding,
+    [MODBUS_READ_INPUT_REG] = handle_read_input,
+    [MODBUS_WRITE_SINGLE_REG] = handle_write_single,
+    [MODBUS_WRITE_MULTIPLE_REGS] = handle_write_multiple,
+    [MODBUS_READ_WRITE_MULTIPLE_REGS] = handle_read_write,
+};
+
+/**
+ * @brief Answer a request PDU.
+ *
+ * @param map Register sources
+ * @param unit_id Unit ID of the request, passed to the callbacks
+ * @param req Request PDU
+ * @param req_len Length of the request PDU
+ * @param resp Output response PDU, at least MODBUS_MAX_PDU_SIZE bytes
+ * @return Length of the response PDU (normal or exception), or -1 on invalid arguments
+ */
+int modbus_pdu_dispatch(const modbus_register_map_st *map, uint8_t unit_id, const uint8_t *req, size_t req_len,
+                        uint8_t *resp)
+{
+    if (!map || !req || !resp || (req_len == 0))
+    {
+        return -1;
+    }
+
+    pdu_handler_fn handler = handlers[req[0]];
+    if (!handler)
+    {
+        return exception(resp, req[0], MODBUS_EX_ILLEGAL_FUNCTION);
+    }
+
+    return handler(map, unit_id, req, req_len, resp);
+}
+
+/**
+ * @brief Length of a request PDU from its first bytes.
+ *
+ * @param pdu First bytes of the PDU
+ * @param avail Number of bytes available
+ * @return PDU length, 0 if more bytes are needed to tell, or -1 for an unsupported function code
+ */
+int modbus_pdu_request_length(const uint8_t *pdu, size_t avail)
+{
+    if (!pdu)
+    {
+        return -1;
+    }
+
+    if (avail < 1)
+    {
+        return 0;
+    }
+
+    switch (pdu[0])
+    {
+    case MODBUS_READ_HOLDING_REG:
+    case MODBUS_READ_INPUT_REG:
+    case MODBUS_WRITE_SINGLE_REG:
+        return PDU_FIXED_SIZE;
+    case MODBUS_WRITE_MULTIPLE_REGS:
+        if (avail < PDU_WRITE_MULTIPLE_HEADER_SIZE)
+        {
+            return 0;
+        }
+        return (pdu[5] > MODBUS_MAX_WRITE_REGS * 2) ? -1 : PDU_WRITE_MULTIPLE_HEADER_SIZE + pdu[5];
+    case MODBUS_READ_WRITE_MULTIPLE_REGS:
+        if (avail < PDU_READ_WRITE_HEADER_SIZE)
+        {
+            return 0;
+        }
+        return (pdu[9] > MODBUS_MAX_RW_WRITE_REGS * 2) ? -1 : PDU_READ_WRITE_HEADER_SIZE + pdu[9];
+    default:
+        return -1;
+    }
+}
+
+/**
+ * @brief Length of a response PDU from its first bytes.
+ *
+ * @param pdu First bytes of the PDU
+ * @param avail Number of bytes available
+ * @return PDU length, 0 if more bytes are needed to tell, or -1 for an unsupported function code
+ */
+int modbus_pdu_response_length(const uint8_t *pdu, size_t avail)
+{
+    if (!pdu)
+    {
+        return -1;
+    }
+
+    if (avail < 1)
+    {
+        return 0;
+    }
+
+    uint8_t function_code = pdu[0] & (uint8_t)~MODBUS_EXCEPTION_FLAG;
+    if (!handlers[function_code])
+    {
+        return -1;
+    }
+
+    if (pdu[0] & MODBUS_EXCEPTION_FLAG)
+    {
+        return PDU_EXCEPTION_SIZE;
+    }
+
+    switch (function_code)
+    {
+    case MODBUS_WRITE_SINGLE_REG:
+    case MODBUS_WRITE_MULTIPLE_REGS:
+        return PDU_FIXED_SIZE;
+    default:
+        if (avail < PDU_READ_RESPONSE_HEADER_SIZE)
+        {
+            return 0;
+        }
+        if (!is_valid_byte_count(pdu[1]) || (pdu[1] & 1))
+        {
+            return -1;
+        }
+        return PDU_READ_RESPONSE_HEADER_SIZE + pdu[1];
+    }
+}
+
+/**
+ * @brief Encode a Read Holding Registers or Read Input Registers request.
+ *
+ * @param function_code MODBUS_READ_HOLDING_REG or MODBUS_READ_INPUT_REG
+ * @param addr First register address
+ * @param qty Number of registers (1..MODBUS_MAX_REGS)
+ * @param pdu Output buffer
+ * @param size Size of the output buffer
+ * @return PDU length, or 0 on failure
+ */
+uint16_t modbus_pdu_encode_read(uint8_t function_code, uint16_t addr, uint16_t qty, uint8_t *pdu, size_t size)
+{
+    if (!pdu || (size < PDU_FIXED_SIZE))
+    {
+        return 0;
+    }
+
+    if (((function_code != MODBUS_READ_HOLDING_REG) && (function_code != MODBUS_READ_INPUT_REG)) ||
+        !is_valid_quantity(qty) || !is_valid_address_range(addr, qty))
+    {
+        return 0;
+    }
+
+    pdu[0] = function_code;
+    put_u16(pdu + 1, addr);
+    put_u16(pdu + 3, qty);
+    return PDU_FIXED_SIZE;
+}
+
+/**
+ * @brief Encode a Write Single Register request.
+ *
+ * @param addr Register address
+ * @param value Value to store
+ * @param pdu Output buffer
+ * @param size Size of the output buffer
+ * @return PDU length, or 0 on failure
+ */
+uint16_t modbus_pdu_encode_write_single(uint16_t addr, uint16_t value, uint8_t *pdu, size_t size)
+{
+    if (!pdu || (size < PDU_FIXED_SIZE))
+    {
+        return 0;
+    }
+
+    pdu[0] = MODBUS_WRITE_SINGLE_REG;
+    put_u16(pdu + 1, addr);
+    put_u16(pdu + 3, value);
+    return PDU_FIXED_SIZE;
+}
+
+/**
+ * @brief Encode a Write Multiple Registers request.
+ *
+ * @param addr First register address
+ * @param values Values to store, host order
+ * @param qty Number of registers (1..MODBUS_MAX_WRITE_REGS)
+ * @param pdu Output buffer
+ * @param size Size of the output buffer
+ * @return PDU length, or 0 on failure
+ */
+uint16_t modbus_pdu_encode_write_multiple(uint16_t addr, const uint16_t *values, uint16_t qty, uint8_t *pdu,
+                                          size_t size)
+{
+    if (!pdu || !values || (qty == 0) || (qty > MODBUS_MAX_WRITE_REGS) || !is_valid_address_range(addr, qty))
+    {
+        return 0;
+    }
+
+    size_t len = PDU_WRITE_MULTIPLE_HEADER_SIZE + qty * 2;
+    if (size < len)
+    {
+        return 0;
+    }
+
+    pdu[0] = MODBUS_WRITE_MULTIPLE_REGS;
+    put_u16(pdu + 1, addr);
+    put_u16(pdu + 3, qty);
+    pdu[5] = (uint8_t)(qty * 2);
+    modbus_regs_to_be(pdu + PDU_WRITE_MULTIPLE_HEADER_SIZE, values, qty);
+    return (uint16_t)len;
+}
+
+/**
+ * @brief Encode a Read/Write Multiple Registers request.
+ *
+ * @param read_addr First register to read
+ * @param read_qty Number of registers to read (1..MODBUS_MAX_REGS)
+ * @param write_addr First register to write
+ * @param values Values to store, host order
+ * @param write_qty Number of registers to write (1..MODBUS_MAX_RW_WRITE_REGS)
+ * @param pdu Output buffer
+ * @param size Size of the output buffer
+ * @return PDU length, or 0 on failure
+ */
+uint16_t modbus_pdu_encode_read_write(uint16_t read_addr, uint16_t read_qty, uint16_t write_addr,
+                                      const uint16_t *values, uint16_t write_qty, uint8_t *pdu, size_t size)
+{
+    if (!pdu || !values || !is_valid_quantity(read_qty) || !is_valid_address_range(read_addr, read_qty))
+    {
+        return 0;
+    }
+
+    if ((write_qty == 0) || (write_qty > MODBUS_MAX_RW_WRITE_REGS) || !is_valid_address_range(write_addr, write_qty))
+    {
+        return 0;
+    }
+
+    size_t len = PDU_READ_WRITE_HEADER_SIZE + write_qty * 2;
+    if (size < len)
+    {
+        return 0;
+    }
+
+    pdu[0] = MODBUS_READ_WRITE_MULTIPLE_REGS;
+    put_u16(pdu + 1, read_addr);
+    put_u16(pdu + 3, read_qty);
+    put_u16(pdu + 5, write_addr);
+    put_u16(pdu + 7, write_qty);
+    pdu[9] = (uint8_t)(write_qty * 2);
+    modbus_regs_to_be(pdu + PDU_READ_WRITE_HEADER_SIZE, values, write_qty);
+    return (uint16_t)len;
+}
+
+/**
+ * @brief Number of registers a request asks for, as its response must echo them.
+ *
+ * @param pdu Request PDU
+ * @param len Length of the request PDU
+ * @return Read quantity for 0x03, 0x04 and 0x17, write quantity for 0x06 and 0x10, or 0 if unsupported
+ */
+uint16_t modbus_pdu_request_qty(const uint8_t *pdu, size_t len)
+{
+    if (!pdu || (len < PDU_FIXED_SIZE))
+    {
+        return 0;
+    }
+
+    switch (pdu[0])
+    {
+    case MODBUS_READ_HOLDING_REG:
+    case MODBUS_READ_INPUT_REG:
+    case MODBUS_WRITE_MULTIPLE_REGS:
+    case MODBUS_READ_WRITE_MULTIPLE_REGS:
+        return get_u16(pdu + 3);
+    case MODBUS_WRITE_SINGLE_REG:
+        return 1;
+    default:
+        return 0;
+    }
+}
+
+/**
+ * @brief Decode a response PDU against the request it answers.
+ *
+ * @param req Request PDU, or at least its first MODBUS_PDU_REQUEST_HEADER_SIZE bytes
+ * @param req_len Length of req
+ * @param pdu Response PDU
+ * @param len Length of the response PDU
+ * @param regs Output register values for reads (may be NULL for writes)
+ * @param regs_len Length of the output array
+ * @return Number of registers read (0 for writes), or a negative error code:
+ *         -1: Invalid input pointers
+ *         -3: Function code mismatch
+ *         -4: Byte count or echoed address, value or quantity does not match the request
+ *         -5: PDU too short
+ *         -6: Output array too small
+ *         -8: Exception response; the exception code is pdu[1]
+ */
+int modbus_pdu_decode_response(const uint8_t *req, size_t req_len, const uint8_t *pdu, size_t len, uint16_t *regs,
+                               uint16_t regs_len)
+{
+    if (!req || !pdu || (req_len < MODBUS_PDU_REQUEST_HEADER_SIZE))
+    {
+        return -1;
+    }
+
+    uint8_t function_code = req[0];
+    uint16_t qty = modbus_pdu_request_qty(req, req_len);
+
+    if (len < PDU_EXCEPTION_SIZE)
+    {
+        return -5;
+    }
+
+    if (pdu[0] == (function_code | MODBUS_EXCEPTION_FLAG))
+    {
+        return -8;
+    }
+
+    if (pdu[0] != function_code)
+    {
+        return -3;
+    }
+
+    switch (function_code)
+    {
+    case MODBUS_READ_HOLDING_REG:
+    case MODBUS_READ_INPUT_REG:
+    case MODBUS_READ_WRITE_MULTIPLE_REGS:
+        if (!regs)
+        {
+            return -1;
+        }
+        if (!is_valid_quantity(qty) || (pdu[1] != qty * 2))
+        {
+            return -4;
+        }
+        if (len < (size_t)PDU_READ_RESPONSE_HEADER_SIZE + pdu[1])
+        {
+            return -5;
+        }
+        if (regs_len < qty)
+        {
+            return -6;
+        }
+        modbus_regs_from_be(regs, pdu + PDU_READ_RESPONSE_HEADER_SIZE, qty);
+        return qty;
+    case MODBUS_WRITE_SINGLE_REG:
+    case MODBUS_WRITE_MULTIPLE_REGS:
+        if (len < PDU_FIXED_SIZE)
+        {
+            return -5;
+        }
+        /* 0x06 echoes address and value, 0x10 address and quantity */
+        return (memcmp(pdu + 1, req + 1, PDU_FIXED_SIZE - 1) != 0) ? -4 : 0;
+    default:
+        return -3;
+    }
+}
@@ -0,0 +1,222 @@
+/**
+ * @file modbus_planner.c
+ * @brief Read planner that coalesces scattered points into few requests.
+ *
+ * Points are sorted through packed 64-bit keys, (unit << 48) |
+ * (address << 32) | index, so a plain qsort() on integers orders them
+ * and the index rides along without a context-aware comparator.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "modbus_planner.h"
+#include "modbus_utils.h"
+
+/**
+ * @brief qsort() comparator for packed point keys.
+ */
+static int compare_keys(const void *a, const void *b)
+{
+    uint64_t ka = *(const uint64_t *)a;
+    uint64_t kb = *(const uint64_t *)b;
+    return (ka > kb) - (ka < kb);
+}
+
+/**
+ * @brief Plan the reads for a point list.
+ *
+ * @param plan Plan to build
+ * @param points Points to cover; their values are updated by the scatter step
+ * @param count Number of points
+ * @param max_gap Largest run of unused registers a read may carry between two points
+ * @return Number of planned reads, or a negative error code:
+ *         -1: Invalid input pointers
+ *         -2: A point has an invalid unit ID, or count does not fit 32 bits
+ *         -3: Out of memory
+ */
+int modbus_read_plan_build(modbus_read_plan_st *plan, modbus_point_st *points, size_t count, uint16_t max_gap)
+{
+    if (!plan || (!points && count > 0))
+    {
+        return -1;
+    }
+
+    memset(plan, 0, sizeof(*plan));
+
+    if (count > UINT32_MAX)
+    {
+        return -2;
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        if (points[i].unit_id == 0 || !is_valid_slave_id(points[i].unit_id))
+        {
+            return -2;
+        }
+    }
+
+    if (count == 0)
+    {
+        return 0;
+    }
+
+    uint64_t *keys = malloc(count * sizeof(*keys));
+    plan->order = malloc(count * sizeof(*plan->order));
+    plan->reads = malloc(count * sizeof(*plan->reads));
+    if (!keys || !plan->order || !plan->reads)
+    {
+        free(keys);
+        modbus_read_plan_free(plan);
+        return -3;
+    }
+
+    for (size_t i = 0; i < count; i++)
+    {
+        keys[i] = ((uint64_t)points[i].unit_id << 48) | ((uint64_t)points[i].addr << 32) | i;
+    }
+    qsort(keys, count, sizeof(*keys), compare_keys);
+
+    modbus_planned_read_st *read = NULL;
+    uint16_t last_addr = 0;
+    size_t n = 0;
+
+    for (size_t i = 0; i < count; i++)
+    {
+        uint8_t unit_id = (uint8_t)(keys[i] >> 48);
+        uint16_t addr = (uint16_t)(keys[i] >> 32);
+        plan->order[i] = (uint32_t)keys[i];
+
+        // Duplicates give a step of 0, adjacent registers a step of 1
+        bool same_read = read && (read->unit_id == unit_id) &&
+                         ((uint32_t)(addr - last_addr) <= (uint32_t)max_gap + 1u) &&
+                         ((uint32_t)(addr - read->start_addr) < MODBUS_MAX_REGS);
+        if (!same_read)
+        {
+            read = &plan->reads[n++];
+            read->unit_id = unit_id;
+            read->start_addr = addr;
+            read->first = (uint32_t)i;
+            read->count = 0;
+        }
+
+        read->qty = (uint16_t)(addr - read->start_addr + 1);
+        read->count++;
+        last_addr = addr;
+    }
+
+    free(keys);
+    plan->points = points;
+    plan->read_count = n;
+    return (int)n;
+}
+
+/**
+ * @brief Release the plan.
+ *
+ * @param plan Plan
+ */
+void modbus_read_plan_free(modbus_read_plan_st *plan)
+{
+    if (!plan)
+    {
+        return;
+    }
+
+    free(plan->order);
+    free(plan->reads);
+    plan->order = NULL;
+    plan->reads = NULL;
+    plan->points = NULL;
+    plan->read_count = 0;
+}
+
+/**
+ * @brief Copy the registers of a read into its points.
+ *
+ * @param plan Plan
+ * @param index Index of the read in plan->reads
+ * @param regs Decoded registers, regs[0] is the read's start address
+ * @param qty Number of decoded registers
+ * @return Number of points updated, or a negative error code:
+ *         -1: Invalid input pointers or index
+ *         -2: qty differs from the planned read
+ */
+int modbus_read_plan_scatter(const modbus_read_plan_st *plan, size_t index, const uint16_t *regs, uint16_t qty)
+{
+    if (!plan || !regs || index >= plan->read_count)
+    {
+        return -1;
+    }
+
+    const modbus_planned_read_st *read = &plan->reads[index];
+    if (qty != read->qty)
+    {
+        return -2;
+    }
+
+    const uint32_t *order = &plan->order[read->first];
+    for (uint32_t i = 0; i < read->count; i++)
+    {
+        modbus_point_st *point = &plan->points[order[i]];
+        point->value = regs[point->addr - read->start_addr];
+    }
+
+    return (int)read->count;
+}
+
+/**
+ * @brief Encode the RTU request of a planned read.
+ *
+ * @param plan Plan
+ * @param index Index of the read in plan->reads
+ * @param ctx Master context, records the slave expected to answer
+ * @param buffer Output buffer
+ * @param bufsize Size of the output buffer
+ * @return Length of the encoded request in bytes, or 0 on failure
+ */
+uint16_t modbus_read_plan_encode(const modbus_read_plan_st *plan, size_t index, modbus_master_ctx_st *ctx,
+                                 uint8_t *buffer, size_t bufsize)
+{
+    if (!plan || index >= plan->read_count)
+    {
+        return 0;
+    }
+
+    const modbus_planned_read_st *read = &plan->reads[index];
+    return encode_read_request(ctx, read->unit_id, read->start_addr, read->qty, buffer, bufsize);
+}
+
+/**
+ * @brief Decode the RTU response of a planned read and scatter it into its points.
+ *
+ * @param plan Plan
+ * @param index Index of the read in plan->reads
+ * @param ctx Master context used to encode the request
+ * @param buffer Buffer containing the response
+ * @param bufsize Size of the buffer
+ * @return Number of points updated, a decode_read_response() error code (-1..-7),
+ *         or -8 if the response carries a different number of registers than planned
+ */
+int modbus_read_plan_decode(const modbus_read_plan_st *plan, size_t index, const modbus_master_ctx_st *ctx,
+                            const uint8_t *buffer, size_t bufsize)
+{
+    if (!plan || index >= plan->read_count)
+    {
+        return -1;
+    }
+
+    uint16_t regs[MODBUS_MAX_REGS];
+    int ret = decode_read_response(ctx, buffer, bufsize, regs, MODBUS_MAX_REGS);
+    if (ret < 0)
+    {
+        return ret;
+    }
+
+    if (ret != plan->reads[index].qty)
+    {
+        return -8;
+    }
+
+    return modbus_read_plan_scatter(plan, index, regs, (uint16_t)ret);
+}
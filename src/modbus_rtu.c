@@ -0,0 +1,482 @@
+/**
+ * @file modbus_rtu.c
+ * @brief Modbus RTU transport on a serial line (termios).
+ *
+ * VMIN and VTIME are left at zero: VTIME counts in tenths of a second,
+ * far too coarse for t3.5 (1.75 ms above 19200 baud). The line is polled
+ * together with a timerfd armed on absolute CLOCK_MONOTONIC deadlines,
+ * first for the response timeout, then t3.5 after every chunk received.
+ */
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/timerfd.h>
+
+#include "modbus_rtu.h"
+
+/**
+ * @brief Standard baud rates and their termios speeds.
+ */
+static const struct
+{
+    uint32_t baud;
+    speed_t speed;
+} baud_rates[] = {
+    {1200, B1200},     {2400, B2400},     {4800, B4800},     {9600, B9600},
+    {19200, B19200},   {38400, B38400},   {57600, B57600},   {115200, B115200},
+    {230400, B230400}, {460800, B460800}, {921600, B921600},
+};
+
+/**
+ * @brief CLOCK_MONOTONIC in nanoseconds.
+ */
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief Convert nanoseconds of CLOCK_MONOTONIC to a timespec.
+ */
+static struct timespec to_timespec(uint64_t ns)
+{
+    struct timespec ts = {
+        .tv_sec = (time_t)(ns / 1000000000ull),
+        .tv_nsec = (long)(ns % 1000000000ull),
+    };
+    return ts;
+}
+
+/**
+ * @brief Sleep until an absolute CLOCK_MONOTONIC time; returns at once if it has passed.
+ */
+static void sleep_until(uint64_t at_ns)
+{
+    if (at_ns <= now_ns())
+    {
+        return;
+    }
+    struct timespec ts = to_timespec(at_ns);
+    while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR)
+    {
+    }
+}
+
+/**
+ * @brief Arm the timer for an absolute CLOCK_MONOTONIC time (0 disarms it).
+ *
+ * Setting the timer also clears any expiry not yet read.
+ */
+static int arm_timer(modbus_rtu_st *rtu, uint64_t at_ns)
+{
+    struct itimerspec its = {.it_value = to_timespec(at_ns)};
+    return timerfd_settime(rtu->timer_fd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
+/**
+ * @brief Wait until the line has bytes or the timer expires.
+ *
+ * @return 1 if the line is readable, 0 if the timer expired, -1 on error or hang-up
+ */
+static int wait_event(modbus_rtu_st *rtu)
+{
+    struct pollfd fds[2] = {
+        {.fd = rtu->fd, .events = POLLIN},
+        {.fd = rtu->timer_fd, .events = POLLIN},
+    };
+
+    for (;;)
+    {
+        if (poll(fds, 2, -1) < 0)
+        {
+            if (errno == EINTR)
+            {
+                continue;
+            }
+            return -1;
+        }
+
+        // Bytes that raced the timer still belong to the frame
+        if (fds[0].revents & POLLIN)
+        {
+            return 1;
+        }
+        if (fds[0].revents & (POLLERR | POLLHUP | POLLNVAL))
+        {
+            return -1;
+        }
+        if (fds[1].revents & POLLIN)
+        {
+            uint64_t expirations;
+            if (read(rtu->timer_fd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN)
+            {
+                return -1;
+            }
+            return 0;
+        }
+    }
+}
+
+/**
+ * @brief Read and count every byte already waiting on the line.
+ */
+static void drain_input(modbus_rtu_st *rtu)
+{
+    uint8_t scratch[MODBUS_RTU_MAX_ADU_SIZE];
+    ssize_t n;
+
+    while ((n = read(rtu->fd, scratch, sizeof(scratch))) > 0)
+    {
+        rtu->stats.dropped_bytes += (uint64_t)n;
+    }
+}
+
+/**
+ * @brief Open and configure a serial device.
+ *
+ * @param rtu Transport to initialize
+ * @param path Device path
+ * @param cfg Line settings
+ * @return 0 on success, or a negative error code
+ */
+int modbus_rtu_open(modbus_rtu_st *rtu, const char *path, const modbus_rtu_config_st *cfg)
+{
+    if (!rtu || !path || !cfg)
+    {
+        return -1;
+    }
+
+    int fd = open(path, O_RDWR | O_NOCTTY | O_NONBLOCK | O_CLOEXEC);
+    if (fd < 0)
+    {
+        return -2;
+    }
+    return modbus_rtu_init(rtu, fd, cfg);
+}
+
+/**
+ * @brief Configure an already open serial line or pseudo-terminal.
+ *
+ * @param rtu Transport to initialize
+ * @param fd Open descriptor, owned by the transport from now on
+ * @param cfg Line settings
+ * @return 0 on success, or a negative error code
+ */
+int modbus_rtu_init(modbus_rtu_st *rtu, int fd, const modbus_rtu_config_st *cfg)
+{
+    speed_t speed = 0;
+
+    if (cfg)
+    {
+        for (size_t i = 0; i < sizeof(baud_rates) / sizeof(baud_rates[0]); i++)
+        {
+            if (baud_rates[i].baud == cfg->baud)
+            {
+                speed = baud_rates[i].speed;
+            }
+        }
+    }
+
+    if (!rtu || (fd < 0) || (speed == 0) || ((cfg->parity != 'E') && (cfg->parity != 'O') && (cfg->parity != 'N')) ||
+        ((cfg->stop_bits != 1) && (cfg->stop_bits != 2)) ||
+        ((cfg->rx_mode != MODBUS_STREAM_RTU_REQUEST) && (cfg->rx_mode != MODBUS_STREAM_RTU_RESPONSE)))
+    {
+        if (fd >= 0)
+        {
+            close(fd);
+        }
+        return -1;
+    }
+
+    memset(rtu, 0, sizeof(*rtu));
+    rtu->fd = fd;
+    rtu->timer_fd = -1;
+    rtu->rx_mode = cfg->rx_mode;
+    rtu->response_timeout_us = cfg->response_timeout_us;
+    rtu->turnaround_ns = (uint64_t)cfg->turnaround_us * 1000u;
+
+    struct termios tio;
+    if (tcgetattr(fd, &tio) != 0)
+    {
+        modbus_rtu_close(rtu);
+        return -3;
+    }
+    cfmakeraw(&tio);
+    tio.c_cflag &= ~(tcflag_t)(PARENB | PARODD | CSTOPB);
+    tio.c_cflag |= CLOCAL | CREAD;
+    if (cfg->parity != 'N')
+    {
+        tio.c_cflag |= PARENB;
+    }
+    if (cfg->parity == 'O')
+    {
+        tio.c_cflag |= PARODD;
+    }
+    if (cfg->stop_bits == 2)
+    {
+        tio.c_cflag |= CSTOPB;
+    }
+    tio.c_cc[VMIN] = 0;
+    tio.c_cc[VTIME] = 0;
+    if ((cfsetispeed(&tio, speed) != 0) || (cfsetospeed(&tio, speed) != 0) || (tcsetattr(fd, TCSANOW, &tio) != 0))
+    {
+        modbus_rtu_close(rtu);
+        return -3;
+    }
+
+    int flags = fcntl(fd, F_GETFL);
+    if ((flags < 0) || (fcntl(fd, F_SETFL, flags | O_NONBLOCK) < 0))
+    {
+        modbus_rtu_close(rtu);
+        return -3;
+    }
+
+    rtu->timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC);
+    if (rtu->timer_fd < 0)
+    {
+        modbus_rtu_close(rtu);
+        return -4;
+    }
+
+    // Start bit, 8 data bits, optional parity bit, stop bits
+    uint32_t bits = 1u + 8u + ((cfg->parity != 'N') ? 1u : 0u) + cfg->stop_bits;
+    rtu->char_ns = (uint64_t)bits * 1000000000ull / cfg->baud;
+    if (cfg->baud > 19200)
+    {
+        rtu->t15_ns = MODBUS_RTU_T15_FIXED_NS;
+        rtu->t35_ns = MODBUS_RTU_T35_FIXED_NS;
+    }
+    else
+    {
+        rtu->t15_ns = rtu->char_ns * 3u / 2u;
+        rtu->t35_ns = rtu->char_ns * 7u / 2u;
+    }
+    return 0;
+}
+
+/**
+ * @brief Close the line and the timer.
+ *
+ * @param rtu Transport
+ */
+void modbus_rtu_close(modbus_rtu_st *rtu)
+{
+    if (!rtu)
+    {
+        return;
+    }
+    if (rtu->fd >= 0)
+    {
+        close(rtu->fd);
+        rtu->fd = -1;
+    }
+    if (rtu->timer_fd >= 0)
+    {
+        close(rtu->timer_fd);
+        rtu->timer_fd = -1;
+    }
+}
+
+/**
+ * @brief Send one frame as soon as the line has been silent for t3.5.
+ *
+ * @param rtu Transport
+ * @param frame Complete RTU frame
+ * @param len Length of the frame
+ * @return 0 once the last character has left, or a negative error code
+ */
+int modbus_rtu_send(modbus_rtu_st *rtu, const uint8_t *frame, size_t len)
+{
+    if (!rtu || !frame || (len == 0) || (len > MODBUS_RTU_MAX_ADU_SIZE))
+    {
+        return -1;
+    }
+
+    sleep_until(rtu->line_idle_ns + rtu->t35_ns);
+    if (rtu->flush_input)
+    {
+        drain_input(rtu);
+        rtu->flush_input = false;
+    }
+
+    uint64_t start_ns = now_ns();
+    size_t off = 0;
+    while (off < len)
+    {
+        ssize_t n = write(rtu->fd, frame + off, len - off);
+        if (n >= 0)
+        {
+            off += (size_t)n;
+        }
+        else if (errno == EAGAIN)
+        {
+            struct pollfd pfd = {.fd = rtu->fd, .events = POLLOUT};
+            poll(&pfd, 1, -1);
+        }
+        else if (errno != EINTR)
+        {
+            return -2;
+        }
+    }
+
+    // The line is ours until the last character is out; a slave must not answer before that
+    uint64_t wire_ns = (uint64_t)len * rtu->char_ns;
+    rtu->line_idle_ns = start_ns + wire_ns;
+    sleep_until(rtu->line_idle_ns);
+
+    rtu->stats.frames_sent++;
+    rtu->stats.busy_ns += wire_ns;
+    return 0;
+}
+
+/**
+ * @brief Receive one frame.
+ *
+ * @param rtu Transport
+ * @param buf Output buffer
+ * @param size Size of the output buffer
+ * @param timeout_us Wait for the first byte (0 = forever)
+ * @return Frame length, 0 on timeout, or a negative error code
+ */
+int modbus_rtu_recv(modbus_rtu_st *rtu, uint8_t *buf, size_t size, uint32_t timeout_us)
+{
+    if (!rtu || !buf || (size == 0))
+    {
+        return -1;
+    }
+
+    uint8_t scratch[MODBUS_RTU_MAX_ADU_SIZE];
+    size_t len = 0;
+    size_t total = 0;
+    uint64_t first_ns = 0;
+    uint64_t last_ns = 0;
+
+    if (arm_timer(rtu, (timeout_us != 0) ? now_ns() + (uint64_t)timeout_us * 1000u : 0) != 0)
+    {
+        return -2;
+    }
+
+    for (;;)
+    {
+        int ev = wait_event(rtu);
+        if (ev < 0)
+        {
+            return -2;
+        }
+        if (ev == 0)
+        {
+            if (total == 0)
+            {
+                rtu->stats.timeouts++;
+                return 0;
+            }
+            // t3.5 of silence: whatever arrived is the frame
+            break;
+        }
+
+        // Past the end of the buffer the rest of the frame is read and thrown away
+        bool overflow = (len == size);
+        ssize_t n = overflow ? read(rtu->fd, scratch, sizeof(scratch)) : read(rtu->fd, buf + len, size - len);
+        if (n < 0 && ((errno == EAGAIN) || (errno == EINTR)))
+        {
+            continue;
+        }
+        if (n <= 0)
+        {
+            return -2;
+        }
+
+        uint64_t now = now_ns();
+        if (total == 0)
+        {
+            first_ns = now;
+        }
+        else if (now - last_ns > rtu->t15_ns)
+        {
+            rtu->stats.char_gaps++;
+        }
+        last_ns = now;
+        total += (size_t)n;
+
+        if (overflow)
+        {
+            rtu->stats.dropped_bytes += (uint64_t)n;
+        }
+        else
+        {
+            len += (size_t)n;
+            int frame_len = modbus_frame_length(rtu->rx_mode, buf, len);
+            if ((frame_len > 0) && (len >= (size_t)frame_len))
+            {
+                rtu->stats.dropped_bytes += len - (size_t)frame_len;
+                len = (size_t)frame_len;
+                break;
+            }
+        }
+
+        if (arm_timer(rtu, last_ns + rtu->t35_ns) != 0)
+        {
+            return -2;
+        }
+    }
+
+    // The last character left the sender no earlier than the first one plus the rest
+    uint64_t end_ns = first_ns + (uint64_t)(total - 1) * rtu->char_ns;
+    rtu->line_idle_ns = (end_ns > last_ns) ? end_ns : last_ns;
+    rtu->stats.busy_ns += (uint64_t)total * rtu->char_ns;
+
+    if (len == size && total > size)
+    {
+        return -3;
+    }
+    rtu->stats.frames_received++;
+    return (int)len;
+}
+
+/**
+ * @brief Send a request and receive its answer.
+ *
+ * @param arg Transport (modbus_rtu_st *)
+ * @param request Encoded RTU request
+ * @param len Length of the request
+ * @param response Output buffer for the response
+ * @param size Size of the output buffer
+ * @return Length of the response, 0 on timeout or after a broadcast, or negative on error
+ */
+int modbus_rtu_transact(void *arg, const uint8_t *request, size_t len, uint8_t *response, size_t size)
+{
+    modbus_rtu_st *rtu = arg;
+    if (!rtu || !request || (len == 0) || !response)
+    {
+        return -1;
+    }
+
+    int rc = modbus_rtu_send(rtu, request, len);
+    if (rc != 0)
+    {
+        return rc;
+    }
+
+    // Nobody answers a broadcast; the slaves get the turnaround delay to act on it
+    if (request[0] == BROADCAST_SLAVE_ID)
+    {
+        rtu->line_idle_ns += rtu->turnaround_ns;
+        return 0;
+    }
+
+    int n = modbus_rtu_recv(rtu, response, size, rtu->response_timeout_us);
+    if (n <= 0)
+    {
+        // A late answer must not be taken for the answer to the next request
+        rtu->flush_input = true;
+    }
+    return n;
+}
@@ -0,0 +1,376 @@
+/**
+ * @file modbus_scheduler.c
+ * @brief Earliest-deadline-first polling scheduler for one RTU bus.
+ *
+ * Picking the next group is a linear scan. A bus has at most a few hundred
+ * groups and each transaction takes milliseconds on the wire, so the scan
+ * is noise next to it and keeps release times, deadlines and priorities
+ * in one place without a heap to maintain.
+ *
+ * Adaptive groups detect changes with modbus_cov on the decoded registers,
+ * with no deadband: any new value counts.
+ */
+#define _GNU_SOURCE
+
+#include <string.h>
+#include <time.h>
+
+#include "modbus_scheduler.h"
+#include "modbus_utils.h"
+
+/**
+ * @brief CLOCK_MONOTONIC in microseconds.
+ */
+static uint64_t monotonic_now_us(void *arg)
+{
+    (void)arg;
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000u + (uint64_t)ts.tv_nsec / 1000u;
+}
+
+/**
+ * @brief nanosleep() for a number of microseconds.
+ */
+static void monotonic_sleep_us(void *arg, uint64_t us)
+{
+    (void)arg;
+    struct timespec ts = {
+        .tv_sec = (time_t)(us / 1000000u),
+        .tv_nsec = (long)(us % 1000000u) * 1000,
+    };
+    nanosleep(&ts, NULL);
+}
+
+/**
+ * @brief Whether group a should run before group b.
+ */
+static inline bool more_urgent(const modbus_scan_group_st *a, const modbus_scan_group_st *b)
+{
+    if (a->deadline_us != b->deadline_us)
+    {
+        return a->deadline_us < b->deadline_us;
+    }
+    return a->cfg.priority > b->cfg.priority;
+}
+
+/**
+ * @brief Whether a group adapts its period.
+ */
+static inline bool is_adaptive(const modbus_scan_group_config_st *cfg)
+{
+    return (cfg->min_period_us != 0) || (cfg->max_period_us != 0);
+}
+
+/**
+ * @brief Halve the period of a group whose values changed, stretch it by half otherwise.
+ */
+static void adapt_period(modbus_scan_group_st *group, const uint16_t *regs)
+{
+    modbus_cov_changes_st changes;
+    bool first = !group->cov.primed;
+    int changed = modbus_cov_update(&group->cov, regs, &changes);
+
+    // The first poll has nothing to compare with
+    if (first || (changed < 0))
+    {
+        return;
+    }
+
+    uint64_t period = group->period_us;
+    if (changed > 0)
+    {
+        group->stats.changes++;
+        period /= 2;
+        if (period < group->cfg.min_period_us)
+        {
+            period = group->cfg.min_period_us;
+        }
+    }
+    else
+    {
+        period += (period / 2) + 1;
+        if (period > group->cfg.max_period_us)
+        {
+            period = group->cfg.max_period_us;
+        }
+    }
+    group->period_us = (uint32_t)period;
+}
+
+/**
+ * @brief Run one poll of a group on the bus.
+ *
+ * @return true if the registers were received and delivered
+ */
+static bool run_transaction(modbus_scheduler_st *sched, modbus_scan_group_st *group)
+{
+    uint8_t request[8];
+    uint8_t response[MODBUS_RTU_MAX_ADU_SIZE];
+    uint16_t regs[MODBUS_MAX_REGS];
+    const modbus_scan_group_config_st *cfg = &group->cfg;
+
+    uint16_t len = encode_read_request(&sched->master, cfg->unit_id, cfg->start_addr, cfg->qty, request,
+                                       sizeof(request));
+    if (len == 0)
+    {
+        return false;
+    }
+
+    int n = sched->transport.transact(sched->transport.arg, request, len, response, sizeof(response));
+    if (n <= 0)
+    {
+        return false;
+    }
+
+    if (decode_read_response(&sched->master, response, (size_t)n, regs, MODBUS_MAX_REGS) != cfg->qty)
+    {
+        return false;
+    }
+
+    if (cfg->on_data)
+    {
+        cfg->on_data(cfg->arg, group, regs, cfg->qty);
+    }
+    if (is_adaptive(cfg))
+    {
+        adapt_period(group, regs);
+    }
+    return true;
+}
+
+/**
+ * @brief Move a group to its next period, dropping the periods that already ended.
+ */
+static void release_next(modbus_scan_group_st *group, uint64_t now)
+{
+    uint64_t period = group->period_us;
+
+    group->release_us += period;
+    if (group->release_us + period <= now)
+    {
+        uint64_t missed = (now - group->release_us) / period;
+        group->release_us += missed * period;
+        group->stats.skipped += missed;
+    }
+    group->deadline_us = group->release_us + period;
+}
+
+/**
+ * @brief Initialize a scheduler.
+ *
+ * @param sched Scheduler to initialize
+ * @param groups Storage for the groups (must outlive the scheduler)
+ * @param capacity Number of entries in groups
+ * @param transport Bus transport
+ * @param clock Time source, or NULL for CLOCK_MONOTONIC
+ * @return 0 on success, or -1 on invalid arguments
+ */
+int modbus_scheduler_init(modbus_scheduler_st *sched, modbus_scan_group_st *groups, uint32_t capacity,
+                          const modbus_transport_st *transport, const modbus_clock_st *clock)
+{
+    if (!sched || !groups || capacity == 0 || !transport || !transport->transact)
+    {
+        return -1;
+    }
+
+    if (clock && (!clock->now_us != !clock->sleep_us))
+    {
+        return -1;
+    }
+
+    memset(sched, 0, sizeof(*sched));
+    sched->groups = groups;
+    sched->capacity = capacity;
+    sched->transport = *transport;
+
+    if (clock && clock->now_us)
+    {
+        sched->clock = *clock;
+    }
+    else
+    {
+        sched->clock.now_us = monotonic_now_us;
+        sched->clock.sleep_us = monotonic_sleep_us;
+    }
+
+    modbus_master_ctx_init(&sched->master);
+    return 0;
+}
+
+/**
+ * @brief Add a scan group, first released now.
+ *
+ * @param sched Scheduler
+ * @param cfg Group configuration
+ * @return Index of the group, or a negative error code:
+ *         -1: Invalid input pointers
+ *         -2: Invalid configuration (including an adaptive range that does not hold period_us)
+ *         -3: No free group slot
+ */
+int modbus_scheduler_add(modbus_scheduler_st *sched, const modbus_scan_group_config_st *cfg)
+{
+    if (!sched || !cfg)
+    {
+        return -1;
+    }
+
+    if (cfg->unit_id == 0 || !is_valid_slave_id(cfg->unit_id) || !is_valid_quantity(cfg->qty) ||
+        !is_valid_address_range(cfg->start_addr, cfg->qty) || cfg->period_us == 0)
+    {
+        return -2;
+    }
+
+    if (is_adaptive(cfg) &&
+        ((cfg->min_period_us == 0) || (cfg->min_period_us > cfg->period_us) || (cfg->period_us > cfg->max_period_us)))
+    {
+        return -2;
+    }
+
+    if (sched->count == sched->capacity)
+    {
+        return -3;
+    }
+
+    modbus_scan_group_st *group = &sched->groups[sched->count];
+    memset(group, 0, sizeof(*group));
+    group->cfg = *cfg;
+    group->period_us = cfg->period_us;
+    group->release_us = modbus_scheduler_now(sched);
+    group->deadline_us = group->release_us + cfg->period_us;
+    if (is_adaptive(cfg))
+    {
+        modbus_cov_init(&group->cov, cfg->start_addr, cfg->qty, NULL, false);
+    }
+    return (int)sched->count++;
+}
+
+/**
+ * @brief Run the most urgent released group, if any.
+ *
+ * @param sched Scheduler
+ * @param wait_us Output: when nothing is released, the time until the next release (may be NULL)
+ * @return Index of the group polled, -1 on invalid arguments, or -2 if no group is released yet
+ */
+int modbus_scheduler_poll(modbus_scheduler_st *sched, uint64_t *wait_us)
+{
+    if (!sched)
+    {
+        return -1;
+    }
+
+    uint64_t now = modbus_scheduler_now(sched);
+    uint64_t next_release = UINT64_MAX;
+    modbus_scan_group_st *best = NULL;
+
+    for (uint32_t i = 0; i < sched->count; i++)
+    {
+        modbus_scan_group_st *group = &sched->groups[i];
+        if (group->release_us > now)
+        {
+            if (group->release_us < next_release)
+            {
+                next_release = group->release_us;
+            }
+        }
+        else if (!best || more_urgent(group, best))
+        {
+            best = group;
+        }
+    }
+
+    if (!best)
+    {
+        if (wait_us)
+        {
+            *wait_us = (next_release == UINT64_MAX) ? UINT64_MAX : next_release - now;
+        }
+        return -2;
+    }
+
+    uint64_t jitter = now - best->release_us;
+    best->stats.jitter_sum_us += jitter;
+    if (jitter > best->stats.jitter_max_us)
+    {
+        best->stats.jitter_max_us = (jitter > UINT32_MAX) ? UINT32_MAX : (uint32_t)jitter;
+    }
+
+    best->stats.polls++;
+    if (!run_transaction(sched, best))
+    {
+        best->stats.failures++;
+    }
+
+    uint64_t end = modbus_scheduler_now(sched);
+    if (end > best->deadline_us)
+    {
+        best->stats.overruns++;
+    }
+
+    release_next(best, end);
+    return (int)(best - sched->groups);
+}
+
+/**
+ * @brief Poll groups until the given time or until stopped.
+ *
+ * @param sched Scheduler
+ * @param until_us Clock time to return at
+ * @return Number of transactions run, or -1 on invalid arguments
+ */
+int64_t modbus_scheduler_run(modbus_scheduler_st *sched, uint64_t until_us)
+{
+    if (!sched)
+    {
+        return -1;
+    }
+
+    int64_t transactions = 0;
+    while (!atomic_load_explicit(&sched->stop, memory_order_acquire))
+    {
+        uint64_t now = modbus_scheduler_now(sched);
+        if (now >= until_us)
+        {
+            break;
+        }
+
+        uint64_t wait;
+        if (modbus_scheduler_poll(sched, &wait) >= 0)
+        {
+            transactions++;
+            continue;
+        }
+
+        if (wait > until_us - now)
+        {
+            wait = until_us - now;
+        }
+        sched->clock.sleep_us(sched->clock.arg, wait);
+    }
+
+    return transactions;
+}
+
+/**
+ * @brief Make modbus_scheduler_run() return after the current transaction.
+ *
+ * @param sched Scheduler
+ */
+void modbus_scheduler_stop(modbus_scheduler_st *sched)
+{
+    if (sched)
+    {
+        atomic_store_explicit(&sched->stop, true, memory_order_release);
+    }
+}
+
+/**
+ * @brief Current time on the scheduler's clock.
+ *
+ * @param sched Scheduler
+ * @return Time in microseconds
+ */
+uint64_t modbus_scheduler_now(const modbus_scheduler_st *sched)
+{
+    return sched->clock.now_us(sched->clock.arg);
+}
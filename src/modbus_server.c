@@ -0,0 +1,589 @@
+/**
+ * @file modbus_server.c
+ * @brief Edge-triggered epoll Modbus TCP slave server.
+ *
+ * Every socket is non-blocking and registered once with EPOLLET for both
+ * directions. On each event a connection is serviced until it would block:
+ * read into the receive ring until EAGAIN, answer every complete request
+ * that fits in the transmit buffer, then send until EAGAIN. A connection
+ * whose ring filled up before the socket was drained keeps its readable
+ * flag, since no new edge will be reported for bytes already queued.
+ */
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+
+#include "modbus_server.h"
+#include "modbus_tcp.h"
+
+/** @brief Events fetched per epoll_wait() call */
+#define SERVER_MAX_EVENTS 256
+
+/** @brief epoll token of the listening socket */
+#define TOKEN_LISTEN UINT64_MAX
+
+/** @brief epoll token of the stop eventfd */
+#define TOKEN_WAKE (UINT64_MAX - 1)
+
+/** @brief End of the free list */
+#define NO_SLOT UINT32_MAX
+
+/**
+ * @brief Return a connection slot to the free list.
+ */
+static void conn_release(modbus_server_st *srv, uint32_t slot)
+{
+    modbus_server_conn_st *c = &srv->conns[slot];
+
+    close(c->fd);
+    c->fd = -1;
+    c->next_free = srv->free_head;
+    srv->free_head = slot;
+    srv->active--;
+    modbus_stats_add(&srv->stats.closed, 1);
+}
+
+/**
+ * @brief Accept every pending connection on the listening socket.
+ */
+static void accept_all(modbus_server_st *srv)
+{
+    for (;;)
+    {
+        int fd = accept4(srv->listen_fd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd < 0)
+        {
+            if (errno == EINTR || errno == ECONNABORTED)
+            {
+                continue;
+            }
+            return; // EAGAIN, or out of descriptors: retried on the next connection
+        }
+
+        if (srv->free_head == NO_SLOT)
+        {
+            close(fd);
+            modbus_stats_add(&srv->stats.rejected, 1);
+            continue;
+        }
+
+        uint32_t slot = srv->free_head;
+        modbus_server_conn_st *c = &srv->conns[slot];
+
+        int one = 1;
+        setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+        struct epoll_event ev = {.events = EPOLLIN | EPOLLOUT | EPOLLRDHUP | EPOLLET, .data.u64 = slot};
+        if (epoll_ctl(srv->epoll_fd, EPOLL_CTL_ADD, fd, &ev) < 0)
+        {
+            close(fd);
+            modbus_stats_add(&srv->stats.rejected, 1);
+            continue;
+        }
+
+        srv->free_head = c->next_free;
+        c->fd = fd;
+        c->readable = true;
+        c->tx_len = 0;
+        modbus_stream_reset(&c->rx);
+        srv->active++;
+        modbus_stats_add(&srv->stats.accepted, 1);
+    }
+}
+
+/**
+ * @brief Read from the socket until EAGAIN or until the receive ring is full.
+ *
+ * @return Bytes received, or -1 if the connection must be closed
+ */
+static ssize_t conn_fill(modbus_server_st *srv, modbus_server_conn_st *c)
+{
+    ssize_t total = 0;
+
+    while (c->readable)
+    {
+        size_t avail;
+        uint8_t *dst = modbus_stream_write_ptr(&c->rx, &avail);
+        if (!dst)
+        {
+            break;
+        }
+
+        ssize_t n = recv(c->fd, dst, avail, 0);
+        if (n > 0)
+        {
+            modbus_stream_commit(&c->rx, (size_t)n);
+            modbus_stats_add(&srv->stats.rx_bytes, (uint64_t)n);
+            total += n;
+        }
+        else if (n == 0)
+        {
+            return -1;
+        }
+        else if (errno == EAGAIN || errno == EWOULDBLOCK)
+        {
+            c->readable = false;
+        }
+        else if (errno != EINTR)
+        {
+            return -1;
+        }
+    }
+
+    return total;
+}
+
+/**
+ * @brief Answer one request into the transmit buffer.
+ */
+static void handle_request(modbus_server_st *srv, modbus_server_conn_st *c, const uint8_t *frame, size_t len)
+{
+    uint16_t tid, pdu_len;
+    uint8_t unit_id = frame[MODBUS_MBAP_HEADER_SIZE - 1];
+
+    // The stream only yields frames with a valid MBAP header, so unit and function code are there
+    modbus_stats_frame(srv->stats_shard, unit_id, frame[MODBUS_MBAP_HEADER_SIZE]);
+
+    const modbus_host_unit_st *unit = modbus_host_unit(srv->host, unit_id);
+    if (!unit)
+    {
+        modbus_stats_error(srv->stats_shard, MODBUS_STATS_SLAVE, unit_id, -4);
+        modbus_stats_add(&srv->stats.errors, 1);
+        return;
+    }
+
+    if (decode_mbap_header(frame, len, &tid, &unit_id, &pdu_len) != (int)len)
+    {
+        modbus_stats_error(srv->stats_shard, MODBUS_STATS_SLAVE, unit_id, -2);
+        modbus_stats_add(&srv->stats.errors, 1);
+        return;
+    }
+
+    // Build the response in place: MBAP header here, PDU written by the unit's sources
+    uint8_t *out = c->tx + c->tx_len;
+    int resp_len = modbus_host_dispatch(unit, unit_id, frame + MODBUS_MBAP_HEADER_SIZE, pdu_len,
+                                        out + MODBUS_MBAP_HEADER_SIZE);
+    if (resp_len < 0)
+    {
+        modbus_stats_error(srv->stats_shard, MODBUS_STATS_SLAVE, unit_id, -2);
+        modbus_stats_add(&srv->stats.errors, 1);
+        return;
+    }
+    encode_mbap_header(tid, unit_id, (uint16_t)resp_len, out, sizeof(c->tx) - c->tx_len);
+    c->tx_len += MODBUS_MBAP_HEADER_SIZE + (size_t)resp_len;
+
+    if (out[MODBUS_MBAP_HEADER_SIZE] & MODBUS_EXCEPTION_FLAG)
+    {
+        modbus_stats_add(&srv->stats.exceptions, 1);
+    }
+    modbus_stats_add(&srv->stats.requests, 1);
+}
+
+/**
+ * @brief Answer buffered requests while the transmit buffer has room for a full ADU.
+ *
+ * @return Number of frames consumed
+ */
+static int conn_process(modbus_server_st *srv, modbus_server_conn_st *c)
+{
+    int frames = 0;
+
+    while (sizeof(c->tx) - c->tx_len >= MODBUS_TCP_MAX_ADU_SIZE)
+    {
+        const uint8_t *frame;
+        int len = modbus_stream_next_frame(&c->rx, &frame);
+        if (len <= 0)
+        {
+            break;
+        }
+        handle_request(srv, c, frame, (size_t)len);
+        frames++;
+    }
+
+    return frames;
+}
+
+/**
+ * @brief Send queued responses until done or EAGAIN.
+ *
+ * @return Bytes sent, or -1 if the connection must be closed
+ */
+static ssize_t conn_flush(modbus_server_st *srv, modbus_server_conn_st *c)
+{
+    size_t sent = 0;
+
+    while (sent < c->tx_len)
+    {
+        ssize_t n = send(c->fd, c->tx + sent, c->tx_len - sent, MSG_NOSIGNAL);
+        if (n > 0)
+        {
+            sent += (size_t)n;
+            modbus_stats_add(&srv->stats.tx_bytes, (uint64_t)n);
+        }
+        else if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+        {
+            break;
+        }
+        else if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        else
+        {
+            return -1;
+        }
+    }
+
+    // Keep the unsent tail at the front so the free space stays contiguous
+    if ((sent > 0) && (sent < c->tx_len))
+    {
+        memmove(c->tx, c->tx + sent, c->tx_len - sent);
+    }
+    c->tx_len -= sent;
+
+    return (ssize_t)sent;
+}
+
+/**
+ * @brief Service a connection until it would block.
+ *
+ * @return 0 on success, -1 if the connection must be closed
+ */
+static int conn_service(modbus_server_st *srv, modbus_server_conn_st *c)
+{
+    // Each step can unblock another: sending frees room for answers, answering
+    // frees ring space for bytes still queued in the socket. Stop when none moves.
+    for (;;)
+    {
+        ssize_t received = conn_fill(srv, c);
+        if (received < 0)
+        {
+            return -1;
+        }
+
+        int frames = conn_process(srv, c);
+
+        ssize_t sent = conn_flush(srv, c);
+        if (sent < 0)
+        {
+            return -1;
+        }
+
+        if ((received == 0) && (frames == 0) && (sent == 0))
+        {
+            return 0;
+        }
+    }
+}
+
+/**
+ * @brief Units a server configuration serves.
+ *
+ * @param cfg Configuration
+ * @param single Host to build when cfg has none (freed with modbus_host_free())
+ * @param host Output: cfg->host, or single
+ * @return 0 on success, or a negative error code
+ */
+int modbus_server_config_units(const modbus_server_config_st *cfg, modbus_host_st *single,
+                               const modbus_host_st **host)
+{
+    if (!cfg || !single || !host)
+    {
+        return -1;
+    }
+
+    memset(single, 0, sizeof(*single));
+    if (cfg->host)
+    {
+        *host = cfg->host;
+        return 0;
+    }
+    if (!cfg->read_cb && !cfg->read_wire_cb)
+    {
+        return -1;
+    }
+
+    modbus_register_map_st map = {
+        .read_holding = cfg->read_cb,
+        .read_input = cfg->read_input_cb,
+        .write_holding = cfg->write_cb,
+        .arg = cfg->read_arg,
+    };
+    if (modbus_host_init(single, 1) != 0)
+    {
+        return -2;
+    }
+
+    // A single device also answers the broadcast and "ignored" unit IDs
+    if ((modbus_host_add_unit(single, cfg->slave_id, &map, cfg->read_wire_cb) < 0) ||
+        (modbus_host_alias(single, BROADCAST_SLAVE_ID, cfg->slave_id) != 0) ||
+        (modbus_host_alias(single, MODBUS_TCP_UNIT_ID_IGNORED, cfg->slave_id) != 0))
+    {
+        modbus_host_free(single);
+        return -1;
+    }
+    *host = single;
+    return 0;
+}
+
+/**
+ * @brief Create the listening socket, the event loop and the connection pool.
+ *
+ * @param srv Server to initialize
+ * @param cfg Configuration
+ * @return 0 on success, or a negative error code:
+ *         -1: Invalid arguments
+ *         -2: Out of memory
+ *         -3: Socket, bind or listen failed
+ *         -4: epoll or eventfd setup failed
+ */
+int modbus_server_init(modbus_server_st *srv, const modbus_server_config_st *cfg)
+{
+    if (!srv || !cfg || (cfg->max_connections == 0) || (cfg->max_connections >= NO_SLOT))
+    {
+        return -1;
+    }
+
+    memset(srv, 0, sizeof(*srv));
+    srv->listen_fd = -1;
+    srv->epoll_fd = -1;
+    srv->wake_fd = -1;
+    srv->max_connections = cfg->max_connections;
+    if (cfg->stats)
+    {
+        srv->stats_shard = modbus_stats_shard(cfg->stats, cfg->stats_shard);
+        if (!srv->stats_shard)
+        {
+            return -1;
+        }
+    }
+
+    int ret = modbus_server_config_units(cfg, &srv->single, &srv->host);
+    if (ret != 0)
+    {
+        return ret;
+    }
+
+    srv->conns = malloc(sizeof(*srv->conns) * cfg->max_connections);
+    if (!srv->conns)
+    {
+        modbus_host_free(&srv->single);
+        return -2;
+    }
+
+    for (uint32_t i = 0; i < srv->max_connections; i++)
+    {
+        modbus_server_conn_st *c = &srv->conns[i];
+        c->fd = -1;
+        c->next_free = (i + 1 < srv->max_connections) ? i + 1 : NO_SLOT;
+        modbus_stream_init(&c->rx, MODBUS_STREAM_TCP, c->rx_storage, sizeof(c->rx_storage));
+    }
+    srv->free_head = 0;
+
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(cfg->port);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (cfg->bind_addr && (inet_pton(AF_INET, cfg->bind_addr, &addr.sin_addr) != 1))
+    {
+        modbus_server_deinit(srv);
+        return -1;
+    }
+
+    int one = 1;
+    srv->listen_fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if ((srv->listen_fd < 0) ||
+        (setsockopt(srv->listen_fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) < 0) ||
+        (cfg->reuse_port && (setsockopt(srv->listen_fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) < 0)) ||
+        (bind(srv->listen_fd, (struct sockaddr *)&addr, sizeof(addr)) < 0) ||
+        (listen(srv->listen_fd, (cfg->backlog > 0) ? cfg->backlog : MODBUS_SERVER_DEFAULT_BACKLOG) < 0))
+    {
+        modbus_server_deinit(srv);
+        return -3;
+    }
+
+    srv->epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+    srv->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    struct epoll_event lev = {.events = EPOLLIN | EPOLLET, .data.u64 = TOKEN_LISTEN};
+    struct epoll_event wev = {.events = EPOLLIN, .data.u64 = TOKEN_WAKE};
+    if ((srv->epoll_fd < 0) || (srv->wake_fd < 0) ||
+        (epoll_ctl(srv->epoll_fd, EPOLL_CTL_ADD, srv->listen_fd, &lev) < 0) ||
+        (epoll_ctl(srv->epoll_fd, EPOLL_CTL_ADD, srv->wake_fd, &wev) < 0))
+    {
+        modbus_server_deinit(srv);
+        return -4;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Release the sockets and the connection pool.
+ *
+ * @param srv Server
+ */
+void modbus_server_deinit(modbus_server_st *srv)
+{
+    if (!srv)
+    {
+        return;
+    }
+
+    if (srv->conns)
+    {
+        for (uint32_t i = 0; i < srv->max_connections; i++)
+        {
+            if (srv->conns[i].fd >= 0)
+            {
+                close(srv->conns[i].fd);
+            }
+        }
+        free(srv->conns);
+        srv->conns = NULL;
+    }
+
+    if (srv->listen_fd >= 0)
+    {
+        close(srv->listen_fd);
+    }
+    if (srv->epoll_fd >= 0)
+    {
+        close(srv->epoll_fd);
+    }
+    if (srv->wake_fd >= 0)
+    {
+        close(srv->wake_fd);
+    }
+    srv->listen_fd = -1;
+    srv->epoll_fd = -1;
+    srv->wake_fd = -1;
+    srv->active = 0;
+    modbus_host_free(&srv->single);
+    srv->host = NULL;
+}
+
+/**
+ * @brief Port the server is listening on.
+ *
+ * @param srv Server
+ * @return Port in host order, or 0 on error
+ */
+uint16_t modbus_server_port(const modbus_server_st *srv)
+{
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+
+    if (!srv || (getsockname(srv->listen_fd, (struct sockaddr *)&addr, &len) < 0))
+    {
+        return 0;
+    }
+    return ntohs(addr.sin_port);
+}
+
+/**
+ * @brief Run one iteration of the event loop.
+ *
+ * @param srv Server
+ * @param timeout_ms epoll_wait timeout (-1 = wait forever)
+ * @return Number of events handled, or -1 on error
+ */
+int modbus_server_poll(modbus_server_st *srv, int timeout_ms)
+{
+    struct epoll_event events[SERVER_MAX_EVENTS];
+
+    if (!srv || (srv->epoll_fd < 0))
+    {
+        return -1;
+    }
+
+    int n = epoll_wait(srv->epoll_fd, events, SERVER_MAX_EVENTS, timeout_ms);
+    if (n < 0)
+    {
+        return (errno == EINTR) ? 0 : -1;
+    }
+
+    for (int i = 0; i < n; i++)
+    {
+        uint64_t token = events[i].data.u64;
+
+        if (token == TOKEN_LISTEN)
+        {
+            accept_all(srv);
+            continue;
+        }
+
+        if (token == TOKEN_WAKE)
+        {
+            uint64_t value;
+            (void)!read(srv->wake_fd, &value, sizeof(value));
+            continue;
+        }
+
+        modbus_server_conn_st *c = &srv->conns[token];
+        if (c->fd < 0)
+        {
+            continue;
+        }
+
+        if (events[i].events & (EPOLLIN | EPOLLRDHUP | EPOLLHUP | EPOLLERR))
+        {
+            c->readable = true;
+        }
+
+        if (conn_service(srv, c) < 0)
+        {
+            conn_release(srv, (uint32_t)token);
+        }
+    }
+
+    return n;
+}
+
+/**
+ * @brief Run the event loop until modbus_server_stop() is called.
+ *
+ * @param srv Server
+ * @return 0 when stopped, or -1 on error
+ */
+int modbus_server_run(modbus_server_st *srv)
+{
+    if (!srv)
+    {
+        return -1;
+    }
+
+    while (!atomic_load_explicit(&srv->stop, memory_order_acquire))
+    {
+        if (modbus_server_poll(srv, -1) < 0)
+        {
+            return -1;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Ask modbus_server_run() to return.
+ *
+ * @param srv Server
+ */
+void modbus_server_stop(modbus_server_st *srv)
+{
+    if (srv)
+    {
+        uint64_t one = 1;
+        // Lock-free, so also safe from a signal handler
+        atomic_store_explicit(&srv->stop, true, memory_order_release);
+        (void)!write(srv->wake_fd, &one, sizeof(one));
+    }
+}
@@ -0,0 +1,197 @@
+/**
+ * @file modbus_server_group.c
+ * @brief One modbus_server per core behind a shared SO_REUSEPORT port.
+ */
+#define _GNU_SOURCE
+
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "modbus_server_group.h"
+
+/**
+ * @brief Thread body: pin to the shard CPU, then run its event loop.
+ */
+static void *shard_main(void *arg)
+{
+    modbus_server_shard_st *shard = arg;
+
+    if (shard->cpu >= 0)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(shard->cpu, &set);
+        pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+    }
+
+    shard->result = modbus_server_run(&shard->server);
+    return NULL;
+}
+
+/**
+ * @brief Create the shards and their listening sockets.
+ *
+ * @param g Group to initialize
+ * @param cfg Per-shard configuration (max_connections is per shard; reuse_port is forced on)
+ * @param shards Number of shards (0 = one per online CPU)
+ * @return 0 on success, or a negative error code:
+ *         -1: Invalid arguments
+ *         -2: Out of memory
+ *         -3: A shard failed to initialize
+ */
+int modbus_server_group_init(modbus_server_group_st *g, const modbus_server_config_st *cfg, uint32_t shards)
+{
+    if (!g || !cfg)
+    {
+        return -1;
+    }
+
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    if (cpus < 1)
+    {
+        cpus = 1;
+    }
+    if (shards == 0)
+    {
+        shards = (uint32_t)cpus;
+    }
+    if (shards > MODBUS_SERVER_GROUP_MAX_SHARDS)
+    {
+        return -1;
+    }
+
+    memset(g, 0, sizeof(*g));
+    g->shards = aligned_alloc(MODBUS_CACHE_LINE_SIZE, sizeof(*g->shards) * shards);
+    if (!g->shards)
+    {
+        return -2;
+    }
+    memset(g->shards, 0, sizeof(*g->shards) * shards);
+
+    modbus_server_config_st shard_cfg = *cfg;
+    shard_cfg.reuse_port = true;
+
+    for (uint32_t i = 0; i < shards; i++)
+    {
+        modbus_server_shard_st *shard = &g->shards[i];
+        shard->cpu = (shards <= (uint32_t)cpus) ? (int)i : -1;
+        shard_cfg.stats_shard = cfg->stats_shard + i;
+
+        if (modbus_server_init(&shard->server, &shard_cfg) != 0)
+        {
+            modbus_server_group_deinit(g);
+            return -3;
+        }
+        g->count = i + 1;
+
+        // The first shard may have picked an ephemeral port; the rest join it
+        if (i == 0)
+        {
+            shard_cfg.port = modbus_server_port(&shard->server);
+            g->port = shard_cfg.port;
+        }
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Start one thread per shard.
+ *
+ * @param g Group
+ * @return 0 on success, -1 if a thread could not be created (started shards keep running)
+ */
+int modbus_server_group_start(modbus_server_group_st *g)
+{
+    if (!g || !g->shards || (g->running > 0))
+    {
+        return -1;
+    }
+
+    for (uint32_t i = 0; i < g->count; i++)
+    {
+        if (pthread_create(&g->shards[i].thread, NULL, shard_main, &g->shards[i]) != 0)
+        {
+            return -1;
+        }
+        g->running = i + 1;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Stop every shard and wait for its thread.
+ *
+ * @param g Group
+ */
+void modbus_server_group_stop(modbus_server_group_st *g)
+{
+    if (!g || !g->shards)
+    {
+        return;
+    }
+
+    for (uint32_t i = 0; i < g->running; i++)
+    {
+        modbus_server_stop(&g->shards[i].server);
+    }
+    for (uint32_t i = 0; i < g->running; i++)
+    {
+        pthread_join(g->shards[i].thread, NULL);
+    }
+    g->running = 0;
+}
+
+/**
+ * @brief Release all shards. Stops them first if they are running.
+ *
+ * @param g Group
+ */
+void modbus_server_group_deinit(modbus_server_group_st *g)
+{
+    if (!g || !g->shards)
+    {
+        return;
+    }
+
+    modbus_server_group_stop(g);
+    for (uint32_t i = 0; i < g->count; i++)
+    {
+        modbus_server_deinit(&g->shards[i].server);
+    }
+    free(g->shards);
+    g->shards = NULL;
+    g->count = 0;
+}
+
+/**
+ * @brief Sum the counters of all shards.
+ *
+ * @param g Group
+ * @param total Output totals
+ */
+void modbus_server_group_stats(const modbus_server_group_st *g, modbus_server_stats_st *total)
+{
+    if (!g || !total)
+    {
+        return;
+    }
+
+    memset(total, 0, sizeof(*total));
+    for (uint32_t i = 0; i < g->count; i++)
+    {
+        // The shard threads may still be counting: read with relaxed loads
+        const modbus_server_stats_st *s = &g->shards[i].server.stats;
+        total->accepted += __atomic_load_n(&s->accepted, __ATOMIC_RELAXED);
+        total->rejected += __atomic_load_n(&s->rejected, __ATOMIC_RELAXED);
+        total->closed += __atomic_load_n(&s->closed, __ATOMIC_RELAXED);
+        total->requests += __atomic_load_n(&s->requests, __ATOMIC_RELAXED);
+        total->exceptions += __atomic_load_n(&s->exceptions, __ATOMIC_RELAXED);
+        total->errors += __atomic_load_n(&s->errors, __ATOMIC_RELAXED);
+        total->rx_bytes += __atomic_load_n(&s->rx_bytes, __ATOMIC_RELAXED);
+        total->tx_bytes += __atomic_load_n(&s->tx_bytes, __ATOMIC_RELAXED);
+    }
+}
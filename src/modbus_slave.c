@@ -11,12 +11,25 @@
 #include "modbus_slave.h"
 #include "modbus_utils.h"
 #include "modbus_types.h"
+#include "modbus_swap.h"
 
-static uint8_t device_slave_id = 0;
+/**
+ * @brief Initialize a slave context with no slave ID configured.
+ *
+ * @param ctx Context to initialize
+ */
+void modbus_slave_ctx_init(modbus_slave_ctx_st *ctx)
+{
+    if (ctx)
+    {
+        ctx->device_slave_id = 0;
+    }
+}
 
 /**
  * @brief Encode a Modbus Read Holding Registers response frame.
  *
+ * @param ctx Slave context
  * @param slave_id Modbus slave ID (1..247)
  * @param regs Array of register values to include in response
  * @param qty Number of registers to include (must be <= MODBUS_MAX_REGS)
@@ -25,16 +38,17 @@ static uint8_t device_slave_id = 0;
  * @return Length of the encoded response in bytes (including CRC), or 0 on failure
  *
  * This function validates the input parameters, converts registers to big-endian
- * format, and appends the CRC16 checksum at the end of the frame.
+ * format, and appends the CRC16 checksum at the end of the frame. The conversion
+ * and the checksum are done in a single sweep over the payload.
  */
-uint16_t encode_read_response(uint8_t slave_id,
+uint16_t encode_read_response(const modbus_slave_ctx_st *ctx, uint8_t slave_id,
                               const uint16_t *regs, uint16_t qty,
                               uint8_t *buffer, size_t bufsize)
 {
     static const uint8_t PACKET_HEADER_SIZE = sizeof(read_holding_registers_header_response_st);
     static const uint8_t PACKET_CRC_SIZE = sizeof(uint16_t);
 
-    if ((!buffer) || (!regs))
+    if ((!ctx) || (!buffer) || (!regs))
     {
         return 0;
     }
@@ -45,7 +59,7 @@ uint16_t encode_read_response(uint8_t slave_id,
     }
 
     size_t frame_len = PACKET_HEADER_SIZE + (qty * sizeof(uint16_t));
-    if (bufsize < frame_len)
+    if (bufsize < (frame_len + PACKET_CRC_SIZE))
     {
         return 0;
     }
@@ -56,15 +70,13 @@ uint16_t encode_read_response(uint8_t slave_id,
     resp.byte_count = qty * sizeof(uint16_t);
 
     memcpy(buffer, &resp, sizeof(resp));
-    uint8_t *reg_addr = buffer + sizeof(resp);
 
-    for (int i = 0; i < qty; i++)
-    {
-        uint16_t reg_val = MODBUS_HTONS(regs[i]);
-        memcpy(&reg_addr[i * 2], &reg_val, sizeof(reg_val));
-    }
+    modbus_crc16_ctx_st crc_ctx;
+    modbus_crc16_init(&crc_ctx);
+    modbus_crc16_update(&crc_ctx, buffer, sizeof(resp));
+    modbus_regs_to_be_crc(buffer + sizeof(resp), regs, qty, &crc_ctx);
 
-    uint16_t crc = modbus_crc16(buffer, frame_len);
+    uint16_t crc = modbus_crc16_final(&crc_ctx);
     memcpy(buffer + frame_len, &crc, PACKET_CRC_SIZE);
 
     return frame_len + PACKET_CRC_SIZE;
@@ -73,6 +85,7 @@ uint16_t encode_read_response(uint8_t slave_id,
 /**
  * @brief Decode a Modbus Read Holding Registers request.
  *
+ * @param ctx Slave context holding the device slave ID
  * @param buffer Pointer to the incoming Modbus request frame
  * @param bufsize Size of the incoming buffer
  * @param slave_id Pointer to store the decoded slave ID
@@ -83,12 +96,12 @@ uint16_t encode_read_response(uint8_t slave_id,
  * This function validates the Modbus request frame, checks the CRC,
  * ensures the slave ID and quantity are valid, and outputs the decoded values.
  */
-int decode_read_request(uint8_t *buffer, size_t bufsize, uint8_t *slave_id, uint16_t *start_addr, uint16_t *qty)
+int decode_read_request(const modbus_slave_ctx_st *ctx, const uint8_t *buffer, size_t bufsize, uint8_t *slave_id, uint16_t *start_addr, uint16_t *qty)
 {
     static const uint8_t PACKET_SIZE = sizeof(read_holding_registers_request_st);
     static const uint8_t PACKET_CRC_SIZE = sizeof(uint16_t);
 
-    if (!buffer || !slave_id || !start_addr || !qty) {
+    if (!ctx || !buffer || !slave_id || !start_addr || !qty) {
         return -1;
     }
 
@@ -106,7 +119,7 @@ int decode_read_request(uint8_t *buffer, size_t bufsize, uint8_t *slave_id, uint
         return -3;
     }
 
-    if ((req.slave_id != device_slave_id) && (req.slave_id != BROADCAST_SLAVE_ID)) {
+    if ((req.slave_id != ctx->device_slave_id) && (req.slave_id != BROADCAST_SLAVE_ID)) {
         return -4;
     }
 
@@ -127,20 +140,89 @@ int decode_read_request(uint8_t *buffer, size_t bufsize, uint8_t *slave_id, uint
     return 0;
 }
 
+/**
+ * @brief Answer any supported RTU request through the function-code dispatcher.
+ *
+ * @param ctx Slave context holding the device slave ID
+ * @param map Register sources
+ * @param buffer Incoming RTU request frame
+ * @param bufsize Size of the incoming buffer
+ * @param response Output buffer, at least MODBUS_RTU_MAX_ADU_SIZE bytes
+ * @param respsize Size of the output buffer
+ * @return Length of the response frame, 0 if the request was a broadcast
+ *         (executed, never answered), or a negative error code:
+ *         -1: Invalid input pointers or response buffer too small
+ *         -2: Frame incomplete
+ *         -4: Slave ID not addressed to this device
+ *         -6: CRC mismatch
+ */
+int modbus_slave_handle_request(const modbus_slave_ctx_st *ctx, const modbus_register_map_st *map,
+                                const uint8_t *buffer, size_t bufsize, uint8_t *response, size_t respsize)
+{
+    static const uint8_t PACKET_CRC_SIZE = sizeof(uint16_t);
+
+    if (!ctx || !map || !buffer || !response || (respsize < MODBUS_RTU_MAX_ADU_SIZE))
+    {
+        return -1;
+    }
+
+    if (bufsize < 2)
+    {
+        return -2;
+    }
+
+    // No layout to size an unknown function code by, but the t3.5 silence already delimited the frame
+    int pdu_len = modbus_pdu_request_length(buffer + 1, bufsize - 1);
+    if (pdu_len < 0)
+    {
+        pdu_len = (bufsize > (size_t)1 + PACKET_CRC_SIZE) ? (int)(bufsize - 1 - PACKET_CRC_SIZE) : 0;
+    }
+    if ((pdu_len == 0) || (bufsize < 1 + (size_t)pdu_len + PACKET_CRC_SIZE))
+    {
+        return -2;
+    }
+
+    uint8_t slave_id = buffer[0];
+    if ((slave_id != ctx->device_slave_id) && (slave_id != BROADCAST_SLAVE_ID))
+    {
+        return -4;
+    }
+
+    uint16_t crc_calc = modbus_crc16(buffer, 1 + pdu_len);
+    uint16_t crc_recv = buffer[1 + pdu_len] | (buffer[1 + pdu_len + 1] << 8);
+    if (crc_calc != crc_recv)
+    {
+        return -6;
+    }
+
+    int resp_len = modbus_pdu_dispatch(map, slave_id, buffer + 1, pdu_len, response + 1);
+    if (slave_id == BROADCAST_SLAVE_ID)
+    {
+        return 0;
+    }
+
+    response[0] = slave_id;
+    uint16_t crc = modbus_crc16(response, 1 + resp_len);
+    response[1 + resp_len] = (uint8_t)(crc & 0xFF);
+    response[1 + resp_len + 1] = (uint8_t)(crc >> 8);
+    return 1 + resp_len + PACKET_CRC_SIZE;
+}
+
 /**
  * @brief Set the Modbus slave ID for this device.
  *
+ * @param ctx Slave context to configure
  * @param slave_id Modbus slave ID (1..247)
- * @return 0 on success, -1 if the slave ID is invalid
+ * @return 0 on success, -1 if the context is NULL or the slave ID is invalid
  *
  * This function sets the slave ID that the device will respond to.
  * It validates the input to ensure it is within the allowed range.
  */
-int set_device_slave_id(uint8_t slave_id)
+int set_device_slave_id(modbus_slave_ctx_st *ctx, uint8_t slave_id)
 {
-    if (!is_valid_slave_id(slave_id) || (slave_id == BROADCAST_SLAVE_ID)) {
+    if (!ctx || !is_valid_slave_id(slave_id) || (slave_id == BROADCAST_SLAVE_ID)) {
         return -1;
     }
-    device_slave_id = slave_id;
+    ctx->device_slave_id = slave_id;
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,375 @@
+/**
+ * @file modbus_sniff.c
+ * @brief Passive RTU bus listener that keeps a mirror of the slaves' registers.
+ *
+ * Confirmed writes are replayed into the mirror through the modbus_pdu
+ * dispatcher, so the request layouts are parsed in exactly one place;
+ * read responses are decoded with modbus_pdu_decode_response() against the
+ * request they answer.
+ */
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <poll.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "modbus_sniff.h"
+#include "modbus_pdu.h"
+#include "modbus_stream.h"
+#include "modbus_utils.h"
+
+/** @brief Address byte and CRC around the PDU of an RTU frame */
+#define RTU_OVERHEAD 3
+
+/**
+ * @brief CLOCK_MONOTONIC in nanoseconds.
+ */
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief Whether frames with this address byte are decoded (broadcasts are, for any watched unit).
+ */
+static inline bool is_watched(const modbus_sniff_st *sniff, uint8_t address)
+{
+    const modbus_sniff_unit_st *u = &sniff->units[address];
+    return (address == BROADCAST_SLAVE_ID) ? (sniff->watched > 0) : (u->holding || u->input);
+}
+
+/**
+ * @brief Check the CRC that ends an RTU frame.
+ */
+static bool crc_ok(const uint8_t *frame, size_t len)
+{
+    uint16_t crc = modbus_crc16(frame, (uint16_t)(len - 2));
+    return (frame[len - 2] | (frame[len - 1] << 8)) == crc;
+}
+
+/**
+ * @brief Apply a transaction to a unit's mirror.
+ *
+ * @param resp Response PDU, or NULL for a broadcast
+ * @return Registers read (0 for writes), or the negative code of modbus_pdu_decode_response()
+ */
+static int apply(modbus_sniff_unit_st *u, uint8_t unit_id, const uint8_t *req, size_t req_len, const uint8_t *resp,
+                 size_t resp_len)
+{
+    uint16_t regs[MODBUS_MAX_REGS];
+    int n = 0;
+
+    if (resp)
+    {
+        n = modbus_pdu_decode_response(req, req_len, resp, resp_len, regs, MODBUS_MAX_REGS);
+        if (n < 0)
+        {
+            return n;
+        }
+    }
+
+    // The slave took the write: replay the request into the mirror
+    if (u->holding && ((req[0] == MODBUS_WRITE_SINGLE_REG) || (req[0] == MODBUS_WRITE_MULTIPLE_REGS) ||
+                       (req[0] == MODBUS_READ_WRITE_MULTIPLE_REGS)))
+    {
+        uint8_t scratch[MODBUS_MAX_PDU_SIZE];
+        modbus_register_map_st map = {
+            .read_holding = modbus_bank_read_cb,
+            .write_holding = modbus_bank_write_cb,
+            .arg = u->holding,
+        };
+        modbus_pdu_dispatch(&map, unit_id, req, req_len, scratch);
+    }
+
+    modbus_bank_st *bank = (req[0] == MODBUS_READ_INPUT_REG) ? u->input : u->holding;
+    if ((n > 0) && bank)
+    {
+        modbus_bank_write(bank, (uint16_t)((req[1] << 8) | req[2]), regs, (uint32_t)n);
+    }
+    return n;
+}
+
+/**
+ * @brief Handle one complete, delimited frame.
+ *
+ * @return 1 if a transaction was applied to a mirror, 0 otherwise
+ */
+static int on_frame(modbus_sniff_st *sniff, const uint8_t *frame, size_t len, bool response, uint64_t now)
+{
+    uint8_t address = frame[0];
+
+    sniff->stats.frames++;
+    if (!is_watched(sniff, address))
+    {
+        // Only the framing matters: remember whom a request went to, so its response is framed as one
+        sniff->stats.filtered++;
+        if (!response && sniff->pending)
+        {
+            sniff->stats.unanswered++;
+        }
+        sniff->pending = !response && (address != BROADCAST_SLAVE_ID);
+        memcpy(sniff->request, frame, 2);
+        sniff->request_len = 2;
+        sniff->request_ns = now;
+        return 0;
+    }
+
+    if (response)
+    {
+        sniff->pending = false;
+        modbus_sniff_unit_st *u = &sniff->units[address];
+        int ret = apply(u, address, sniff->request + 1, sniff->request_len - RTU_OVERHEAD, frame + 1,
+                        len - RTU_OVERHEAD);
+        if (ret == -8)
+        {
+            sniff->stats.exceptions++;
+            return 0;
+        }
+        if (ret < 0)
+        {
+            sniff->stats.mismatches++;
+            return 0;
+        }
+        u->transactions++;
+        u->updated_ns = now;
+        sniff->stats.transactions++;
+        return 1;
+    }
+
+    if (sniff->pending)
+    {
+        sniff->stats.unanswered++;
+    }
+    sniff->pending = false;
+
+    if (address == BROADCAST_SLAVE_ID)
+    {
+        for (uint32_t id = 1; id <= MODBUS_MAX_SLAVES; id++)
+        {
+            modbus_sniff_unit_st *u = &sniff->units[id];
+            if (u->holding)
+            {
+                apply(u, (uint8_t)id, frame + 1, len - RTU_OVERHEAD, NULL, 0);
+                u->updated_ns = now;
+            }
+        }
+        sniff->stats.broadcasts++;
+        return 0;
+    }
+
+    memcpy(sniff->request, frame, len);
+    sniff->request_len = len;
+    sniff->request_ns = now;
+    sniff->pending = true;
+    return 0;
+}
+
+/**
+ * @brief Split the buffered bytes into frames.
+ *
+ * @return Transactions applied to a mirror
+ */
+static int parse(modbus_sniff_st *sniff, uint64_t now)
+{
+    size_t pos = 0;
+    int applied = 0;
+
+    while (sniff->len - pos >= 2)
+    {
+        const uint8_t *f = sniff->buf + pos;
+        size_t avail = sniff->len - pos;
+
+        // Same address and function code right after a request: its response
+        bool response = sniff->pending && (f[0] == sniff->request[0]) &&
+                        ((f[1] & (uint8_t)~MODBUS_EXCEPTION_FLAG) == sniff->request[1]);
+        bool watched = is_watched(sniff, f[0]);
+        int len = modbus_frame_length(response ? MODBUS_STREAM_RTU_RESPONSE : MODBUS_STREAM_RTU_REQUEST, f, avail);
+
+        if (response && watched && (len > 0) && ((size_t)len <= avail) && !crc_ok(f, (size_t)len))
+        {
+            // Not an answer after all: the master may be repeating its request
+            response = false;
+            len = modbus_frame_length(MODBUS_STREAM_RTU_REQUEST, f, avail);
+        }
+        if ((len == 0) || ((len > 0) && ((size_t)len > avail)))
+        {
+            break;
+        }
+
+        if ((len < 0) || (watched && !crc_ok(f, (size_t)len)))
+        {
+            if (len > 0)
+            {
+                sniff->stats.crc_errors++;
+            }
+            if (sniff->t35_ns)
+            {
+                // Line timing known: nothing can be trusted before the next silence
+                sniff->stats.dropped_bytes += avail;
+                sniff->resync = true;
+                pos = sniff->len;
+                break;
+            }
+            sniff->stats.dropped_bytes++;
+            pos++;
+            continue;
+        }
+
+        applied += on_frame(sniff, f, (size_t)len, response, now);
+        pos += (size_t)len;
+    }
+
+    memmove(sniff->buf, sniff->buf + pos, sniff->len - pos);
+    sniff->len -= pos;
+    return applied;
+}
+
+/**
+ * @brief Initialize a sniffer that watches no unit yet.
+ *
+ * @param sniff Sniffer to initialize
+ * @param t35_ns Silence that ends a frame (0 = frame on structure alone)
+ * @param response_timeout_us Longest time a slave takes to answer (0 = wait for the next request)
+ * @return 0 on success, -1 if sniff is NULL
+ */
+int modbus_sniff_init(modbus_sniff_st *sniff, uint64_t t35_ns, uint32_t response_timeout_us)
+{
+    if (!sniff)
+    {
+        return -1;
+    }
+
+    memset(sniff, 0, sizeof(*sniff));
+    sniff->t35_ns = t35_ns;
+    sniff->response_timeout_ns = (uint64_t)response_timeout_us * 1000u;
+    return 0;
+}
+
+/**
+ * @brief Mirror a unit.
+ *
+ * @param sniff Sniffer
+ * @param unit_id Unit ID
+ * @param holding Mirror of its holding registers (NULL = not mirrored)
+ * @param input Mirror of its input registers (NULL = not mirrored)
+ * @return 0 on success, or -1 on invalid arguments
+ */
+int modbus_sniff_watch(modbus_sniff_st *sniff, uint8_t unit_id, modbus_bank_st *holding, modbus_bank_st *input)
+{
+    if (!sniff || (!holding && !input) || (unit_id == BROADCAST_SLAVE_ID) || (unit_id > MODBUS_MAX_SLAVES))
+    {
+        return -1;
+    }
+
+    modbus_sniff_unit_st *u = &sniff->units[unit_id];
+    if (!u->holding && !u->input)
+    {
+        sniff->watched++;
+    }
+    u->holding = holding;
+    u->input = input;
+    return 0;
+}
+
+/**
+ * @brief Feed bytes received from the line.
+ *
+ * @param sniff Sniffer
+ * @param buf Bytes, in line order
+ * @param len Number of bytes
+ * @param now_ns CLOCK_MONOTONIC time they were received
+ * @return Number of transactions applied to a mirror, or -1 on invalid arguments
+ */
+int modbus_sniff_feed(modbus_sniff_st *sniff, const uint8_t *buf, size_t len, uint64_t now_ns)
+{
+    if (!sniff || (!buf && (len > 0)))
+    {
+        return -1;
+    }
+
+    // A silence of t3.5 ends any frame: what is still buffered was cut short
+    if (sniff->t35_ns && (now_ns - sniff->last_rx_ns >= sniff->t35_ns))
+    {
+        sniff->stats.dropped_bytes += sniff->len;
+        sniff->len = 0;
+        sniff->resync = false;
+    }
+    if (sniff->pending && sniff->response_timeout_ns && (sniff->len == 0) &&
+        (now_ns - sniff->request_ns > sniff->response_timeout_ns))
+    {
+        sniff->stats.unanswered++;
+        sniff->pending = false;
+    }
+    if (len == 0)
+    {
+        return 0;
+    }
+    sniff->last_rx_ns = now_ns;
+
+    int applied = 0;
+    while (len > 0)
+    {
+        if (sniff->resync)
+        {
+            sniff->stats.dropped_bytes += len;
+            break;
+        }
+
+        size_t n = sizeof(sniff->buf) - sniff->len;
+        if (n > len)
+        {
+            n = len;
+        }
+        memcpy(sniff->buf + sniff->len, buf, n);
+        sniff->len += n;
+        buf += n;
+        len -= n;
+        applied += parse(sniff, now_ns);
+    }
+    return applied;
+}
+
+/**
+ * @brief Wait for bytes on a line and feed them.
+ *
+ * @param sniff Sniffer
+ * @param fd Serial line opened listen-only
+ * @param timeout_ms Longest wait for the first byte (-1 = forever)
+ * @return Number of transactions applied to a mirror (0 on timeout), or a negative error code
+ */
+int modbus_sniff_poll(modbus_sniff_st *sniff, int fd, int timeout_ms)
+{
+    if (!sniff || (fd < 0))
+    {
+        return -1;
+    }
+
+    struct pollfd pfd = {.fd = fd, .events = POLLIN};
+    int ret = poll(&pfd, 1, timeout_ms);
+    if (ret < 0)
+    {
+        return (errno == EINTR) ? 0 : -2;
+    }
+    if (ret == 0)
+    {
+        // Let the silence end a cut-short frame and time out an unanswered request
+        return modbus_sniff_feed(sniff, NULL, 0, now_ns());
+    }
+
+    // One read per call, so every chunk carries its own arrival time
+    uint8_t chunk[MODBUS_RTU_MAX_ADU_SIZE];
+    ssize_t n = read(fd, chunk, sizeof(chunk));
+    if (n < 0)
+    {
+        return ((errno == EAGAIN) || (errno == EWOULDBLOCK) || (errno == EINTR)) ? 0 : -2;
+    }
+    if (n == 0)
+    {
+        return -2;
+    }
+    return modbus_sniff_feed(sniff, chunk, (size_t)n, now_ns());
+}
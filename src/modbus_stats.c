@@ -0,0 +1,199 @@
+/**
+ * @file modbus_stats.c
+ * @brief Allocation, aggregation and percentiles for the per-thread counters.
+ *
+ * Recording is inline in modbus_stats.h; this file only holds what runs
+ * off the hot path.
+ */
+#include <stdlib.h>
+#include <string.h>
+
+#include "modbus_stats.h"
+
+/** @brief Largest number of shards */
+#define STATS_MAX_SHARDS 1024
+
+/**
+ * @brief Add every counter of a shard to a total.
+ *
+ * The shard is read counter by counter with relaxed loads while its
+ * owner may still be writing.
+ */
+static void add_counters(uint64_t *total, const uint64_t *shard, size_t count)
+{
+    for (size_t i = 0; i < count; i++)
+    {
+        total[i] += __atomic_load_n(&shard[i], __ATOMIC_RELAXED);
+    }
+}
+
+/**
+ * @brief Allocate zeroed shards.
+ *
+ * @param stats Set to initialize
+ * @param shards Number of shards
+ * @return 0 on success, or a negative error code
+ */
+int modbus_stats_init(modbus_stats_st *stats, uint32_t shards)
+{
+    if (!stats || (shards == 0) || (shards > STATS_MAX_SHARDS))
+    {
+        return -1;
+    }
+
+    stats->shards = aligned_alloc(MODBUS_CACHE_LINE_SIZE, sizeof(*stats->shards) * shards);
+    if (!stats->shards)
+    {
+        stats->count = 0;
+        return -2;
+    }
+    memset(stats->shards, 0, sizeof(*stats->shards) * shards);
+    stats->count = shards;
+    return 0;
+}
+
+/**
+ * @brief Release the shards.
+ *
+ * @param stats Set
+ */
+void modbus_stats_free(modbus_stats_st *stats)
+{
+    if (!stats)
+    {
+        return;
+    }
+
+    free(stats->shards);
+    stats->shards = NULL;
+    stats->count = 0;
+}
+
+/**
+ * @brief Shard for one thread.
+ *
+ * @param stats Set
+ * @param index Shard index
+ * @return Shard, or NULL if there is no such shard
+ */
+modbus_stats_shard_st *modbus_stats_shard(modbus_stats_st *stats, uint32_t index)
+{
+    if (!stats || (index >= stats->count))
+    {
+        return NULL;
+    }
+    return &stats->shards[index];
+}
+
+/**
+ * @brief Sum every shard.
+ *
+ * @param stats Set
+ * @param total Output totals
+ */
+void modbus_stats_aggregate(const modbus_stats_st *stats, modbus_stats_shard_st *total)
+{
+    if (!stats || !total)
+    {
+        return;
+    }
+
+    memset(total, 0, sizeof(*total));
+    for (uint32_t s = 0; s < stats->count; s++)
+    {
+        const modbus_stats_shard_st *shard = &stats->shards[s];
+        add_counters(total->frames_by_function, shard->frames_by_function, 256);
+        add_counters(total->frames_by_unit, shard->frames_by_unit, 256);
+        add_counters(total->errors_by_unit, shard->errors_by_unit, 256);
+        add_counters(&total->errors[0][0], &shard->errors[0][0], MODBUS_STATS_SIDES * MODBUS_STATS_ERROR_CODES);
+        add_counters(total->latency.buckets, shard->latency.buckets, MODBUS_STATS_HIST_BUCKETS);
+        total->latency.count += __atomic_load_n(&shard->latency.count, __ATOMIC_RELAXED);
+        total->latency.sum_ns += __atomic_load_n(&shard->latency.sum_ns, __ATOMIC_RELAXED);
+
+        uint64_t max_ns = __atomic_load_n(&shard->latency.max_ns, __ATOMIC_RELAXED);
+        if (max_ns > total->latency.max_ns)
+        {
+            total->latency.max_ns = max_ns;
+        }
+    }
+}
+
+/**
+ * @brief Zero every shard.
+ *
+ * @param stats Set
+ */
+void modbus_stats_reset(modbus_stats_st *stats)
+{
+    if (!stats || !stats->shards)
+    {
+        return;
+    }
+
+    memset(stats->shards, 0, sizeof(*stats->shards) * stats->count);
+}
+
+/**
+ * @brief Smallest value of the bucket a histogram index stands for.
+ *
+ * @param bucket Bucket index
+ * @return Lowest value that lands in this bucket
+ */
+uint64_t modbus_stats_bucket_floor(uint32_t bucket)
+{
+    if (bucket < MODBUS_STATS_HIST_SUB_BUCKETS)
+    {
+        return bucket;
+    }
+    if (bucket >= MODBUS_STATS_HIST_BUCKETS)
+    {
+        bucket = MODBUS_STATS_HIST_BUCKETS - 1;
+    }
+
+    // Inverse of modbus_stats_bucket(): rebuild the leading bits, zero the rest
+    uint32_t exponent = bucket / MODBUS_STATS_HIST_SUB_BUCKETS + MODBUS_STATS_HIST_SUB_BITS - 1;
+    uint64_t mantissa = bucket % MODBUS_STATS_HIST_SUB_BUCKETS + MODBUS_STATS_HIST_SUB_BUCKETS;
+    return mantissa << (exponent - MODBUS_STATS_HIST_SUB_BITS);
+}
+
+/**
+ * @brief Value below which a fraction of the recorded latencies fall.
+ *
+ * @param h Histogram
+ * @param quantile Fraction, 0.0 .. 1.0
+ * @return Upper bound of the bucket holding that rank, or 0 if empty
+ */
+uint64_t modbus_stats_percentile(const modbus_stats_histogram_st *h, double quantile)
+{
+    if (!h || (h->count == 0))
+    {
+        return 0;
+    }
+    if (quantile < 0.0)
+    {
+        quantile = 0.0;
+    }
+    if (quantile > 1.0)
+    {
+        quantile = 1.0;
+    }
+
+    // Rank of the value wanted, 1-based: p50 of 10 values is the 5th
+    uint64_t rank = (uint64_t)(quantile * (double)h->count + 0.5);
+    if (rank == 0)
+    {
+        rank = 1;
+    }
+
+    uint64_t seen = 0;
+    for (uint32_t b = 0; b < MODBUS_STATS_HIST_BUCKETS; b++)
+    {
+        seen += h->buckets[b];
+        if (seen >= rank)
+        {
+            uint64_t upper = (b + 1 < MODBUS_STATS_HIST_BUCKETS) ? modbus_stats_bucket_floor(b + 1) - 1 : h->max_ns;
+            return (upper < h->max_ns) ? upper : h->max_ns;
+        }
+    }
+    return h->max_ns;
+}
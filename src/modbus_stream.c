@@ -0,0 +1,270 @@
+/**
+ * @file modbus_stream.c
+ * @brief Zero-copy frame reassembler on a mirrored ring buffer.
+ *
+ * Writers append bytes at read_pos + count; every byte written into the
+ * first MODBUS_STREAM_MIRROR_SIZE positions of the ring is also written
+ * at the same offset past the end of the ring. Since no frame is longer
+ * than the mirror, any frame starting anywhere in the ring can be read
+ * as one contiguous block.
+ */
+#include <string.h>
+
+#include "modbus_stream.h"
+#include "modbus_pdu.h"
+#include "modbus_tcp.h"
+#include "modbus_utils.h"
+
+/** @brief Slave ID in front of an RTU PDU */
+#define RTU_SLAVE_ID_SIZE 1
+
+/** @brief CRC after an RTU PDU */
+#define RTU_CRC_SIZE 2
+
+/**
+ * @brief Ring index where the next byte will be written.
+ */
+static size_t write_index(const modbus_stream_st *s)
+{
+    size_t wp = s->read_pos + s->count;
+    return (wp >= s->capacity) ? wp - s->capacity : wp;
+}
+
+/**
+ * @brief Mark @p len bytes at the read position as consumed.
+ */
+static void consume(modbus_stream_st *s, size_t len)
+{
+    s->read_pos += len;
+    if (s->read_pos >= s->capacity)
+    {
+        s->read_pos -= s->capacity;
+    }
+    s->count -= len;
+}
+
+/**
+ * @brief Frame length of an RTU frame: slave ID, PDU, CRC.
+ */
+static int rtu_length(int (*pdu_length)(const uint8_t *, size_t), const uint8_t *buf, size_t avail)
+{
+    if (avail < 2)
+    {
+        return 0;
+    }
+
+    if (!is_valid_slave_id(buf[0]))
+    {
+        return -1;
+    }
+
+    int len = pdu_length(buf + 1, avail - 1);
+    return (len <= 0) ? len : RTU_SLAVE_ID_SIZE + len + RTU_CRC_SIZE;
+}
+
+/**
+ * @brief Compute the length of the frame starting at @p buf.
+ *
+ * @param mode Framing rule
+ * @param buf First bytes of the frame
+ * @param avail Number of bytes available at @p buf
+ * @return Frame length, 0 if more bytes are needed to tell,
+ *         or -1 if these bytes cannot start a frame
+ */
+int modbus_frame_length(modbus_stream_mode_et mode, const uint8_t *buf, size_t avail)
+{
+    if (!buf)
+    {
+        return -1;
+    }
+
+    switch (mode)
+    {
+    case MODBUS_STREAM_RTU_REQUEST:
+        return rtu_length(modbus_pdu_request_length, buf, avail);
+    case MODBUS_STREAM_RTU_RESPONSE:
+        return rtu_length(modbus_pdu_response_length, buf, avail);
+    case MODBUS_STREAM_TCP:
+    {
+        int len = decode_mbap_header(buf, avail, NULL, NULL, NULL);
+        if (len == -2)
+        {
+            return 0;
+        }
+        return (len < 0) ? -1 : len;
+    }
+    default:
+        return -1;
+    }
+}
+
+/**
+ * @brief Initialize a stream reassembler on caller-provided storage.
+ *
+ * @param s Stream to initialize
+ * @param mode Framing rule
+ * @param storage Storage of MODBUS_STREAM_STORAGE_SIZE(capacity) bytes
+ * @param storage_size Size of @p storage in bytes
+ * @return 0 on success, -1 on invalid arguments or storage too small
+ */
+int modbus_stream_init(modbus_stream_st *s, modbus_stream_mode_et mode, uint8_t *storage, size_t storage_size)
+{
+    if (!s || !storage || (storage_size < MODBUS_STREAM_STORAGE_SIZE(MODBUS_STREAM_MIRROR_SIZE)))
+    {
+        return -1;
+    }
+
+    if ((mode != MODBUS_STREAM_RTU_REQUEST) && (mode != MODBUS_STREAM_RTU_RESPONSE) && (mode != MODBUS_STREAM_TCP))
+    {
+        return -1;
+    }
+
+    memset(s, 0, sizeof(*s));
+    s->data = storage;
+    s->capacity = storage_size - MODBUS_STREAM_MIRROR_SIZE;
+    s->mode = mode;
+    return 0;
+}
+
+/**
+ * @brief Drop all buffered bytes.
+ *
+ * @param s Stream
+ */
+void modbus_stream_reset(modbus_stream_st *s)
+{
+    if (s)
+    {
+        s->read_pos = 0;
+        s->count = 0;
+    }
+}
+
+/**
+ * @brief Get the contiguous free region to receive into directly.
+ *
+ * @param s Stream
+ * @param avail Output: number of bytes that can be written at the returned pointer
+ * @return Write pointer, or NULL if the ring is full
+ */
+uint8_t *modbus_stream_write_ptr(modbus_stream_st *s, size_t *avail)
+{
+    if (!s || !avail)
+    {
+        return NULL;
+    }
+
+    size_t wp = write_index(s);
+    size_t free_bytes = s->capacity - s->count;
+    size_t to_end = s->capacity - wp;
+
+    *avail = (free_bytes < to_end) ? free_bytes : to_end;
+    return (*avail > 0) ? s->data + wp : NULL;
+}
+
+/**
+ * @brief Publish bytes written through modbus_stream_write_ptr().
+ *
+ * @param s Stream
+ * @param len Number of bytes written
+ * @return 0 on success, -1 if @p len exceeds the region returned by write_ptr
+ */
+int modbus_stream_commit(modbus_stream_st *s, size_t len)
+{
+    size_t avail = 0;
+    if (!modbus_stream_write_ptr(s, &avail) || (len > avail))
+    {
+        return (s && (len == 0)) ? 0 : -1;
+    }
+
+    size_t wp = write_index(s);
+    if (wp < MODBUS_STREAM_MIRROR_SIZE)
+    {
+        size_t mirrored = MODBUS_STREAM_MIRROR_SIZE - wp;
+        if (mirrored > len)
+        {
+            mirrored = len;
+        }
+        memcpy(s->data + s->capacity + wp, s->data + wp, mirrored);
+    }
+
+    s->count += len;
+    return 0;
+}
+
+/**
+ * @brief Copy a chunk of bytes into the stream.
+ *
+ * @param s Stream
+ * @param buf Bytes to append
+ * @param len Number of bytes
+ * @return Number of bytes accepted (less than @p len when the ring is full)
+ */
+size_t modbus_stream_feed(modbus_stream_st *s, const uint8_t *buf, size_t len)
+{
+    size_t accepted = 0;
+
+    if (!buf)
+    {
+        return 0;
+    }
+
+    while (accepted < len)
+    {
+        size_t avail = 0;
+        uint8_t *dst = modbus_stream_write_ptr(s, &avail);
+        if (!dst)
+        {
+            break;
+        }
+
+        size_t n = ((len - accepted) < avail) ? (len - accepted) : avail;
+        memcpy(dst, buf + accepted, n);
+        modbus_stream_commit(s, n);
+        accepted += n;
+    }
+
+    return accepted;
+}
+
+/**
+ * @brief Extract the next complete frame, in place.
+ *
+ * @param s Stream
+ * @param frame Output: pointer to the first byte of the frame inside the ring
+ * @return Frame length in bytes, 0 if no complete frame is buffered yet,
+ *         or -1 on invalid arguments
+ */
+int modbus_stream_next_frame(modbus_stream_st *s, const uint8_t **frame)
+{
+    if (!s || !frame)
+    {
+        return -1;
+    }
+
+    while (s->count > 0)
+    {
+        const uint8_t *p = s->data + s->read_pos;
+        size_t contiguous = s->capacity + MODBUS_STREAM_MIRROR_SIZE - s->read_pos;
+        size_t avail = (s->count < contiguous) ? s->count : contiguous;
+
+        int len = modbus_frame_length(s->mode, p, avail);
+        if (len < 0)
+        {
+            consume(s, 1);
+            s->dropped_bytes++;
+            continue;
+        }
+
+        if ((len == 0) || ((size_t)len > avail))
+        {
+            return 0;
+        }
+
+        *frame = p;
+        consume(s, len);
+        return len;
+    }
+
+    return 0;
+}
@@ -0,0 +1,316 @@
+/**
+ * @file modbus_swap.c
+ * @brief Register block conversion between host order and Modbus wire order.
+ *
+ * The vector engines swap the two bytes of every register with one shuffle
+ * per vector (PSHUFB, VPSHUFB or VREV16). They are only built for
+ * little-endian hosts, where wire order is exactly the byte-swapped memory
+ * image of a uint16_t array. The scalar engine is portable to any host.
+ */
+#include <stdatomic.h>
+
+#include "modbus_swap.h"
+
+#if defined(__x86_64__) && defined(__GNUC__)
+#include <immintrin.h>
+#define MODBUS_SWAP_HAVE_X86 1
+#else
+#define MODBUS_SWAP_HAVE_X86 0
+#endif
+
+#if defined(__ARM_NEON) && defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+#include <arm_neon.h>
+#define MODBUS_SWAP_HAVE_NEON 1
+#else
+#define MODBUS_SWAP_HAVE_NEON 0
+#endif
+
+/** @brief Registers converted per chunk before its bytes are checksummed */
+#define SWAP_CRC_CHUNK_REGS 64
+
+typedef void (*swap_kernel_ft)(uint8_t *dst, const uint8_t *src, size_t qty);
+
+static atomic_int selected_engine = MODBUS_SWAP_ENGINE_AUTO;
+
+/**
+ * @brief Swap the two bytes of each 16-bit word (little-endian hosts only).
+ */
+static void swap_pairs_scalar(uint8_t *dst, const uint8_t *src, size_t qty)
+{
+    for (size_t i = 0; i < qty; i++)
+    {
+        uint8_t hi = src[(i * 2) + 1];
+        dst[(i * 2) + 1] = src[i * 2];
+        dst[i * 2] = hi;
+    }
+}
+
+#if MODBUS_SWAP_HAVE_X86
+/**
+ * @brief SSSE3 kernel: 8 registers per shuffle.
+ */
+__attribute__((target("ssse3"))) static void swap_pairs_ssse3(uint8_t *dst, const uint8_t *src, size_t qty)
+{
+    const __m128i mask = _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+    size_t i = 0;
+
+    for (; i + 8 <= qty; i += 8)
+    {
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + (i * 2)));
+        _mm_storeu_si128((__m128i *)(dst + (i * 2)), _mm_shuffle_epi8(v, mask));
+    }
+    swap_pairs_scalar(dst + (i * 2), src + (i * 2), qty - i);
+}
+
+/**
+ * @brief AVX2 kernel: 16 registers per shuffle.
+ */
+__attribute__((target("avx2"))) static void swap_pairs_avx2(uint8_t *dst, const uint8_t *src, size_t qty)
+{
+    const __m256i mask = _mm256_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+                                          1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+    size_t i = 0;
+
+    for (; i + 16 <= qty; i += 16)
+    {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(src + (i * 2)));
+        _mm256_storeu_si256((__m256i *)(dst + (i * 2)), _mm256_shuffle_epi8(v, mask));
+    }
+    if (i + 8 <= qty)
+    {
+        const __m128i mask128 = _mm256_castsi256_si128(mask);
+        __m128i v = _mm_loadu_si128((const __m128i *)(src + (i * 2)));
+        _mm_storeu_si128((__m128i *)(dst + (i * 2)), _mm_shuffle_epi8(v, mask128));
+        i += 8;
+    }
+    swap_pairs_scalar(dst + (i * 2), src + (i * 2), qty - i);
+}
+#endif
+
+#if MODBUS_SWAP_HAVE_NEON
+/**
+ * @brief NEON kernel: 8 registers per VREV16.
+ */
+static void swap_pairs_neon(uint8_t *dst, const uint8_t *src, size_t qty)
+{
+    size_t i = 0;
+
+    for (; i + 8 <= qty; i += 8)
+    {
+        vst1q_u8(dst + (i * 2), vrev16q_u8(vld1q_u8(src + (i * 2))));
+    }
+    swap_pairs_scalar(dst + (i * 2), src + (i * 2), qty - i);
+}
+#endif
+
+/**
+ * @brief Resolve the selected engine to a byte-pair kernel.
+ *
+ * @return Kernel, or NULL when the portable typed conversion must be used
+ */
+static swap_kernel_ft swap_kernel(void)
+{
+    switch (modbus_swap_get_engine())
+    {
+    case MODBUS_SWAP_ENGINE_SCALAR:
+        return NULL;
+#if MODBUS_SWAP_HAVE_X86
+    case MODBUS_SWAP_ENGINE_SSSE3:
+        return swap_pairs_ssse3;
+    case MODBUS_SWAP_ENGINE_AVX2:
+        return swap_pairs_avx2;
+#endif
+#if MODBUS_SWAP_HAVE_NEON
+    case MODBUS_SWAP_ENGINE_NEON:
+        return swap_pairs_neon;
+#endif
+    default:
+        break;
+    }
+
+#if MODBUS_SWAP_HAVE_X86
+    if (modbus_swap_engine_supported(MODBUS_SWAP_ENGINE_AVX2))
+    {
+        return swap_pairs_avx2;
+    }
+    if (modbus_swap_engine_supported(MODBUS_SWAP_ENGINE_SSSE3))
+    {
+        return swap_pairs_ssse3;
+    }
+#endif
+#if MODBUS_SWAP_HAVE_NEON
+    return swap_pairs_neon;
+#else
+    return NULL;
+#endif
+}
+
+/**
+ * @brief Check whether an engine can run on this build and CPU.
+ *
+ * @param engine Engine to check
+ * @return true if the engine can be selected
+ */
+bool modbus_swap_engine_supported(modbus_swap_engine_et engine)
+{
+    switch (engine)
+    {
+    case MODBUS_SWAP_ENGINE_AUTO:
+    case MODBUS_SWAP_ENGINE_SCALAR:
+        return true;
+#if MODBUS_SWAP_HAVE_X86
+    case MODBUS_SWAP_ENGINE_SSSE3:
+        return __builtin_cpu_supports("ssse3");
+    case MODBUS_SWAP_ENGINE_AVX2:
+        return __builtin_cpu_supports("avx2");
+#endif
+#if MODBUS_SWAP_HAVE_NEON
+    case MODBUS_SWAP_ENGINE_NEON:
+        return true;
+#endif
+    default:
+        return false;
+    }
+}
+
+/**
+ * @brief Get a short printable name for an engine.
+ *
+ * @param engine Engine
+ * @return Static string, "unknown" for invalid values
+ */
+const char *modbus_swap_engine_name(modbus_swap_engine_et engine)
+{
+    switch (engine)
+    {
+    case MODBUS_SWAP_ENGINE_AUTO:
+        return "auto";
+    case MODBUS_SWAP_ENGINE_SCALAR:
+        return "scalar";
+    case MODBUS_SWAP_ENGINE_SSSE3:
+        return "ssse3";
+    case MODBUS_SWAP_ENGINE_AVX2:
+        return "avx2";
+    case MODBUS_SWAP_ENGINE_NEON:
+        return "neon";
+    default:
+        return "unknown";
+    }
+}
+
+/**
+ * @brief Select the conversion engine.
+ *
+ * @param engine Engine to use
+ * @return 0 on success, -1 if the engine is unknown or not supported by this CPU
+ */
+int modbus_swap_set_engine(modbus_swap_engine_et engine)
+{
+    if (!modbus_swap_engine_supported(engine))
+    {
+        return -1;
+    }
+    atomic_store_explicit(&selected_engine, (int)engine, memory_order_relaxed);
+    return 0;
+}
+
+/**
+ * @brief Get the currently selected conversion engine.
+ *
+ * @return Selected engine (MODBUS_SWAP_ENGINE_AUTO by default)
+ */
+modbus_swap_engine_et modbus_swap_get_engine(void)
+{
+    return (modbus_swap_engine_et)atomic_load_explicit(&selected_engine, memory_order_relaxed);
+}
+
+/**
+ * @brief Convert host-order registers to wire order.
+ *
+ * @param dst Output buffer of at least qty * 2 bytes (no alignment required)
+ * @param regs Registers in host byte order
+ * @param qty Number of registers
+ */
+void modbus_regs_to_be(uint8_t *dst, const uint16_t *regs, size_t qty)
+{
+    swap_kernel_ft kernel = swap_kernel();
+
+    if (kernel)
+    {
+        kernel(dst, (const uint8_t *)regs, qty);
+        return;
+    }
+
+    for (size_t i = 0; i < qty; i++)
+    {
+        dst[i * 2] = (uint8_t)(regs[i] >> 8);
+        dst[(i * 2) + 1] = (uint8_t)(regs[i] & 0xFF);
+    }
+}
+
+/**
+ * @brief Convert wire-order registers to host order.
+ *
+ * @param regs Output array of at least qty entries
+ * @param src Input buffer of qty * 2 bytes (no alignment required)
+ * @param qty Number of registers
+ */
+void modbus_regs_from_be(uint16_t *regs, const uint8_t *src, size_t qty)
+{
+    swap_kernel_ft kernel = swap_kernel();
+
+    if (kernel)
+    {
+        kernel((uint8_t *)regs, src, qty);
+        return;
+    }
+
+    for (size_t i = 0; i < qty; i++)
+    {
+        regs[i] = (uint16_t)((src[i * 2] << 8) | src[(i * 2) + 1]);
+    }
+}
+
+/**
+ * @brief Convert host-order registers to wire order and feed the wire bytes
+ *        into a CRC16 context in the same sweep.
+ *
+ * @param dst Output buffer of at least qty * 2 bytes
+ * @param regs Registers in host byte order
+ * @param qty Number of registers
+ * @param crc CRC context updated with the written bytes
+ */
+void modbus_regs_to_be_crc(uint8_t *dst, const uint16_t *regs, size_t qty, modbus_crc16_ctx_st *crc)
+{
+    while (qty)
+    {
+        size_t n = (qty < SWAP_CRC_CHUNK_REGS) ? qty : SWAP_CRC_CHUNK_REGS;
+        modbus_regs_to_be(dst, regs, n);
+        modbus_crc16_update(crc, dst, n * 2);
+        dst += n * 2;
+        regs += n;
+        qty -= n;
+    }
+}
+
+/**
+ * @brief Convert wire-order registers to host order and feed the wire bytes
+ *        into a CRC16 context in the same sweep.
+ *
+ * @param regs Output array of at least qty entries
+ * @param src Input buffer of qty * 2 bytes
+ * @param qty Number of registers
+ * @param crc CRC context updated with the read bytes
+ */
+void modbus_regs_from_be_crc(uint16_t *regs, const uint8_t *src, size_t qty, modbus_crc16_ctx_st *crc)
+{
+    while (qty)
+    {
+        size_t n = (qty < SWAP_CRC_CHUNK_REGS) ? qty : SWAP_CRC_CHUNK_REGS;
+        modbus_crc16_update(crc, src, n * 2);
+        modbus_regs_from_be(regs, src, n);
+        src += n * 2;
+        regs += n;
+        qty -= n;
+    }
+}
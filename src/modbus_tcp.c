@@ -0,0 +1,590 @@
+/**
+ * @file modbus_tcp.c
+ * @brief Modbus TCP (MBAP) framing for Read Holding Registers.
+ *
+ * This module provides functions to:
+ *  - Encode and decode the MBAP header.
+ *  - Encode requests and decode responses on a pipelining master, matching
+ *    responses to outstanding requests by transaction ID.
+ *  - Decode requests and encode responses on a slave.
+ *  - Carry any PDU from modbus_pdu on the same pipelining master.
+ *
+ * The PDU layout is the RTU frame without its CRC, so the same packed
+ * request/response structures are reused after the 6-byte MBAP prefix.
+ */
+#include <string.h>
+
+#include "modbus_tcp.h"
+#include "modbus_pdu.h"
+#include "modbus_utils.h"
+#include "modbus_types.h"
+#include "modbus_swap.h"
+
+/** @brief Bytes of the MBAP header that precede the unit ID */
+#define MBAP_PREFIX_SIZE (MODBUS_MBAP_HEADER_SIZE - 1)
+
+/** @brief open_transaction() result when the pipeline is full */
+#define NO_TRANSACTION UINT32_MAX
+
+/** @brief Largest MBAP length field: unit ID + 253-byte PDU */
+#define MBAP_MAX_LENGTH (MODBUS_TCP_MAX_ADU_SIZE - MBAP_PREFIX_SIZE)
+
+/**
+ * @brief Encode an MBAP header.
+ *
+ * @param transaction_id Transaction identifier
+ * @param unit_id Unit identifier
+ * @param pdu_len Length of the PDU that follows the header
+ * @param buffer Output buffer
+ * @param bufsize Size of the output buffer
+ * @return MODBUS_MBAP_HEADER_SIZE on success, or 0 on failure
+ */
+uint16_t encode_mbap_header(uint16_t transaction_id, uint8_t unit_id, uint16_t pdu_len,
+                            uint8_t *buffer, size_t bufsize)
+{
+    if ((buffer == NULL) || (bufsize < sizeof(mbap_header_st)) || (pdu_len == 0) || (pdu_len >= MBAP_MAX_LENGTH))
+    {
+        return 0;
+    }
+
+    mbap_header_st h = {0};
+    h.transaction_id = MODBUS_HTONS(transaction_id);
+    h.protocol_id = MODBUS_HTONS(MODBUS_TCP_PROTOCOL_ID);
+    h.length = MODBUS_HTONS(pdu_len + 1);
+    h.unit_id = unit_id;
+
+    memcpy(buffer, &h, sizeof(h));
+    return sizeof(h);
+}
+
+/**
+ * @brief Decode and validate an MBAP header.
+ *
+ * @param buffer Buffer starting with an MBAP header
+ * @param bufsize Number of valid bytes in the buffer
+ * @param transaction_id Output transaction identifier (may be NULL)
+ * @param unit_id Output unit identifier (may be NULL)
+ * @param pdu_len Output PDU length (may be NULL)
+ * @return Total ADU length (header + PDU) on success, or a negative error code:
+ *         -1: Invalid input pointer
+ *         -2: Buffer shorter than the MBAP header
+ *         -3: Protocol identifier is not Modbus
+ *         -4: Length field out of range
+ */
+int decode_mbap_header(const uint8_t *buffer, size_t bufsize,
+                       uint16_t *transaction_id, uint8_t *unit_id, uint16_t *pdu_len)
+{
+    if (!buffer)
+    {
+        return -1;
+    }
+
+    if (bufsize < sizeof(mbap_header_st))
+    {
+        return -2;
+    }
+
+    mbap_header_st h;
+    memcpy(&h, buffer, sizeof(h));
+
+    if (MODBUS_HTONS(h.protocol_id) != MODBUS_TCP_PROTOCOL_ID)
+    {
+        return -3;
+    }
+
+    uint16_t length = MODBUS_HTONS(h.length);
+    if ((length < 2) || (length > MBAP_MAX_LENGTH))
+    {
+        return -4;
+    }
+
+    if (transaction_id)
+    {
+        *transaction_id = MODBUS_HTONS(h.transaction_id);
+    }
+    if (unit_id)
+    {
+        *unit_id = h.unit_id;
+    }
+    if (pdu_len)
+    {
+        *pdu_len = length - 1;
+    }
+
+    return MBAP_PREFIX_SIZE + length;
+}
+
+/**
+ * @brief Initialize a Modbus TCP master context.
+ *
+ * @param ctx Context to initialize
+ * @param max_outstanding Maximum number of requests in flight (1..MODBUS_TCP_MAX_PIPELINE)
+ * @return 0 on success, -1 on invalid arguments
+ */
+int modbus_tcp_master_ctx_init(modbus_tcp_master_ctx_st *ctx, uint8_t max_outstanding)
+{
+    if (!ctx || (max_outstanding == 0) || (max_outstanding > MODBUS_TCP_MAX_PIPELINE))
+    {
+        return -1;
+    }
+
+    memset(ctx, 0, sizeof(*ctx));
+    ctx->max_outstanding = max_outstanding;
+    return 0;
+}
+
+/**
+ * @brief Number of requests sent and not yet answered or cancelled.
+ *
+ * @param ctx Master context
+ * @return Outstanding request count
+ */
+uint8_t modbus_tcp_master_outstanding(const modbus_tcp_master_ctx_st *ctx)
+{
+    return ctx ? ctx->outstanding : 0;
+}
+
+/**
+ * @brief Find the pending slot of a transaction.
+ */
+static modbus_tcp_transaction_st *find_transaction(modbus_tcp_master_ctx_st *ctx, uint16_t transaction_id)
+{
+    for (int i = 0; i < MODBUS_TCP_MAX_PIPELINE; i++)
+    {
+        if (ctx->pending[i].in_use && (ctx->pending[i].transaction_id == transaction_id))
+        {
+            return &ctx->pending[i];
+        }
+    }
+    return NULL;
+}
+
+/**
+ * @brief Release a pending slot.
+ */
+static void release_transaction(modbus_tcp_master_ctx_st *ctx, modbus_tcp_transaction_st *t)
+{
+    t->in_use = false;
+    ctx->outstanding--;
+}
+
+/**
+ * @brief Reserve a pending slot and a transaction ID for a new request.
+ *
+ * @return Transaction ID, or NO_TRANSACTION if the pipeline is full
+ */
+static uint32_t open_transaction(modbus_tcp_master_ctx_st *ctx, uint8_t unit_id, const uint8_t *pdu)
+{
+    if (ctx->outstanding >= ctx->max_outstanding)
+    {
+        return NO_TRANSACTION;
+    }
+
+    modbus_tcp_transaction_st *slot = NULL;
+    for (int i = 0; i < MODBUS_TCP_MAX_PIPELINE; i++)
+    {
+        if (!ctx->pending[i].in_use)
+        {
+            slot = &ctx->pending[i];
+            break;
+        }
+    }
+
+    /* Skip IDs still in flight after a wrap-around */
+    uint16_t tid = ctx->next_transaction_id++;
+    while (find_transaction(ctx, tid))
+    {
+        tid = ctx->next_transaction_id++;
+    }
+
+    slot->in_use = true;
+    slot->transaction_id = tid;
+    slot->unit_id = unit_id;
+    memcpy(slot->request, pdu, sizeof(slot->request));
+    ctx->outstanding++;
+
+    return tid;
+}
+
+/**
+ * @brief Forget an outstanding request, e.g. after a timeout.
+ *
+ * @param ctx Master context
+ * @param transaction_id Transaction to cancel
+ * @return 0 on success, -1 if no such transaction is outstanding
+ */
+int modbus_tcp_master_cancel(modbus_tcp_master_ctx_st *ctx, uint16_t transaction_id)
+{
+    if (!ctx)
+    {
+        return -1;
+    }
+
+    modbus_tcp_transaction_st *t = find_transaction(ctx, transaction_id);
+    if (!t)
+    {
+        return -1;
+    }
+
+    release_transaction(ctx, t);
+    return 0;
+}
+
+/**
+ * @brief Encode a Modbus TCP Read Holding Registers request.
+ *
+ * @param ctx Master context, records the outstanding transaction
+ * @param unit_id Unit identifier
+ * @param addr Starting register address
+ * @param qty Number of registers to read
+ * @param buffer Output buffer to store the encoded request
+ * @param bufsize Size of the output buffer
+ * @param transaction_id Output transaction ID assigned to the request (may be NULL)
+ * @return Length of the encoded request in bytes, or 0 on failure
+ *         (invalid parameters or pipeline full)
+ */
+uint16_t encode_tcp_read_request(modbus_tcp_master_ctx_st *ctx, uint8_t unit_id, uint16_t addr, uint16_t qty,
+                                 uint8_t *buffer, size_t bufsize, uint16_t *transaction_id)
+{
+    if ((ctx == NULL) || (buffer == NULL) || (bufsize < (MBAP_PREFIX_SIZE + sizeof(read_holding_registers_request_st))))
+    {
+        return 0;
+    }
+
+    if (!is_valid_quantity(qty) || !is_valid_address_range(addr, qty))
+    {
+        return 0;
+    }
+
+    uint8_t pdu[MODBUS_PDU_REQUEST_HEADER_SIZE];
+    modbus_pdu_encode_read(MODBUS_READ_HOLDING_REG, addr, qty, pdu, sizeof(pdu));
+
+    uint32_t tid = open_transaction(ctx, unit_id, pdu);
+    if (tid == NO_TRANSACTION)
+    {
+        return 0;
+    }
+
+    read_holding_registers_request_st r = {0};
+    r.slave_id = unit_id;
+    r.function_code = MODBUS_READ_HOLDING_REG;
+    r.starting_address = MODBUS_HTONS(addr);
+    r.qty = MODBUS_HTONS(qty);
+
+    encode_mbap_header((uint16_t)tid, unit_id, sizeof(r) - 1, buffer, bufsize);
+    memcpy(buffer + MBAP_PREFIX_SIZE, &r, sizeof(r));
+
+    if (transaction_id)
+    {
+        *transaction_id = (uint16_t)tid;
+    }
+
+    return MBAP_PREFIX_SIZE + sizeof(r);
+}
+
+/**
+ * @brief Encode a Modbus TCP request around any PDU built with the modbus_pdu_encode_*() functions.
+ *
+ * @param ctx Master context, records the outstanding transaction
+ * @param unit_id Unit identifier
+ * @param pdu Request PDU
+ * @param pdu_len Length of the request PDU
+ * @param buffer Output buffer to store the encoded request
+ * @param bufsize Size of the output buffer
+ * @param transaction_id Output transaction ID assigned to the request (may be NULL)
+ * @return Length of the encoded request in bytes, or 0 on failure
+ *         (invalid parameters or pipeline full)
+ */
+uint16_t encode_tcp_request(modbus_tcp_master_ctx_st *ctx, uint8_t unit_id, const uint8_t *pdu, size_t pdu_len,
+                            uint8_t *buffer, size_t bufsize, uint16_t *transaction_id)
+{
+    if (!ctx || !pdu || !buffer || (bufsize < MODBUS_MBAP_HEADER_SIZE + pdu_len))
+    {
+        return 0;
+    }
+
+    if (modbus_pdu_request_length(pdu, pdu_len) != (int)pdu_len)
+    {
+        return 0;
+    }
+
+    uint32_t tid = open_transaction(ctx, unit_id, pdu);
+    if (tid == NO_TRANSACTION)
+    {
+        return 0;
+    }
+
+    encode_mbap_header((uint16_t)tid, unit_id, (uint16_t)pdu_len, buffer, bufsize);
+    memcpy(buffer + MODBUS_MBAP_HEADER_SIZE, pdu, pdu_len);
+
+    if (transaction_id)
+    {
+        *transaction_id = (uint16_t)tid;
+    }
+
+    return (uint16_t)(MODBUS_MBAP_HEADER_SIZE + pdu_len);
+}
+
+/**
+ * @brief Decode a Modbus TCP Read Holding Registers response.
+ *
+ * @param ctx Master context holding the outstanding requests
+ * @param buffer Buffer containing the response ADU
+ * @param bufsize Size of the buffer
+ * @param regs Output array to store decoded register values
+ * @param regs_len Length of the output array
+ * @param transaction_id Output transaction ID of the response (may be NULL)
+ * @return Number of registers decoded on success, or a negative error code:
+ *         -1: Invalid input pointers
+ *         -2: No outstanding request with this transaction ID and unit ID
+ *         -3: Function code mismatch
+ *         -4: Byte count does not match the request
+ *         -5: Buffer too small
+ *         -6: Output array too small
+ *         -7: Invalid MBAP header
+ */
+int decode_tcp_read_response(modbus_tcp_master_ctx_st *ctx, const uint8_t *buffer, size_t bufsize,
+                             uint16_t *regs, uint8_t regs_len, uint16_t *transaction_id)
+{
+    static const uint8_t PACKET_HEADER_SIZE = MBAP_PREFIX_SIZE + sizeof(read_holding_registers_header_response_st);
+
+    if (!ctx || !buffer || !regs)
+    {
+        return -1;
+    }
+
+    uint16_t tid = 0;
+    uint8_t unit_id = 0;
+    int adu_len = decode_mbap_header(buffer, bufsize, &tid, &unit_id, NULL);
+    if (adu_len == -2)
+    {
+        return -5;
+    }
+    if (adu_len < 0)
+    {
+        return -7;
+    }
+
+    modbus_tcp_transaction_st *t = find_transaction(ctx, tid);
+    if (!t || (t->unit_id != unit_id))
+    {
+        return -2;
+    }
+
+    // A partial ADU keeps its transaction, so the caller can retry with the rest
+    if ((bufsize < PACKET_HEADER_SIZE) || (bufsize < (size_t)adu_len))
+    {
+        return -5;
+    }
+
+    uint16_t expected_qty = modbus_pdu_request_qty(t->request, sizeof(t->request));
+    release_transaction(ctx, t);
+
+    if (transaction_id)
+    {
+        *transaction_id = tid;
+    }
+
+    read_holding_registers_header_response_st resp;
+    memcpy(&resp, buffer + MBAP_PREFIX_SIZE, sizeof(resp));
+
+    if (resp.function_code != MODBUS_READ_HOLDING_REG)
+    {
+        return -3;
+    }
+
+    if (!is_valid_byte_count(resp.byte_count) || (resp.byte_count != (expected_qty * 2)) ||
+        (adu_len != (PACKET_HEADER_SIZE + resp.byte_count)))
+    {
+        return -4;
+    }
+
+    uint8_t reg_count = resp.byte_count / 2;
+    if (regs_len < reg_count)
+    {
+        return -6;
+    }
+
+    modbus_regs_from_be(regs, buffer + PACKET_HEADER_SIZE, reg_count);
+    return reg_count;
+}
+
+/**
+ * @brief Decode the Modbus TCP response to any request encoded on this context.
+ *
+ * @param ctx Master context holding the outstanding requests
+ * @param buffer Buffer containing the response ADU
+ * @param bufsize Size of the buffer
+ * @param regs Output register values for reads (may be NULL for writes)
+ * @param regs_len Length of the output array
+ * @param transaction_id Output transaction ID of the response (may be NULL)
+ * @return Number of registers read (0 for writes), or a negative error code:
+ *         -1: Invalid input pointers
+ *         -2: No outstanding request with this transaction ID and unit ID
+ *         -3: Function code mismatch
+ *         -4: Byte count or echoed address, value or quantity does not match the request
+ *         -5: Buffer too small
+ *         -6: Output array too small
+ *         -7: Invalid MBAP header
+ *         -8: Exception response; the exception code follows the function code
+ */
+int decode_tcp_response(modbus_tcp_master_ctx_st *ctx, const uint8_t *buffer, size_t bufsize, uint16_t *regs,
+                        uint16_t regs_len, uint16_t *transaction_id)
+{
+    if (!ctx || !buffer)
+    {
+        return -1;
+    }
+
+    uint16_t tid = 0;
+    uint8_t unit_id = 0;
+    uint16_t pdu_len = 0;
+    int adu_len = decode_mbap_header(buffer, bufsize, &tid, &unit_id, &pdu_len);
+    if (adu_len == -2)
+    {
+        return -5;
+    }
+    if (adu_len < 0)
+    {
+        return -7;
+    }
+
+    modbus_tcp_transaction_st *t = find_transaction(ctx, tid);
+    if (!t || (t->unit_id != unit_id))
+    {
+        return -2;
+    }
+
+    // A partial ADU keeps its transaction, so the caller can retry with the rest
+    if (bufsize < (size_t)adu_len)
+    {
+        return -5;
+    }
+
+    uint8_t request[MODBUS_PDU_REQUEST_HEADER_SIZE];
+    memcpy(request, t->request, sizeof(request));
+    release_transaction(ctx, t);
+
+    if (transaction_id)
+    {
+        *transaction_id = tid;
+    }
+
+    const uint8_t *pdu = buffer + MODBUS_MBAP_HEADER_SIZE;
+    int expected = modbus_pdu_response_length(pdu, pdu_len);
+    if ((pdu_len == 0) || ((expected > 0) && (expected != pdu_len)))
+    {
+        return ((pdu[0] & (uint8_t)~MODBUS_EXCEPTION_FLAG) != request[0]) ? -3 : -4;
+    }
+
+    return modbus_pdu_decode_response(request, sizeof(request), pdu, pdu_len, regs, regs_len);
+}
+
+/**
+ * @brief Decode a Modbus TCP Read Holding Registers request.
+ *
+ * @param ctx Slave context holding the device slave ID
+ * @param buffer Pointer to the incoming request ADU
+ * @param bufsize Size of the incoming buffer
+ * @param transaction_id Output transaction ID to echo in the response
+ * @param unit_id Output unit identifier to echo in the response
+ * @param start_addr Output starting register address
+ * @param qty Output quantity of registers
+ * @return 0 on success, or a negative error code:
+ *         -1: Invalid input pointers
+ *         -2: Buffer too small or invalid MBAP header
+ *         -3: Invalid quantity or address range
+ *         -4: Unit ID not addressed to this device
+ *         -5: Function code not supported
+ */
+int decode_tcp_read_request(const modbus_slave_ctx_st *ctx, const uint8_t *buffer, size_t bufsize,
+                            uint16_t *transaction_id, uint8_t *unit_id, uint16_t *start_addr, uint16_t *qty)
+{
+    static const uint8_t PACKET_SIZE = MBAP_PREFIX_SIZE + sizeof(read_holding_registers_request_st);
+
+    if (!ctx || !buffer || !transaction_id || !unit_id || !start_addr || !qty)
+    {
+        return -1;
+    }
+
+    uint16_t tid = 0;
+    int adu_len = decode_mbap_header(buffer, bufsize, &tid, NULL, NULL);
+    if ((adu_len != PACKET_SIZE) || (bufsize < PACKET_SIZE))
+    {
+        return -2;
+    }
+
+    read_holding_registers_request_st req;
+    memcpy(&req, buffer + MBAP_PREFIX_SIZE, sizeof(req));
+
+    uint16_t qty_req = MODBUS_HTONS(req.qty);
+    uint16_t start_addr_req = MODBUS_HTONS(req.starting_address);
+
+    if (!is_valid_quantity(qty_req) || !is_valid_address_range(start_addr_req, qty_req))
+    {
+        return -3;
+    }
+
+    if ((req.slave_id != ctx->device_slave_id) && (req.slave_id != BROADCAST_SLAVE_ID) &&
+        (req.slave_id != MODBUS_TCP_UNIT_ID_IGNORED))
+    {
+        return -4;
+    }
+
+    if (req.function_code != MODBUS_READ_HOLDING_REG)
+    {
+        return -5;
+    }
+
+    *transaction_id = tid;
+    *unit_id = req.slave_id;
+    *start_addr = start_addr_req;
+    *qty = qty_req;
+
+    return 0;
+}
+
+/**
+ * @brief Encode a Modbus TCP Read Holding Registers response.
+ *
+ * @param ctx Slave context
+ * @param transaction_id Transaction ID copied from the request
+ * @param unit_id Unit ID copied from the request
+ * @param regs Array of register values to include in response
+ * @param qty Number of registers to include (must be <= MODBUS_MAX_REGS)
+ * @param buffer Output buffer to store the encoded response
+ * @param bufsize Size of the output buffer
+ * @return Length of the encoded response in bytes, or 0 on failure
+ */
+uint16_t encode_tcp_read_response(const modbus_slave_ctx_st *ctx, uint16_t transaction_id, uint8_t unit_id,
+                                  const uint16_t *regs, uint16_t qty, uint8_t *buffer, size_t bufsize)
+{
+    static const uint8_t PACKET_HEADER_SIZE = MBAP_PREFIX_SIZE + sizeof(read_holding_registers_header_response_st);
+
+    if ((!ctx) || (!buffer) || (!regs))
+    {
+        return 0;
+    }
+
+    if (!is_valid_quantity(qty))
+    {
+        return 0;
+    }
+
+    size_t frame_len = PACKET_HEADER_SIZE + (qty * sizeof(uint16_t));
+    if (bufsize < frame_len)
+    {
+        return 0;
+    }
+
+    read_holding_registers_header_response_st resp = {0};
+    resp.slave_id = unit_id;
+    resp.function_code = MODBUS_READ_HOLDING_REG;
+    resp.byte_count = qty * sizeof(uint16_t);
+
+    encode_mbap_header(transaction_id, unit_id, sizeof(resp) - 1 + resp.byte_count, buffer, bufsize);
+    memcpy(buffer + MBAP_PREFIX_SIZE, &resp, sizeof(resp));
+    modbus_regs_to_be(buffer + PACKET_HEADER_SIZE, regs, qty);
+
+    return frame_len;
+}
@@ -0,0 +1,287 @@
+/**
+ * @file modbus_trace.c
+ * @brief Ring allocation, kernel receive timestamps and the reader side of the trace rings.
+ *
+ * Appending is inline in modbus_trace.h. Reading follows the sequence
+ * lock protocol: the slot sequence is loaded before and after the words
+ * are copied, and the copy only counts if both loads saw the complete
+ * sequence of the record wanted.
+ */
+#define _GNU_SOURCE
+
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <sys/socket.h>
+
+#include "modbus_trace.h"
+
+/** @brief Largest number of rings */
+#define TRACE_MAX_RINGS 1024
+
+/** @brief Records copied out per modbus_trace_read() call in modbus_trace_collect() */
+#define TRACE_COLLECT_CHUNK 256
+
+/**
+ * @brief Start and end stage of every span.
+ */
+static const uint8_t SPAN_STAGES[MODBUS_TRACE_SPANS][2] = {
+    [MODBUS_TRACE_SPAN_SUBMIT] = {MODBUS_TRACE_ENCODED, MODBUS_TRACE_SENT},
+    [MODBUS_TRACE_SPAN_WIRE] = {MODBUS_TRACE_SENT, MODBUS_TRACE_RECEIVED},
+    [MODBUS_TRACE_SPAN_QUEUE] = {MODBUS_TRACE_RECEIVED, MODBUS_TRACE_READ},
+    [MODBUS_TRACE_SPAN_DECODE] = {MODBUS_TRACE_READ, MODBUS_TRACE_DECODED},
+    [MODBUS_TRACE_SPAN_TOTAL] = {MODBUS_TRACE_ENCODED, MODBUS_TRACE_DECODED},
+};
+
+/**
+ * @brief Add one value to a histogram only the caller can see.
+ */
+static void histogram_add(modbus_stats_histogram_st *h, uint64_t value_ns)
+{
+    h->buckets[modbus_stats_bucket(value_ns)]++;
+    h->count++;
+    h->sum_ns += value_ns;
+    if (value_ns > h->max_ns)
+    {
+        h->max_ns = value_ns;
+    }
+}
+
+/**
+ * @brief Allocate empty rings.
+ *
+ * @param trace Set to initialize
+ * @param rings Number of rings
+ * @param capacity Records per ring, a power of two
+ * @return 0 on success, or a negative error code
+ */
+int modbus_trace_init(modbus_trace_st *trace, uint32_t rings, uint32_t capacity)
+{
+    if (!trace || (rings == 0) || (rings > TRACE_MAX_RINGS) || (capacity < 2) ||
+        (capacity > MODBUS_TRACE_MAX_CAPACITY) || ((capacity & (capacity - 1)) != 0))
+    {
+        return -1;
+    }
+
+    trace->count = 0;
+    trace->rings = aligned_alloc(MODBUS_CACHE_LINE_SIZE, sizeof(*trace->rings) * rings);
+    if (!trace->rings)
+    {
+        return -2;
+    }
+    memset(trace->rings, 0, sizeof(*trace->rings) * rings);
+
+    for (uint32_t r = 0; r < rings; r++)
+    {
+        trace->rings[r].mask = capacity - 1;
+        trace->rings[r].slots = calloc(capacity, sizeof(modbus_trace_slot_st));
+        if (!trace->rings[r].slots)
+        {
+            trace->count = r;
+            modbus_trace_free(trace);
+            return -2;
+        }
+    }
+    trace->count = rings;
+    return 0;
+}
+
+/**
+ * @brief Release the rings.
+ *
+ * @param trace Set
+ */
+void modbus_trace_free(modbus_trace_st *trace)
+{
+    if (!trace)
+    {
+        return;
+    }
+
+    for (uint32_t r = 0; trace->rings && (r < trace->count); r++)
+    {
+        free(trace->rings[r].slots);
+    }
+    free(trace->rings);
+    trace->rings = NULL;
+    trace->count = 0;
+}
+
+/**
+ * @brief Ring for one thread.
+ *
+ * @param trace Set
+ * @param index Ring index
+ * @return Ring, or NULL if there is no such ring
+ */
+modbus_trace_ring_st *modbus_trace_ring(modbus_trace_st *trace, uint32_t index)
+{
+    if (!trace || (index >= trace->count))
+    {
+        return NULL;
+    }
+    return &trace->rings[index];
+}
+
+/**
+ * @brief Current time on the clock of the kernel receive timestamps.
+ *
+ * @return CLOCK_REALTIME in nanoseconds
+ */
+uint64_t modbus_trace_now_ns(void)
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+/**
+ * @brief Ask the kernel to timestamp every packet a socket receives.
+ *
+ * @param fd Socket
+ * @return 0 on success, or -1 on error
+ */
+int modbus_trace_enable_rx_timestamps(int fd)
+{
+    int on = 1;
+    return (setsockopt(fd, SOL_SOCKET, SO_TIMESTAMPNS, &on, sizeof(on)) == 0) ? 0 : -1;
+}
+
+/**
+ * @brief Receive timestamp of a received message.
+ *
+ * @param msg Message header
+ * @return CLOCK_REALTIME in nanoseconds, or 0 if there is none
+ */
+uint64_t modbus_trace_rx_timestamp(const struct msghdr *msg)
+{
+    if (!msg || !msg->msg_control)
+    {
+        return 0;
+    }
+
+    for (struct cmsghdr *c = CMSG_FIRSTHDR(msg); c; c = CMSG_NXTHDR((struct msghdr *)msg, c))
+    {
+        // SCM_TIMESTAMPING carries three stamps; the software one comes first
+        if ((c->cmsg_level == SOL_SOCKET) && ((c->cmsg_type == SCM_TIMESTAMPNS) || (c->cmsg_type == SCM_TIMESTAMPING)))
+        {
+            struct timespec ts;
+            memcpy(&ts, CMSG_DATA(c), sizeof(ts));
+            return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Copy out the records of a ring written since a cursor.
+ *
+ * @param ring Ring
+ * @param cursor In: first record wanted; out: next record
+ * @param out Output records
+ * @param max Capacity of out
+ * @return Number of records copied
+ */
+uint32_t modbus_trace_read(const modbus_trace_ring_st *ring, uint64_t *cursor, modbus_trace_record_st *out,
+                           uint32_t max)
+{
+    if (!ring || !ring->slots || !cursor || (!out && (max > 0)))
+    {
+        return 0;
+    }
+
+    uint64_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    uint64_t n = (*cursor < head) ? *cursor : head;
+    if (head - n > (uint64_t)ring->mask + 1)
+    {
+        n = head - ring->mask - 1;
+    }
+
+    uint32_t copied = 0;
+    for (; (n < head) && (copied < max); n++)
+    {
+        const modbus_trace_slot_st *slot = &ring->slots[n & ring->mask];
+        uint64_t seq = __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE);
+        if (seq != 2 * n + 2)
+        {
+            // Already overwritten by a later lap, or being overwritten now
+            continue;
+        }
+
+        uint64_t words[MODBUS_TRACE_RECORD_WORDS];
+        for (size_t i = 0; i < MODBUS_TRACE_RECORD_WORDS; i++)
+        {
+            words[i] = __atomic_load_n(&slot->words[i], __ATOMIC_RELAXED);
+        }
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&slot->seq, __ATOMIC_RELAXED) != seq)
+        {
+            continue;
+        }
+        memcpy(&out[copied++], words, sizeof(words));
+    }
+
+    *cursor = n;
+    return copied;
+}
+
+/**
+ * @brief Add the spans of one record to a breakdown.
+ *
+ * @param breakdown Breakdown
+ * @param record Record
+ */
+void modbus_trace_breakdown_add(modbus_trace_breakdown_st *breakdown, const modbus_trace_record_st *record)
+{
+    if (!breakdown || !record)
+    {
+        return;
+    }
+
+    for (int s = 0; s < MODBUS_TRACE_SPANS; s++)
+    {
+        uint64_t start = record->ns[SPAN_STAGES[s][0]];
+        uint64_t end = record->ns[SPAN_STAGES[s][1]];
+        // CLOCK_REALTIME may step backwards; such a span says nothing
+        if ((start != 0) && (end >= start))
+        {
+            histogram_add(&breakdown->spans[s], end - start);
+        }
+    }
+    breakdown->records++;
+}
+
+/**
+ * @brief Fold everything written to the rings since the last call into a breakdown.
+ *
+ * @param trace Set
+ * @param cursors One cursor per ring
+ * @param breakdown Breakdown to add to
+ * @return Number of records folded in, or -1 on invalid arguments
+ */
+int64_t modbus_trace_collect(const modbus_trace_st *trace, uint64_t *cursors, modbus_trace_breakdown_st *breakdown)
+{
+    if (!trace || !cursors || !breakdown)
+    {
+        return -1;
+    }
+
+    modbus_trace_record_st chunk[TRACE_COLLECT_CHUNK];
+    int64_t folded = 0;
+    for (uint32_t r = 0; r < trace->count; r++)
+    {
+        uint32_t got;
+        do
+        {
+            uint64_t from = cursors[r];
+            got = modbus_trace_read(&trace->rings[r], &cursors[r], chunk, TRACE_COLLECT_CHUNK);
+            breakdown->lost += cursors[r] - from - got;
+            for (uint32_t i = 0; i < got; i++)
+            {
+                modbus_trace_breakdown_add(breakdown, &chunk[i]);
+            }
+            folded += got;
+        } while (got == TRACE_COLLECT_CHUNK);
+    }
+    return folded;
+}
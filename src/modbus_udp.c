@@ -0,0 +1,694 @@
+/**
+ * @file modbus_udp.c
+ * @brief Modbus over UDP with recvmmsg()/sendmmsg() bursts.
+ *
+ * Every receive slot has its own buffer and source address, and each
+ * datagram is decoded where the kernel put it. The server answers slot i
+ * into transmit slot i, addressed to the source of slot i, so a burst of
+ * requests becomes one burst of responses with no copy in between.
+ */
+#define _GNU_SOURCE
+
+#include <errno.h>
+#include <poll.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+
+#include "modbus_udp.h"
+
+/**
+ * @brief Burst buffers.
+ */
+struct modbus_udp_ring_s
+{
+    struct mmsghdr rx_msgs[MODBUS_UDP_BURST];
+    struct iovec rx_iov[MODBUS_UDP_BURST];
+    struct sockaddr_in rx_addr[MODBUS_UDP_BURST];
+    union
+    {
+        struct cmsghdr align;
+        uint8_t buf[MODBUS_TRACE_CMSG_SIZE];
+    } rx_control[MODBUS_UDP_BURST];
+    uint8_t rx_buf[MODBUS_UDP_BURST][MODBUS_TCP_MAX_ADU_SIZE];
+    struct mmsghdr tx_msgs[MODBUS_UDP_BURST];
+    struct iovec tx_iov[MODBUS_UDP_BURST];
+    uint8_t tx_buf[MODBUS_UDP_BURST][MODBUS_TCP_MAX_ADU_SIZE];
+};
+
+/**
+ * @brief Allocate the burst buffers and point every receive slot at its buffer.
+ */
+static modbus_udp_ring_st *ring_alloc(void)
+{
+    modbus_udp_ring_st *r = calloc(1, sizeof(*r));
+    if (!r)
+    {
+        return NULL;
+    }
+
+    for (int i = 0; i < MODBUS_UDP_BURST; i++)
+    {
+        r->rx_iov[i].iov_base = r->rx_buf[i];
+        r->rx_iov[i].iov_len = sizeof(r->rx_buf[i]);
+    }
+    return r;
+}
+
+/**
+ * @brief Receive one burst without blocking.
+ *
+ * @return Number of datagrams, 0 if none is queued, or -1 on error
+ */
+static int ring_receive(modbus_udp_ring_st *r, int fd, modbus_udp_stats_st *stats)
+{
+    // recvmmsg() overwrites the lengths, so every header is rebuilt
+    for (int i = 0; i < MODBUS_UDP_BURST; i++)
+    {
+        struct msghdr *h = &r->rx_msgs[i].msg_hdr;
+        memset(h, 0, sizeof(*h));
+        h->msg_name = &r->rx_addr[i];
+        h->msg_namelen = sizeof(r->rx_addr[i]);
+        h->msg_iov = &r->rx_iov[i];
+        h->msg_iovlen = 1;
+        h->msg_control = r->rx_control[i].buf;
+        h->msg_controllen = sizeof(r->rx_control[i].buf);
+    }
+
+    for (;;)
+    {
+        int n = recvmmsg(fd, r->rx_msgs, MODBUS_UDP_BURST, MSG_DONTWAIT, NULL);
+        if (n > 0)
+        {
+            stats->rx_calls++;
+            stats->rx_datagrams += (uint64_t)n;
+            return n;
+        }
+        if ((n < 0) && (errno == EINTR))
+        {
+            continue;
+        }
+        return ((n == 0) || (errno == EAGAIN) || (errno == EWOULDBLOCK)) ? 0 : -1;
+    }
+}
+
+/**
+ * @brief Send the first count transmit headers, waiting for room if the socket is full.
+ *
+ * @return 0 on success, or -1 on error
+ */
+static int ring_send(modbus_udp_ring_st *r, int fd, int count, modbus_udp_stats_st *stats)
+{
+    int sent = 0;
+
+    while (sent < count)
+    {
+        int n = sendmmsg(fd, r->tx_msgs + sent, (unsigned int)(count - sent), 0);
+        if (n > 0)
+        {
+            sent += n;
+            stats->tx_calls++;
+            stats->tx_datagrams += (uint64_t)n;
+        }
+        else if ((n < 0) && ((errno == EAGAIN) || (errno == EWOULDBLOCK)))
+        {
+            struct pollfd pfd = {.fd = fd, .events = POLLOUT};
+            poll(&pfd, 1, -1);
+        }
+        else if ((n < 0) && (errno != EINTR))
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Wait until a socket has a datagram queued.
+ *
+ * @return 1 if readable, 0 on timeout, or -1 on error
+ */
+static int wait_readable(int fd, int timeout_ms)
+{
+    struct pollfd pfd = {.fd = fd, .events = POLLIN};
+
+    int n = poll(&pfd, 1, timeout_ms);
+    if (n < 0)
+    {
+        return (errno == EINTR) ? 0 : -1;
+    }
+    return n;
+}
+
+/**
+ * @brief Answer one request datagram.
+ *
+ * @return Length of the response ADU, or -1 to drop the datagram
+ */
+static int server_answer(modbus_udp_server_st *srv, const uint8_t *req, size_t len, uint8_t *out)
+{
+    uint16_t tid, pdu_len;
+    uint8_t unit_id;
+
+    // One datagram is exactly one ADU: a length field that disagrees means a bad frame
+    if (decode_mbap_header(req, len, &tid, &unit_id, &pdu_len) != (int)len)
+    {
+        uint8_t unit = (len >= MODBUS_MBAP_HEADER_SIZE) ? req[MODBUS_MBAP_HEADER_SIZE - 1] : 0;
+        modbus_stats_error(srv->stats_shard, MODBUS_STATS_SLAVE, unit, -2);
+        return -1;
+    }
+    modbus_stats_frame(srv->stats_shard, unit_id, req[MODBUS_MBAP_HEADER_SIZE]);
+    const modbus_host_unit_st *unit = modbus_host_unit(srv->host, unit_id);
+    if (!unit)
+    {
+        modbus_stats_error(srv->stats_shard, MODBUS_STATS_SLAVE, unit_id, -4);
+        return -1;
+    }
+
+    uint8_t *resp = out + MODBUS_MBAP_HEADER_SIZE;
+    int resp_len = modbus_host_dispatch(unit, unit_id, req + MODBUS_MBAP_HEADER_SIZE, pdu_len, resp);
+    if (resp_len <= 0)
+    {
+        return -1;
+    }
+    if (resp[0] & MODBUS_EXCEPTION_FLAG)
+    {
+        srv->stats.exceptions++;
+    }
+
+    encode_mbap_header(tid, unit_id, (uint16_t)resp_len, out, MODBUS_MBAP_HEADER_SIZE);
+    return MODBUS_MBAP_HEADER_SIZE + resp_len;
+}
+
+/**
+ * @brief Bind the server socket and allocate its burst buffers.
+ *
+ * @param srv Server to initialize
+ * @param cfg Server configuration
+ * @return 0 on success, or a negative error code
+ */
+int modbus_udp_server_init(modbus_udp_server_st *srv, const modbus_server_config_st *cfg)
+{
+    if (!srv || !cfg)
+    {
+        return -1;
+    }
+
+    memset(srv, 0, sizeof(*srv));
+    srv->fd = -1;
+    srv->wake_fd = -1;
+    if (cfg->stats)
+    {
+        srv->stats_shard = modbus_stats_shard(cfg->stats, cfg->stats_shard);
+        if (!srv->stats_shard)
+        {
+            return -1;
+        }
+    }
+
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(cfg->port);
+    addr.sin_addr.s_addr = htonl(INADDR_ANY);
+    if (cfg->bind_addr && (inet_pton(AF_INET, cfg->bind_addr, &addr.sin_addr) != 1))
+    {
+        return -1;
+    }
+
+    int ret = modbus_server_config_units(cfg, &srv->single, &srv->host);
+    if (ret != 0)
+    {
+        return ret;
+    }
+
+    srv->ring = ring_alloc();
+    if (!srv->ring)
+    {
+        modbus_host_free(&srv->single);
+        return -2;
+    }
+
+    srv->fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if ((srv->fd < 0) || (bind(srv->fd, (struct sockaddr *)&addr, sizeof(addr)) < 0))
+    {
+        modbus_udp_server_deinit(srv);
+        return -3;
+    }
+
+    srv->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (srv->wake_fd < 0)
+    {
+        modbus_udp_server_deinit(srv);
+        return -4;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Close the sockets and release the burst buffers.
+ *
+ * @param srv Server
+ */
+void modbus_udp_server_deinit(modbus_udp_server_st *srv)
+{
+    if (!srv)
+    {
+        return;
+    }
+
+    if (srv->fd >= 0)
+    {
+        close(srv->fd);
+    }
+    if (srv->wake_fd >= 0)
+    {
+        close(srv->wake_fd);
+    }
+    free(srv->ring);
+    srv->fd = -1;
+    srv->wake_fd = -1;
+    srv->ring = NULL;
+    modbus_host_free(&srv->single);
+    srv->host = NULL;
+}
+
+/**
+ * @brief Port the server is bound to.
+ *
+ * @param srv Server
+ * @return Port in host order, or 0 on error
+ */
+uint16_t modbus_udp_server_port(const modbus_udp_server_st *srv)
+{
+    struct sockaddr_in addr;
+    socklen_t len = sizeof(addr);
+
+    if (!srv || (getsockname(srv->fd, (struct sockaddr *)&addr, &len) < 0))
+    {
+        return 0;
+    }
+    return ntohs(addr.sin_port);
+}
+
+/**
+ * @brief Wait for requests, then answer every queued datagram.
+ *
+ * @param srv Server
+ * @param timeout_ms Longest wait for the first datagram (-1 = forever)
+ * @return Number of requests answered, or -1 on error
+ */
+int modbus_udp_server_poll(modbus_udp_server_st *srv, int timeout_ms)
+{
+    if (!srv || (srv->fd < 0))
+    {
+        return -1;
+    }
+
+    struct pollfd pfds[2] = {{.fd = srv->fd, .events = POLLIN}, {.fd = srv->wake_fd, .events = POLLIN}};
+    int ready = poll(pfds, 2, timeout_ms);
+    if (ready <= 0)
+    {
+        return ((ready == 0) || (errno == EINTR)) ? 0 : -1;
+    }
+    if (pfds[1].revents & POLLIN)
+    {
+        uint64_t value;
+        (void)!read(srv->wake_fd, &value, sizeof(value));
+    }
+
+    modbus_udp_ring_st *r = srv->ring;
+    int answered = 0;
+    for (;;)
+    {
+        int n = ring_receive(r, srv->fd, &srv->stats);
+        if (n <= 0)
+        {
+            return (n < 0) ? -1 : answered;
+        }
+
+        int out = 0;
+        for (int i = 0; i < n; i++)
+        {
+            const struct msghdr *h = &r->rx_msgs[i].msg_hdr;
+            int len = (h->msg_flags & MSG_TRUNC) ? -1
+                                                 : server_answer(srv, r->rx_buf[i], r->rx_msgs[i].msg_len,
+                                                                 r->tx_buf[out]);
+            if (len < 0)
+            {
+                srv->stats.errors++;
+                continue;
+            }
+
+            r->tx_iov[out].iov_base = r->tx_buf[out];
+            r->tx_iov[out].iov_len = (size_t)len;
+            struct msghdr *t = &r->tx_msgs[out].msg_hdr;
+            memset(t, 0, sizeof(*t));
+            t->msg_name = &r->rx_addr[i];
+            t->msg_namelen = h->msg_namelen;
+            t->msg_iov = &r->tx_iov[out];
+            t->msg_iovlen = 1;
+            out++;
+        }
+
+        if (ring_send(r, srv->fd, out, &srv->stats) < 0)
+        {
+            return -1;
+        }
+        srv->stats.requests += (uint64_t)out;
+        answered += out;
+
+        // A short burst means the socket is empty
+        if (n < MODBUS_UDP_BURST)
+        {
+            return answered;
+        }
+    }
+}
+
+/**
+ * @brief Serve requests until modbus_udp_server_stop() is called.
+ *
+ * @param srv Server
+ * @return 0 when stopped, or -1 on error
+ */
+int modbus_udp_server_run(modbus_udp_server_st *srv)
+{
+    if (!srv)
+    {
+        return -1;
+    }
+
+    while (!atomic_load_explicit(&srv->stop, memory_order_acquire))
+    {
+        if (modbus_udp_server_poll(srv, -1) < 0)
+        {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+/**
+ * @brief Ask modbus_udp_server_run() to return.
+ *
+ * @param srv Server
+ */
+void modbus_udp_server_stop(modbus_udp_server_st *srv)
+{
+    if (!srv)
+    {
+        return;
+    }
+
+    // Lock-free, so also safe from a signal handler
+    atomic_store_explicit(&srv->stop, true, memory_order_release);
+    uint64_t one = 1;
+    (void)!write(srv->wake_fd, &one, sizeof(one));
+}
+
+/**
+ * @brief Hash slot of an address (network order IPv4 and port).
+ */
+static uint32_t address_hash(const modbus_udp_master_st *m, const struct sockaddr_in *addr)
+{
+    uint64_t key = ((uint64_t)addr->sin_addr.s_addr << 16) | addr->sin_port;
+    return (uint32_t)((key * 0x9E3779B97F4A7C15ull) >> 32) & m->table_mask;
+}
+
+/**
+ * @brief Find the device with an address.
+ *
+ * @return Device, or NULL if none is registered
+ */
+static modbus_udp_device_st *find_device(const modbus_udp_master_st *m, const struct sockaddr_in *addr)
+{
+    for (uint32_t slot = address_hash(m, addr);; slot = (slot + 1) & m->table_mask)
+    {
+        uint32_t entry = m->table[slot];
+        if (entry == 0)
+        {
+            return NULL;
+        }
+
+        modbus_udp_device_st *d = &m->devices[entry - 1];
+        if ((d->addr.sin_addr.s_addr == addr->sin_addr.s_addr) && (d->addr.sin_port == addr->sin_port))
+        {
+            return d;
+        }
+    }
+}
+
+/**
+ * @brief Open the master socket and allocate room for the devices.
+ *
+ * @param m Master to initialize
+ * @param max_devices Largest number of devices
+ * @return 0 on success, or a negative error code
+ */
+int modbus_udp_master_init(modbus_udp_master_st *m, uint32_t max_devices)
+{
+    if (!m || (max_devices == 0) || (max_devices > UINT16_MAX))
+    {
+        return -1;
+    }
+
+    memset(m, 0, sizeof(*m));
+    m->fd = -1;
+
+    // At most half full, so a probe for an absent address ends quickly
+    uint32_t table_size = 2;
+    while (table_size < 2 * max_devices)
+    {
+        table_size <<= 1;
+    }
+
+    m->devices = calloc(max_devices, sizeof(*m->devices));
+    m->table = calloc(table_size, sizeof(*m->table));
+    m->ring = ring_alloc();
+    if (!m->devices || !m->table || !m->ring)
+    {
+        modbus_udp_master_deinit(m);
+        return -2;
+    }
+    m->device_capacity = max_devices;
+    m->table_mask = table_size - 1;
+
+    m->fd = socket(AF_INET, SOCK_DGRAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (m->fd < 0)
+    {
+        modbus_udp_master_deinit(m);
+        return -3;
+    }
+
+    return 0;
+}
+
+/**
+ * @brief Close the socket and release the devices and burst buffers.
+ *
+ * @param m Master
+ */
+void modbus_udp_master_deinit(modbus_udp_master_st *m)
+{
+    if (!m)
+    {
+        return;
+    }
+
+    if (m->fd >= 0)
+    {
+        close(m->fd);
+    }
+    free(m->devices);
+    free(m->table);
+    free(m->ring);
+    memset(m, 0, sizeof(*m));
+    m->fd = -1;
+}
+
+/**
+ * @brief Register a device.
+ *
+ * @param m Master
+ * @param ip IPv4 address of the device
+ * @param port UDP port of the device
+ * @param max_outstanding Pipeline depth for this device
+ * @return Device index, or a negative error code
+ */
+int modbus_udp_master_add_device(modbus_udp_master_st *m, const char *ip, uint16_t port, uint8_t max_outstanding)
+{
+    struct sockaddr_in addr = {0};
+
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    if (!m || !m->devices || !ip || (inet_pton(AF_INET, ip, &addr.sin_addr) != 1) || (port == 0) ||
+        (max_outstanding == 0) || (max_outstanding > MODBUS_TCP_MAX_PIPELINE))
+    {
+        return -1;
+    }
+    if (m->device_count == m->device_capacity)
+    {
+        return -2;
+    }
+    if (find_device(m, &addr))
+    {
+        return -3;
+    }
+
+    uint32_t index = m->device_count++;
+    modbus_udp_device_st *d = &m->devices[index];
+    d->addr = addr;
+    modbus_tcp_master_ctx_init(&d->ctx, max_outstanding);
+
+    uint32_t slot = address_hash(m, &addr);
+    while (m->table[slot] != 0)
+    {
+        slot = (slot + 1) & m->table_mask;
+    }
+    m->table[slot] = index + 1;
+    return (int)index;
+}
+
+/**
+ * @brief Master context of a device.
+ *
+ * @param m Master
+ * @param device Device index
+ * @return Context, or NULL if there is no such device
+ */
+modbus_tcp_master_ctx_st *modbus_udp_master_ctx(modbus_udp_master_st *m, uint32_t device)
+{
+    if (!m || (device >= m->device_count))
+    {
+        return NULL;
+    }
+    return &m->devices[device].ctx;
+}
+
+/**
+ * @brief Send every frame of a batch to the device it was encoded for.
+ *
+ * @param m Master
+ * @param batch Frames encoded on contexts of this master
+ * @return Number of datagrams sent, or a negative error code
+ */
+int modbus_udp_master_send(modbus_udp_master_st *m, modbus_batch_st *batch)
+{
+    if (!m || (m->fd < 0) || !batch)
+    {
+        return -1;
+    }
+
+    // Turned on before the first traced request leaves, so its response gets stamped
+    if (batch->trace && !m->rx_timestamps)
+    {
+        m->rx_timestamps = (modbus_trace_enable_rx_timestamps(m->fd) == 0);
+    }
+
+    modbus_udp_ring_st *r = m->ring;
+    uintptr_t first = (uintptr_t)&m->devices[0].ctx;
+    uint32_t i = 0;
+    while (i < batch->count)
+    {
+        // Point each header at the frame in the batch arena: nothing is copied
+        uint32_t burst_first = i;
+        int out = 0;
+        for (; (i < batch->count) && (out < MODBUS_UDP_BURST); i++, out++)
+        {
+            uintptr_t offset = (uintptr_t)batch->frames[i].ctx - first;
+            if ((offset % sizeof(modbus_udp_device_st) != 0) ||
+                (offset / sizeof(modbus_udp_device_st) >= m->device_count))
+            {
+                return -2;
+            }
+
+            struct msghdr *t = &r->tx_msgs[out].msg_hdr;
+            memset(t, 0, sizeof(*t));
+            t->msg_name = &m->devices[offset / sizeof(modbus_udp_device_st)].addr;
+            t->msg_namelen = sizeof(struct sockaddr_in);
+            t->msg_iov = &batch->iov[i];
+            t->msg_iovlen = 1;
+        }
+
+        if (ring_send(r, m->fd, out, &m->stats) < 0)
+        {
+            return -1;
+        }
+        if (batch->trace)
+        {
+            uint64_t now = modbus_trace_now_ns();
+            for (uint32_t f = burst_first; f < i; f++)
+            {
+                batch->traces[f].ns[MODBUS_TRACE_SENT] = now;
+            }
+        }
+    }
+    return (int)batch->count;
+}
+
+/**
+ * @brief Receive responses and complete the frames they answer.
+ *
+ * @param m Master
+ * @param batch Batch the requests were sent from
+ * @param timeout_ms Longest wait for the first datagram
+ * @return Number of frames completed, 0 on timeout, or -1 on error
+ */
+int modbus_udp_master_recv(modbus_udp_master_st *m, modbus_batch_st *batch, int timeout_ms)
+{
+    if (!m || (m->fd < 0) || !batch)
+    {
+        return -1;
+    }
+
+    int ready = wait_readable(m->fd, timeout_ms);
+    if (ready <= 0)
+    {
+        return ready;
+    }
+
+    modbus_udp_ring_st *r = m->ring;
+    int completed = 0;
+    for (;;)
+    {
+        int n = ring_receive(r, m->fd, &m->stats);
+        if (n <= 0)
+        {
+            return (n < 0) ? -1 : completed;
+        }
+        uint64_t read_ns = batch->trace ? modbus_trace_now_ns() : 0;
+
+        for (int i = 0; i < n; i++)
+        {
+            size_t len = r->rx_msgs[i].msg_len;
+            size_t consumed = 0;
+            if ((r->rx_msgs[i].msg_hdr.msg_flags & MSG_TRUNC) ||
+                (decode_mbap_header(r->rx_buf[i], len, NULL, NULL, NULL) != (int)len))
+            {
+                m->stats.errors++;
+                continue;
+            }
+
+            modbus_udp_device_st *d = find_device(m, &r->rx_addr[i]);
+            modbus_batch_trace_rx(batch, &r->rx_msgs[i].msg_hdr, read_ns);
+            int matched = d ? modbus_batch_decode(batch, &d->ctx, r->rx_buf[i], len, &consumed) : 0;
+            if (matched <= 0)
+            {
+                m->stats.unknown++;
+                continue;
+            }
+            m->stats.requests += (uint64_t)matched;
+            completed += matched;
+        }
+
+        if (n < MODBUS_UDP_BURST)
+        {
+            return completed;
+        }
+    }
+}
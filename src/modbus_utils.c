@@ -14,28 +14,12 @@
  *
  * This function implements the standard Modbus RTU CRC16 algorithm.
  * It can be used for both requests and responses to ensure data integrity.
+ * The computation runs on the engine selected with modbus_crc16_set_engine().
  */
 uint16_t modbus_crc16(const uint8_t *buf, uint16_t len)
 {
-    uint16_t crc = 0xFFFF;
-    if (!buf || (len == 0))
-    {
-        return crc;
-    }
-
-    for (int pos = 0; pos < len; pos++)
-    {
-        crc ^= (uint16_t)buf[pos];
-        for (int i = 8; i != 0; i--)
-        {
-            if ((crc & 0x0001) != 0)
-            {
-                crc >>= 1;
-                crc ^= 0xA001;
-            }
-            else
-                crc >>= 1;
-        }
-    }
-    return crc;
+    modbus_crc16_ctx_st ctx;
+    modbus_crc16_init(&ctx);
+    modbus_crc16_update(&ctx, buf, len);
+    return modbus_crc16_final(&ctx);
 }
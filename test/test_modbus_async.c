@@ -0,0 +1,352 @@
+#define _GNU_SOURCE
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <cmocka.h>
+
+#include "modbus_async.h"
+#include "modbus_pdu.h"
+#include "modbus_server_group.h"
+
+#define SLAVE_ID 1
+#define CLIENTS 32
+#define DEPTH 8
+#define ROUNDS 20
+
+static uint16_t table[16];
+
+static int read_regs(void *arg, uint8_t unit_id, uint16_t start_addr, uint16_t qty, uint16_t *regs) {
+    (void) arg;
+    (void) unit_id;
+    for (uint16_t i = 0; i < qty; i++) {
+        regs[i] = (uint16_t)(start_addr + i);
+    }
+    return 0;
+}
+
+static int table_write(void *arg, uint8_t unit_id, uint16_t start_addr, uint16_t qty, const uint16_t *values) {
+    (void) arg;
+    (void) unit_id;
+    if (start_addr + qty > 16) {
+        return -1;
+    }
+    memcpy(&table[start_addr], values, qty * sizeof(uint16_t));
+    return 0;
+}
+
+static const modbus_server_config_st server_cfg = {
+    .bind_addr = "127.0.0.1",
+    .max_connections = 64,
+    .slave_id = SLAVE_ID,
+    .read_cb = read_regs,
+    .write_cb = table_write,
+};
+
+static int connect_client(uint16_t port) {
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    assert_true(fd >= 0);
+    assert_int_equal(connect(fd, (struct sockaddr *)&addr, sizeof(addr)), 0);
+    return fd;
+}
+
+static void init_engine(modbus_async_st *engine, modbus_async_backend_et backend, uint32_t timeout_ms,
+                        modbus_stats_shard_st *stats) {
+    modbus_async_config_st cfg = {
+        .max_connections = CLIENTS, .backend = backend, .timeout_ms = timeout_ms, .stats = stats};
+    assert_int_equal(modbus_async_init(engine, &cfg), 0);
+    assert_int_equal(engine->backend, backend);
+}
+
+// Each completed read checks its registers and issues the next one on the same connection
+typedef struct {
+    modbus_async_st *engine;
+    uint32_t issued;
+    uint32_t completed;
+    uint32_t errors;
+    uint32_t peak_in_flight;
+} load_st;
+
+static void on_read(void *arg, uint32_t conn, int status, const uint16_t *regs) {
+    load_st *load = arg;
+    load->completed++;
+    if ((status != 10) || (regs[0] != conn) || (regs[9] != conn + 9)) {
+        load->errors++;
+    }
+    if (load->issued < CLIENTS * DEPTH * ROUNDS) {
+        assert_true(modbus_async_read(load->engine, conn, SLAVE_ID, (uint16_t)conn, 10, on_read, load) >= 0);
+        load->issued++;
+    }
+}
+
+static void run_pipelined_reads(modbus_async_backend_et backend) {
+    modbus_server_group_st group;
+    modbus_async_st engine;
+    load_st load = {.engine = &engine};
+
+    assert_int_equal(modbus_server_group_init(&group, &server_cfg, 2), 0);
+    assert_int_equal(modbus_server_group_start(&group), 0);
+    init_engine(&engine, backend, 5000, NULL);
+
+    for (int c = 0; c < CLIENTS; c++) {
+        assert_int_equal(modbus_async_add_connection(&engine, connect_client(group.port), DEPTH), c);
+        for (int d = 0; d < DEPTH; d++) {
+            assert_true(modbus_async_read(&engine, (uint32_t)c, SLAVE_ID, (uint16_t)c, 10, on_read, &load) >= 0);
+            load.issued++;
+        }
+        // The pipeline is full
+        assert_int_equal(modbus_async_read(&engine, (uint32_t)c, SLAVE_ID, 0, 1, NULL, NULL), -3);
+    }
+    load.peak_in_flight = modbus_async_in_flight(&engine);
+
+    for (int spins = 0; spins < 100000 && modbus_async_in_flight(&engine) > 0; spins++) {
+        assert_true(modbus_async_poll(&engine, 100) >= 0);
+    }
+
+    assert_int_equal(load.peak_in_flight, CLIENTS * DEPTH);
+    assert_int_equal(load.completed, CLIENTS * DEPTH * ROUNDS);
+    assert_int_equal(load.errors, 0);
+    assert_int_equal(engine.stats.responses, CLIENTS * DEPTH * ROUNDS);
+    assert_int_equal(engine.stats.timeouts, 0);
+    // Batching: far fewer system calls than transactions
+    assert_true(engine.stats.syscalls < engine.stats.requests);
+
+    modbus_async_deinit(&engine);
+    modbus_server_group_stop(&group);
+    modbus_server_group_deinit(&group);
+}
+
+typedef struct {
+    int status;
+    uint32_t calls;
+    uint16_t regs[4];
+} result_st;
+
+static void on_result(void *arg, uint32_t conn, int status, const uint16_t *regs) {
+    (void) conn;
+    result_st *r = arg;
+    r->status = status;
+    r->calls++;
+    if (regs) {
+        memcpy(r->regs, regs, (size_t)status * sizeof(uint16_t));
+    }
+}
+
+static void wait_result(modbus_async_st *engine, result_st *r) {
+    for (int spins = 0; spins < 1000 && r->calls == 0; spins++) {
+        assert_true(modbus_async_poll(engine, 10) >= 0);
+    }
+    assert_int_equal(r->calls, 1);
+}
+
+static void run_any_function(modbus_async_backend_et backend) {
+    modbus_server_group_st group;
+    modbus_async_st engine;
+    modbus_stats_st stats;
+    uint8_t pdu[MODBUS_MAX_PDU_SIZE];
+    uint16_t values[2] = {0x1234, 0x5678};
+
+    memset(table, 0, sizeof(table));
+    assert_int_equal(modbus_stats_init(&stats, 1), 0);
+    assert_int_equal(modbus_server_group_init(&group, &server_cfg, 1), 0);
+    assert_int_equal(modbus_server_group_start(&group), 0);
+    init_engine(&engine, backend, 1000, modbus_stats_shard(&stats, 0));
+    int conn = modbus_async_add_connection(&engine, connect_client(group.port), 4);
+    assert_int_equal(conn, 0);
+
+    result_st write = {0}, exception = {0};
+    uint16_t len = modbus_pdu_encode_write_multiple(3, values, 2, pdu, sizeof(pdu));
+    assert_true(modbus_async_request(&engine, 0, SLAVE_ID, pdu, len, on_result, &write) >= 0);
+    len = modbus_pdu_encode_read(MODBUS_READ_INPUT_REG, 0, 1, pdu, sizeof(pdu));
+    assert_true(modbus_async_request(&engine, 0, SLAVE_ID, pdu, len, on_result, &exception) >= 0);
+    wait_result(&engine, &write);
+    wait_result(&engine, &exception);
+    assert_int_equal(write.status, 0);
+    assert_int_equal(table[4], 0x5678);
+    assert_int_equal(exception.status, -8);
+
+    // Both responses are counted under their function code, with a latency each
+    modbus_stats_shard_st *shard = modbus_stats_shard(&stats, 0);
+    assert_int_equal(shard->frames_by_function[MODBUS_WRITE_MULTIPLE_REGS], 1);
+    assert_int_equal(shard->frames_by_function[MODBUS_READ_INPUT_REG | MODBUS_EXCEPTION_FLAG], 1);
+    assert_int_equal(shard->frames_by_unit[SLAVE_ID], 2);
+    assert_int_equal(shard->errors[MODBUS_STATS_MASTER][8], 1);
+    assert_int_equal(shard->latency.count, 2);
+    assert_true(shard->latency.max_ns > 0);
+
+    assert_int_equal(modbus_async_request(&engine, 1, SLAVE_ID, pdu, len, NULL, NULL), -1);
+    assert_int_equal(modbus_async_read(&engine, 0, SLAVE_ID, 0, 0, NULL, NULL), -1);
+
+    modbus_async_deinit(&engine);
+    modbus_server_group_stop(&group);
+    modbus_server_group_deinit(&group);
+    modbus_stats_free(&stats);
+}
+
+static void run_timeout_and_close(modbus_async_backend_et backend) {
+    modbus_async_st engine;
+    int silent[2], closing[2];
+
+    // A peer that never answers, and one that hangs up
+    assert_int_equal(socketpair(AF_UNIX, SOCK_STREAM, 0, silent), 0);
+    assert_int_equal(socketpair(AF_UNIX, SOCK_STREAM, 0, closing), 0);
+    init_engine(&engine, backend, 50, NULL);
+    assert_int_equal(modbus_async_add_connection(&engine, silent[0], 2), 0);
+    assert_int_equal(modbus_async_add_connection(&engine, closing[0], 2), 1);
+
+    result_st timed_out = {0}, closed = {0};
+    int tid = modbus_async_read(&engine, 0, SLAVE_ID, 0, 1, on_result, &timed_out);
+    assert_true(tid >= 0);
+    assert_true(modbus_async_read(&engine, 1, SLAVE_ID, 0, 1, on_result, &closed) >= 0);
+    close(closing[1]);
+
+    wait_result(&engine, &closed);
+    assert_int_equal(closed.status, MODBUS_ASYNC_CLOSED);
+    assert_int_equal(modbus_async_read(&engine, 1, SLAVE_ID, 0, 1, NULL, NULL), -2);
+
+    wait_result(&engine, &timed_out);
+    assert_int_equal(timed_out.status, MODBUS_ASYNC_TIMEOUT);
+    assert_int_equal(engine.stats.timeouts, 1);
+    assert_int_equal(engine.stats.failures, 1);
+    assert_int_equal(modbus_async_in_flight(&engine), 0);
+
+    // A late answer to the expired request is ignored
+    uint8_t late[MODBUS_MBAP_HEADER_SIZE + 4];
+    encode_mbap_header((uint16_t)tid, SLAVE_ID, 4, late, sizeof(late));
+    memcpy(late + MODBUS_MBAP_HEADER_SIZE, (const uint8_t[]){MODBUS_READ_HOLDING_REG, 2, 0x00, 0x01}, 4);
+    assert_int_equal(write(silent[1], late, MODBUS_MBAP_HEADER_SIZE + 4), MODBUS_MBAP_HEADER_SIZE + 4);
+    assert_int_equal(modbus_async_poll(&engine, 20), 0);
+
+    modbus_async_deinit(&engine);
+    close(silent[1]);
+}
+
+// Responses too short to hold a PDU, to every request of a full pipeline
+static void run_short_responses(modbus_async_backend_et backend) {
+    modbus_async_st engine;
+    int peer[2];
+    uint8_t req[MODBUS_TCP_MAX_PIPELINE * (MODBUS_MBAP_HEADER_SIZE + 5)];
+    size_t got = 0;
+
+    assert_int_equal(socketpair(AF_UNIX, SOCK_STREAM, 0, peer), 0);
+    init_engine(&engine, backend, 0, NULL);
+    assert_int_equal(modbus_async_add_connection(&engine, peer[0], MODBUS_TCP_MAX_PIPELINE), 0);
+
+    result_st results[MODBUS_TCP_MAX_PIPELINE] = {0};
+    for (int i = 0; i < MODBUS_TCP_MAX_PIPELINE; i++) {
+        assert_true(modbus_async_read(&engine, 0, SLAVE_ID, 0, 1, on_result, &results[i]) >= 0);
+    }
+    for (int spins = 0; spins < 1000 && got < sizeof(req); spins++) {
+        assert_true(modbus_async_poll(&engine, 1) >= 0);
+        ssize_t n = recv(peer[1], req + got, sizeof(req) - got, MSG_DONTWAIT);
+        if (n > 0) {
+            got += (size_t)n;
+        }
+    }
+    assert_int_equal(got, sizeof(req));
+
+    // Each answer matches its transaction but carries a lone function code
+    for (int i = 0; i < MODBUS_TCP_MAX_PIPELINE; i++) {
+        uint8_t resp[MODBUS_MBAP_HEADER_SIZE + 1];
+        const uint8_t *r = req + i * (MODBUS_MBAP_HEADER_SIZE + 5);
+        encode_mbap_header((uint16_t)((r[0] << 8) | r[1]), SLAVE_ID, 1, resp, sizeof(resp));
+        resp[MODBUS_MBAP_HEADER_SIZE] = MODBUS_READ_HOLDING_REG;
+        assert_int_equal(write(peer[1], resp, sizeof(resp)), sizeof(resp));
+    }
+    for (int spins = 0; spins < 1000 && modbus_async_in_flight(&engine) > 0; spins++) {
+        assert_true(modbus_async_poll(&engine, 10) >= 0);
+    }
+
+    // Every call completed with the decode status, and the pipeline is whole again
+    for (int i = 0; i < MODBUS_TCP_MAX_PIPELINE; i++) {
+        assert_int_equal(results[i].calls, 1);
+        assert_int_equal(results[i].status, -5);
+    }
+    assert_int_equal(modbus_async_in_flight(&engine), 0);
+    assert_int_equal(modbus_tcp_master_outstanding(&engine.conns[0].master), 0);
+    for (int i = 0; i < MODBUS_TCP_MAX_PIPELINE; i++) {
+        assert_true(modbus_async_read(&engine, 0, SLAVE_ID, 0, 1, NULL, NULL) >= 0);
+    }
+    assert_int_equal(modbus_async_read(&engine, 0, SLAVE_ID, 0, 1, NULL, NULL), -3);
+
+    modbus_async_deinit(&engine);
+    close(peer[1]);
+}
+
+static void test_init_errors(void **state) {
+    (void) state;
+    modbus_async_st engine;
+    modbus_async_config_st cfg = {.max_connections = 0};
+
+    assert_int_equal(modbus_async_init(NULL, &cfg), -1);
+    assert_int_equal(modbus_async_init(&engine, NULL), -1);
+    assert_int_equal(modbus_async_init(&engine, &cfg), -1);
+    cfg.max_connections = MODBUS_ASYNC_MAX_CONNECTIONS + 1;
+    assert_int_equal(modbus_async_init(&engine, &cfg), -1);
+
+    cfg.max_connections = 1;
+    assert_int_equal(modbus_async_init(&engine, &cfg), 0);
+    assert_int_not_equal(engine.backend, MODBUS_ASYNC_AUTO);
+    assert_int_equal(modbus_async_add_connection(&engine, -1, 1), -1);
+    int fds[2];
+    assert_int_equal(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    assert_int_equal(modbus_async_add_connection(&engine, fds[0], 0), -1);
+    assert_int_equal(modbus_async_add_connection(&engine, fds[0], 1), 0);
+    assert_int_equal(modbus_async_add_connection(&engine, fds[1], 1), -2);
+
+    // Unsent bytes left behind by cancelled requests leave no room for a read
+    engine.conns[0].tx_len = sizeof(engine.conns[0].tx) - MODBUS_MBAP_HEADER_SIZE - 4;
+    assert_int_equal(modbus_async_read(&engine, 0, SLAVE_ID, 0, 1, NULL, NULL), -4);
+    assert_int_equal(modbus_async_in_flight(&engine), 0);
+    engine.conns[0].tx_len = 0;
+    modbus_async_deinit(&engine);
+    close(fds[1]);
+
+    assert_int_equal(modbus_async_poll(NULL, 0), -1);
+    assert_int_equal(modbus_async_in_flight(NULL), 0);
+    modbus_async_deinit(NULL);
+}
+
+static void test_io_uring(void **state) {
+    (void) state;
+    modbus_async_st engine;
+    modbus_async_config_st cfg = {.max_connections = 1, .backend = MODBUS_ASYNC_IO_URING};
+    // Kernels or sandboxes without io_uring are covered by the epoll test
+    if (modbus_async_init(&engine, &cfg) != 0) {
+        return;
+    }
+    modbus_async_deinit(&engine);
+
+    run_pipelined_reads(MODBUS_ASYNC_IO_URING);
+    run_any_function(MODBUS_ASYNC_IO_URING);
+    run_timeout_and_close(MODBUS_ASYNC_IO_URING);
+    run_short_responses(MODBUS_ASYNC_IO_URING);
+}
+
+static void test_epoll(void **state) {
+    (void) state;
+    run_pipelined_reads(MODBUS_ASYNC_EPOLL);
+    run_any_function(MODBUS_ASYNC_EPOLL);
+    run_timeout_and_close(MODBUS_ASYNC_EPOLL);
+    run_short_responses(MODBUS_ASYNC_EPOLL);
+}
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_init_errors),
+        cmocka_unit_test(test_io_uring),
+        cmocka_unit_test(test_epoll),
+    };
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
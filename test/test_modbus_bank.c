@@ -0,0 +1,275 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <cmocka.h>
+
+#include "modbus_bank.h"
+#include "modbus_master.h"
+#include "modbus_swap.h"
+
+static modbus_bank_st bank;
+
+static void test_layout(void **state) {
+    (void) state;
+    assert_int_equal(sizeof(modbus_bank_segment_st) % MODBUS_CACHE_LINE_SIZE, 0);
+    assert_int_equal((uintptr_t)&bank.segments[1] % MODBUS_CACHE_LINE_SIZE, 0);
+}
+
+static void test_write_read_roundtrip(void **state) {
+    (void) state;
+    uint16_t values[300];
+    uint16_t out[MODBUS_MAX_REGS];
+    for (int i = 0; i < 300; i++) {
+        values[i] = (uint16_t)(0xA000 + i);
+    }
+    assert_int_equal(modbus_bank_init(&bank), 0);
+
+    // A write spanning several segments, read back at segment-straddling offsets
+    assert_int_equal(modbus_bank_write(&bank, 60, values, 300), 0);
+    assert_int_equal(modbus_bank_read(&bank, 63, MODBUS_MAX_REGS, out), 0);
+    for (int i = 0; i < MODBUS_MAX_REGS; i++) {
+        assert_int_equal(out[i], 0xA000 + 3 + i);
+    }
+
+    assert_int_equal(modbus_bank_read(&bank, 58, 3, out), 0);
+    assert_int_equal(out[0], 0);
+    assert_int_equal(out[1], 0);
+    assert_int_equal(out[2], 0xA000);
+
+    // Last register of the address space
+    assert_int_equal(modbus_bank_write(&bank, 0xFFFF, values, 1), 0);
+    assert_int_equal(modbus_bank_read(&bank, 0xFFFF, 1, out), 0);
+    assert_int_equal(out[0], 0xA000);
+}
+
+static void test_errors(void **state) {
+    (void) state;
+    uint16_t regs[MODBUS_MAX_REGS + 1] = {0};
+    assert_int_equal(modbus_bank_init(NULL), -1);
+    assert_int_equal(modbus_bank_write(NULL, 0, regs, 1), -1);
+    assert_int_equal(modbus_bank_write(&bank, 0, NULL, 1), -1);
+    assert_int_equal(modbus_bank_write(&bank, 0, regs, 0), -2);
+    assert_int_equal(modbus_bank_write(&bank, 0xFFFF, regs, 2), -2);
+    assert_int_equal(modbus_bank_write(&bank, 1, regs, UINT32_MAX), -2);
+    assert_int_equal(modbus_bank_write(&bank, 0, regs, MODBUS_BANK_REGS + 1), -2);
+    assert_int_equal(modbus_bank_read(NULL, 0, 1, regs), -1);
+    assert_int_equal(modbus_bank_read(&bank, 0, 1, NULL), -1);
+    assert_int_equal(modbus_bank_read(&bank, 0, 0, regs), -2);
+    assert_int_equal(modbus_bank_read(&bank, 0, MODBUS_MAX_REGS + 1, regs), -2);
+    assert_int_equal(modbus_bank_read(&bank, 0xFFF0, 32, regs), -2);
+}
+
+static void test_encode_response(void **state) {
+    (void) state;
+    modbus_slave_ctx_st slave;
+    modbus_master_ctx_st master;
+    modbus_slave_ctx_init(&slave);
+    modbus_master_ctx_init(&master);
+    modbus_bank_init(&bank);
+
+    uint16_t values[10];
+    for (int i = 0; i < 10; i++) {
+        values[i] = (uint16_t)(i * 1000);
+    }
+    modbus_bank_write(&bank, 500, values, 10);
+
+    uint8_t req[8], resp[64];
+    encode_read_request(&master, 1, 500, 10, req, sizeof(req));
+    uint16_t len = modbus_bank_encode_read_response(&bank, &slave, 1, 500, 10, resp, sizeof(resp));
+    assert_int_equal(len, 3 + 20 + 2);
+
+    uint16_t out[10];
+    assert_int_equal(decode_read_response(&master, resp, len, out, 10), 10);
+    assert_memory_equal(out, values, sizeof(values));
+
+    assert_int_equal(modbus_bank_read_cb(&bank, 1, 500, 10, out), 0);
+    assert_memory_equal(out, values, sizeof(values));
+    assert_int_equal(modbus_bank_encode_read_response(&bank, &slave, 1, 0xFFFF, 2, resp, sizeof(resp)), 0);
+}
+
+static void fill_pattern(void) {
+    static uint16_t values[MODBUS_BANK_REGS];
+    modbus_bank_init(&bank);
+    for (uint32_t i = 0; i < MODBUS_BANK_REGS; i++) {
+        values[i] = (uint16_t)(i * 2654435761u >> 7);
+    }
+    // Uneven write sizes so block CRCs are refreshed from partial updates
+    for (uint32_t addr = 0; addr < MODBUS_BANK_REGS;) {
+        uint32_t n = 1 + (addr % 37);
+        if (addr + n > MODBUS_BANK_REGS) {
+            n = MODBUS_BANK_REGS - addr;
+        }
+        assert_int_equal(modbus_bank_write(&bank, (uint16_t)addr, values + addr, n), 0);
+        addr += n;
+    }
+}
+
+static void test_wire_shadow(void **state) {
+    (void) state;
+    fill_pattern();
+
+    for (uint32_t start = 0; start + MODBUS_MAX_REGS <= MODBUS_BANK_REGS; start += 251) {
+        for (uint16_t qty = 1; qty <= MODBUS_MAX_REGS; qty += 31) {
+            uint16_t regs[MODBUS_MAX_REGS];
+            uint8_t expected[MODBUS_MAX_REGS * 2], wire[MODBUS_MAX_REGS * 2];
+            assert_int_equal(modbus_bank_read(&bank, (uint16_t)start, qty, regs), 0);
+            modbus_regs_to_be(expected, regs, qty);
+
+            uint16_t crc = 0x1234;
+            assert_int_equal(modbus_bank_read_wire(&bank, (uint16_t)start, qty, wire, &crc), 0);
+            assert_memory_equal(wire, expected, qty * 2u);
+            assert_int_equal(crc, modbus_crc16_accumulate(0x1234, expected, qty * 2u));
+        }
+    }
+
+    uint8_t wire[4];
+    assert_int_equal(modbus_bank_read_wire(NULL, 0, 1, wire, NULL), -1);
+    assert_int_equal(modbus_bank_read_wire(&bank, 0, 1, NULL, NULL), -1);
+    assert_int_equal(modbus_bank_read_wire(&bank, 0xFFFF, 2, wire, NULL), -2);
+    assert_int_equal(modbus_bank_read_wire_cb(&bank, 1, 0xFFFE, 2, wire), 0);
+}
+
+static void test_encode_matches_swap_path(void **state) {
+    (void) state;
+    modbus_slave_ctx_st slave;
+    modbus_slave_ctx_init(&slave);
+    fill_pattern();
+
+    for (uint32_t start = 0; start + MODBUS_MAX_REGS <= MODBUS_BANK_REGS; start += 1021) {
+        for (uint16_t qty = 1; qty <= MODBUS_MAX_REGS; qty += 17) {
+            uint16_t regs[MODBUS_MAX_REGS];
+            uint8_t expected[256], frame[256];
+            modbus_bank_read(&bank, (uint16_t)start, qty, regs);
+            uint16_t len = encode_read_response(&slave, 7, regs, qty, expected, sizeof(expected));
+            assert_int_equal(modbus_bank_encode_read_response(&bank, &slave, 7, (uint16_t)start, qty, frame, sizeof(frame)), len);
+            assert_memory_equal(frame, expected, len);
+        }
+    }
+}
+
+static void test_send_response(void **state) {
+    (void) state;
+    int sv[2];
+    modbus_master_ctx_st master;
+    modbus_master_ctx_init(&master);
+    fill_pattern();
+    assert_int_equal(socketpair(AF_UNIX, SOCK_STREAM, 0, sv), 0);
+
+    uint8_t req[8], resp[256];
+    encode_read_request(&master, 3, 1000, MODBUS_MAX_REGS, req, sizeof(req));
+    assert_int_equal(modbus_bank_send_read_response(&bank, sv[0], 3, 1000, MODBUS_MAX_REGS), 3 + MODBUS_MAX_REGS * 2 + 2);
+    assert_int_equal(read(sv[1], resp, sizeof(resp)), 3 + MODBUS_MAX_REGS * 2 + 2);
+
+    uint16_t out[MODBUS_MAX_REGS], regs[MODBUS_MAX_REGS];
+    assert_int_equal(decode_read_response(&master, resp, 3 + MODBUS_MAX_REGS * 2 + 2, out, MODBUS_MAX_REGS), MODBUS_MAX_REGS);
+    modbus_bank_read(&bank, 1000, MODBUS_MAX_REGS, regs);
+    assert_memory_equal(out, regs, sizeof(regs));
+
+    assert_int_equal(modbus_bank_send_read_response(&bank, sv[0], 3, 0xFFFF, 2), -1);
+    close(sv[0]);
+    close(sv[1]);
+}
+
+static void test_generations(void **state) {
+    (void) state;
+    uint32_t before[MODBUS_BANK_MAX_READ_SEGMENTS], after[MODBUS_BANK_MAX_READ_SEGMENTS];
+    uint16_t value = 1;
+    assert_int_equal(modbus_bank_init(&bank), 0);
+
+    assert_int_equal(modbus_bank_generations(&bank, 10, 5, before), 1);
+    assert_int_equal(modbus_bank_generations(&bank, 63, MODBUS_MAX_REGS, before), 3);
+
+    // Only the written segment moves, by one full write cycle
+    assert_int_equal(modbus_bank_write(&bank, 130, &value, 1), 0);
+    assert_int_equal(modbus_bank_generations(&bank, 63, MODBUS_MAX_REGS, after), 3);
+    assert_int_equal(after[0], before[0]);
+    assert_int_equal(after[1], before[1]);
+    assert_int_equal(after[2], before[2] + 2);
+
+    assert_int_equal(modbus_bank_generations(NULL, 0, 1, after), -1);
+    assert_int_equal(modbus_bank_generations(&bank, 0, 1, NULL), -1);
+    assert_int_equal(modbus_bank_generations(&bank, 0, 0, after), -2);
+    assert_int_equal(modbus_bank_generations(&bank, 0xFFFF, 2, after), -2);
+}
+
+// Writers store one value across a range spanning three segments; readers must never see a mix
+#define TORN_START 60
+#define TORN_QTY MODBUS_MAX_REGS
+#define TORN_WRITES 20000
+
+static atomic_bool writers_done;
+
+static void *writer_main(void *arg) {
+    uint16_t base = (uint16_t)(uintptr_t)arg;
+    uint16_t values[TORN_QTY];
+    for (uint32_t k = 0; k < TORN_WRITES; k++) {
+        for (int i = 0; i < TORN_QTY; i++) {
+            values[i] = (uint16_t)(base + k);
+        }
+        modbus_bank_write(&bank, TORN_START, values, TORN_QTY);
+    }
+    return NULL;
+}
+
+static void *reader_main(void *arg) {
+    uintptr_t torn = 0;
+    uint16_t out[TORN_QTY];
+    (void) arg;
+    while (!atomic_load(&writers_done)) {
+        modbus_bank_read(&bank, TORN_START, TORN_QTY, out);
+        for (int i = 1; i < TORN_QTY; i++) {
+            torn += (out[i] != out[0]);
+        }
+    }
+    return (void *)torn;
+}
+
+static void test_concurrent_snapshots(void **state) {
+    (void) state;
+    pthread_t writers[2], readers[2];
+    modbus_bank_init(&bank);
+    atomic_store(&writers_done, false);
+
+    for (int i = 0; i < 2; i++) {
+        pthread_create(&readers[i], NULL, reader_main, NULL);
+    }
+    pthread_create(&writers[0], NULL, writer_main, (void *)(uintptr_t)0);
+    pthread_create(&writers[1], NULL, writer_main, (void *)(uintptr_t)0x8000);
+    for (int i = 0; i < 2; i++) {
+        pthread_join(writers[i], NULL);
+    }
+    atomic_store(&writers_done, true);
+
+    for (int i = 0; i < 2; i++) {
+        void *torn;
+        pthread_join(readers[i], &torn);
+        assert_int_equal((uintptr_t)torn, 0);
+    }
+
+    // Every segment went through an even number of increments
+    for (int s = 0; s < MODBUS_BANK_SEGMENTS; s++) {
+        assert_int_equal(atomic_load(&bank.segments[s].seq) & 1, 0);
+    }
+}
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_layout),
+        cmocka_unit_test(test_write_read_roundtrip),
+        cmocka_unit_test(test_errors),
+        cmocka_unit_test(test_encode_response),
+        cmocka_unit_test(test_wire_shadow),
+        cmocka_unit_test(test_encode_matches_swap_path),
+        cmocka_unit_test(test_send_response),
+        cmocka_unit_test(test_generations),
+        cmocka_unit_test(test_concurrent_snapshots),
+    };
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
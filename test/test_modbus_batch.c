@@ -0,0 +1,277 @@
+#define _GNU_SOURCE
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <cmocka.h>
+
+#include "modbus_batch.h"
+#include "modbus_pdu.h"
+
+#define READ_LEN 12
+#define PIPELINE 16
+#define QTY 10
+
+static int read_regs(void *arg, uint8_t unit_id, uint16_t start_addr, uint16_t qty, uint16_t *regs) {
+    (void) arg;
+    for (uint16_t i = 0; i < qty; i++) {
+        regs[i] = (uint16_t)(unit_id * 1000 + start_addr + i);
+    }
+    return 0;
+}
+
+// Holding registers only: Read Input Registers gets an exception
+static const modbus_register_map_st device_map = {.read_holding = read_regs};
+
+/*
+ * Device side: answer every request in the received bytes, in reverse
+ * order, concatenated into one buffer.
+ */
+static size_t answer_all(const uint8_t *req, size_t len, uint8_t *out) {
+    const uint8_t *frames[PIPELINE * 2];
+    size_t count = 0, out_len = 0;
+
+    for (size_t off = 0; off < len;) {
+        int adu_len = decode_mbap_header(req + off, len - off, NULL, NULL, NULL);
+        assert_true(adu_len > 0);
+        frames[count++] = req + off;
+        off += (size_t)adu_len;
+    }
+
+    while (count > 0) {
+        const uint8_t *frame = frames[--count];
+        uint16_t tid, pdu_len;
+        uint8_t unit_id;
+        assert_true(decode_mbap_header(frame, MODBUS_TCP_MAX_ADU_SIZE, &tid, &unit_id, &pdu_len) > 0);
+        int resp_len = modbus_pdu_dispatch(&device_map, unit_id, frame + MODBUS_MBAP_HEADER_SIZE, pdu_len,
+                                           out + out_len + MODBUS_MBAP_HEADER_SIZE);
+        assert_true(resp_len > 0);
+        out_len += encode_mbap_header(tid, unit_id, (uint16_t)resp_len, out + out_len, MODBUS_MBAP_HEADER_SIZE);
+        out_len += (size_t)resp_len;
+    }
+    return out_len;
+}
+
+static size_t read_exact(int fd, uint8_t *buf, size_t len) {
+    size_t got = 0;
+    while (got < len) {
+        ssize_t n = read(fd, buf + got, len - got);
+        assert_true(n > 0);
+        got += (size_t)n;
+    }
+    return got;
+}
+
+static void test_init_and_add(void **state) {
+    (void) state;
+    modbus_batch_st batch;
+    modbus_tcp_master_ctx_st ctx;
+    uint16_t regs[QTY];
+
+    assert_int_equal(modbus_batch_init(NULL, 4, 64), -1);
+    assert_int_equal(modbus_batch_init(&batch, 0, 64), -1);
+    assert_int_equal(modbus_batch_init(&batch, UINT16_MAX + 1, 64), -1);
+    assert_int_equal(modbus_batch_init(&batch, 4, 0), -1);
+
+    // Out of frames
+    modbus_tcp_master_ctx_init(&ctx, PIPELINE);
+    assert_int_equal(modbus_batch_init(&batch, 4, 4 * READ_LEN), 0);
+    for (int i = 0; i < 4; i++) {
+        assert_int_equal(modbus_batch_add_read(&batch, &ctx, 1, 0, QTY, regs), i);
+    }
+    assert_int_equal(modbus_batch_add_read(&batch, &ctx, 1, 0, QTY, regs), -2);
+    assert_int_equal(batch.arena_used, 4 * READ_LEN);
+    assert_true(batch.iov[3].iov_base == batch.arena + 3 * READ_LEN);
+
+    assert_int_equal(modbus_batch_add_read(NULL, &ctx, 1, 0, QTY, regs), -1);
+    assert_int_equal(modbus_batch_add_read(&batch, NULL, 1, 0, QTY, regs), -1);
+    assert_int_equal(modbus_batch_add_read(&batch, &ctx, 1, 0, 0, regs), -1);
+    assert_int_equal(modbus_batch_add_read(&batch, &ctx, 1, 0, QTY, NULL), -1);
+    modbus_batch_free(&batch);
+
+    // Out of arena
+    modbus_tcp_master_ctx_init(&ctx, PIPELINE);
+    assert_int_equal(modbus_batch_init(&batch, 8, 2 * READ_LEN + 4), 0);
+    assert_int_equal(modbus_batch_add_read(&batch, &ctx, 1, 0, QTY, regs), 0);
+    assert_int_equal(modbus_batch_add_read(&batch, &ctx, 1, 0, QTY, regs), 1);
+    assert_int_equal(modbus_batch_add_read(&batch, &ctx, 1, 0, QTY, regs), -2);
+
+    // Out of pipeline
+    modbus_batch_reset(&batch);
+    assert_int_equal(batch.count, 0);
+    modbus_tcp_master_ctx_init(&ctx, 1);
+    assert_int_equal(modbus_batch_add_read(&batch, &ctx, 1, 0, QTY, regs), 0);
+    assert_int_equal(modbus_batch_add_read(&batch, &ctx, 1, 0, QTY, regs), -3);
+    modbus_batch_free(&batch);
+    modbus_batch_free(NULL);
+}
+
+static void test_pipeline(void **state) {
+    (void) state;
+    modbus_batch_st batch;
+    modbus_tcp_master_ctx_st ctx;
+    uint16_t regs[PIPELINE][QTY];
+    uint8_t wire[PIPELINE * READ_LEN], answers[PIPELINE * 32];
+    int fds[2];
+
+    assert_int_equal(socketpair(AF_UNIX, SOCK_STREAM, 0, fds), 0);
+    modbus_tcp_master_ctx_init(&ctx, PIPELINE);
+    assert_int_equal(modbus_batch_init(&batch, PIPELINE, sizeof(wire)), 0);
+    for (int i = 0; i < PIPELINE; i++) {
+        assert_int_equal(modbus_batch_add_read(&batch, &ctx, 7, (uint16_t)(i * QTY), QTY, regs[i]), i);
+    }
+
+    // The whole pipeline leaves in one segment
+    assert_int_equal(modbus_batch_writev(&batch, fds[0], NULL), sizeof(wire));
+    assert_int_equal(batch.gather[0].iov_len, sizeof(wire));
+    read_exact(fds[1], wire, sizeof(wire));
+    assert_memory_equal(wire, batch.arena, sizeof(wire));
+
+    // Answers in reverse order, the last one cut short
+    size_t len = answer_all(wire, sizeof(wire), answers);
+    size_t consumed = 0;
+    assert_int_equal(modbus_batch_decode(&batch, &ctx, answers, len - 3, &consumed), PIPELINE - 1);
+    assert_int_equal(consumed, len - (MODBUS_MBAP_HEADER_SIZE + 2 + 2 * QTY));
+    assert_false(batch.frames[0].answered);
+    assert_int_equal(modbus_batch_decode(&batch, &ctx, answers + consumed, len - consumed, &consumed), 1);
+
+    assert_int_equal(batch.answered, PIPELINE);
+    assert_int_equal(modbus_tcp_master_outstanding(&ctx), 0);
+    for (int i = 0; i < PIPELINE; i++) {
+        assert_int_equal(batch.frames[i].status, QTY);
+        assert_int_equal(regs[i][0], 7000 + i * QTY);
+        assert_int_equal(regs[i][QTY - 1], 7000 + i * QTY + QTY - 1);
+    }
+
+    // A second answer to the same request matches nothing
+    assert_int_equal(modbus_batch_decode(&batch, &ctx, answers, len, &consumed), 0);
+    assert_int_equal(consumed, len);
+
+    // Garbage ends the walk
+    memset(answers, 0xFF, 16);
+    assert_int_equal(modbus_batch_decode(&batch, &ctx, answers, 16, &consumed), 0);
+    assert_int_equal(consumed, 16);
+    assert_int_equal(modbus_batch_decode(NULL, &ctx, answers, 16, NULL), -1);
+
+    modbus_batch_free(&batch);
+    close(fds[0]);
+    close(fds[1]);
+}
+
+static void test_fan_out(void **state) {
+    (void) state;
+    modbus_batch_st batch;
+    modbus_tcp_master_ctx_st devices[2];
+    uint16_t regs[4][QTY];
+    uint8_t wire[4 * READ_LEN], answers[4 * 32];
+    int fds[2][2];
+
+    assert_int_equal(modbus_batch_init(&batch, 8, 256), 0);
+    for (int d = 0; d < 2; d++) {
+        assert_int_equal(socketpair(AF_UNIX, SOCK_STREAM, 0, fds[d]), 0);
+        modbus_tcp_master_ctx_init(&devices[d], 4);
+    }
+
+    // Frames of the two devices interleave in the arena
+    uint8_t pdu[5];
+    modbus_pdu_encode_read(MODBUS_READ_INPUT_REG, 0, QTY, pdu, sizeof(pdu));
+    assert_int_equal(modbus_batch_add_read(&batch, &devices[0], 1, 0, QTY, regs[0]), 0);
+    assert_int_equal(modbus_batch_add_read(&batch, &devices[1], 2, 0, QTY, regs[1]), 1);
+    assert_int_equal(modbus_batch_add_read(&batch, &devices[0], 1, 100, QTY, regs[2]), 2);
+    assert_int_equal(modbus_batch_add_request(&batch, &devices[1], 2, pdu, sizeof(pdu), regs[3], QTY), 3);
+
+    for (int d = 0; d < 2; d++) {
+        assert_int_equal(modbus_batch_writev(&batch, fds[d][0], &devices[d]), 2 * READ_LEN);
+        read_exact(fds[d][1], wire, 2 * READ_LEN);
+        size_t len = answer_all(wire, 2 * READ_LEN, answers);
+
+        // Answers are matched within their own device (and unit) only
+        assert_int_equal(modbus_batch_decode(&batch, &devices[1 - d], answers, len, NULL), 0);
+        assert_int_equal(modbus_batch_decode(&batch, &devices[d], answers, len, NULL), 2);
+    }
+
+    assert_int_equal(batch.frames[0].status, QTY);
+    assert_int_equal(regs[0][0], 1000);
+    assert_int_equal(batch.frames[1].status, QTY);
+    assert_int_equal(regs[1][0], 2000);
+    assert_int_equal(batch.frames[2].status, QTY);
+    assert_int_equal(regs[2][0], 1100);
+    assert_int_equal(batch.frames[3].status, -8);
+
+    modbus_batch_free(&batch);
+    for (int d = 0; d < 2; d++) {
+        close(fds[d][0]);
+        close(fds[d][1]);
+    }
+}
+
+static int bound_udp(struct sockaddr_in *addr) {
+    socklen_t len = sizeof(*addr);
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    assert_true(fd >= 0);
+    memset(addr, 0, sizeof(*addr));
+    addr->sin_family = AF_INET;
+    addr->sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    assert_int_equal(bind(fd, (struct sockaddr *)addr, sizeof(*addr)), 0);
+    assert_int_equal(getsockname(fd, (struct sockaddr *)addr, &len), 0);
+    return fd;
+}
+
+static void test_sendmmsg(void **state) {
+    (void) state;
+    modbus_batch_st batch;
+    modbus_tcp_master_ctx_st devices[2];
+    struct sockaddr_in addrs[2];
+    uint16_t regs[QTY];
+    uint8_t datagram[MODBUS_TCP_MAX_ADU_SIZE];
+    int receivers[2];
+
+    for (int d = 0; d < 2; d++) {
+        receivers[d] = bound_udp(&addrs[d]);
+        modbus_tcp_master_ctx_init(&devices[d], PIPELINE);
+    }
+    int sender = socket(AF_INET, SOCK_DGRAM, 0);
+    assert_true(sender >= 0);
+
+    // One datagram per frame, each to its own device
+    const struct sockaddr *dests[6];
+    assert_int_equal(modbus_batch_init(&batch, 6, 6 * READ_LEN), 0);
+    for (int i = 0; i < 6; i++) {
+        assert_int_equal(modbus_batch_add_read(&batch, &devices[i % 2], 1, (uint16_t)i, QTY, regs), i);
+        dests[i] = (const struct sockaddr *)&addrs[i % 2];
+    }
+    assert_int_equal(modbus_batch_sendmmsg(&batch, sender, dests, sizeof(addrs[0])), 6);
+    for (int i = 0; i < 6; i++) {
+        assert_int_equal(recv(receivers[i % 2], datagram, sizeof(datagram), 0), READ_LEN);
+        assert_memory_equal(datagram, batch.iov[i].iov_base, READ_LEN);
+    }
+
+    // Connected socket: no destinations
+    assert_int_equal(connect(sender, (struct sockaddr *)&addrs[1], sizeof(addrs[1])), 0);
+    assert_int_equal(modbus_batch_sendmmsg(&batch, sender, NULL, 0), 6);
+    for (int i = 0; i < 6; i++) {
+        assert_int_equal(recv(receivers[1], datagram, sizeof(datagram), 0), READ_LEN);
+    }
+    assert_int_equal(modbus_batch_sendmmsg(NULL, sender, NULL, 0), -1);
+
+    modbus_batch_free(&batch);
+    close(sender);
+    close(receivers[0]);
+    close(receivers[1]);
+}
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_init_and_add),
+        cmocka_unit_test(test_pipeline),
+        cmocka_unit_test(test_fan_out),
+        cmocka_unit_test(test_sendmmsg),
+    };
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,195 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdint.h>
+#include <string.h>
+#include <cmocka.h>
+
+#include "modbus_cache.h"
+#include "modbus_master.h"
+#include "modbus_utils.h"
+
+#define SLAVE_ID 1
+
+static modbus_bank_st bank;
+
+static void fill_bank(void) {
+    static uint16_t values[MODBUS_BANK_REGS];
+    for (uint32_t i = 0; i < MODBUS_BANK_REGS; i++) {
+        values[i] = (uint16_t)(i * 3 + 1);
+    }
+    assert_int_equal(modbus_bank_init(&bank), 0);
+    assert_int_equal(modbus_bank_write(&bank, 0, values, MODBUS_BANK_REGS), 0);
+}
+
+static void expect_fresh(modbus_cache_st *cache, uint8_t slave_id, uint16_t start, uint16_t qty) {
+    static const modbus_slave_ctx_st ctx = {0};
+    uint8_t expected[MODBUS_CACHE_FRAME_SIZE];
+    const uint8_t *frame = NULL;
+
+    uint16_t want = modbus_bank_encode_read_response(&bank, &ctx, slave_id, start, qty, expected, sizeof(expected));
+    assert_int_equal(modbus_cache_get(cache, slave_id, start, qty, &frame), want);
+    assert_memory_equal(frame, expected, want);
+}
+
+static void test_init_errors(void **state) {
+    (void) state;
+    modbus_cache_st cache;
+    assert_int_equal(modbus_cache_init(NULL, &bank, 1 << 16), -1);
+    assert_int_equal(modbus_cache_init(&cache, NULL, 1 << 16), -1);
+    assert_int_equal(modbus_cache_init(&cache, &bank, sizeof(modbus_cache_entry_st) - 1), -2);
+    assert_null(cache.entries);
+    modbus_cache_deinit(&cache);
+    modbus_cache_deinit(NULL);
+}
+
+static void test_memory_bound(void **state) {
+    (void) state;
+    modbus_cache_st cache;
+
+    assert_int_equal(modbus_cache_init(&cache, &bank, sizeof(modbus_cache_entry_st)), 0);
+    assert_int_equal(cache.capacity, 1);
+    modbus_cache_deinit(&cache);
+
+    // Largest power of two that fits the budget
+    assert_int_equal(modbus_cache_init(&cache, &bank, sizeof(modbus_cache_entry_st) * 100), 0);
+    assert_int_equal(cache.capacity, 64);
+    assert_int_equal(cache.mask, 63);
+    modbus_cache_deinit(&cache);
+    assert_null(cache.entries);
+}
+
+static void test_hit_and_invalidate(void **state) {
+    (void) state;
+    modbus_cache_st cache;
+    const uint8_t *frame;
+    fill_bank();
+    assert_int_equal(modbus_cache_init(&cache, &bank, 1 << 16), 0);
+
+    expect_fresh(&cache, SLAVE_ID, 100, 10);
+    assert_int_equal(cache.stats.misses, 1);
+    assert_int_equal(cache.stats.hits, 0);
+
+    expect_fresh(&cache, SLAVE_ID, 100, 10);
+    expect_fresh(&cache, SLAVE_ID, 100, 10);
+    assert_int_equal(cache.stats.hits, 2);
+
+    // A write elsewhere in the same segment also invalidates; the frame is rebuilt
+    uint16_t value = 0xBEEF;
+    assert_int_equal(modbus_bank_write(&bank, 127, &value, 1), 0);
+    expect_fresh(&cache, SLAVE_ID, 100, 10);
+    assert_int_equal(cache.stats.stale, 1);
+    assert_int_equal(cache.stats.misses, 2);
+
+    // A write to another segment does not
+    assert_int_equal(modbus_bank_write(&bank, 200, &value, 1), 0);
+    assert_int_not_equal(modbus_cache_get(&cache, SLAVE_ID, 100, 10, &frame), 0);
+    assert_int_equal(cache.stats.hits, 3);
+
+    // A range over three segments is invalidated by a write to the last one
+    expect_fresh(&cache, SLAVE_ID, 63, MODBUS_MAX_REGS);
+    assert_int_equal(modbus_bank_write(&bank, 63 + MODBUS_MAX_REGS - 1, &value, 1), 0);
+    expect_fresh(&cache, SLAVE_ID, 63, MODBUS_MAX_REGS);
+    assert_int_equal(cache.stats.stale, 2);
+
+    // Unit and quantity are part of the key
+    expect_fresh(&cache, 2, 100, 10);
+    expect_fresh(&cache, SLAVE_ID, 100, 11);
+    assert_int_equal(cache.stats.hits, 3);
+
+    modbus_cache_clear(&cache);
+    expect_fresh(&cache, SLAVE_ID, 100, 10);
+    assert_int_equal(cache.stats.hits, 3);
+
+    assert_int_equal(modbus_cache_get(&cache, SLAVE_ID, 0xFFFF, 2, &frame), 0);
+    assert_int_equal(modbus_cache_get(&cache, SLAVE_ID, 0, 0, &frame), 0);
+    assert_int_equal(modbus_cache_get(&cache, MODBUS_MAX_SLAVES + 1, 0, 1, &frame), 0);
+    assert_int_equal(modbus_cache_get(&cache, SLAVE_ID, 0, 1, NULL), 0);
+    modbus_cache_deinit(&cache);
+}
+
+static void test_eviction(void **state) {
+    (void) state;
+    modbus_cache_st cache;
+    fill_bank();
+    assert_int_equal(modbus_cache_init(&cache, &bank, sizeof(modbus_cache_entry_st)), 0);
+
+    // One slot: alternating keys keep replacing each other and stay correct
+    for (int i = 0; i < 4; i++) {
+        expect_fresh(&cache, SLAVE_ID, 0, 5);
+        expect_fresh(&cache, SLAVE_ID, 1000, 5);
+    }
+    assert_int_equal(cache.stats.hits, 0);
+    assert_int_equal(cache.stats.misses, 8);
+    assert_int_equal(cache.stats.evictions, 7);
+    modbus_cache_deinit(&cache);
+}
+
+static void test_respond_raw_request(void **state) {
+    (void) state;
+    modbus_cache_st cache;
+    modbus_slave_ctx_st ctx;
+    modbus_master_ctx_st master;
+    uint8_t req[8];
+    const uint8_t *frame;
+    uint16_t regs[MODBUS_MAX_REGS];
+
+    fill_bank();
+    modbus_slave_ctx_init(&ctx);
+    assert_int_equal(set_device_slave_id(&ctx, SLAVE_ID), 0);
+    modbus_master_ctx_init(&master);
+    assert_int_equal(modbus_cache_init(&cache, &bank, 1 << 16), 0);
+
+    assert_int_equal(encode_read_request(&master, SLAVE_ID, 40, 20, req, sizeof(req)), sizeof(req));
+    for (int round = 0; round < 3; round++) {
+        uint16_t len = modbus_cache_respond(&cache, &ctx, req, sizeof(req), &frame);
+        assert_int_equal(len, 3 + 40 + 2);
+        assert_int_equal(decode_read_response(&master, frame, len, regs, 20), 20);
+        assert_int_equal(regs[0], 40 * 3 + 1);
+    }
+    assert_int_equal(cache.stats.misses, 1);
+    assert_int_equal(cache.stats.hits, 2);
+
+    // Entries made from decoded requests are found by raw ones too
+    uint16_t len = modbus_cache_get(&cache, SLAVE_ID, 500, 4, &frame);
+    assert_int_equal(encode_read_request(&master, SLAVE_ID, 500, 4, req, sizeof(req)), sizeof(req));
+    assert_int_equal(modbus_cache_respond(&cache, &ctx, req, sizeof(req), &frame), len);
+    assert_int_equal(cache.stats.hits, 3);
+
+    // A corrupted CRC, another unit or a short frame never hits
+    req[7] ^= 0x01;
+    assert_int_equal(modbus_cache_respond(&cache, &ctx, req, sizeof(req), &frame), 0);
+    req[7] ^= 0x01;
+    assert_int_equal(modbus_cache_respond(&cache, &ctx, req, sizeof(req) - 1, &frame), 0);
+    assert_int_equal(set_device_slave_id(&ctx, 2), 0);
+    assert_int_equal(modbus_cache_respond(&cache, &ctx, req, sizeof(req), &frame), 0);
+    assert_int_equal(cache.stats.hits, 3);
+
+    // A broadcast is never answered, even with its frame in the cache
+    assert_int_not_equal(modbus_cache_get(&cache, BROADCAST_SLAVE_ID, 40, 20, &frame), 0);
+    uint8_t broadcast[8] = {BROADCAST_SLAVE_ID, MODBUS_READ_HOLDING_REG, 0, 40, 0, 20};
+    uint16_t crc = modbus_crc16(broadcast, 6);
+    memcpy(broadcast + 6, &crc, 2);
+    frame = NULL;
+    assert_int_equal(modbus_cache_respond(&cache, &ctx, broadcast, sizeof(broadcast), &frame), 0);
+    assert_int_equal(set_device_slave_id(&ctx, SLAVE_ID), 0);
+    assert_int_equal(modbus_cache_respond(&cache, &ctx, broadcast, sizeof(broadcast), &frame), 0);
+    assert_true(frame == NULL);
+    assert_int_equal(cache.stats.hits, 3);
+
+    assert_int_equal(modbus_cache_respond(NULL, &ctx, req, sizeof(req), &frame), 0);
+    assert_int_equal(modbus_cache_respond(&cache, NULL, req, sizeof(req), &frame), 0);
+    modbus_cache_deinit(&cache);
+}
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_init_errors),
+        cmocka_unit_test(test_memory_bound),
+        cmocka_unit_test(test_hit_and_invalidate),
+        cmocka_unit_test(test_eviction),
+        cmocka_unit_test(test_respond_raw_request),
+    };
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,219 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <cmocka.h>
+
+#include "modbus_cov.h"
+
+static modbus_cov_block_st block;
+static modbus_cov_changes_st changes;
+static uint16_t regs[MODBUS_MAX_REGS];
+
+static void assert_bitmap_matches_index(const modbus_cov_changes_st *c, uint16_t qty) {
+    uint16_t n = 0;
+    for (uint16_t i = 0; i < qty; i++) {
+        if (c->bitmap[i >> 6] & (1ull << (i & 63))) {
+            assert_true(n < c->count);
+            assert_int_equal(c->index[n], i);
+            n++;
+        }
+    }
+    assert_int_equal(n, c->count);
+}
+
+static void test_init_invalid(void **state) {
+    (void) state;
+    assert_int_equal(modbus_cov_init(NULL, 0, 10, NULL, false), -1);
+    assert_int_equal(modbus_cov_init(&block, 0, 0, NULL, false), -1);
+    assert_int_equal(modbus_cov_init(&block, 0, MODBUS_MAX_REGS + 1, NULL, false), -1);
+    assert_int_equal(modbus_cov_init(&block, 100, MODBUS_MAX_REGS, NULL, false), 0);
+    assert_int_equal(modbus_cov_update(&block, NULL, &changes), -1);
+    assert_int_equal(modbus_cov_update(&block, regs, NULL), -1);
+}
+
+static void test_first_scan_reports_all(void **state) {
+    (void) state;
+    for (uint16_t qty = 1; qty <= MODBUS_MAX_REGS; qty++) {
+        assert_int_equal(modbus_cov_init(&block, 0, qty, NULL, false), 0);
+        memset(regs, 0, sizeof(regs));
+        assert_int_equal(modbus_cov_update(&block, regs, &changes), qty);
+        assert_bitmap_matches_index(&changes, qty);
+        assert_int_equal(modbus_cov_update(&block, regs, &changes), 0);
+    }
+}
+
+static void test_exact_change(void **state) {
+    (void) state;
+    for (int e = MODBUS_COV_ENGINE_AUTO; e < MODBUS_COV_ENGINE_COUNT; e++) {
+        if (modbus_cov_set_engine((modbus_cov_engine_et)e) != 0) {
+            continue;
+        }
+        for (uint16_t i = 0; i < MODBUS_MAX_REGS; i++) {
+            regs[i] = (uint16_t)(i * 7);
+        }
+        assert_int_equal(modbus_cov_init(&block, 0, MODBUS_MAX_REGS, NULL, false), 0);
+        assert_int_equal(modbus_cov_update(&block, regs, &changes), MODBUS_MAX_REGS);
+
+        // One register in each vector, the scalar tail and both bitmap words
+        regs[0]++;
+        regs[15]--;
+        regs[63] ^= 0x8000;
+        regs[64] = 0xFFFF;
+        regs[124]++;
+        assert_int_equal(modbus_cov_update(&block, regs, &changes), 5);
+        assert_int_equal(changes.index[0], 0);
+        assert_int_equal(changes.index[1], 15);
+        assert_int_equal(changes.index[2], 63);
+        assert_int_equal(changes.index[3], 64);
+        assert_int_equal(changes.index[4], 124);
+        assert_bitmap_matches_index(&changes, MODBUS_MAX_REGS);
+        assert_memory_equal(block.published, regs, sizeof(regs));
+        assert_int_equal(modbus_cov_update(&block, regs, &changes), 0);
+    }
+    assert_int_equal(modbus_cov_set_engine(MODBUS_COV_ENGINE_AUTO), 0);
+}
+
+static void test_deadband_against_published(void **state) {
+    (void) state;
+    uint16_t deadband[4] = {10, 10, 0, 0xFFFF};
+    uint16_t scan[4] = {1000, 1000, 5, 0};
+
+    assert_int_equal(modbus_cov_init(&block, 0, 4, deadband, false), 0);
+    assert_int_equal(modbus_cov_update(&block, scan, &changes), 4);
+
+    // Drift of 6 per scan: never more than 10 from the last scan, but from the published value
+    scan[0] = 1006;
+    assert_int_equal(modbus_cov_update(&block, scan, &changes), 0);
+    scan[0] = 1012;
+    assert_int_equal(modbus_cov_update(&block, scan, &changes), 1);
+    assert_int_equal(changes.index[0], 0);
+    assert_int_equal(block.published[0], 1012);
+
+    // Exactly the deadband is not a change
+    scan[1] = 990;
+    assert_int_equal(modbus_cov_update(&block, scan, &changes), 0);
+    scan[1] = 989;
+    assert_int_equal(modbus_cov_update(&block, scan, &changes), 1);
+    assert_int_equal(changes.index[0], 1);
+
+    // Deadband 0xFFFF never reports, deadband 0 reports any step
+    scan[2] = 6;
+    scan[3] = 0xFFFF;
+    assert_int_equal(modbus_cov_update(&block, scan, &changes), 1);
+    assert_int_equal(changes.index[0], 2);
+    assert_int_equal(block.published[3], 0);
+}
+
+static void test_signed_compare(void **state) {
+    (void) state;
+    uint16_t deadband[MODBUS_MAX_REGS];
+    for (int i = 0; i < MODBUS_MAX_REGS; i++) {
+        deadband[i] = 2;
+    }
+
+    for (int e = MODBUS_COV_ENGINE_AUTO; e < MODBUS_COV_ENGINE_COUNT; e++) {
+        if (modbus_cov_set_engine((modbus_cov_engine_et)e) != 0) {
+            continue;
+        }
+        for (int is_signed = 0; is_signed < 2; is_signed++) {
+            memset(regs, 0, sizeof(regs));
+            assert_int_equal(modbus_cov_init(&block, 0, MODBUS_MAX_REGS, deadband, is_signed), 0);
+            modbus_cov_update(&block, regs, &changes);
+
+            // -1 is one away from 0 when signed, 65535 away when not
+            for (int i = 0; i < MODBUS_MAX_REGS; i++) {
+                regs[i] = 0xFFFF;
+            }
+            assert_int_equal(modbus_cov_update(&block, regs, &changes), is_signed ? 0 : MODBUS_MAX_REGS);
+        }
+
+        // 32767 to -32768 is the widest signed step
+        memset(regs, 0, sizeof(regs));
+        regs[3] = 0x7FFF;
+        assert_int_equal(modbus_cov_init(&block, 0, 8, deadband, true), 0);
+        modbus_cov_update(&block, regs, &changes);
+        regs[3] = 0x8000;
+        assert_int_equal(modbus_cov_update(&block, regs, &changes), 1);
+        assert_int_equal(changes.index[0], 3);
+    }
+    assert_int_equal(modbus_cov_set_engine(MODBUS_COV_ENGINE_AUTO), 0);
+}
+
+static void test_engines_bit_identical(void **state) {
+    (void) state;
+    static modbus_cov_block_st reference;
+    modbus_cov_changes_st expected;
+    uint16_t deadband[MODBUS_MAX_REGS];
+    uint16_t scan[MODBUS_MAX_REGS];
+
+    srand(24);
+    for (int i = 0; i < MODBUS_MAX_REGS; i++) {
+        deadband[i] = (uint16_t)(rand() % 4 == 0 ? 0 : rand() % 300);
+        regs[i] = (uint16_t)rand();
+    }
+
+    for (int e = MODBUS_COV_ENGINE_AUTO; e < MODBUS_COV_ENGINE_COUNT; e++) {
+        if (modbus_cov_set_engine((modbus_cov_engine_et)e) != 0) {
+            continue;
+        }
+        for (uint16_t qty = 1; qty <= MODBUS_MAX_REGS; qty += 3) {
+            for (int is_signed = 0; is_signed < 2; is_signed++) {
+                modbus_cov_init(&reference, 0, qty, deadband, is_signed);
+                modbus_cov_init(&block, 0, qty, deadband, is_signed);
+                modbus_cov_update(&reference, regs, &expected);
+                modbus_cov_update(&block, regs, &changes);
+
+                for (int round = 0; round < 8; round++) {
+                    for (uint16_t i = 0; i < qty; i++) {
+                        scan[i] = (uint16_t)(regs[i] + (rand() % 600) - 300);
+                    }
+                    modbus_cov_set_engine(MODBUS_COV_ENGINE_SCALAR);
+                    int want = modbus_cov_update(&reference, scan, &expected);
+                    modbus_cov_set_engine((modbus_cov_engine_et)e);
+                    assert_int_equal(modbus_cov_update(&block, scan, &changes), want);
+                    assert_memory_equal(changes.bitmap, expected.bitmap, sizeof(expected.bitmap));
+                    assert_memory_equal(changes.index, expected.index, expected.count);
+                    assert_memory_equal(block.published, reference.published, qty * sizeof(uint16_t));
+                    assert_bitmap_matches_index(&changes, qty);
+                }
+            }
+        }
+    }
+    assert_int_equal(modbus_cov_set_engine(MODBUS_COV_ENGINE_AUTO), 0);
+}
+
+static void test_reset(void **state) {
+    (void) state;
+    memset(regs, 0, sizeof(regs));
+    assert_int_equal(modbus_cov_init(&block, 40, 10, NULL, false), 0);
+    assert_int_equal(modbus_cov_update(&block, regs, &changes), 10);
+    assert_int_equal(modbus_cov_update(&block, regs, &changes), 0);
+    modbus_cov_reset(&block);
+    assert_int_equal(modbus_cov_update(&block, regs, &changes), 10);
+    assert_int_equal(block.start_addr, 40);
+}
+
+static void test_set_engine_invalid(void **state) {
+    (void) state;
+    assert_int_equal(modbus_cov_set_engine(MODBUS_COV_ENGINE_COUNT), -1);
+    assert_true(modbus_cov_engine_supported(MODBUS_COV_ENGINE_SCALAR));
+    assert_int_equal(strcmp(modbus_cov_engine_name(MODBUS_COV_ENGINE_COUNT), "unknown"), 0);
+}
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_init_invalid),
+        cmocka_unit_test(test_first_scan_reports_all),
+        cmocka_unit_test(test_exact_change),
+        cmocka_unit_test(test_deadband_against_published),
+        cmocka_unit_test(test_signed_compare),
+        cmocka_unit_test(test_engines_bit_identical),
+        cmocka_unit_test(test_reset),
+        cmocka_unit_test(test_set_engine_invalid),
+    };
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,140 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdint.h>
+#include <cmocka.h>
+
+#include "modbus_crc.h"
+#include "modbus_utils.h"
+
+#define TEST_DATA_SIZE 1100
+
+static uint8_t test_data[TEST_DATA_SIZE];
+
+// Fill the shared buffer with a deterministic pseudo-random pattern
+static void fill_test_data(void) {
+    uint32_t x = 0x12345678;
+    for (size_t i = 0; i < TEST_DATA_SIZE; i++) {
+        x = x * 1103515245u + 12345u;
+        test_data[i] = (uint8_t)(x >> 16);
+    }
+}
+
+// Independent bit-at-a-time reference
+static uint16_t reference_crc(uint16_t crc, const uint8_t *buf, size_t len) {
+    for (size_t pos = 0; pos < len; pos++) {
+        crc ^= buf[pos];
+        for (int i = 0; i < 8; i++) {
+            crc = (crc & 1) ? (crc >> 1) ^ 0xA001 : (crc >> 1);
+        }
+    }
+    return crc;
+}
+
+static void test_engines_match_reference(void **state) {
+    (void) state;
+    fill_test_data();
+
+    for (int e = MODBUS_CRC16_ENGINE_AUTO; e < MODBUS_CRC16_ENGINE_COUNT; e++) {
+        if (!modbus_crc16_engine_supported((modbus_crc16_engine_et)e)) {
+            continue;
+        }
+        assert_int_equal(modbus_crc16_set_engine((modbus_crc16_engine_et)e), 0);
+        for (size_t len = 0; len <= TEST_DATA_SIZE; len++) {
+            assert_int_equal(modbus_crc16_accumulate(MODBUS_CRC16_INIT, test_data, len),
+                             reference_crc(MODBUS_CRC16_INIT, test_data, len));
+        }
+        // Arbitrary register values and unaligned starts
+        assert_int_equal(modbus_crc16_accumulate(0x1234, test_data + 3, 517),
+                         reference_crc(0x1234, test_data + 3, 517));
+        assert_int_equal(modbus_crc16_accumulate(0x0000, test_data + 1, 255),
+                         reference_crc(0x0000, test_data + 1, 255));
+    }
+    assert_int_equal(modbus_crc16_set_engine(MODBUS_CRC16_ENGINE_AUTO), 0);
+}
+
+static void test_engines_known_frame(void **state) {
+    (void) state;
+    const uint8_t frame[] = {0x01, 0x03, 0x00, 0x01, 0x00, 0x01};
+
+    for (int e = MODBUS_CRC16_ENGINE_AUTO; e < MODBUS_CRC16_ENGINE_COUNT; e++) {
+        if (modbus_crc16_set_engine((modbus_crc16_engine_et)e) != 0) {
+            continue;
+        }
+        assert_int_equal(modbus_crc16(frame, sizeof(frame)), 0xCAD5);
+        assert_int_equal(modbus_crc16(frame, 0), 0xFFFF);
+        assert_int_equal(modbus_crc16(NULL, 4), 0xFFFF);
+    }
+    assert_int_equal(modbus_crc16_set_engine(MODBUS_CRC16_ENGINE_AUTO), 0);
+}
+
+static void test_set_engine_invalid(void **state) {
+    (void) state;
+    assert_int_equal(modbus_crc16_set_engine(MODBUS_CRC16_ENGINE_COUNT), -1);
+    assert_int_equal(modbus_crc16_get_engine(), MODBUS_CRC16_ENGINE_AUTO);
+    assert_true(modbus_crc16_engine_supported(MODBUS_CRC16_ENGINE_TABLE));
+    assert_false(modbus_crc16_engine_supported(MODBUS_CRC16_ENGINE_COUNT));
+}
+
+static void test_streaming_matches_one_shot(void **state) {
+    (void) state;
+    fill_test_data();
+
+    for (size_t chunk = 1; chunk <= 70; chunk += 3) {
+        modbus_crc16_ctx_st ctx;
+        modbus_crc16_init(&ctx);
+        for (size_t pos = 0; pos < TEST_DATA_SIZE; pos += chunk) {
+            size_t n = (TEST_DATA_SIZE - pos < chunk) ? TEST_DATA_SIZE - pos : chunk;
+            modbus_crc16_update(&ctx, test_data + pos, n);
+        }
+        assert_int_equal(modbus_crc16_final(&ctx), reference_crc(MODBUS_CRC16_INIT, test_data, TEST_DATA_SIZE));
+    }
+
+    modbus_crc16_ctx_st empty;
+    modbus_crc16_init(&empty);
+    assert_int_equal(modbus_crc16_final(&empty), 0xFFFF);
+}
+
+static void test_combine(void **state) {
+    (void) state;
+    fill_test_data();
+
+    for (size_t split = 0; split <= 300; split += 7) {
+        for (size_t len_b = 0; len_b <= 300; len_b += 13) {
+            uint16_t crc_a = modbus_crc16_accumulate(MODBUS_CRC16_INIT, test_data, split);
+            uint16_t crc_b = modbus_crc16_accumulate(MODBUS_CRC16_INIT, test_data + split, len_b);
+            assert_int_equal(modbus_crc16_combine(crc_a, crc_b, len_b),
+                             reference_crc(MODBUS_CRC16_INIT, test_data, split + len_b));
+        }
+    }
+}
+
+static void test_shift(void **state) {
+    (void) state;
+    static const size_t lens[] = {1, 2, 16, 32, 128};
+    modbus_crc16_shift_st op;
+    fill_test_data();
+
+    for (size_t l = 0; l < sizeof(lens) / sizeof(lens[0]); l++) {
+        modbus_crc16_shift_init(&op, lens[l]);
+        for (size_t start = 0; start + lens[l] <= 300; start += 11) {
+            uint16_t crc = modbus_crc16_accumulate(MODBUS_CRC16_INIT, test_data, start);
+            uint16_t block0 = modbus_crc16_accumulate(0, test_data + start, lens[l]);
+            assert_int_equal(modbus_crc16_shift(&op, crc, block0),
+                             reference_crc(MODBUS_CRC16_INIT, test_data, start + lens[l]));
+        }
+    }
+}
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_engines_match_reference),
+        cmocka_unit_test(test_engines_known_frame),
+        cmocka_unit_test(test_set_engine_invalid),
+        cmocka_unit_test(test_streaming_matches_one_shot),
+        cmocka_unit_test(test_combine),
+        cmocka_unit_test(test_shift),
+    };
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
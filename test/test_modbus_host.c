@@ -0,0 +1,186 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdint.h>
+#include <string.h>
+#include <cmocka.h>
+
+#include "modbus_host.h"
+#include "modbus_master.h"
+#include "modbus_utils.h"
+
+#define UNITS 3
+
+static const uint8_t unit_ids[UNITS] = {1, 17, MODBUS_MAX_SLAVES};
+static modbus_bank_st banks[UNITS];
+
+// Each bank holds its unit ID at every address, so a response shows which unit answered
+static void setup_host(modbus_host_st *host) {
+    assert_int_equal(modbus_host_init(host, UNITS), 0);
+    for (int u = 0; u < UNITS; u++) {
+        uint16_t values[16];
+        for (int i = 0; i < 16; i++) {
+            values[i] = unit_ids[u];
+        }
+        modbus_bank_init(&banks[u]);
+        modbus_bank_write(&banks[u], 0, values, 16);
+        assert_int_equal(modbus_host_add_bank(host, unit_ids[u], &banks[u]), u);
+    }
+}
+
+static void test_init_and_add(void **state) {
+    (void) state;
+    modbus_host_st host;
+    modbus_register_map_st map = {0};
+
+    assert_int_equal(modbus_host_init(NULL, 1), -1);
+    assert_int_equal(modbus_host_init(&host, 0), -1);
+    assert_int_equal(modbus_host_init(&host, MODBUS_MAX_SLAVES + 1), -1);
+    assert_int_equal(modbus_host_init(&host, 2), 0);
+
+    assert_int_equal(modbus_host_add_unit(NULL, 1, &map, NULL), -1);
+    assert_int_equal(modbus_host_add_unit(&host, 1, NULL, NULL), -1);
+    assert_int_equal(modbus_host_add_unit(&host, BROADCAST_SLAVE_ID, &map, NULL), -1);
+    assert_int_equal(modbus_host_add_unit(&host, MODBUS_MAX_SLAVES + 1, &map, NULL), -1);
+    assert_int_equal(modbus_host_add_bank(&host, 1, NULL), -1);
+
+    assert_int_equal(modbus_host_add_unit(&host, 5, &map, NULL), 0);
+    assert_int_equal(modbus_host_add_unit(&host, 5, &map, NULL), -3);
+    assert_int_equal(modbus_host_add_unit(&host, 6, &map, NULL), 1);
+    assert_int_equal(modbus_host_add_unit(&host, 7, &map, NULL), -2);
+
+    assert_int_equal(modbus_host_alias(&host, MODBUS_TCP_UNIT_ID_IGNORED, 7), -1);
+    assert_int_equal(modbus_host_alias(&host, 6, 5), -3);
+    assert_int_equal(modbus_host_alias(&host, MODBUS_TCP_UNIT_ID_IGNORED, 5), 0);
+
+    modbus_host_free(&host);
+    assert_null(host.units);
+    assert_int_equal(host.count, 0);
+    modbus_host_free(NULL);
+}
+
+static void test_lookup(void **state) {
+    (void) state;
+    modbus_host_st host;
+    setup_host(&host);
+    assert_int_equal(modbus_host_alias(&host, MODBUS_TCP_UNIT_ID_IGNORED, 17), 0);
+
+    // Every ID resolves through the table: the units added, the alias, and nothing else
+    for (int id = 0; id < 256; id++) {
+        const modbus_host_unit_st *unit = modbus_host_unit(&host, (uint8_t)id);
+        if ((id == 17) || (id == MODBUS_TCP_UNIT_ID_IGNORED)) {
+            assert_true(unit == &host.units[1]);
+        } else if (id == 1) {
+            assert_true(unit == &host.units[0]);
+        } else if (id == MODBUS_MAX_SLAVES) {
+            assert_true(unit == &host.units[2]);
+        } else {
+            assert_null(unit);
+        }
+    }
+    assert_true(host.units[2].map.arg == &banks[2]);
+    assert_true(host.units[2].read_wire == modbus_bank_read_wire_cb);
+
+    modbus_host_free(&host);
+}
+
+static void test_rtu_unicast(void **state) {
+    (void) state;
+    modbus_host_st host;
+    modbus_master_ctx_st master;
+    uint8_t pdu[MODBUS_MAX_PDU_SIZE], req[MODBUS_RTU_MAX_ADU_SIZE], resp[MODBUS_RTU_MAX_ADU_SIZE];
+    uint16_t regs[4];
+
+    setup_host(&host);
+    modbus_master_ctx_init(&master);
+
+    for (int u = 0; u < UNITS; u++) {
+        uint16_t pdu_len = modbus_pdu_encode_read(MODBUS_READ_HOLDING_REG, 2, 4, pdu, sizeof(pdu));
+        uint16_t len = encode_rtu_request(&master, unit_ids[u], pdu, pdu_len, req, sizeof(req));
+        int resp_len = modbus_host_handle_rtu_request(&host, req, len, resp, sizeof(resp));
+        assert_true(resp_len > 0);
+        assert_int_equal(decode_rtu_response(&master, resp, (size_t)resp_len, regs, 4), 4);
+        for (int i = 0; i < 4; i++) {
+            assert_int_equal(regs[i], unit_ids[u]);
+        }
+    }
+
+    // A write reaches only the unit it addresses
+    uint16_t pdu_len = modbus_pdu_encode_write_single(3, 0xBEEF, pdu, sizeof(pdu));
+    uint16_t len = encode_rtu_request(&master, 17, pdu, pdu_len, req, sizeof(req));
+    assert_int_equal(modbus_host_handle_rtu_request(&host, req, len, resp, sizeof(resp)), len);
+    modbus_bank_read(&banks[1], 3, 1, regs);
+    assert_int_equal(regs[0], 0xBEEF);
+    modbus_bank_read(&banks[0], 3, 1, regs);
+    assert_int_equal(regs[0], 1);
+
+    // Not served: dropped like a frame for another slave on the line
+    len = encode_rtu_request(&master, 2, pdu, pdu_len, req, sizeof(req));
+    assert_int_equal(modbus_host_handle_rtu_request(&host, req, len, resp, sizeof(resp)), -4);
+
+    // Served, but corrupted: the unit's own checks apply
+    len = encode_rtu_request(&master, 1, pdu, pdu_len, req, sizeof(req));
+    req[len - 1] ^= 0xFF;
+    assert_true(modbus_host_handle_rtu_request(&host, req, len, resp, sizeof(resp)) < 0);
+
+    assert_int_equal(modbus_host_handle_rtu_request(NULL, req, len, resp, sizeof(resp)), -1);
+    assert_int_equal(modbus_host_handle_rtu_request(&host, req, 1, resp, sizeof(resp)), -2);
+
+    modbus_host_free(&host);
+}
+
+static void test_rtu_broadcast(void **state) {
+    (void) state;
+    modbus_host_st host;
+    modbus_master_ctx_st master;
+    uint8_t pdu[MODBUS_MAX_PDU_SIZE], req[MODBUS_RTU_MAX_ADU_SIZE], resp[MODBUS_RTU_MAX_ADU_SIZE];
+    uint16_t values[2] = {0x1234, 0x5678}, regs[2];
+
+    setup_host(&host);
+    modbus_master_ctx_init(&master);
+
+    // Executed by every unit, answered by none
+    uint16_t pdu_len = modbus_pdu_encode_write_multiple(10, values, 2, pdu, sizeof(pdu));
+    uint16_t len = encode_rtu_request(&master, BROADCAST_SLAVE_ID, pdu, pdu_len, req, sizeof(req));
+    assert_int_equal(modbus_host_handle_rtu_request(&host, req, len, resp, sizeof(resp)), 0);
+    for (int u = 0; u < UNITS; u++) {
+        modbus_bank_read(&banks[u], 10, 2, regs);
+        assert_int_equal(regs[0], 0x1234);
+        assert_int_equal(regs[1], 0x5678);
+    }
+
+    // A broadcast with a bad CRC changes nothing
+    values[0] = 0;
+    pdu_len = modbus_pdu_encode_write_multiple(10, values, 2, pdu, sizeof(pdu));
+    len = encode_rtu_request(&master, BROADCAST_SLAVE_ID, pdu, pdu_len, req, sizeof(req));
+    req[len - 2] ^= 0xFF;
+    assert_true(modbus_host_handle_rtu_request(&host, req, len, resp, sizeof(resp)) < 0);
+    for (int u = 0; u < UNITS; u++) {
+        modbus_bank_read(&banks[u], 10, 1, regs);
+        assert_int_equal(regs[0], 0x1234);
+    }
+
+    // An unknown function code: nothing to execute, nothing to answer
+    uint8_t unknown[] = {BROADCAST_SLAVE_ID, 0x2B, 0x0E, 0x01, 0x00, 0, 0};
+    uint16_t crc = modbus_crc16(unknown, 5);
+    unknown[5] = (uint8_t)crc;
+    unknown[6] = (uint8_t)(crc >> 8);
+    assert_int_equal(modbus_host_handle_rtu_request(&host, unknown, sizeof(unknown), resp, sizeof(resp)), 0);
+    modbus_host_free(&host);
+
+    // No units: nobody to broadcast to
+    assert_int_equal(modbus_host_init(&host, 1), 0);
+    req[len - 2] ^= 0xFF;
+    assert_int_equal(modbus_host_handle_rtu_request(&host, req, len, resp, sizeof(resp)), -4);
+    modbus_host_free(&host);
+}
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_init_and_add),
+        cmocka_unit_test(test_lookup),
+        cmocka_unit_test(test_rtu_unicast),
+        cmocka_unit_test(test_rtu_broadcast),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -11,15 +11,17 @@
 #include "modbus_types.h"
 
 static uint8_t test_slave_id = 1;
+static modbus_master_ctx_st master_ctx;
+static modbus_slave_ctx_st slave_ctx;
 
 // Helper to encode a request and capture the buffer
 static uint16_t encode_request(uint8_t slave_id, uint16_t addr, uint16_t qty, uint8_t *buffer) {
-    return encode_read_request(slave_id, addr, qty, buffer, 256);
+    return encode_read_request(&master_ctx, slave_id, addr, qty, buffer, 256);
 }
 
 // Helper to encode a response with given registers
 static uint16_t encode_response(uint8_t slave_id, uint16_t *regs, uint8_t qty, uint8_t *buffer) {
-    return encode_read_response(slave_id, regs, qty, buffer, 256);
+    return encode_read_response(&slave_ctx, slave_id, regs, qty, buffer, 256);
 }
 
 static void test_encode_read_request_success(void **state) {
@@ -48,12 +50,15 @@ static void test_encode_read_request_invalid(void **state) {
 
 static void test_decode_read_response_success(void **state) {
     (void) state;
+    uint8_t request[256] = {0};
+    encode_request(test_slave_id, 0x0100, 2, request);
+
     uint16_t regs[2] = {1000, 5000};
     uint8_t buffer[256] = {0};
     encode_response(test_slave_id, regs, 2, buffer);
 
     uint16_t read_regs[2] = {0};
-    int ret = decode_read_response(buffer, sizeof(buffer), read_regs, 2);
+    int ret = decode_read_response(&master_ctx, buffer, sizeof(buffer), read_regs, 2);
 
     assert_int_equal(ret, 2);
     assert_int_equal(read_regs[0], 1000);
@@ -62,6 +67,9 @@ static void test_decode_read_response_success(void **state) {
 
 static void test_decode_read_response_errors(void **state) {
     (void) state;
+    uint8_t request[256] = {0};
+    encode_request(test_slave_id, 0x0100, 2, request);
+
     uint16_t regs[2] = {1000, 5000};
     uint8_t buffer[256] = {0};
     encode_response(test_slave_id, regs, 2, buffer);
@@ -69,34 +77,121 @@ static void test_decode_read_response_errors(void **state) {
     uint16_t read_regs[2] = {0};
 
     // Null pointer
-    assert_int_equal(decode_read_response(NULL, sizeof(buffer), read_regs, 2), -1);
-    assert_int_equal(decode_read_response(buffer, sizeof(buffer), NULL, 2), -1);
+    assert_int_equal(decode_read_response(NULL, buffer, sizeof(buffer), read_regs, 2), -1);
+    assert_int_equal(decode_read_response(&master_ctx, NULL, sizeof(buffer), read_regs, 2), -1);
+    assert_int_equal(decode_read_response(&master_ctx, buffer, sizeof(buffer), NULL, 2), -1);
 
     // Wrong slave
     buffer[0] ^= 0xFF;
-    assert_int_equal(decode_read_response(buffer, sizeof(buffer), read_regs, 2), -2);
+    assert_int_equal(decode_read_response(&master_ctx, buffer, sizeof(buffer), read_regs, 2), -2);
     buffer[0] = test_slave_id;
 
     // Wrong function code
     buffer[1] = 0xFF;
-    assert_int_equal(decode_read_response(buffer, sizeof(buffer), read_regs, 2), -3);
+    assert_int_equal(decode_read_response(&master_ctx, buffer, sizeof(buffer), read_regs, 2), -3);
     buffer[1] = MODBUS_READ_HOLDING_REG;
 
     // Bad byte count
     buffer[2] = 255;
-    assert_int_equal(decode_read_response(buffer, sizeof(buffer), read_regs, 2), -4);
+    assert_int_equal(decode_read_response(&master_ctx, buffer, sizeof(buffer), read_regs, 2), -4);
     buffer[2] = 4;
 
     // Buffer too small
-    assert_int_equal(decode_read_response(buffer, 2, read_regs, 2), -5);
+    assert_int_equal(decode_read_response(&master_ctx, buffer, 2, read_regs, 2), -5);
 
     // Output array too small
-    assert_int_equal(decode_read_response(buffer, sizeof(buffer), read_regs, 1), -6);
+    assert_int_equal(decode_read_response(&master_ctx, buffer, sizeof(buffer), read_regs, 1), -6);
 
     // CRC mismatch
     uint16_t crc = modbus_crc16(buffer, 3 + 4);
     buffer[7] ^= 0xFF;
-    assert_int_equal(decode_read_response(buffer, sizeof(buffer), read_regs, 2), -7);
+    assert_int_equal(decode_read_response(&master_ctx, buffer, sizeof(buffer), read_regs, 2), -7);
+}
+
+static void test_contexts_are_independent(void **state) {
+    (void) state;
+    modbus_master_ctx_st bus_a;
+    modbus_master_ctx_st bus_b;
+    modbus_master_ctx_init(&bus_a);
+    modbus_master_ctx_init(&bus_b);
+
+    uint8_t request[256] = {0};
+    assert_true(encode_read_request(&bus_a, 1, 0x0100, 2, request, sizeof(request)) > 0);
+    assert_true(encode_read_request(&bus_b, 2, 0x0100, 2, request, sizeof(request)) > 0);
+    assert_int_equal(encode_read_request(NULL, 1, 0x0100, 2, request, sizeof(request)), 0);
+
+    uint16_t regs[2] = {1000, 5000};
+    uint16_t read_regs[2] = {0};
+    uint8_t response[256] = {0};
+    encode_response(1, regs, 2, response);
+
+    // Only the bus that asked slave 1 accepts its answer
+    assert_int_equal(decode_read_response(&bus_a, response, sizeof(response), read_regs, 2), 2);
+    assert_int_equal(decode_read_response(&bus_b, response, sizeof(response), read_regs, 2), -2);
+}
+
+static void test_rtu_request_any_function(void **state) {
+    (void) state;
+    modbus_master_ctx_st ctx;
+    uint8_t pdu[MODBUS_MAX_PDU_SIZE], req[MODBUS_RTU_MAX_ADU_SIZE];
+    uint16_t values[3] = {1, 2, 3}, regs[4];
+    modbus_master_ctx_init(&ctx);
+
+    uint16_t pdu_len = modbus_pdu_encode_write_multiple(0x0010, values, 3, pdu, sizeof(pdu));
+    uint16_t len = encode_rtu_request(&ctx, 9, pdu, pdu_len, req, sizeof(req));
+    assert_int_equal(len, 1 + 6 + 6 + 2);
+    assert_int_equal(req[0], 9);
+    assert_memory_equal(req + 1, pdu, pdu_len);
+    assert_int_equal(modbus_crc16(req, len - 2), req[len - 2] | (req[len - 1] << 8));
+    assert_memory_equal(ctx.last_request, pdu, MODBUS_PDU_REQUEST_HEADER_SIZE);
+
+    // Echo: slave, function, address, quantity, CRC
+    uint8_t echo[8] = {9, MODBUS_WRITE_MULTIPLE_REGS, 0x00, 0x10, 0x00, 0x03};
+    uint16_t crc = modbus_crc16(echo, 6);
+    echo[6] = (uint8_t)crc;
+    echo[7] = (uint8_t)(crc >> 8);
+    assert_int_equal(decode_rtu_response(&ctx, echo, sizeof(echo), NULL, 0), 0);
+    assert_int_equal(decode_rtu_response(&ctx, echo, 7, NULL, 0), -5);
+    echo[7] ^= 1;
+    assert_int_equal(decode_rtu_response(&ctx, echo, sizeof(echo), NULL, 0), -7);
+
+    // An echo for another address does not acknowledge this write
+    echo[3] = 0x11;
+    crc = modbus_crc16(echo, 6);
+    echo[6] = (uint8_t)crc;
+    echo[7] = (uint8_t)(crc >> 8);
+    assert_int_equal(decode_rtu_response(&ctx, echo, sizeof(echo), NULL, 0), -4);
+
+    // Exception: slave, function | 0x80, code, CRC
+    uint8_t ex[5] = {9, MODBUS_WRITE_MULTIPLE_REGS | MODBUS_EXCEPTION_FLAG, MODBUS_EX_ILLEGAL_DATA_ADDRESS};
+    crc = modbus_crc16(ex, 3);
+    ex[3] = (uint8_t)crc;
+    ex[4] = (uint8_t)(crc >> 8);
+    assert_int_equal(decode_rtu_response(&ctx, ex, sizeof(ex), NULL, 0), -8);
+    ex[0] = 8;
+    assert_int_equal(decode_rtu_response(&ctx, ex, sizeof(ex), NULL, 0), -2);
+    ex[0] = 9;
+    ex[1] = MODBUS_READ_INPUT_REG | MODBUS_EXCEPTION_FLAG;
+    assert_int_equal(decode_rtu_response(&ctx, ex, sizeof(ex), NULL, 0), -3);
+
+    // A read of input registers
+    pdu_len = modbus_pdu_encode_read(MODBUS_READ_INPUT_REG, 0, 2, pdu, sizeof(pdu));
+    len = encode_rtu_request(&ctx, 9, pdu, pdu_len, req, sizeof(req));
+    assert_int_equal(len, 8);
+    uint8_t resp[9] = {9, MODBUS_READ_INPUT_REG, 4, 0x12, 0x34, 0x56, 0x78};
+    crc = modbus_crc16(resp, 7);
+    resp[7] = (uint8_t)crc;
+    resp[8] = (uint8_t)(crc >> 8);
+    assert_int_equal(decode_rtu_response(&ctx, resp, sizeof(resp), regs, 4), 2);
+    assert_int_equal(regs[0], 0x1234);
+    assert_int_equal(regs[1], 0x5678);
+    assert_int_equal(decode_rtu_response(&ctx, resp, sizeof(resp), regs, 1), -6);
+    assert_int_equal(decode_rtu_response(NULL, resp, sizeof(resp), regs, 4), -1);
+
+    // The PDU length must match its own header
+    assert_int_equal(encode_rtu_request(&ctx, 9, pdu, pdu_len - 1, req, sizeof(req)), 0);
+    assert_int_equal(encode_rtu_request(&ctx, 9, pdu, pdu_len, req, 7), 0);
+    assert_int_equal(encode_rtu_request(&ctx, MODBUS_MAX_SLAVES + 1, pdu, pdu_len, req, sizeof(req)), 0);
 }
 
 int main(void) {
@@ -105,7 +200,12 @@ int main(void) {
         cmocka_unit_test(test_encode_read_request_invalid),
         cmocka_unit_test(test_decode_read_response_success),
         cmocka_unit_test(test_decode_read_response_errors),
+        cmocka_unit_test(test_contexts_are_independent),
+        cmocka_unit_test(test_rtu_request_any_function),
     };
 
+    modbus_master_ctx_init(&master_ctx);
+    modbus_slave_ctx_init(&slave_ctx);
+
     return cmocka_run_group_tests(tests, NULL, NULL);
 }
@@ -0,0 +1,259 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdint.h>
+#include <string.h>
+#include <cmocka.h>
+
+#include "modbus_pdu.h"
+
+// A small register file: holding registers are writable, input registers are address * 2
+static uint16_t holding[256];
+static int writes;
+static int fail_reads;
+
+static int read_holding(void *arg, uint8_t unit_id, uint16_t start_addr, uint16_t qty, uint16_t *regs) {
+    (void) arg;
+    (void) unit_id;
+    if (fail_reads || start_addr + qty > 256) {
+        return -1;
+    }
+    memcpy(regs, &holding[start_addr], qty * sizeof(uint16_t));
+    return 0;
+}
+
+static int read_input(void *arg, uint8_t unit_id, uint16_t start_addr, uint16_t qty, uint16_t *regs) {
+    (void) arg;
+    (void) unit_id;
+    for (uint16_t i = 0; i < qty; i++) {
+        regs[i] = (uint16_t)((start_addr + i) * 2);
+    }
+    return 0;
+}
+
+static int write_holding(void *arg, uint8_t unit_id, uint16_t start_addr, uint16_t qty, const uint16_t *values) {
+    (void) arg;
+    (void) unit_id;
+    if (start_addr + qty > 256) {
+        return -1;
+    }
+    memcpy(&holding[start_addr], values, qty * sizeof(uint16_t));
+    writes++;
+    return 0;
+}
+
+static const modbus_register_map_st map = {
+    .read_holding = read_holding,
+    .read_input = read_input,
+    .write_holding = write_holding,
+};
+
+static void reset(void) {
+    for (int i = 0; i < 256; i++) {
+        holding[i] = (uint16_t)(0x1000 + i);
+    }
+    writes = 0;
+    fail_reads = 0;
+}
+
+// Run a request through the dispatcher and decode the answer as the master would
+static int roundtrip(const uint8_t *req, uint16_t req_len, uint16_t *regs, uint16_t regs_len) {
+    uint8_t resp[MODBUS_MAX_PDU_SIZE];
+    int len = modbus_pdu_dispatch(&map, 1, req, req_len, resp);
+    assert_true(len > 0);
+    assert_int_equal(modbus_pdu_response_length(resp, (size_t)len), len);
+    return modbus_pdu_decode_response(req, req_len, resp, (size_t)len, regs, regs_len);
+}
+
+static void test_read_holding_and_input(void **state) {
+    (void) state;
+    reset();
+    uint8_t req[MODBUS_MAX_PDU_SIZE];
+    uint16_t regs[MODBUS_MAX_REGS];
+
+    uint16_t len = modbus_pdu_encode_read(MODBUS_READ_HOLDING_REG, 10, 3, req, sizeof(req));
+    assert_int_equal(len, 5);
+    assert_int_equal(modbus_pdu_request_length(req, len), len);
+    assert_int_equal(roundtrip(req, len, regs, MODBUS_MAX_REGS), 3);
+    assert_int_equal(regs[0], 0x100A);
+    assert_int_equal(regs[2], 0x100C);
+
+    len = modbus_pdu_encode_read(MODBUS_READ_INPUT_REG, 100, MODBUS_MAX_REGS, req, sizeof(req));
+    assert_int_equal(roundtrip(req, len, regs, MODBUS_MAX_REGS), MODBUS_MAX_REGS);
+    assert_int_equal(regs[0], 200);
+    assert_int_equal(regs[MODBUS_MAX_REGS - 1], (100 + MODBUS_MAX_REGS - 1) * 2);
+
+    assert_int_equal(modbus_pdu_encode_read(MODBUS_WRITE_SINGLE_REG, 0, 1, req, sizeof(req)), 0);
+    assert_int_equal(modbus_pdu_encode_read(MODBUS_READ_INPUT_REG, 0, MODBUS_MAX_REGS + 1, req, sizeof(req)), 0);
+    assert_int_equal(modbus_pdu_encode_read(MODBUS_READ_INPUT_REG, 0, 1, req, 4), 0);
+}
+
+static void test_writes(void **state) {
+    (void) state;
+    reset();
+    uint8_t req[MODBUS_MAX_PDU_SIZE];
+    uint16_t values[MODBUS_MAX_WRITE_REGS];
+    for (int i = 0; i < MODBUS_MAX_WRITE_REGS; i++) {
+        values[i] = (uint16_t)(0xA000 + i);
+    }
+
+    uint16_t len = modbus_pdu_encode_write_single(7, 0xBEEF, req, sizeof(req));
+    assert_int_equal(len, 5);
+    assert_int_equal(roundtrip(req, len, NULL, 0), 0);
+    assert_int_equal(holding[7], 0xBEEF);
+
+    len = modbus_pdu_encode_write_multiple(20, values, MODBUS_MAX_WRITE_REGS, req, sizeof(req));
+    assert_int_equal(len, 6 + MODBUS_MAX_WRITE_REGS * 2);
+    assert_int_equal(modbus_pdu_request_length(req, len), len);
+    assert_int_equal(modbus_pdu_request_length(req, 5), 0);
+    assert_int_equal(roundtrip(req, len, NULL, 0), 0);
+    assert_int_equal(holding[20], 0xA000);
+    assert_int_equal(holding[20 + MODBUS_MAX_WRITE_REGS - 1], 0xA000 + MODBUS_MAX_WRITE_REGS - 1);
+    assert_int_equal(writes, 2);
+
+    assert_int_equal(modbus_pdu_encode_write_multiple(0, values, MODBUS_MAX_WRITE_REGS + 1, req, sizeof(req)), 0);
+    assert_int_equal(modbus_pdu_encode_write_multiple(0, NULL, 1, req, sizeof(req)), 0);
+    assert_int_equal(modbus_pdu_encode_write_multiple(0, values, 2, req, 9), 0);
+}
+
+static void test_read_write_is_one_round_trip(void **state) {
+    (void) state;
+    reset();
+    uint8_t req[MODBUS_MAX_PDU_SIZE];
+    uint16_t regs[MODBUS_MAX_REGS];
+    uint16_t setpoint[2] = {0x1111, 0x2222};
+
+    // The write lands before the read, so the read sees the new setpoint
+    uint16_t len = modbus_pdu_encode_read_write(50, 4, 51, setpoint, 2, req, sizeof(req));
+    assert_int_equal(len, 10 + 4);
+    assert_int_equal(modbus_pdu_request_length(req, len), len);
+    assert_int_equal(modbus_pdu_request_length(req, 9), 0);
+    assert_int_equal(modbus_pdu_request_qty(req, len), 4);
+    assert_int_equal(roundtrip(req, len, regs, MODBUS_MAX_REGS), 4);
+    assert_int_equal(regs[0], 0x1000 + 50);
+    assert_int_equal(regs[1], 0x1111);
+    assert_int_equal(regs[2], 0x2222);
+    assert_int_equal(regs[3], 0x1000 + 53);
+
+    assert_int_equal(modbus_pdu_encode_read_write(0, 0, 0, setpoint, 1, req, sizeof(req)), 0);
+    assert_int_equal(modbus_pdu_encode_read_write(0, 1, 0, setpoint, MODBUS_MAX_RW_WRITE_REGS + 1, req, sizeof(req)), 0);
+    assert_int_equal(modbus_pdu_encode_read_write(0, 1, 0xFFFF, setpoint, 2, req, sizeof(req)), 0);
+}
+
+static void test_exceptions(void **state) {
+    (void) state;
+    reset();
+    uint8_t req[MODBUS_MAX_PDU_SIZE];
+    uint8_t resp[MODBUS_MAX_PDU_SIZE];
+    uint16_t values[2] = {1, 2};
+    uint16_t regs[MODBUS_MAX_REGS];
+
+    // Unknown function code
+    req[0] = 0x2B;
+    assert_int_equal(modbus_pdu_dispatch(&map, 1, req, 1, resp), 2);
+    assert_int_equal(resp[0], 0xAB);
+    assert_int_equal(resp[1], MODBUS_EX_ILLEGAL_FUNCTION);
+    assert_int_equal(modbus_pdu_request_length(req, 1), -1);
+
+    // Quantity out of range, then an address range past 0xFFFF
+    modbus_pdu_encode_read(MODBUS_READ_HOLDING_REG, 0, 1, req, sizeof(req));
+    req[4] = MODBUS_MAX_REGS + 1;
+    assert_int_equal(modbus_pdu_dispatch(&map, 1, req, 5, resp), 2);
+    assert_int_equal(resp[1], MODBUS_EX_ILLEGAL_DATA_VALUE);
+    req[1] = 0xFF;
+    req[2] = 0xFF;
+    req[4] = 2;
+    assert_int_equal(modbus_pdu_dispatch(&map, 1, req, 5, resp), 2);
+    assert_int_equal(resp[1], MODBUS_EX_ILLEGAL_DATA_ADDRESS);
+
+    // Byte count that disagrees with the quantity; nothing is written
+    uint16_t len = modbus_pdu_encode_write_multiple(0, values, 2, req, sizeof(req));
+    req[5] = 2;
+    assert_int_equal(modbus_pdu_dispatch(&map, 1, req, len, resp), 2);
+    assert_int_equal(resp[0], MODBUS_WRITE_MULTIPLE_REGS | MODBUS_EXCEPTION_FLAG);
+    assert_int_equal(resp[1], MODBUS_EX_ILLEGAL_DATA_VALUE);
+    assert_int_equal(writes, 0);
+
+    // Callback failure
+    fail_reads = 1;
+    len = modbus_pdu_encode_read(MODBUS_READ_HOLDING_REG, 0, 1, req, sizeof(req));
+    assert_int_equal(modbus_pdu_dispatch(&map, 1, req, len, resp), 2);
+    assert_int_equal(resp[1], MODBUS_EX_SLAVE_DEVICE_FAILURE);
+    assert_int_equal(modbus_pdu_response_length(resp, 2), 2);
+    assert_int_equal(modbus_pdu_decode_response(req, len, resp, 2, regs, MODBUS_MAX_REGS), -8);
+
+    // A map without a write sink is read-only
+    const modbus_register_map_st read_only = {.read_holding = read_holding};
+    len = modbus_pdu_encode_write_single(0, 1, req, sizeof(req));
+    assert_int_equal(modbus_pdu_dispatch(&read_only, 1, req, len, resp), 2);
+    assert_int_equal(resp[1], MODBUS_EX_ILLEGAL_FUNCTION);
+    len = modbus_pdu_encode_read(MODBUS_READ_INPUT_REG, 0, 1, req, sizeof(req));
+    assert_int_equal(modbus_pdu_dispatch(&read_only, 1, req, len, resp), 2);
+    assert_int_equal(resp[1], MODBUS_EX_ILLEGAL_FUNCTION);
+
+    assert_int_equal(modbus_pdu_dispatch(NULL, 1, req, len, resp), -1);
+    assert_int_equal(modbus_pdu_dispatch(&map, 1, req, 0, resp), -1);
+}
+
+static void test_decode_response_errors(void **state) {
+    (void) state;
+    reset();
+    uint16_t regs[4];
+    const uint8_t read_resp[] = {MODBUS_READ_HOLDING_REG, 4, 0x00, 0x01, 0x00, 0x02};
+    const uint8_t write_echo[] = {MODBUS_WRITE_MULTIPLE_REGS, 0x00, 0x10, 0x00, 0x03};
+    uint8_t req[MODBUS_MAX_PDU_SIZE];
+    const uint16_t values[4] = {7, 8, 9, 10};
+
+    uint16_t len = modbus_pdu_encode_read(MODBUS_READ_HOLDING_REG, 0, 2, req, sizeof(req));
+    assert_int_equal(modbus_pdu_decode_response(req, len, read_resp, sizeof(read_resp), regs, 4), 2);
+    assert_int_equal(regs[1], 2);
+    assert_int_equal(modbus_pdu_decode_response(req, len, NULL, 6, regs, 4), -1);
+    assert_int_equal(modbus_pdu_decode_response(NULL, len, read_resp, sizeof(read_resp), regs, 4), -1);
+    assert_int_equal(modbus_pdu_decode_response(req, 4, read_resp, sizeof(read_resp), regs, 4), -1);
+    assert_int_equal(modbus_pdu_decode_response(req, len, read_resp, sizeof(read_resp), NULL, 4), -1);
+    assert_int_equal(modbus_pdu_decode_response(req, len, read_resp, 5, regs, 4), -5);
+    assert_int_equal(modbus_pdu_decode_response(req, len, read_resp, sizeof(read_resp), regs, 1), -6);
+    len = modbus_pdu_encode_read(MODBUS_READ_INPUT_REG, 0, 2, req, sizeof(req));
+    assert_int_equal(modbus_pdu_decode_response(req, len, read_resp, sizeof(read_resp), regs, 4), -3);
+    len = modbus_pdu_encode_read(MODBUS_READ_HOLDING_REG, 0, 3, req, sizeof(req));
+    assert_int_equal(modbus_pdu_decode_response(req, len, read_resp, sizeof(read_resp), regs, 4), -4);
+
+    // 0x10 must echo address and quantity
+    len = modbus_pdu_encode_write_multiple(0x0010, values, 3, req, sizeof(req));
+    assert_int_equal(modbus_pdu_decode_response(req, len, write_echo, sizeof(write_echo), NULL, 0), 0);
+    assert_int_equal(modbus_pdu_decode_response(req, len, write_echo, 4, NULL, 0), -5);
+    len = modbus_pdu_encode_write_multiple(0x0010, values, 4, req, sizeof(req));
+    assert_int_equal(modbus_pdu_decode_response(req, len, write_echo, sizeof(write_echo), NULL, 0), -4);
+    len = modbus_pdu_encode_write_multiple(0x0011, values, 3, req, sizeof(req));
+    assert_int_equal(modbus_pdu_decode_response(req, len, write_echo, sizeof(write_echo), NULL, 0), -4);
+
+    // 0x06 must echo address and value
+    const uint8_t single_echo[] = {MODBUS_WRITE_SINGLE_REG, 0x00, 0x20, 0x12, 0x34};
+    len = modbus_pdu_encode_write_single(0x0020, 0x1234, req, sizeof(req));
+    assert_int_equal(modbus_pdu_decode_response(req, len, single_echo, sizeof(single_echo), NULL, 0), 0);
+    len = modbus_pdu_encode_write_single(0x0021, 0x1234, req, sizeof(req));
+    assert_int_equal(modbus_pdu_decode_response(req, len, single_echo, sizeof(single_echo), NULL, 0), -4);
+    len = modbus_pdu_encode_write_single(0x0020, 0x1235, req, sizeof(req));
+    assert_int_equal(modbus_pdu_decode_response(req, len, single_echo, sizeof(single_echo), NULL, 0), -4);
+
+    // Response framing
+    assert_int_equal(modbus_pdu_response_length(read_resp, 1), 0);
+    assert_int_equal(modbus_pdu_response_length(read_resp, 2), 6);
+    assert_int_equal(modbus_pdu_response_length(write_echo, 1), 5);
+    const uint8_t odd[] = {MODBUS_READ_INPUT_REG, 3};
+    assert_int_equal(modbus_pdu_response_length(odd, 2), -1);
+    const uint8_t unknown[] = {0x2B | MODBUS_EXCEPTION_FLAG, 1};
+    assert_int_equal(modbus_pdu_response_length(unknown, 2), -1);
+}
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_read_holding_and_input),
+        cmocka_unit_test(test_writes),
+        cmocka_unit_test(test_read_write_is_one_round_trip),
+        cmocka_unit_test(test_exceptions),
+        cmocka_unit_test(test_decode_response_errors),
+    };
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
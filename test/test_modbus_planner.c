@@ -0,0 +1,189 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdint.h>
+#include <string.h>
+#include <cmocka.h>
+
+#include "modbus_planner.h"
+#include "modbus_slave.h"
+
+static int read_regs(void *arg, uint8_t unit_id, uint16_t start_addr, uint16_t qty, uint16_t *regs) {
+    (void) arg;
+    for (uint16_t i = 0; i < qty; i++) {
+        regs[i] = (uint16_t)(unit_id * 1000 + start_addr + i);
+    }
+    return 0;
+}
+
+static void expect_read(const modbus_read_plan_st *plan, size_t index, uint8_t unit_id, uint16_t start,
+                        uint16_t qty, uint32_t count) {
+    assert_true(index < plan->read_count);
+    assert_int_equal(plan->reads[index].unit_id, unit_id);
+    assert_int_equal(plan->reads[index].start_addr, start);
+    assert_int_equal(plan->reads[index].qty, qty);
+    assert_int_equal(plan->reads[index].count, count);
+}
+
+static void test_build_errors(void **state) {
+    (void) state;
+    modbus_read_plan_st plan;
+    modbus_point_st points[2] = {{.unit_id = 1, .addr = 0}, {.unit_id = 0, .addr = 1}};
+
+    assert_int_equal(modbus_read_plan_build(NULL, points, 2, 0), -1);
+    assert_int_equal(modbus_read_plan_build(&plan, NULL, 2, 0), -1);
+    assert_int_equal(modbus_read_plan_build(&plan, points, 2, 0), -2);
+    points[1].unit_id = MODBUS_MAX_SLAVES + 1;
+    assert_int_equal(modbus_read_plan_build(&plan, points, 2, 0), -2);
+    assert_null(plan.reads);
+
+    assert_int_equal(modbus_read_plan_build(&plan, NULL, 0, 0), 0);
+    assert_int_equal(plan.read_count, 0);
+    modbus_read_plan_free(&plan);
+    modbus_read_plan_free(NULL);
+}
+
+static void test_gap_threshold(void **state) {
+    (void) state;
+    modbus_read_plan_st plan;
+    // Deliberately unsorted, with a duplicate
+    modbus_point_st points[] = {
+        {.unit_id = 1, .addr = 20}, {.unit_id = 1, .addr = 10}, {.unit_id = 1, .addr = 14},
+        {.unit_id = 1, .addr = 11}, {.unit_id = 1, .addr = 14}, {.unit_id = 1, .addr = 40},
+    };
+    size_t count = sizeof(points) / sizeof(points[0]);
+
+    // Gap 0: only adjacent registers share a read
+    assert_int_equal(modbus_read_plan_build(&plan, points, count, 0), 4);
+    expect_read(&plan, 0, 1, 10, 2, 2);
+    expect_read(&plan, 1, 1, 14, 1, 2);
+    expect_read(&plan, 2, 1, 20, 1, 1);
+    expect_read(&plan, 3, 1, 40, 1, 1);
+    modbus_read_plan_free(&plan);
+
+    // Gap 5: 11 -> 14 and 14 -> 20 (5 unused registers) merge, 20 -> 40 does not
+    assert_int_equal(modbus_read_plan_build(&plan, points, count, 5), 2);
+    expect_read(&plan, 0, 1, 10, 11, 5);
+    expect_read(&plan, 1, 1, 40, 1, 1);
+    modbus_read_plan_free(&plan);
+
+    assert_int_equal(modbus_read_plan_build(&plan, points, count, 4), 3);
+    modbus_read_plan_free(&plan);
+
+    assert_int_equal(modbus_read_plan_build(&plan, points, count, UINT16_MAX), 1);
+    expect_read(&plan, 0, 1, 10, 31, 6);
+    modbus_read_plan_free(&plan);
+}
+
+static void test_register_limit_and_units(void **state) {
+    (void) state;
+    modbus_read_plan_st plan;
+    static modbus_point_st points[1000];
+    size_t count = 0;
+
+    // Every register of 0..299 on unit 3: the fewest reads is ceil(300 / 125)
+    for (uint16_t addr = 0; addr < 300; addr++) {
+        points[count++] = (modbus_point_st){.unit_id = 3, .addr = addr};
+    }
+    // The same addresses on another unit never share a read
+    points[count++] = (modbus_point_st){.unit_id = 2, .addr = 0};
+    points[count++] = (modbus_point_st){.unit_id = 2, .addr = 124};
+    points[count++] = (modbus_point_st){.unit_id = 2, .addr = 125};
+    // Top of the address space
+    points[count++] = (modbus_point_st){.unit_id = 4, .addr = 0xFFFF};
+
+    assert_int_equal(modbus_read_plan_build(&plan, points, count, UINT16_MAX), 6);
+    expect_read(&plan, 0, 2, 0, MODBUS_MAX_REGS, 2);
+    expect_read(&plan, 1, 2, 125, 1, 1);
+    expect_read(&plan, 2, 3, 0, MODBUS_MAX_REGS, MODBUS_MAX_REGS);
+    expect_read(&plan, 3, 3, 125, MODBUS_MAX_REGS, MODBUS_MAX_REGS);
+    expect_read(&plan, 4, 3, 250, 50, 50);
+    expect_read(&plan, 5, 4, 0xFFFF, 1, 1);
+
+    // Every point belongs to exactly one read and lies inside it
+    uint32_t covered = 0;
+    for (size_t r = 0; r < plan.read_count; r++) {
+        const modbus_planned_read_st *read = &plan.reads[r];
+        assert_int_equal(read->first, covered);
+        for (uint32_t i = read->first; i < read->first + read->count; i++) {
+            const modbus_point_st *point = &points[plan.order[i]];
+            assert_int_equal(point->unit_id, read->unit_id);
+            assert_true(point->addr >= read->start_addr);
+            assert_true(point->addr < read->start_addr + read->qty);
+        }
+        covered += read->count;
+    }
+    assert_int_equal(covered, count);
+    modbus_read_plan_free(&plan);
+}
+
+static void test_scan_roundtrip(void **state) {
+    (void) state;
+    modbus_read_plan_st plan;
+    modbus_master_ctx_st master;
+    modbus_slave_ctx_st slave;
+    modbus_register_map_st map = {.read_holding = read_regs};
+    static modbus_point_st points[500];
+    uint8_t req[MODBUS_RTU_MAX_ADU_SIZE], resp[MODBUS_RTU_MAX_ADU_SIZE];
+
+    // Scattered tags over three units
+    size_t count = 0;
+    for (uint32_t i = 0; i < 500; i++) {
+        points[count++] = (modbus_point_st){
+            .unit_id = (uint8_t)(1 + i % 3),
+            .addr = (uint16_t)((i * 7919u) % 1000u),
+        };
+    }
+
+    int reads = modbus_read_plan_build(&plan, points, count, 10);
+    assert_true(reads > 0);
+    assert_true((size_t)reads < count / 4);
+
+    modbus_master_ctx_init(&master);
+    modbus_slave_ctx_init(&slave);
+    uint32_t updated = 0;
+    for (size_t r = 0; r < plan.read_count; r++) {
+        uint16_t len = modbus_read_plan_encode(&plan, r, &master, req, sizeof(req));
+        assert_int_not_equal(len, 0);
+        assert_int_equal(set_device_slave_id(&slave, plan.reads[r].unit_id), 0);
+        int resp_len = modbus_slave_handle_request(&slave, &map, req, len, resp, sizeof(resp));
+        assert_true(resp_len > 0);
+        int ret = modbus_read_plan_decode(&plan, r, &master, resp, (size_t)resp_len);
+        assert_int_equal(ret, plan.reads[r].count);
+        updated += (uint32_t)ret;
+    }
+    assert_int_equal(updated, count);
+
+    for (size_t i = 0; i < count; i++) {
+        assert_int_equal(points[i].value, (uint16_t)(points[i].unit_id * 1000 + points[i].addr));
+    }
+
+    // A response for another window is rejected
+    uint16_t len = modbus_read_plan_encode(&plan, 0, &master, req, sizeof(req));
+    assert_int_equal(set_device_slave_id(&slave, plan.reads[0].unit_id), 0);
+    assert_int_equal(encode_read_request(&master, plan.reads[0].unit_id, plan.reads[0].start_addr,
+                                         (uint16_t)(plan.reads[0].qty + 1), req, sizeof(req)), len);
+    int resp_len = modbus_slave_handle_request(&slave, &map, req, len, resp, sizeof(resp));
+    assert_int_equal(modbus_read_plan_decode(&plan, 0, &master, resp, (size_t)resp_len), -8);
+    resp[resp_len - 1] ^= 0xFF;
+    assert_int_equal(modbus_read_plan_decode(&plan, 0, &master, resp, (size_t)resp_len), -7);
+
+    uint16_t regs[MODBUS_MAX_REGS] = {0};
+    assert_int_equal(modbus_read_plan_scatter(&plan, 0, regs, (uint16_t)(plan.reads[0].qty + 1)), -2);
+    assert_int_equal(modbus_read_plan_scatter(&plan, plan.read_count, regs, 1), -1);
+    assert_int_equal(modbus_read_plan_scatter(&plan, 0, NULL, plan.reads[0].qty), -1);
+    assert_int_equal(modbus_read_plan_encode(&plan, plan.read_count, &master, req, sizeof(req)), 0);
+    assert_int_equal(modbus_read_plan_decode(&plan, plan.read_count, &master, resp, sizeof(resp)), -1);
+    modbus_read_plan_free(&plan);
+}
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_build_errors),
+        cmocka_unit_test(test_gap_threshold),
+        cmocka_unit_test(test_register_limit_and_units),
+        cmocka_unit_test(test_scan_roundtrip),
+    };
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
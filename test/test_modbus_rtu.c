@@ -0,0 +1,347 @@
+#define _GNU_SOURCE
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <cmocka.h>
+
+#include "modbus_rtu.h"
+#include "modbus_master.h"
+#include "modbus_slave.h"
+
+#define SLAVE_ID 1
+#define QTY 10
+// Read Holding Registers: 8-byte request, 5 + 2 * QTY byte response
+#define REQUEST_LEN 8
+#define RESPONSE_LEN (5 + 2 * QTY)
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ull + (uint64_t)ts.tv_nsec;
+}
+
+static void sleep_ms(long ms) {
+    struct timespec ts = {ms / 1000, (ms % 1000) * 1000000};
+    nanosleep(&ts, NULL);
+}
+
+// A pseudo-terminal has no parity bit and rejects settings asking for one
+static modbus_rtu_config_st line_config(uint32_t baud, modbus_stream_mode_et rx_mode) {
+    modbus_rtu_config_st cfg = {
+        .baud = baud,
+        .parity = 'N',
+        .stop_bits = 1,
+        .rx_mode = rx_mode,
+        .response_timeout_us = 1000000,
+        .turnaround_us = 20000,
+    };
+    return cfg;
+}
+
+// The pseudo-terminal master plays the bus master, its peer the slave
+static void open_line(uint32_t baud, modbus_rtu_st *master, modbus_rtu_st *slave) {
+    int ptm = posix_openpt(O_RDWR | O_NOCTTY);
+    assert_true(ptm >= 0);
+    assert_int_equal(grantpt(ptm), 0);
+    assert_int_equal(unlockpt(ptm), 0);
+    int pts = open(ptsname(ptm), O_RDWR | O_NOCTTY);
+    assert_true(pts >= 0);
+
+    modbus_rtu_config_st cfg = line_config(baud, MODBUS_STREAM_RTU_RESPONSE);
+    assert_int_equal(modbus_rtu_init(master, ptm, &cfg), 0);
+    cfg.rx_mode = MODBUS_STREAM_RTU_REQUEST;
+    assert_int_equal(modbus_rtu_init(slave, pts, &cfg), 0);
+}
+
+static int read_regs(void *arg, uint8_t unit_id, uint16_t start_addr, uint16_t qty, uint16_t *regs) {
+    (void) arg;
+    (void) unit_id;
+    for (uint16_t i = 0; i < qty; i++) {
+        regs[i] = (uint16_t)(start_addr + i);
+    }
+    return 0;
+}
+
+// Answers requests until the master side hangs up
+typedef struct {
+    modbus_rtu_st rtu;
+    modbus_slave_ctx_st ctx;
+    long delay_ms;
+    volatile uint32_t served;
+} slave_st;
+
+static void *slave_main(void *arg) {
+    slave_st *s = arg;
+    modbus_register_map_st map = {.read_holding = read_regs};
+    uint8_t request[MODBUS_RTU_MAX_ADU_SIZE], response[MODBUS_RTU_MAX_ADU_SIZE];
+
+    for (;;) {
+        int n = modbus_rtu_recv(&s->rtu, request, sizeof(request), 0);
+        if (n < 0) {
+            break;
+        }
+        int r = modbus_slave_handle_request(&s->ctx, &map, request, (size_t)n, response, sizeof(response));
+        if (r > 0) {
+            if (s->delay_ms) {
+                sleep_ms(s->delay_ms);
+            }
+            modbus_rtu_send(&s->rtu, response, (size_t)r);
+        }
+        s->served++;
+    }
+    return NULL;
+}
+
+static void start_slave(slave_st *s, pthread_t *thread) {
+    modbus_slave_ctx_init(&s->ctx);
+    set_device_slave_id(&s->ctx, SLAVE_ID);
+    assert_int_equal(pthread_create(thread, NULL, slave_main, s), 0);
+}
+
+static void test_init_errors(void **state) {
+    (void) state;
+    modbus_rtu_st rtu;
+    modbus_rtu_config_st cfg = line_config(9600, MODBUS_STREAM_RTU_RESPONSE);
+    int fds[2];
+
+    assert_int_equal(modbus_rtu_open(NULL, "/dev/null", &cfg), -1);
+    assert_int_equal(modbus_rtu_open(&rtu, NULL, &cfg), -1);
+    assert_int_equal(modbus_rtu_open(&rtu, "/nonexistent/ttyS0", &cfg), -2);
+    assert_int_equal(modbus_rtu_init(&rtu, -1, &cfg), -1);
+
+    // Invalid settings; the descriptor is closed anyway
+    cfg.baud = 12345;
+    assert_int_equal(pipe(fds), 0);
+    close(fds[1]);
+    assert_int_equal(modbus_rtu_init(&rtu, fds[0], &cfg), -1);
+    assert_int_equal(fcntl(fds[0], F_GETFD), -1);
+    cfg = line_config(9600, MODBUS_STREAM_RTU_RESPONSE);
+    cfg.parity = 'X';
+    assert_int_equal(modbus_rtu_init(&rtu, dup(0), &cfg), -1);
+    cfg.parity = 'N';
+    cfg.stop_bits = 3;
+    assert_int_equal(modbus_rtu_init(&rtu, dup(0), &cfg), -1);
+    cfg.stop_bits = 1;
+    cfg.rx_mode = MODBUS_STREAM_TCP;
+    assert_int_equal(modbus_rtu_init(&rtu, dup(0), &cfg), -1);
+
+    // Not a terminal
+    cfg.rx_mode = MODBUS_STREAM_RTU_RESPONSE;
+    assert_int_equal(pipe(fds), 0);
+    close(fds[1]);
+    assert_int_equal(modbus_rtu_init(&rtu, fds[0], &cfg), -3);
+    assert_int_equal(rtu.fd, -1);
+
+    assert_int_equal(modbus_rtu_send(NULL, (const uint8_t *)"x", 1), -1);
+    assert_int_equal(modbus_rtu_recv(NULL, (uint8_t *)fds, 1, 0), -1);
+    assert_int_equal(modbus_rtu_transact(NULL, (const uint8_t *)"x", 1, (uint8_t *)fds, 1), -1);
+    modbus_rtu_close(NULL);
+}
+
+static void test_character_timing(void **state) {
+    (void) state;
+    modbus_rtu_st master, slave;
+
+    // 9600 8N1: 10 bits per character
+    open_line(9600, &master, &slave);
+    assert_int_equal(master.char_ns, 1041666);
+    assert_int_equal(master.t15_ns, 1562499);
+    assert_int_equal(master.t35_ns, 3645831);
+    modbus_rtu_close(&master);
+    modbus_rtu_close(&slave);
+
+    // Above 19200 baud the silences are fixed
+    open_line(115200, &master, &slave);
+    assert_int_equal(master.char_ns, 86805);
+    assert_int_equal(master.t15_ns, MODBUS_RTU_T15_FIXED_NS);
+    assert_int_equal(master.t35_ns, MODBUS_RTU_T35_FIXED_NS);
+    modbus_rtu_close(&master);
+    modbus_rtu_close(&slave);
+
+    // 8E1 is 11 bits, 8O2 is 12
+    modbus_rtu_config_st cfg = line_config(9600, MODBUS_STREAM_RTU_RESPONSE);
+    cfg.parity = 'E';
+    assert_int_equal(modbus_rtu_init(&master, posix_openpt(O_RDWR | O_NOCTTY), &cfg), 0);
+    assert_int_equal(master.char_ns, 1145833);
+    assert_int_equal(master.t35_ns, 4010415);
+    modbus_rtu_close(&master);
+    cfg.parity = 'O';
+    cfg.stop_bits = 2;
+    assert_int_equal(modbus_rtu_init(&master, posix_openpt(O_RDWR | O_NOCTTY), &cfg), 0);
+    assert_int_equal(master.char_ns, 1250000);
+    modbus_rtu_close(&master);
+}
+
+static void test_end_of_frame(void **state) {
+    (void) state;
+    modbus_rtu_st master, slave;
+    modbus_master_ctx_st ctx;
+    uint8_t request[REQUEST_LEN + 2], buf[MODBUS_RTU_MAX_ADU_SIZE];
+
+    open_line(9600, &master, &slave);
+    modbus_master_ctx_init(&ctx);
+    assert_int_equal(encode_read_request(&ctx, SLAVE_ID, 0, QTY, request, sizeof(request)), REQUEST_LEN);
+
+    // A frame whose length is known ends with its last byte. Its receive
+    // time is not bounded here: a loaded host can stall for longer than t3.5
+    uint64_t start = now_ns();
+    assert_int_equal(modbus_rtu_send(&master, request, REQUEST_LEN), 0);
+    assert_true(now_ns() - start >= REQUEST_LEN * master.char_ns);
+    assert_int_equal(modbus_rtu_recv(&slave, buf, sizeof(buf), 100000), REQUEST_LEN);
+    assert_memory_equal(buf, request, REQUEST_LEN);
+
+    // An unknown function code ends on t3.5 of silence
+    const uint8_t unknown[] = {SLAVE_ID, 0x41, 0x12, 0x34, 0x56};
+    assert_int_equal(modbus_rtu_send(&master, unknown, sizeof(unknown)), 0);
+    start = now_ns();
+    assert_int_equal(modbus_rtu_recv(&slave, buf, sizeof(buf), 100000), sizeof(unknown));
+    assert_true(now_ns() - start >= slave.t35_ns);
+    assert_memory_equal(buf, unknown, sizeof(unknown));
+
+    // A frame that stops short also ends on t3.5 of silence; the rest is another frame
+    assert_int_equal(modbus_rtu_send(&master, request, 3), 0);
+    assert_int_equal(modbus_rtu_recv(&slave, buf, sizeof(buf), 100000), 3);
+    assert_int_equal(modbus_rtu_send(&master, request + 3, REQUEST_LEN - 3), 0);
+    assert_true(modbus_rtu_recv(&slave, buf, sizeof(buf), 100000) > 0);
+
+    // Bytes behind a complete frame are dropped
+    uint64_t dropped = slave.stats.dropped_bytes;
+    request[REQUEST_LEN] = 0xAA;
+    request[REQUEST_LEN + 1] = 0x55;
+    assert_int_equal(modbus_rtu_send(&master, request, REQUEST_LEN + 2), 0);
+    assert_int_equal(modbus_rtu_recv(&slave, buf, sizeof(buf), 100000), REQUEST_LEN);
+    assert_int_equal(slave.stats.dropped_bytes, dropped + 2);
+
+    // A frame longer than the buffer
+    assert_int_equal(modbus_rtu_send(&master, request, REQUEST_LEN), 0);
+    assert_int_equal(modbus_rtu_recv(&slave, buf, 4, 100000), -3);
+
+    // Silence, then hang-up
+    assert_int_equal(modbus_rtu_recv(&slave, buf, sizeof(buf), 20000), 0);
+    assert_int_equal(slave.stats.timeouts, 1);
+    assert_int_equal(slave.stats.frames_received, 5);
+    modbus_rtu_close(&master);
+    assert_int_equal(modbus_rtu_recv(&slave, buf, sizeof(buf), 100000), -2);
+    modbus_rtu_close(&slave);
+}
+
+static void test_transact(void **state) {
+    (void) state;
+    slave_st s = {.delay_ms = 40};
+    modbus_rtu_st master;
+    modbus_master_ctx_st ctx;
+    pthread_t thread;
+    uint8_t request[REQUEST_LEN], response[MODBUS_RTU_MAX_ADU_SIZE];
+    uint16_t regs[QTY];
+
+    open_line(115200, &master, &s.rtu);
+    start_slave(&s, &thread);
+    modbus_master_ctx_init(&ctx);
+    master.response_timeout_us = 20000;
+
+    // The answer comes after the timeout
+    assert_int_equal(encode_read_request(&ctx, SLAVE_ID, 0, QTY, request, sizeof(request)), REQUEST_LEN);
+    assert_int_equal(modbus_rtu_transact(&master, request, REQUEST_LEN, response, sizeof(response)), 0);
+    assert_true(master.flush_input);
+    while (s.served < 1) {
+        sleep_ms(1);
+    }
+    sleep_ms(10);
+
+    // The late answer is flushed and not taken for the next one
+    s.delay_ms = 0;
+    master.response_timeout_us = 1000000;
+    assert_int_equal(encode_read_request(&ctx, SLAVE_ID, 5, QTY, request, sizeof(request)), REQUEST_LEN);
+    int n = modbus_rtu_transact(&master, request, REQUEST_LEN, response, sizeof(response));
+    assert_int_equal(n, RESPONSE_LEN);
+    assert_int_equal(master.stats.dropped_bytes, RESPONSE_LEN);
+    assert_int_equal(decode_read_response(&ctx, response, (size_t)n, regs, QTY), QTY);
+    assert_int_equal(regs[0], 5);
+
+    // A broadcast is not answered and holds the line for the turnaround delay
+    const uint16_t value = 7;
+    uint8_t pdu[MODBUS_MAX_PDU_SIZE];
+    uint8_t broadcast[16];
+    uint16_t len = modbus_pdu_encode_write_multiple(0, &value, 1, pdu, sizeof(pdu));
+    len = encode_rtu_request(&ctx, BROADCAST_SLAVE_ID, pdu, len, broadcast, sizeof(broadcast));
+    assert_true(len > 0);
+    assert_int_equal(modbus_rtu_transact(&master, broadcast, len, response, sizeof(response)), 0);
+    uint64_t start = now_ns();
+    assert_int_equal(encode_read_request(&ctx, SLAVE_ID, 0, QTY, request, sizeof(request)), REQUEST_LEN);
+    assert_int_equal(modbus_rtu_transact(&master, request, REQUEST_LEN, response, sizeof(response)), RESPONSE_LEN);
+    assert_true(now_ns() - start >= 20000000ull);
+
+    modbus_rtu_close(&master);
+    pthread_join(thread, NULL);
+    modbus_rtu_close(&s.rtu);
+}
+
+/*
+ * Back-to-back polls of 10 registers. Each cycle is the request and the
+ * response on the wire plus the two t3.5 silences, so the best possible
+ * utilisation is wire / (wire + 2 * t3.5). On the pseudo-terminal a frame
+ * may appear up to one character before its modelled start, hence the
+ * upper margin.
+ */
+static void run_utilisation(uint32_t baud, int transactions) {
+    slave_st s = {0};
+    modbus_rtu_st master;
+    modbus_master_ctx_st ctx;
+    pthread_t thread;
+    uint8_t request[REQUEST_LEN], response[MODBUS_RTU_MAX_ADU_SIZE];
+    uint16_t regs[QTY];
+
+    open_line(baud, &master, &s.rtu);
+    start_slave(&s, &thread);
+    modbus_master_ctx_init(&ctx);
+
+    uint64_t start = now_ns();
+    for (int i = 0; i < transactions; i++) {
+        assert_int_equal(encode_read_request(&ctx, SLAVE_ID, (uint16_t)i, QTY, request, sizeof(request)),
+                         REQUEST_LEN);
+        int n = modbus_rtu_transact(&master, request, REQUEST_LEN, response, sizeof(response));
+        assert_int_equal(n, RESPONSE_LEN);
+        assert_int_equal(decode_read_response(&ctx, response, (size_t)n, regs, QTY), QTY);
+        assert_int_equal(regs[0], i);
+    }
+    // The last response arrives at once on the pseudo-terminal; the line carries it until line_idle_ns
+    uint64_t elapsed = master.line_idle_ns - start;
+
+    double wire = (double)(REQUEST_LEN + RESPONSE_LEN) * (double)master.char_ns;
+    double ideal = wire / (wire + 2.0 * (double)master.t35_ns);
+    double measured = (double)master.stats.busy_ns / (double)elapsed;
+    assert_true(measured >= 0.85 * ideal);
+    assert_true(measured <= 1.1 * ideal);
+    assert_int_equal(master.stats.timeouts, 0);
+
+    modbus_rtu_close(&master);
+    pthread_join(thread, NULL);
+    assert_int_equal(s.served, transactions);
+    modbus_rtu_close(&s.rtu);
+}
+
+static void test_bus_utilisation(void **state) {
+    (void) state;
+    run_utilisation(9600, 10);
+    run_utilisation(115200, 100);
+}
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_init_errors),
+        cmocka_unit_test(test_character_timing),
+        cmocka_unit_test(test_end_of_frame),
+        cmocka_unit_test(test_transact),
+        cmocka_unit_test(test_bus_utilisation),
+    };
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
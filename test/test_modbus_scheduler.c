@@ -0,0 +1,412 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdint.h>
+#include <string.h>
+#include <cmocka.h>
+
+#include "modbus_scheduler.h"
+#include "modbus_slave.h"
+
+// 115200 baud, 11 bits per character; t3.5 is fixed at 1750 us above 19200 baud
+#define CHAR_US 95
+#define SILENCE_US 1750
+#define TURNAROUND_US 500
+#define TIMEOUT_US 100000
+#define SECOND_US 1000000ull
+#define SIM_GROUPS 8
+
+/**
+ * Simulated RS-485 bus: every exchange advances a fake clock by the time
+ * the request and response would take on the wire.
+ */
+typedef struct {
+    uint64_t now;
+    uint8_t dead_unit;
+    uint32_t change_us[16];
+    uint8_t log[64];
+    size_t logged;
+    modbus_slave_ctx_st slave;
+    modbus_register_map_st map;
+} fake_bus_st;
+
+static fake_bus_st bus;
+
+static uint64_t fake_now(void *arg) {
+    return ((fake_bus_st *)arg)->now;
+}
+
+static void fake_sleep(void *arg, uint64_t us) {
+    ((fake_bus_st *)arg)->now += us;
+}
+
+static int read_regs(void *arg, uint8_t unit_id, uint16_t start_addr, uint16_t qty, uint16_t *regs) {
+    (void) arg;
+    // Units with a change interval count their changes on top of the fixed pattern
+    uint32_t change_us = (unit_id < 16) ? bus.change_us[unit_id] : 0;
+    uint16_t changes = change_us ? (uint16_t)(bus.now / change_us) : 0;
+    for (uint16_t i = 0; i < qty; i++) {
+        regs[i] = (uint16_t)(unit_id * 1000 + start_addr + i + changes);
+    }
+    return 0;
+}
+
+static int fake_transact(void *arg, const uint8_t *request, size_t len, uint8_t *response, size_t size) {
+    fake_bus_st *fake = arg;
+    fake->now += len * CHAR_US + SILENCE_US;
+    if (fake->logged < sizeof(fake->log)) {
+        fake->log[fake->logged++] = request[0];
+    }
+
+    if (request[0] == fake->dead_unit) {
+        fake->now += TIMEOUT_US;
+        return 0;
+    }
+
+    set_device_slave_id(&fake->slave, request[0]);
+    int n = modbus_slave_handle_request(&fake->slave, &fake->map, request, len, response, size);
+    if (n > 0) {
+        fake->now += TURNAROUND_US + (uint64_t)n * CHAR_US + SILENCE_US;
+    }
+    return n;
+}
+
+static const modbus_transport_st transport = {.transact = fake_transact, .arg = &bus};
+static const modbus_clock_st clock = {.now_us = fake_now, .sleep_us = fake_sleep, .arg = &bus};
+
+static void on_data(void *arg, const modbus_scan_group_st *group, const uint16_t *regs, uint16_t qty) {
+    uint32_t *delivered = arg;
+    assert_int_equal(qty, group->cfg.qty);
+    assert_int_equal(regs[0], group->cfg.unit_id * 1000 + group->cfg.start_addr);
+    assert_int_equal(regs[qty - 1], group->cfg.unit_id * 1000 + group->cfg.start_addr + qty - 1);
+    (*delivered)++;
+}
+
+static void reset(void) {
+    memset(&bus, 0, sizeof(bus));
+    bus.now = 12345;
+    bus.map.read_holding = read_regs;
+    modbus_slave_ctx_init(&bus.slave);
+}
+
+static modbus_scan_group_config_st group(uint8_t unit_id, uint16_t qty, uint32_t period_us, uint32_t *delivered) {
+    return (modbus_scan_group_config_st){
+        .unit_id = unit_id,
+        .start_addr = 100,
+        .qty = qty,
+        .period_us = period_us,
+        .on_data = delivered ? on_data : NULL,
+        .arg = delivered,
+    };
+}
+
+static void test_init_errors(void **state) {
+    (void) state;
+    reset();
+    modbus_scheduler_st sched;
+    modbus_scan_group_st groups[1];
+    modbus_transport_st no_transact = {0};
+    modbus_clock_st half_clock = {.now_us = fake_now};
+
+    assert_int_equal(modbus_scheduler_init(NULL, groups, 1, &transport, &clock), -1);
+    assert_int_equal(modbus_scheduler_init(&sched, NULL, 1, &transport, &clock), -1);
+    assert_int_equal(modbus_scheduler_init(&sched, groups, 0, &transport, &clock), -1);
+    assert_int_equal(modbus_scheduler_init(&sched, groups, 1, &no_transact, &clock), -1);
+    assert_int_equal(modbus_scheduler_init(&sched, groups, 1, &transport, &half_clock), -1);
+
+    // Default clock is monotonic
+    assert_int_equal(modbus_scheduler_init(&sched, groups, 1, &transport, NULL), 0);
+    assert_true(modbus_scheduler_now(&sched) > 0);
+
+    assert_int_equal(modbus_scheduler_init(&sched, groups, 1, &transport, &clock), 0);
+    modbus_scan_group_config_st cfg = group(1, 10, 1000, NULL);
+    assert_int_equal(modbus_scheduler_add(NULL, &cfg), -1);
+    assert_int_equal(modbus_scheduler_add(&sched, NULL), -1);
+    cfg.unit_id = 0;
+    assert_int_equal(modbus_scheduler_add(&sched, &cfg), -2);
+    cfg.unit_id = 1;
+    cfg.qty = MODBUS_MAX_REGS + 1;
+    assert_int_equal(modbus_scheduler_add(&sched, &cfg), -2);
+    cfg.qty = 10;
+    cfg.period_us = 0;
+    assert_int_equal(modbus_scheduler_add(&sched, &cfg), -2);
+    cfg.period_us = 1000;
+
+    // An adaptive range needs a min and must hold the first period
+    cfg.max_period_us = 5000;
+    assert_int_equal(modbus_scheduler_add(&sched, &cfg), -2);
+    cfg.min_period_us = 2000;
+    assert_int_equal(modbus_scheduler_add(&sched, &cfg), -2);
+    cfg.min_period_us = 500;
+    cfg.max_period_us = 800;
+    assert_int_equal(modbus_scheduler_add(&sched, &cfg), -2);
+    cfg.max_period_us = 5000;
+    assert_int_equal(modbus_scheduler_add(&sched, &cfg), 0);
+    assert_int_equal(modbus_scheduler_add(&sched, &cfg), -3);
+
+    assert_int_equal(modbus_scheduler_poll(NULL, NULL), -1);
+    assert_int_equal(modbus_scheduler_run(NULL, 0), -1);
+    modbus_scheduler_stop(NULL);
+}
+
+static void test_deadlines_met(void **state) {
+    (void) state;
+    reset();
+    modbus_scheduler_st sched;
+    modbus_scan_group_st groups[4];
+    uint32_t delivered[4] = {0};
+
+    // About 16% of the bus: every group must keep its rate with no overrun
+    assert_int_equal(modbus_scheduler_init(&sched, groups, 4, &transport, &clock), 0);
+    modbus_scan_group_config_st cfgs[4] = {
+        group(4, MODBUS_MAX_REGS, SECOND_US, &delivered[0]),
+        group(3, 60, 200000, &delivered[1]),
+        group(1, 2, 50000, &delivered[2]),
+        group(2, 2, 50000, &delivered[3]),
+    };
+    for (int i = 0; i < 4; i++) {
+        assert_int_equal(modbus_scheduler_add(&sched, &cfgs[i]), i);
+    }
+
+    uint64_t start = bus.now;
+    int64_t transactions = modbus_scheduler_run(&sched, start + 10 * SECOND_US);
+    assert_int_equal(transactions, 10 + 50 + 200 + 200);
+    assert_true(bus.now >= start + 10 * SECOND_US);
+
+    for (int i = 0; i < 4; i++) {
+        assert_int_equal(groups[i].stats.polls, delivered[i]);
+        assert_int_equal(groups[i].stats.overruns, 0);
+        assert_int_equal(groups[i].stats.skipped, 0);
+        assert_int_equal(groups[i].stats.failures, 0);
+    }
+    assert_int_equal(delivered[2], 200);
+
+    // The earliest deadline goes first: fast groups before the slow ones at t=0
+    assert_int_equal(bus.log[0], 1);
+    assert_int_equal(bus.log[1], 2);
+    assert_int_equal(bus.log[2], 3);
+    assert_int_equal(bus.log[3], 4);
+
+    // A fast group waits at most for one transaction of the longest group
+    uint32_t longest = (8 + 5 + MODBUS_MAX_REGS * 2) * CHAR_US + 2 * SILENCE_US + TURNAROUND_US;
+    assert_true(groups[2].stats.jitter_max_us <= longest);
+    assert_true(groups[3].stats.jitter_max_us <= 2 * longest);
+}
+
+static void test_slow_group_cannot_starve_fast(void **state) {
+    (void) state;
+    reset();
+    modbus_scheduler_st sched;
+    modbus_scan_group_st groups[3];
+
+    // Two long reads with tight periods overload the bus
+    assert_int_equal(modbus_scheduler_init(&sched, groups, 3, &transport, &clock), 0);
+    modbus_scan_group_config_st slow_a = group(5, MODBUS_MAX_REGS, 40000, NULL);
+    modbus_scan_group_config_st slow_b = group(6, MODBUS_MAX_REGS, 40000, NULL);
+    modbus_scan_group_config_st fast = group(1, 2, 10000, NULL);
+    assert_int_equal(modbus_scheduler_add(&sched, &slow_a), 0);
+    assert_int_equal(modbus_scheduler_add(&sched, &slow_b), 1);
+    assert_int_equal(modbus_scheduler_add(&sched, &fast), 2);
+
+    modbus_scheduler_run(&sched, bus.now + 10 * SECOND_US);
+
+    // The fast group keeps running at a useful rate, and nobody builds a backlog
+    const modbus_scan_stats_st *fs = &groups[2].stats;
+    assert_true(fs->polls >= 10 * SECOND_US / 10000 / 4);
+    for (int i = 0; i < 3; i++) {
+        const modbus_scan_group_st *g = &groups[i];
+        assert_true(g->stats.polls > 0);
+        assert_true(g->stats.skipped > 0);
+        assert_true(g->stats.jitter_max_us < g->cfg.period_us + 2 * 30000);
+        // Each period is either polled once or skipped once
+        uint64_t periods = 10 * SECOND_US / g->cfg.period_us;
+        assert_true(g->stats.polls + g->stats.skipped <= periods + 1);
+        assert_true(g->stats.polls + g->stats.skipped + 2 >= periods);
+    }
+}
+
+static void test_failures_and_timeouts(void **state) {
+    (void) state;
+    reset();
+    modbus_scheduler_st sched;
+    modbus_scan_group_st groups[2];
+    uint32_t delivered[2] = {0};
+
+    bus.dead_unit = 9;
+    assert_int_equal(modbus_scheduler_init(&sched, groups, 2, &transport, &clock), 0);
+    modbus_scan_group_config_st dead = group(9, 10, 500000, &delivered[0]);
+    modbus_scan_group_config_st live = group(1, 10, 200000, &delivered[1]);
+    assert_int_equal(modbus_scheduler_add(&sched, &dead), 0);
+    assert_int_equal(modbus_scheduler_add(&sched, &live), 1);
+
+    modbus_scheduler_run(&sched, bus.now + SECOND_US);
+
+    assert_int_equal(groups[0].stats.polls, 2);
+    assert_int_equal(groups[0].stats.failures, 2);
+    assert_int_equal(delivered[0], 0);
+    assert_int_equal(groups[1].stats.failures, 0);
+    assert_int_equal(delivered[1], groups[1].stats.polls);
+    assert_int_equal(delivered[1], 5);
+}
+
+static void test_priority_breaks_ties(void **state) {
+    (void) state;
+    reset();
+    modbus_scheduler_st sched;
+    modbus_scan_group_st groups[3];
+    uint64_t wait;
+
+    assert_int_equal(modbus_scheduler_init(&sched, groups, 3, &transport, &clock), 0);
+    modbus_scan_group_config_st cfgs[3] = {
+        group(1, 1, 100000, NULL), group(2, 1, 100000, NULL), group(3, 1, 100000, NULL),
+    };
+    cfgs[1].priority = 2;
+    cfgs[2].priority = 1;
+    for (int i = 0; i < 3; i++) {
+        modbus_scheduler_add(&sched, &cfgs[i]);
+    }
+
+    assert_int_equal(modbus_scheduler_poll(&sched, &wait), 1);
+    assert_int_equal(modbus_scheduler_poll(&sched, &wait), 2);
+    assert_int_equal(modbus_scheduler_poll(&sched, &wait), 0);
+
+    // Nothing released until the next period
+    uint64_t elapsed = bus.now - 12345;
+    assert_int_equal(modbus_scheduler_poll(&sched, &wait), -2);
+    assert_int_equal(wait, 100000 - elapsed);
+}
+
+/**
+ * Detection latency of every register change: how long after the change
+ * a poll delivered it.
+ */
+typedef struct {
+    uint32_t change_us;
+    uint16_t seen;
+    uint64_t detected;
+    uint64_t latency_sum;
+    uint64_t latency_max;
+} freshness_st;
+
+static void track_changes(void *arg, const modbus_scan_group_st *group, const uint16_t *regs, uint16_t qty) {
+    freshness_st *f = arg;
+    (void) qty;
+    uint16_t changes = (uint16_t)(regs[0] - (group->cfg.unit_id * 1000 + group->cfg.start_addr));
+    for (uint16_t k = (uint16_t)(f->seen + 1); k <= changes; k++) {
+        uint64_t latency = bus.now - (uint64_t)k * f->change_us;
+        f->detected++;
+        f->latency_sum += latency;
+        if (latency > f->latency_max) {
+            f->latency_max = latency;
+        }
+    }
+    f->seen = changes;
+}
+
+static int64_t simulate_plant(bool adaptive, modbus_scan_group_st *groups, freshness_st *fresh) {
+    // One block that changes every cycle, one every second, one twice a minute, five that never do
+    static const uint32_t change_us[SIM_GROUPS] = {10000, 1000000, 30000000, 0, 0, 0, 0, 0};
+    modbus_scheduler_st sched;
+
+    reset();
+    assert_int_equal(modbus_scheduler_init(&sched, groups, SIM_GROUPS, &transport, &clock), 0);
+    for (int i = 0; i < SIM_GROUPS; i++) {
+        uint8_t unit_id = (uint8_t)(i + 1);
+        bus.change_us[unit_id] = change_us[i];
+        fresh[i] = (freshness_st){
+            .change_us = change_us[i],
+            .seen = change_us[i] ? (uint16_t)(bus.now / change_us[i]) : 0,
+        };
+
+        modbus_scan_group_config_st cfg = group(unit_id, 10, 100000, NULL);
+        cfg.on_data = track_changes;
+        cfg.arg = &fresh[i];
+        if (adaptive) {
+            cfg.min_period_us = 25000;
+            cfg.max_period_us = 5 * SECOND_US;
+        }
+        assert_int_equal(modbus_scheduler_add(&sched, &cfg), i);
+    }
+    return modbus_scheduler_run(&sched, bus.now + 60 * SECOND_US);
+}
+
+static void test_adaptive_periods_save_bus_time(void **state) {
+    (void) state;
+    modbus_scan_group_st fixed_groups[SIM_GROUPS];
+    modbus_scan_group_st groups[SIM_GROUPS];
+    freshness_st fixed_fresh[SIM_GROUPS];
+    freshness_st fresh[SIM_GROUPS];
+
+    int64_t fixed_requests = simulate_plant(false, fixed_groups, fixed_fresh);
+    int64_t requests = simulate_plant(true, groups, fresh);
+
+    // Quiet blocks back off to the max period, the busy one gets the min
+    assert_int_equal(groups[0].period_us, 25000);
+    for (int i = 3; i < SIM_GROUPS; i++) {
+        assert_int_equal(groups[i].period_us, 5 * SECOND_US);
+        assert_int_equal(groups[i].stats.changes, 0);
+    }
+    assert_true(groups[1].period_us > 25000);
+    assert_true(groups[1].period_us < SECOND_US);
+    assert_true(groups[0].stats.polls > 2 * fixed_groups[0].stats.polls);
+
+    // Well under two thirds of the requests
+    assert_true(requests * 3 < fixed_requests * 2);
+
+    // Every change is still seen, and on average sooner
+    uint64_t fixed_detected = 0, fixed_latency = 0, detected = 0, latency = 0;
+    for (int i = 0; i < SIM_GROUPS; i++) {
+        fixed_detected += fixed_fresh[i].detected;
+        fixed_latency += fixed_fresh[i].latency_sum;
+        detected += fresh[i].detected;
+        latency += fresh[i].latency_sum;
+        assert_int_equal(groups[i].stats.failures, 0);
+        assert_int_equal(groups[i].stats.overruns, 0);
+    }
+    assert_true(detected + 10 >= fixed_detected);
+    assert_true(latency / detected <= fixed_latency / fixed_detected);
+    assert_true(fresh[0].latency_max <= fixed_fresh[0].latency_max);
+    assert_true(fresh[2].latency_max <= 5 * SECOND_US + 10000);
+}
+
+static void stop_on_data(void *arg, const modbus_scan_group_st *group, const uint16_t *regs, uint16_t qty) {
+    (void) group;
+    (void) regs;
+    (void) qty;
+    modbus_scheduler_stop(arg);
+}
+
+static void test_stop(void **state) {
+    (void) state;
+    reset();
+    modbus_scheduler_st sched;
+    modbus_scan_group_st groups[1];
+    uint64_t wait;
+
+    assert_int_equal(modbus_scheduler_init(&sched, groups, 1, &transport, &clock), 0);
+    modbus_scan_group_config_st cfg = group(1, 1, 1000, NULL);
+    cfg.on_data = stop_on_data;
+    cfg.arg = &sched;
+    modbus_scheduler_add(&sched, &cfg);
+    assert_int_equal(modbus_scheduler_run(&sched, bus.now + SECOND_US), 1);
+
+    // Without groups there is nothing to wait for
+    modbus_scheduler_init(&sched, groups, 1, &transport, &clock);
+    assert_int_equal(modbus_scheduler_poll(&sched, &wait), -2);
+    assert_int_equal(wait, UINT64_MAX);
+    assert_int_equal(modbus_scheduler_run(&sched, bus.now + SECOND_US), 0);
+}
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_init_errors),
+        cmocka_unit_test(test_deadlines_met),
+        cmocka_unit_test(test_slow_group_cannot_starve_fast),
+        cmocka_unit_test(test_failures_and_timeouts),
+        cmocka_unit_test(test_priority_breaks_ties),
+        cmocka_unit_test(test_adaptive_periods_save_bus_time),
+        cmocka_unit_test(test_stop),
+    };
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
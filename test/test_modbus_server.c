@@ -0,0 +1,555 @@
+#define _GNU_SOURCE
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <cmocka.h>
+
+#include "modbus_server.h"
+#include "modbus_tcp.h"
+
+#define SLAVE_ID 1
+
+static int read_regs(void *arg, uint8_t unit_id, uint16_t start_addr, uint16_t qty, uint16_t *regs) {
+    (void) unit_id;
+    int *calls = arg;
+    if (calls) {
+        (*calls)++;
+    }
+    for (uint16_t i = 0; i < qty; i++) {
+        regs[i] = (uint16_t)(start_addr + i);
+    }
+    return 0;
+}
+
+static int read_wire(void *arg, uint8_t unit_id, uint16_t start_addr, uint16_t qty, uint8_t *dst) {
+    uint16_t regs[MODBUS_MAX_REGS];
+    read_regs(arg, unit_id, start_addr, qty, regs);
+    for (uint16_t i = 0; i < qty; i++) {
+        dst[2 * i] = (uint8_t)(regs[i] >> 8);
+        dst[2 * i + 1] = (uint8_t)regs[i];
+    }
+    return 0;
+}
+
+static void start_server(modbus_server_st *srv, uint32_t max_connections, void *arg) {
+    modbus_server_config_st cfg = {
+        .bind_addr = "127.0.0.1",
+        .max_connections = max_connections,
+        .slave_id = SLAVE_ID,
+        .read_cb = read_regs,
+        .read_arg = arg,
+    };
+    assert_int_equal(modbus_server_init(srv, &cfg), 0);
+    assert_int_not_equal(modbus_server_port(srv), 0);
+}
+
+static int connect_client(const modbus_server_st *srv) {
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(modbus_server_port(srv));
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    assert_true(fd >= 0);
+    assert_int_equal(connect(fd, (struct sockaddr *)&addr, sizeof(addr)), 0);
+    return fd;
+}
+
+// Drive the server until the client has received exactly len bytes
+static void recv_all(modbus_server_st *srv, int fd, uint8_t *buf, size_t len) {
+    size_t got = 0;
+    for (int spins = 0; got < len && spins < 10000; spins++) {
+        modbus_server_poll(srv, 1);
+        ssize_t n = recv(fd, buf + got, len - got, MSG_DONTWAIT);
+        if (n > 0) {
+            got += (size_t)n;
+        }
+    }
+    assert_int_equal(got, len);
+}
+
+static void check_response(modbus_tcp_master_ctx_st *master, const uint8_t *adu, size_t len, uint16_t start) {
+    uint16_t regs[MODBUS_MAX_REGS];
+    int ret = decode_tcp_read_response(master, adu, len, regs, MODBUS_MAX_REGS, NULL);
+    assert_true(ret > 0);
+    for (int i = 0; i < ret; i++) {
+        assert_int_equal(regs[i], start + i);
+    }
+}
+
+static void test_init_errors(void **state) {
+    (void) state;
+    modbus_server_st srv;
+    modbus_server_config_st cfg = {.max_connections = 1, .slave_id = SLAVE_ID, .read_cb = read_regs};
+
+    assert_int_equal(modbus_server_init(NULL, &cfg), -1);
+    assert_int_equal(modbus_server_init(&srv, NULL), -1);
+    cfg.read_cb = NULL;
+    assert_int_equal(modbus_server_init(&srv, &cfg), -1);
+    cfg.read_cb = read_regs;
+    cfg.slave_id = BROADCAST_SLAVE_ID;
+    assert_int_equal(modbus_server_init(&srv, &cfg), -1);
+    cfg.slave_id = SLAVE_ID;
+    cfg.max_connections = 0;
+    assert_int_equal(modbus_server_init(&srv, &cfg), -1);
+    cfg.max_connections = 1;
+    cfg.bind_addr = "not an address";
+    assert_int_equal(modbus_server_init(&srv, &cfg), -1);
+}
+
+static void test_many_pipelined_clients(void **state) {
+    (void) state;
+    enum { CLIENTS = 64, DEPTH = 4, QTY = 10 };
+    modbus_server_st srv;
+    int calls = 0;
+    start_server(&srv, CLIENTS, &calls);
+
+    int fds[CLIENTS];
+    modbus_tcp_master_ctx_st masters[CLIENTS];
+    for (int c = 0; c < CLIENTS; c++) {
+        fds[c] = connect_client(&srv);
+        modbus_tcp_master_ctx_init(&masters[c], DEPTH);
+
+        // Send the window in one write, split at an awkward offset
+        uint8_t batch[DEPTH * 12];
+        size_t len = 0;
+        for (int d = 0; d < DEPTH; d++) {
+            len += encode_tcp_read_request(&masters[c], SLAVE_ID, (uint16_t)(c * 100 + d * QTY), QTY,
+                                           batch + len, sizeof(batch) - len, NULL);
+        }
+        assert_int_equal(send(fds[c], batch, 5, 0), 5);
+        modbus_server_poll(&srv, 0);
+        assert_int_equal(send(fds[c], batch + 5, len - 5, 0), (ssize_t)(len - 5));
+    }
+
+    const size_t resp_len = MODBUS_MBAP_HEADER_SIZE + 2 + QTY * 2;
+    for (int c = 0; c < CLIENTS; c++) {
+        uint8_t resp[DEPTH * (MODBUS_MBAP_HEADER_SIZE + 2 + QTY * 2)];
+        recv_all(&srv, fds[c], resp, sizeof(resp));
+        for (int d = 0; d < DEPTH; d++) {
+            check_response(&masters[c], resp + d * resp_len, resp_len, (uint16_t)(c * 100 + d * QTY));
+        }
+        assert_int_equal(modbus_tcp_master_outstanding(&masters[c]), 0);
+    }
+
+    assert_int_equal(srv.active, CLIENTS);
+    assert_int_equal(srv.stats.requests, CLIENTS * DEPTH);
+    assert_int_equal(calls, CLIENTS * DEPTH);
+
+    for (int c = 0; c < CLIENTS; c++) {
+        close(fds[c]);
+    }
+    for (int spins = 0; srv.active > 0 && spins < 1000; spins++) {
+        modbus_server_poll(&srv, 1);
+    }
+    assert_int_equal(srv.active, 0);
+    assert_int_equal(srv.stats.closed, CLIENTS);
+    modbus_server_deinit(&srv);
+}
+
+static void test_backpressure(void **state) {
+    (void) state;
+    // Far more requests than the receive ring and transmit buffer can hold at once
+    enum { REQUESTS = 200 };
+    modbus_server_st srv;
+    start_server(&srv, 1, NULL);
+
+    int fd = connect_client(&srv);
+    modbus_tcp_master_ctx_st master;
+    modbus_tcp_master_ctx_init(&master, MODBUS_TCP_MAX_PIPELINE);
+
+    uint8_t batch[REQUESTS * 12];
+    size_t len = 0;
+    uint16_t tid;
+    for (int i = 0; i < REQUESTS; i++) {
+        len += encode_tcp_read_request(&master, SLAVE_ID, (uint16_t)i, MODBUS_MAX_REGS, batch + len,
+                                       sizeof(batch) - len, &tid);
+        modbus_tcp_master_cancel(&master, tid);
+    }
+    assert_int_equal(send(fd, batch, len, 0), (ssize_t)len);
+
+    const size_t resp_len = MODBUS_MBAP_HEADER_SIZE + 2 + MODBUS_MAX_REGS * 2;
+    static uint8_t resp[REQUESTS * (MODBUS_MBAP_HEADER_SIZE + 2 + MODBUS_MAX_REGS * 2)];
+    recv_all(&srv, fd, resp, sizeof(resp));
+    for (int i = 0; i < REQUESTS; i++) {
+        // Responses come back in request order; the first register echoes the start address
+        const uint8_t *adu = resp + i * resp_len;
+        assert_int_equal(decode_mbap_header(adu, resp_len, NULL, NULL, NULL), (int)resp_len);
+        assert_int_equal((adu[9] << 8) | adu[10], i);
+    }
+    assert_int_equal(srv.stats.requests, REQUESTS);
+
+    close(fd);
+    modbus_server_deinit(&srv);
+}
+
+static void test_pool_exhausted(void **state) {
+    (void) state;
+    modbus_server_st srv;
+    start_server(&srv, 2, NULL);
+
+    int a = connect_client(&srv);
+    int b = connect_client(&srv);
+    int c = connect_client(&srv);
+    for (int spins = 0; srv.stats.rejected == 0 && spins < 1000; spins++) {
+        modbus_server_poll(&srv, 1);
+    }
+    assert_int_equal(srv.stats.accepted, 2);
+    assert_int_equal(srv.stats.rejected, 1);
+
+    uint8_t byte;
+    assert_int_equal(recv(c, &byte, 1, 0), 0);
+
+    close(a);
+    close(b);
+    close(c);
+    modbus_server_deinit(&srv);
+}
+
+static void test_invalid_request_dropped(void **state) {
+    (void) state;
+    modbus_server_st srv;
+    start_server(&srv, 1, NULL);
+    int fd = connect_client(&srv);
+
+    modbus_tcp_master_ctx_st master;
+    modbus_tcp_master_ctx_init(&master, 2);
+
+    uint8_t bad[12], good[12];
+    uint16_t tid;
+    encode_tcp_read_request(&master, SLAVE_ID + 1, 0, 1, bad, sizeof(bad), &tid);
+    modbus_tcp_master_cancel(&master, tid);
+    encode_tcp_read_request(&master, SLAVE_ID, 7, 1, good, sizeof(good), NULL);
+    send(fd, bad, sizeof(bad), 0);
+    send(fd, good, sizeof(good), 0);
+
+    uint8_t resp[MODBUS_MBAP_HEADER_SIZE + 4];
+    recv_all(&srv, fd, resp, sizeof(resp));
+    check_response(&master, resp, sizeof(resp), 7);
+    assert_int_equal(srv.stats.errors, 1);
+    assert_int_equal(srv.stats.requests, 1);
+
+    close(fd);
+    modbus_server_deinit(&srv);
+}
+
+static void test_wire_callback(void **state) {
+    (void) state;
+    modbus_server_st srv;
+    int calls = 0;
+    modbus_server_config_st cfg = {
+        .bind_addr = "127.0.0.1",
+        .max_connections = 1,
+        .slave_id = SLAVE_ID,
+        .read_wire_cb = read_wire,
+        .read_arg = &calls,
+    };
+    assert_int_equal(modbus_server_init(&srv, &cfg), 0);
+    int fd = connect_client(&srv);
+
+    modbus_tcp_master_ctx_st master;
+    modbus_tcp_master_ctx_init(&master, 1);
+    uint8_t req[12];
+    encode_tcp_read_request(&master, SLAVE_ID, 300, MODBUS_MAX_REGS, req, sizeof(req), NULL);
+    send(fd, req, sizeof(req), 0);
+
+    uint8_t resp[MODBUS_MBAP_HEADER_SIZE + 2 + MODBUS_MAX_REGS * 2];
+    recv_all(&srv, fd, resp, sizeof(resp));
+    check_response(&master, resp, sizeof(resp), 300);
+    assert_int_equal(calls, 1);
+
+    close(fd);
+    modbus_server_deinit(&srv);
+}
+
+static int failing_read(void *arg, uint8_t unit_id, uint16_t start_addr, uint16_t qty, uint16_t *regs) {
+    return (start_addr >= 1000) ? -1 : read_regs(arg, unit_id, start_addr, qty, regs);
+}
+
+static int failing_wire(void *arg, uint8_t unit_id, uint16_t start_addr, uint16_t qty, uint8_t *dst) {
+    return (start_addr >= 1000) ? -1 : read_wire(arg, unit_id, start_addr, qty, dst);
+}
+
+// Send a raw 0x03 PDU and expect the given exception code
+static void expect_read_exception(modbus_server_st *srv, int fd, modbus_tcp_master_ctx_st *master, uint16_t addr,
+                                  uint16_t qty, uint8_t code) {
+    uint8_t pdu[5] = {MODBUS_READ_HOLDING_REG, (uint8_t)(addr >> 8), (uint8_t)addr, (uint8_t)(qty >> 8),
+                      (uint8_t)qty};
+    uint8_t req[MODBUS_TCP_MAX_ADU_SIZE], resp[MODBUS_MBAP_HEADER_SIZE + 2];
+    uint16_t len = encode_tcp_request(master, SLAVE_ID, pdu, sizeof(pdu), req, sizeof(req), NULL);
+    assert_int_not_equal(len, 0);
+    send(fd, req, len, 0);
+    recv_all(srv, fd, resp, sizeof(resp));
+    assert_int_equal(decode_tcp_response(master, resp, sizeof(resp), NULL, 0, NULL), -8);
+    assert_int_equal(resp[MODBUS_MBAP_HEADER_SIZE], MODBUS_READ_HOLDING_REG | MODBUS_EXCEPTION_FLAG);
+    assert_int_equal(resp[MODBUS_MBAP_HEADER_SIZE + 1], code);
+}
+
+static void test_read_exceptions(void **state) {
+    (void) state;
+
+    // Both register source kinds answer a bad read the same way
+    for (int wire = 0; wire < 2; wire++) {
+        modbus_server_st srv;
+        modbus_server_config_st cfg = {
+            .bind_addr = "127.0.0.1",
+            .max_connections = 1,
+            .slave_id = SLAVE_ID,
+            .read_cb = wire ? NULL : failing_read,
+            .read_wire_cb = wire ? failing_wire : NULL,
+        };
+        assert_int_equal(modbus_server_init(&srv, &cfg), 0);
+        int fd = connect_client(&srv);
+
+        modbus_tcp_master_ctx_st master;
+        modbus_tcp_master_ctx_init(&master, 1);
+        expect_read_exception(&srv, fd, &master, 0, 0, MODBUS_EX_ILLEGAL_DATA_VALUE);
+        expect_read_exception(&srv, fd, &master, 0, MODBUS_MAX_REGS + 1, MODBUS_EX_ILLEGAL_DATA_VALUE);
+        expect_read_exception(&srv, fd, &master, 0xFFF0, MODBUS_MAX_REGS, MODBUS_EX_ILLEGAL_DATA_ADDRESS);
+        expect_read_exception(&srv, fd, &master, 1000, 1, MODBUS_EX_SLAVE_DEVICE_FAILURE);
+
+        // The connection stays up
+        uint8_t req[12], resp[MODBUS_MBAP_HEADER_SIZE + 4];
+        encode_tcp_read_request(&master, SLAVE_ID, 7, 1, req, sizeof(req), NULL);
+        send(fd, req, sizeof(req), 0);
+        recv_all(&srv, fd, resp, sizeof(resp));
+        check_response(&master, resp, sizeof(resp), 7);
+
+        assert_int_equal(srv.stats.requests, 5);
+        assert_int_equal(srv.stats.exceptions, 4);
+        assert_int_equal(srv.stats.errors, 0);
+
+        close(fd);
+        modbus_server_deinit(&srv);
+    }
+}
+
+static uint16_t table[16];
+
+static int table_read(void *arg, uint8_t unit_id, uint16_t start_addr, uint16_t qty, uint16_t *regs) {
+    (void) arg;
+    (void) unit_id;
+    if (start_addr + qty > 16) {
+        return -1;
+    }
+    memcpy(regs, &table[start_addr], qty * sizeof(uint16_t));
+    return 0;
+}
+
+static int table_write(void *arg, uint8_t unit_id, uint16_t start_addr, uint16_t qty, const uint16_t *values) {
+    (void) arg;
+    (void) unit_id;
+    if (start_addr + qty > 16) {
+        return -1;
+    }
+    memcpy(&table[start_addr], values, qty * sizeof(uint16_t));
+    return 0;
+}
+
+static void test_dispatch_functions(void **state) {
+    (void) state;
+    modbus_server_st srv;
+    modbus_server_config_st cfg = {
+        .bind_addr = "127.0.0.1",
+        .max_connections = 1,
+        .slave_id = SLAVE_ID,
+        .read_cb = table_read,
+        .write_cb = table_write,
+    };
+    memset(table, 0, sizeof(table));
+    assert_int_equal(modbus_server_init(&srv, &cfg), 0);
+    int fd = connect_client(&srv);
+
+    modbus_tcp_master_ctx_st master;
+    modbus_tcp_master_ctx_init(&master, 1);
+    uint8_t pdu[MODBUS_MAX_PDU_SIZE], req[MODBUS_TCP_MAX_ADU_SIZE], resp[MODBUS_TCP_MAX_ADU_SIZE];
+    uint16_t values[2] = {0x1111, 0x2222}, regs[4];
+
+    // Write a setpoint and read back the block around it in one round trip
+    uint16_t pdu_len = modbus_pdu_encode_read_write(2, 4, 3, values, 2, pdu, sizeof(pdu));
+    uint16_t len = encode_tcp_request(&master, SLAVE_ID, pdu, pdu_len, req, sizeof(req), NULL);
+    send(fd, req, len, 0);
+    recv_all(&srv, fd, resp, MODBUS_MBAP_HEADER_SIZE + 2 + 8);
+    assert_int_equal(decode_tcp_response(&master, resp, MODBUS_MBAP_HEADER_SIZE + 2 + 8, regs, 4, NULL), 4);
+    assert_int_equal(regs[0], 0);
+    assert_int_equal(regs[1], 0x1111);
+    assert_int_equal(regs[2], 0x2222);
+
+    pdu_len = modbus_pdu_encode_write_single(15, 0xABCD, pdu, sizeof(pdu));
+    len = encode_tcp_request(&master, SLAVE_ID, pdu, pdu_len, req, sizeof(req), NULL);
+    send(fd, req, len, 0);
+    recv_all(&srv, fd, resp, len);
+    assert_int_equal(decode_tcp_response(&master, resp, len, NULL, 0, NULL), 0);
+    assert_int_equal(table[15], 0xABCD);
+
+    // No input register source: exception, and the connection stays up
+    pdu_len = modbus_pdu_encode_read(MODBUS_READ_INPUT_REG, 0, 1, pdu, sizeof(pdu));
+    len = encode_tcp_request(&master, SLAVE_ID, pdu, pdu_len, req, sizeof(req), NULL);
+    send(fd, req, len, 0);
+    recv_all(&srv, fd, resp, MODBUS_MBAP_HEADER_SIZE + 2);
+    assert_int_equal(decode_tcp_response(&master, resp, MODBUS_MBAP_HEADER_SIZE + 2, regs, 4, NULL), -8);
+    assert_int_equal(resp[MODBUS_MBAP_HEADER_SIZE + 1], MODBUS_EX_ILLEGAL_FUNCTION);
+
+    encode_tcp_read_request(&master, SLAVE_ID, 14, 2, req, sizeof(req), NULL);
+    send(fd, req, MODBUS_MBAP_HEADER_SIZE + 5, 0);
+    recv_all(&srv, fd, resp, MODBUS_MBAP_HEADER_SIZE + 2 + 4);
+    assert_int_equal(decode_tcp_read_response(&master, resp, MODBUS_MBAP_HEADER_SIZE + 2 + 4, regs, 4, NULL), 2);
+    assert_int_equal(regs[1], 0xABCD);
+
+    assert_int_equal(srv.stats.requests, 4);
+    assert_int_equal(srv.stats.exceptions, 1);
+    assert_int_equal(srv.stats.errors, 0);
+
+    close(fd);
+    modbus_server_deinit(&srv);
+}
+
+static void test_stats(void **state) {
+    (void) state;
+    modbus_server_st srv;
+    modbus_stats_st stats;
+    modbus_stats_shard_st total;
+    assert_int_equal(modbus_stats_init(&stats, 2), 0);
+    modbus_server_config_st cfg = {
+        .bind_addr = "127.0.0.1",
+        .max_connections = 1,
+        .slave_id = SLAVE_ID,
+        .read_cb = read_regs,
+        .stats = &stats,
+        .stats_shard = 2,
+    };
+    assert_int_equal(modbus_server_init(&srv, &cfg), -1);
+    cfg.stats_shard = 1;
+    assert_int_equal(modbus_server_init(&srv, &cfg), 0);
+    int fd = connect_client(&srv);
+
+    modbus_tcp_master_ctx_st master;
+    modbus_tcp_master_ctx_init(&master, 4);
+    uint8_t bad[12], good[12], pdu[MODBUS_MAX_PDU_SIZE], input[MODBUS_TCP_MAX_ADU_SIZE];
+    uint16_t tid;
+    encode_tcp_read_request(&master, SLAVE_ID + 1, 0, 1, bad, sizeof(bad), &tid);
+    modbus_tcp_master_cancel(&master, tid);
+    encode_tcp_read_request(&master, SLAVE_ID, 7, 1, good, sizeof(good), NULL);
+    uint16_t pdu_len = modbus_pdu_encode_read(MODBUS_READ_INPUT_REG, 0, 1, pdu, sizeof(pdu));
+    uint16_t input_len = encode_tcp_request(&master, SLAVE_ID, pdu, pdu_len, input, sizeof(input), NULL);
+    send(fd, bad, sizeof(bad), 0);
+    send(fd, good, sizeof(good), 0);
+    send(fd, input, input_len, 0);
+
+    uint8_t resp[MODBUS_MBAP_HEADER_SIZE + 4 + MODBUS_MBAP_HEADER_SIZE + 2];
+    recv_all(&srv, fd, resp, sizeof(resp));
+
+    // Every frame is counted under its unit and function code, the dropped one also as an error
+    modbus_stats_aggregate(&stats, &total);
+    assert_int_equal(total.frames_by_function[MODBUS_READ_HOLDING_REG], 2);
+    assert_int_equal(total.frames_by_function[MODBUS_READ_INPUT_REG], 1);
+    assert_int_equal(total.frames_by_unit[SLAVE_ID], 2);
+    assert_int_equal(total.frames_by_unit[SLAVE_ID + 1], 1);
+    assert_int_equal(total.errors[MODBUS_STATS_SLAVE][4], 1);
+    assert_int_equal(total.errors_by_unit[SLAVE_ID + 1], 1);
+    assert_int_equal(total.errors_by_unit[SLAVE_ID], 0);
+    assert_int_equal(modbus_stats_shard(&stats, 0)->frames_by_function[MODBUS_READ_HOLDING_REG], 0);
+
+    close(fd);
+    modbus_server_deinit(&srv);
+    modbus_stats_free(&stats);
+}
+
+static modbus_bank_st unit_banks[3];
+
+static void test_host_units(void **state) {
+    (void) state;
+    static const uint8_t ids[3] = {2, 40, 200};
+    modbus_server_st srv;
+    modbus_host_st host;
+    modbus_server_config_st cfg = {
+        .bind_addr = "127.0.0.1",
+        .max_connections = 1,
+        .host = &host,
+    };
+
+    // Each unit holds its own ID; only the first also answers "unit ignored"
+    assert_int_equal(modbus_host_init(&host, 3), 0);
+    for (int u = 0; u < 3; u++) {
+        uint16_t value = ids[u];
+        modbus_bank_init(&unit_banks[u]);
+        modbus_bank_write(&unit_banks[u], 0, &value, 1);
+        assert_int_equal(modbus_host_add_bank(&host, ids[u], &unit_banks[u]), u);
+    }
+    assert_int_equal(modbus_host_alias(&host, MODBUS_TCP_UNIT_ID_IGNORED, ids[0]), 0);
+    assert_int_equal(modbus_server_init(&srv, &cfg), 0);
+    int fd = connect_client(&srv);
+
+    modbus_tcp_master_ctx_st master;
+    modbus_tcp_master_ctx_init(&master, 1);
+    uint8_t pdu[MODBUS_MAX_PDU_SIZE], req[MODBUS_TCP_MAX_ADU_SIZE], resp[MODBUS_TCP_MAX_ADU_SIZE];
+    uint16_t regs[1], tid;
+
+    for (int u = 0; u < 3; u++) {
+        encode_tcp_read_request(&master, ids[u], 0, 1, req, sizeof(req), NULL);
+        send(fd, req, MODBUS_MBAP_HEADER_SIZE + 5, 0);
+        recv_all(&srv, fd, resp, MODBUS_MBAP_HEADER_SIZE + 4);
+        assert_int_equal(decode_tcp_read_response(&master, resp, MODBUS_MBAP_HEADER_SIZE + 4, regs, 1, NULL), 1);
+        assert_int_equal(regs[0], ids[u]);
+    }
+
+    // A write lands in the addressed unit's bank only
+    uint16_t pdu_len = modbus_pdu_encode_write_single(0, 0xCAFE, pdu, sizeof(pdu));
+    uint16_t len = encode_tcp_request(&master, ids[1], pdu, pdu_len, req, sizeof(req), NULL);
+    send(fd, req, len, 0);
+    recv_all(&srv, fd, resp, len);
+    assert_int_equal(decode_tcp_response(&master, resp, len, NULL, 0, NULL), 0);
+    modbus_bank_read(&unit_banks[1], 0, 1, regs);
+    assert_int_equal(regs[0], 0xCAFE);
+    modbus_bank_read(&unit_banks[2], 0, 1, regs);
+    assert_int_equal(regs[0], ids[2]);
+
+    // A unit the host does not serve is dropped; the connection keeps going
+    encode_tcp_read_request(&master, ids[0] + 1, 0, 1, req, sizeof(req), &tid);
+    modbus_tcp_master_cancel(&master, tid);
+    send(fd, req, MODBUS_MBAP_HEADER_SIZE + 5, 0);
+    encode_tcp_read_request(&master, MODBUS_TCP_UNIT_ID_IGNORED, 0, 1, req, sizeof(req), NULL);
+    send(fd, req, MODBUS_MBAP_HEADER_SIZE + 5, 0);
+    recv_all(&srv, fd, resp, MODBUS_MBAP_HEADER_SIZE + 4);
+    assert_int_equal(decode_tcp_read_response(&master, resp, MODBUS_MBAP_HEADER_SIZE + 4, regs, 1, NULL), 1);
+    assert_int_equal(regs[0], ids[0]);
+    assert_int_equal(srv.stats.errors, 1);
+    assert_int_equal(srv.stats.requests, 5);
+
+    close(fd);
+    modbus_server_deinit(&srv);
+    modbus_host_free(&host);
+}
+
+static void test_stop(void **state) {
+    (void) state;
+    modbus_server_st srv;
+    start_server(&srv, 1, NULL);
+    modbus_server_stop(&srv);
+    assert_int_equal(modbus_server_run(&srv), 0);
+    modbus_server_deinit(&srv);
+}
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_init_errors),
+        cmocka_unit_test(test_many_pipelined_clients),
+        cmocka_unit_test(test_backpressure),
+        cmocka_unit_test(test_pool_exhausted),
+        cmocka_unit_test(test_invalid_request_dropped),
+        cmocka_unit_test(test_wire_callback),
+        cmocka_unit_test(test_read_exceptions),
+        cmocka_unit_test(test_dispatch_functions),
+        cmocka_unit_test(test_stats),
+        cmocka_unit_test(test_host_units),
+        cmocka_unit_test(test_stop),
+    };
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
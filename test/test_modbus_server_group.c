@@ -0,0 +1,138 @@
+#define _GNU_SOURCE
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <cmocka.h>
+
+#include "modbus_server_group.h"
+#include "modbus_tcp.h"
+
+#define SLAVE_ID 1
+#define SHARDS 4
+
+static int read_regs(void *arg, uint8_t unit_id, uint16_t start_addr, uint16_t qty, uint16_t *regs) {
+    (void) arg;
+    (void) unit_id;
+    for (uint16_t i = 0; i < qty; i++) {
+        regs[i] = (uint16_t)(start_addr + i);
+    }
+    return 0;
+}
+
+static const modbus_server_config_st cfg = {
+    .bind_addr = "127.0.0.1",
+    .max_connections = 64,
+    .slave_id = SLAVE_ID,
+    .read_cb = read_regs,
+};
+
+static int connect_client(uint16_t port) {
+    struct sockaddr_in addr = {0};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+
+    int fd = socket(AF_INET, SOCK_STREAM, 0);
+    assert_true(fd >= 0);
+    assert_int_equal(connect(fd, (struct sockaddr *)&addr, sizeof(addr)), 0);
+    return fd;
+}
+
+static void test_init_errors(void **state) {
+    (void) state;
+    modbus_server_group_st g;
+    assert_int_equal(modbus_server_group_init(NULL, &cfg, 1), -1);
+    assert_int_equal(modbus_server_group_init(&g, NULL, 1), -1);
+    assert_int_equal(modbus_server_group_init(&g, &cfg, MODBUS_SERVER_GROUP_MAX_SHARDS + 1), -1);
+
+    modbus_server_config_st bad = cfg;
+    bad.read_cb = NULL;
+    assert_int_equal(modbus_server_group_init(&g, &bad, 2), -3);
+    assert_null(g.shards);
+}
+
+static void test_shards_share_port(void **state) {
+    (void) state;
+    modbus_server_group_st g;
+    assert_int_equal(modbus_server_group_init(&g, &cfg, SHARDS), 0);
+    assert_int_equal(g.count, SHARDS);
+    assert_int_not_equal(g.port, 0);
+    for (int i = 0; i < SHARDS; i++) {
+        assert_int_equal(modbus_server_port(&g.shards[i].server), g.port);
+        assert_int_equal((uintptr_t)&g.shards[i] % MODBUS_CACHE_LINE_SIZE, 0);
+    }
+    modbus_server_group_deinit(&g);
+    assert_null(g.shards);
+}
+
+static void test_connections_spread_across_shards(void **state) {
+    (void) state;
+    enum { CLIENTS = 64, ROUNDS = 8, QTY = 4 };
+    modbus_server_group_st g;
+    assert_int_equal(modbus_server_group_init(&g, &cfg, SHARDS), 0);
+    assert_int_equal(modbus_server_group_start(&g), 0);
+
+    int fds[CLIENTS];
+    modbus_tcp_master_ctx_st masters[CLIENTS];
+    for (int c = 0; c < CLIENTS; c++) {
+        fds[c] = connect_client(g.port);
+        modbus_tcp_master_ctx_init(&masters[c], 1);
+    }
+
+    for (int r = 0; r < ROUNDS; r++) {
+        for (int c = 0; c < CLIENTS; c++) {
+            uint8_t req[12];
+            uint16_t len = encode_tcp_read_request(&masters[c], SLAVE_ID, (uint16_t)(c + r), QTY, req, sizeof(req), NULL);
+            assert_int_equal(send(fds[c], req, len, 0), len);
+        }
+        for (int c = 0; c < CLIENTS; c++) {
+            uint8_t resp[MODBUS_MBAP_HEADER_SIZE + 2 + QTY * 2];
+            assert_int_equal(recv(fds[c], resp, sizeof(resp), MSG_WAITALL), sizeof(resp));
+
+            uint16_t regs[QTY];
+            assert_int_equal(decode_tcp_read_response(&masters[c], resp, sizeof(resp), regs, QTY, NULL), QTY);
+            assert_int_equal(regs[0], c + r);
+        }
+    }
+
+    // Readable while the shards run; every answer was counted before it was sent
+    modbus_server_stats_st running;
+    modbus_server_group_stats(&g, &running);
+    assert_int_equal(running.requests, CLIENTS * ROUNDS);
+
+    for (int c = 0; c < CLIENTS; c++) {
+        close(fds[c]);
+    }
+    modbus_server_group_stop(&g);
+
+    modbus_server_stats_st total;
+    modbus_server_group_stats(&g, &total);
+    assert_int_equal(total.accepted, CLIENTS);
+    assert_int_equal(total.requests, CLIENTS * ROUNDS);
+
+    // The kernel hashes connections over the shards; each should get a share
+    int busy = 0;
+    for (int i = 0; i < SHARDS; i++) {
+        busy += (g.shards[i].server.stats.accepted > 0);
+        assert_int_equal(g.shards[i].result, 0);
+    }
+    assert_true(busy > 1);
+
+    modbus_server_group_deinit(&g);
+}
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_init_errors),
+        cmocka_unit_test(test_shards_share_port),
+        cmocka_unit_test(test_connections_spread_across_shards),
+    };
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
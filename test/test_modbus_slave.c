@@ -8,8 +8,10 @@
 #include "modbus_slave.h"
 #include "modbus_utils.h"
 #include "modbus_types.h"
+#include "modbus_master.h"
 
 static uint8_t test_slave_id = 1;
+static modbus_slave_ctx_st slave_ctx;
 
 // Helper to create a valid read request buffer
 static void fill_valid_read_request(uint8_t *buffer, uint16_t addr, uint16_t qty, uint8_t slave_id) {
@@ -31,7 +33,7 @@ static void test_decode_read_request_success(void **state) {
     uint8_t slave = 0;
     uint16_t start_addr = 0;
     uint16_t qty = 0;
-    int ret = decode_read_request(buffer, sizeof(buffer), &slave, &start_addr, &qty);
+    int ret = decode_read_request(&slave_ctx, buffer, sizeof(buffer), &slave, &start_addr, &qty);
 
     assert_int_equal(ret, 0);
     assert_int_equal(slave, test_slave_id);
@@ -46,10 +48,11 @@ static void test_decode_read_request_null_ptr(void **state) {
     uint16_t start_addr = 0;
     uint16_t qty = 0;
 
-    assert_int_equal(decode_read_request(NULL, sizeof(buffer), &slave, &start_addr, &qty), -1);
-    assert_int_equal(decode_read_request(buffer, sizeof(buffer), NULL, &start_addr, &qty), -1);
-    assert_int_equal(decode_read_request(buffer, sizeof(buffer), &slave, NULL, &qty), -1);
-    assert_int_equal(decode_read_request(buffer, sizeof(buffer), &slave, &start_addr, NULL), -1);
+    assert_int_equal(decode_read_request(NULL, buffer, sizeof(buffer), &slave, &start_addr, &qty), -1);
+    assert_int_equal(decode_read_request(&slave_ctx, NULL, sizeof(buffer), &slave, &start_addr, &qty), -1);
+    assert_int_equal(decode_read_request(&slave_ctx, buffer, sizeof(buffer), NULL, &start_addr, &qty), -1);
+    assert_int_equal(decode_read_request(&slave_ctx, buffer, sizeof(buffer), &slave, NULL, &qty), -1);
+    assert_int_equal(decode_read_request(&slave_ctx, buffer, sizeof(buffer), &slave, &start_addr, NULL), -1);
 }
 
 static void test_decode_read_request_small_buffer(void **state) {
@@ -58,7 +61,7 @@ static void test_decode_read_request_small_buffer(void **state) {
     uint8_t slave = 0;
     uint16_t start_addr = 0;
     uint16_t qty = 0;
-    assert_int_equal(decode_read_request(buffer, sizeof(buffer), &slave, &start_addr, &qty), -2);
+    assert_int_equal(decode_read_request(&slave_ctx, buffer, sizeof(buffer), &slave, &start_addr, &qty), -2);
 }
 
 static void test_decode_read_request_bad_crc(void **state) {
@@ -71,7 +74,7 @@ static void test_decode_read_request_bad_crc(void **state) {
     uint8_t slave = 0;
     uint16_t start_addr = 0;
     uint16_t qty = 0;
-    assert_int_equal(decode_read_request(buffer, sizeof(buffer), &slave, &start_addr, &qty), -6);
+    assert_int_equal(decode_read_request(&slave_ctx, buffer, sizeof(buffer), &slave, &start_addr, &qty), -6);
 }
 
 static void test_decode_read_request_wrong_function(void **state) {
@@ -85,22 +88,27 @@ static void test_decode_read_request_wrong_function(void **state) {
     uint8_t slave = 0;
     uint16_t start_addr = 0;
     uint16_t qty = 0;
-    assert_int_equal(decode_read_request(buffer, sizeof(buffer), &slave, &start_addr, &qty), -5);
+    assert_int_equal(decode_read_request(&slave_ctx, buffer, sizeof(buffer), &slave, &start_addr, &qty), -5);
 }
 
 static void test_set_device_slave_id(void **state) {
     (void) state;
-    assert_int_equal(set_device_slave_id(5), 0);
-    assert_int_equal(set_device_slave_id(0), -1); // invalid
-    assert_int_equal(set_device_slave_id(248), -1); // invalid
-    assert_int_equal(set_device_slave_id(BROADCAST_SLAVE_ID), -1); // invalid
+    modbus_slave_ctx_st ctx;
+    modbus_slave_ctx_init(&ctx);
+    assert_int_equal(set_device_slave_id(&ctx, 5), 0);
+    assert_int_equal(ctx.device_slave_id, 5);
+    assert_int_equal(set_device_slave_id(&ctx, 0), -1); // invalid
+    assert_int_equal(set_device_slave_id(&ctx, 248), -1); // invalid
+    assert_int_equal(set_device_slave_id(&ctx, BROADCAST_SLAVE_ID), -1); // invalid
+    assert_int_equal(set_device_slave_id(NULL, 5), -1); // invalid
+    assert_int_equal(slave_ctx.device_slave_id, test_slave_id);
 }
 
 static void test_encode_read_response_success(void **state) {
     (void) state;
     uint16_t regs[2] = {1000, 5000};
     uint8_t buffer[256] = {0};
-    uint16_t len = encode_read_response(test_slave_id, regs, 2, buffer, sizeof(buffer));
+    uint16_t len = encode_read_response(&slave_ctx, test_slave_id, regs, 2, buffer, sizeof(buffer));
     assert_true(len > 0);
 
     // Decode back to check registers
@@ -115,6 +123,113 @@ static void test_encode_read_response_success(void **state) {
     assert_int_equal(r1, 5000);
 }
 
+static uint16_t table[64];
+
+static int table_read(void *arg, uint8_t unit_id, uint16_t start_addr, uint16_t qty, uint16_t *regs) {
+    (void) arg;
+    (void) unit_id;
+    if (start_addr + qty > 64) {
+        return -1;
+    }
+    memcpy(regs, &table[start_addr], qty * sizeof(uint16_t));
+    return 0;
+}
+
+static int table_write(void *arg, uint8_t unit_id, uint16_t start_addr, uint16_t qty, const uint16_t *values) {
+    (void) arg;
+    (void) unit_id;
+    if (start_addr + qty > 64) {
+        return -1;
+    }
+    memcpy(&table[start_addr], values, qty * sizeof(uint16_t));
+    return 0;
+}
+
+static void test_handle_request(void **state) {
+    (void) state;
+    const modbus_register_map_st map = {.read_holding = table_read, .write_holding = table_write};
+    modbus_master_ctx_st master;
+    uint8_t pdu[MODBUS_MAX_PDU_SIZE], req[MODBUS_RTU_MAX_ADU_SIZE], resp[MODBUS_RTU_MAX_ADU_SIZE];
+    uint16_t setpoint[2] = {111, 222}, regs[4];
+    modbus_master_ctx_init(&master);
+    memset(table, 0, sizeof(table));
+
+    // Setpoint write and status read in one round trip
+    uint16_t pdu_len = modbus_pdu_encode_read_write(10, 4, 11, setpoint, 2, pdu, sizeof(pdu));
+    uint16_t len = encode_rtu_request(&master, test_slave_id, pdu, pdu_len, req, sizeof(req));
+    assert_int_equal(len, 1 + pdu_len + 2);
+    int resp_len = modbus_slave_handle_request(&slave_ctx, &map, req, len, resp, sizeof(resp));
+    assert_int_equal(resp_len, 3 + 8 + 2);
+    assert_int_equal(decode_rtu_response(&master, resp, (size_t)resp_len, regs, 4), 4);
+    assert_int_equal(regs[0], 0);
+    assert_int_equal(regs[1], 111);
+    assert_int_equal(regs[2], 222);
+    assert_int_equal(regs[3], 0);
+
+    // Write single: the echo decodes as a write
+    pdu_len = modbus_pdu_encode_write_single(5, 0x55AA, pdu, sizeof(pdu));
+    len = encode_rtu_request(&master, test_slave_id, pdu, pdu_len, req, sizeof(req));
+    resp_len = modbus_slave_handle_request(&slave_ctx, &map, req, len, resp, sizeof(resp));
+    assert_int_equal(resp_len, len);
+    assert_memory_equal(resp, req, len);
+    assert_int_equal(decode_rtu_response(&master, resp, (size_t)resp_len, NULL, 0), 0);
+    assert_int_equal(table[5], 0x55AA);
+
+    // Out-of-table read: the callback fails and the master sees an exception
+    pdu_len = modbus_pdu_encode_read(MODBUS_READ_HOLDING_REG, 60, 10, pdu, sizeof(pdu));
+    len = encode_rtu_request(&master, test_slave_id, pdu, pdu_len, req, sizeof(req));
+    resp_len = modbus_slave_handle_request(&slave_ctx, &map, req, len, resp, sizeof(resp));
+    assert_int_equal(resp_len, 5);
+    assert_int_equal(decode_rtu_response(&master, resp, (size_t)resp_len, regs, 4), -8);
+    assert_int_equal(resp[2], MODBUS_EX_SLAVE_DEVICE_FAILURE);
+
+    // Input registers are not mapped
+    pdu_len = modbus_pdu_encode_read(MODBUS_READ_INPUT_REG, 0, 1, pdu, sizeof(pdu));
+    len = encode_rtu_request(&master, test_slave_id, pdu, pdu_len, req, sizeof(req));
+    resp_len = modbus_slave_handle_request(&slave_ctx, &map, req, len, resp, sizeof(resp));
+    assert_int_equal(resp[1], MODBUS_READ_INPUT_REG | MODBUS_EXCEPTION_FLAG);
+    assert_int_equal(resp[2], MODBUS_EX_ILLEGAL_FUNCTION);
+
+    // Broadcast writes are executed but never answered
+    pdu_len = modbus_pdu_encode_write_single(6, 7, pdu, sizeof(pdu));
+    len = encode_rtu_request(&master, BROADCAST_SLAVE_ID, pdu, pdu_len, req, sizeof(req));
+    assert_int_equal(modbus_slave_handle_request(&slave_ctx, &map, req, len, resp, sizeof(resp)), 0);
+    assert_int_equal(table[6], 7);
+
+    // Framing, addressing and CRC problems are dropped silently
+    len = encode_rtu_request(&master, test_slave_id, pdu, pdu_len, req, sizeof(req));
+    assert_int_equal(modbus_slave_handle_request(NULL, &map, req, len, resp, sizeof(resp)), -1);
+    assert_int_equal(modbus_slave_handle_request(&slave_ctx, &map, req, len, resp, 100), -1);
+    assert_int_equal(modbus_slave_handle_request(&slave_ctx, &map, req, len - 1, resp, sizeof(resp)), -2);
+    req[len - 1] ^= 0xFF;
+    assert_int_equal(modbus_slave_handle_request(&slave_ctx, &map, req, len, resp, sizeof(resp)), -6);
+    req[0] = test_slave_id + 1;
+    assert_int_equal(modbus_slave_handle_request(&slave_ctx, &map, req, len, resp, sizeof(resp)), -4);
+    req[1] = 0x2B;
+    assert_int_equal(modbus_slave_handle_request(&slave_ctx, &map, req, len, resp, sizeof(resp)), -4);
+
+    // Unknown function code: the whole frame is checked, then answered with Illegal Function
+    uint8_t unknown[] = {test_slave_id, 0x2B, 0x0E, 0x01, 0x00, 0, 0};
+    uint16_t unknown_crc = modbus_crc16(unknown, 5);
+    unknown[5] = (uint8_t)unknown_crc;
+    unknown[6] = (uint8_t)(unknown_crc >> 8);
+    len = sizeof(unknown);
+    memcpy(req, unknown, len);
+    assert_int_equal(modbus_slave_handle_request(&slave_ctx, &map, req, len, resp, sizeof(resp)), 5);
+    assert_int_equal(resp[0], test_slave_id);
+    assert_int_equal(resp[1], 0x2B | MODBUS_EXCEPTION_FLAG);
+    assert_int_equal(resp[2], MODBUS_EX_ILLEGAL_FUNCTION);
+    assert_int_equal(resp[3] | (resp[4] << 8), modbus_crc16(resp, 3));
+    req[len - 1] ^= 0xFF;
+    assert_int_equal(modbus_slave_handle_request(&slave_ctx, &map, req, len, resp, sizeof(resp)), -6);
+    unknown[0] = BROADCAST_SLAVE_ID;
+    unknown_crc = modbus_crc16(unknown, 5);
+    unknown[5] = (uint8_t)unknown_crc;
+    unknown[6] = (uint8_t)(unknown_crc >> 8);
+    assert_int_equal(modbus_slave_handle_request(&slave_ctx, &map, unknown, len, resp, sizeof(resp)), 0);
+    assert_int_equal(modbus_slave_handle_request(&slave_ctx, &map, unknown, 3, resp, sizeof(resp)), -2);
+}
+
 int main(void) {
     const struct CMUnitTest tests[] = {
         cmocka_unit_test(test_decode_read_request_success),
@@ -124,7 +239,11 @@ int main(void) {
         cmocka_unit_test(test_decode_read_request_wrong_function),
         cmocka_unit_test(test_set_device_slave_id),
         cmocka_unit_test(test_encode_read_response_success),
+        cmocka_unit_test(test_handle_request),
     };
 
+    modbus_slave_ctx_init(&slave_ctx);
+    set_device_slave_id(&slave_ctx, test_slave_id);
+
     return cmocka_run_group_tests(tests, NULL, NULL);
 }
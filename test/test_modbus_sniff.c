@@ -0,0 +1,320 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <setjmp.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <cmocka.h>
+
+#include "modbus_sniff.h"
+#include "modbus_host.h"
+#include "modbus_master.h"
+#include "modbus_utils.h"
+
+#define WATCHED 5
+#define OTHER 9
+#define T35_NS 1750000u
+#define TIMEOUT_US 100000u
+
+// The slaves on the line (WATCHED serves its input registers from its holding bank), and the mirrors
+static modbus_bank_st slave_holding[2], mirror_holding, mirror_input;
+static modbus_host_st line;
+static modbus_master_ctx_st master;
+
+typedef struct {
+    uint8_t req[MODBUS_RTU_MAX_ADU_SIZE];
+    uint8_t resp[MODBUS_RTU_MAX_ADU_SIZE];
+    size_t req_len;
+    size_t resp_len;
+} exchange_st;
+
+static void setup_line(void) {
+    uint16_t values[64];
+    for (int i = 0; i < 64; i++) {
+        values[i] = (uint16_t)(0x1000 + i);
+    }
+    modbus_bank_init(&slave_holding[0]);
+    modbus_bank_init(&slave_holding[1]);
+    modbus_bank_init(&mirror_holding);
+    modbus_bank_init(&mirror_input);
+    modbus_bank_write(&slave_holding[0], 0, values, 64);
+    modbus_bank_write(&slave_holding[1], 0, values, 64);
+    modbus_bank_write(&slave_holding[0], 100, values, 64);
+
+    modbus_register_map_st map = {
+        .read_holding = modbus_bank_read_cb,
+        .write_holding = modbus_bank_write_cb,
+        .read_input = modbus_bank_read_cb,
+        .arg = &slave_holding[0],
+    };
+    assert_int_equal(modbus_host_init(&line, 2), 0);
+    assert_int_equal(modbus_host_add_unit(&line, WATCHED, &map, NULL), 0);
+    assert_int_equal(modbus_host_add_bank(&line, OTHER, &slave_holding[1]), 1);
+    modbus_master_ctx_init(&master);
+}
+
+// A request on the line and the answer of the slave it addresses
+static exchange_st exchange(uint8_t unit, const uint8_t *pdu, uint16_t pdu_len) {
+    exchange_st x;
+    x.req_len = encode_rtu_request(&master, unit, pdu, pdu_len, x.req, sizeof(x.req));
+    assert_true(x.req_len > 0);
+    int ret = modbus_host_handle_rtu_request(&line, x.req, x.req_len, x.resp, sizeof(x.resp));
+    assert_true(ret >= 0);
+    x.resp_len = (size_t)ret;
+    return x;
+}
+
+static exchange_st read_exchange(uint8_t unit, uint8_t function_code, uint16_t addr, uint16_t qty) {
+    uint8_t pdu[MODBUS_MAX_PDU_SIZE];
+    return exchange(unit, pdu, modbus_pdu_encode_read(function_code, addr, qty, pdu, sizeof(pdu)));
+}
+
+static void check_mirror(const modbus_bank_st *mirror, const modbus_bank_st *slave, uint16_t addr, uint16_t qty) {
+    uint16_t want[MODBUS_MAX_REGS], got[MODBUS_MAX_REGS];
+    assert_int_equal(modbus_bank_read(slave, addr, qty, want), 0);
+    assert_int_equal(modbus_bank_read(mirror, addr, qty, got), 0);
+    assert_memory_equal(got, want, qty * sizeof(uint16_t));
+}
+
+static void test_init_and_watch(void **state) {
+    (void) state;
+    static modbus_sniff_st sniff;
+
+    assert_int_equal(modbus_sniff_init(NULL, T35_NS, 0), -1);
+    assert_int_equal(modbus_sniff_init(&sniff, T35_NS, TIMEOUT_US), 0);
+    assert_int_equal(sniff.response_timeout_ns, TIMEOUT_US * 1000ull);
+
+    assert_int_equal(modbus_sniff_watch(NULL, WATCHED, &mirror_holding, NULL), -1);
+    assert_int_equal(modbus_sniff_watch(&sniff, WATCHED, NULL, NULL), -1);
+    assert_int_equal(modbus_sniff_watch(&sniff, BROADCAST_SLAVE_ID, &mirror_holding, NULL), -1);
+    assert_int_equal(modbus_sniff_watch(&sniff, MODBUS_MAX_SLAVES + 1, &mirror_holding, NULL), -1);
+    assert_int_equal(modbus_sniff_watch(&sniff, WATCHED, &mirror_holding, NULL), 0);
+    assert_int_equal(modbus_sniff_watch(&sniff, WATCHED, &mirror_holding, &mirror_input), 0);
+    assert_int_equal(sniff.watched, 1);
+
+    assert_int_equal(modbus_sniff_feed(NULL, NULL, 0, 0), -1);
+    assert_int_equal(modbus_sniff_feed(&sniff, NULL, 1, 0), -1);
+    assert_int_equal(modbus_sniff_feed(&sniff, NULL, 0, 0), 0);
+    assert_int_equal(modbus_sniff_poll(&sniff, -1, 0), -1);
+}
+
+static void test_mirror_reads_and_writes(void **state) {
+    (void) state;
+    static modbus_sniff_st sniff;
+    uint8_t pdu[MODBUS_MAX_PDU_SIZE];
+    uint64_t t = 1000000000ull;
+    setup_line();
+
+    modbus_bank_init(&mirror_holding);
+    modbus_bank_init(&mirror_input);
+    modbus_sniff_init(&sniff, T35_NS, TIMEOUT_US);
+    modbus_sniff_watch(&sniff, WATCHED, &mirror_holding, &mirror_input);
+
+    // Every frame in its own read, t3.5 apart, as on a quiet line
+    exchange_st reads[2] = {
+        read_exchange(WATCHED, MODBUS_READ_HOLDING_REG, 4, 20),
+        read_exchange(WATCHED, MODBUS_READ_INPUT_REG, 110, 8),
+    };
+    for (int i = 0; i < 2; i++) {
+        assert_int_equal(modbus_sniff_feed(&sniff, reads[i].req, reads[i].req_len, t += T35_NS), 0);
+        assert_int_equal(modbus_sniff_feed(&sniff, reads[i].resp, reads[i].resp_len, t += T35_NS), 1);
+    }
+    check_mirror(&mirror_holding, &slave_holding[0], 4, 20);
+    check_mirror(&mirror_input, &slave_holding[0], 110, 8);
+
+    // Acknowledged writes land in the mirror; 0x17 also brings back its read window
+    uint16_t values[3] = {0xA1, 0xA2, 0xA3};
+    exchange_st writes[3] = {
+        exchange(WATCHED, pdu, modbus_pdu_encode_write_single(30, 0xBEEF, pdu, sizeof(pdu))),
+        exchange(WATCHED, pdu, modbus_pdu_encode_write_multiple(40, values, 3, pdu, sizeof(pdu))),
+        exchange(WATCHED, pdu, modbus_pdu_encode_read_write(50, 6, 52, values, 2, pdu, sizeof(pdu))),
+    };
+    for (int i = 0; i < 3; i++) {
+        modbus_sniff_feed(&sniff, writes[i].req, writes[i].req_len, t += T35_NS);
+        assert_int_equal(modbus_sniff_feed(&sniff, writes[i].resp, writes[i].resp_len, t += T35_NS), 1);
+    }
+    check_mirror(&mirror_holding, &slave_holding[0], 30, 1);
+    check_mirror(&mirror_holding, &slave_holding[0], 40, 3);
+    check_mirror(&mirror_holding, &slave_holding[0], 50, 6);
+
+    assert_int_equal(sniff.stats.transactions, 5);
+    assert_int_equal(sniff.units[WATCHED].transactions, 5);
+    assert_int_equal(sniff.units[WATCHED].updated_ns, t);
+    assert_int_equal(sniff.stats.frames, 10);
+    assert_int_equal(sniff.stats.crc_errors + sniff.stats.dropped_bytes + sniff.stats.unanswered, 0);
+    modbus_host_free(&line);
+}
+
+static void test_exceptions_and_broadcast(void **state) {
+    (void) state;
+    static modbus_sniff_st sniff;
+    uint8_t pdu[MODBUS_MAX_PDU_SIZE];
+    uint16_t regs[2], values[2] = {0x7777, 0x8888};
+    uint64_t t = 1000000000ull;
+    setup_line();
+
+    modbus_bank_init(&mirror_holding);
+    modbus_sniff_init(&sniff, T35_NS, TIMEOUT_US);
+    modbus_sniff_watch(&sniff, OTHER, &mirror_holding, NULL);
+
+    // OTHER has no input registers: the exception is counted, nothing is mirrored
+    exchange_st refused = read_exchange(OTHER, MODBUS_READ_INPUT_REG, 0, 2);
+    assert_int_equal(refused.resp[1], MODBUS_READ_INPUT_REG | MODBUS_EXCEPTION_FLAG);
+    modbus_sniff_feed(&sniff, refused.req, refused.req_len, t += T35_NS);
+    assert_int_equal(modbus_sniff_feed(&sniff, refused.resp, refused.resp_len, t += T35_NS), 0);
+    assert_int_equal(sniff.stats.exceptions, 1);
+
+    // A broadcast write is never answered, and every slave executes it
+    exchange_st broadcast = exchange(BROADCAST_SLAVE_ID, pdu,
+                                     modbus_pdu_encode_write_multiple(60, values, 2, pdu, sizeof(pdu)));
+    assert_int_equal(broadcast.resp_len, 0);
+    modbus_sniff_feed(&sniff, broadcast.req, broadcast.req_len, t += T35_NS);
+    assert_int_equal(sniff.stats.broadcasts, 1);
+    modbus_bank_read(&mirror_holding, 60, 2, regs);
+    assert_int_equal(regs[0], 0x7777);
+    assert_int_equal(regs[1], 0x8888);
+    check_mirror(&mirror_holding, &slave_holding[1], 60, 2);
+
+    // A response whose byte count disagrees with its request is not applied
+    exchange_st read = read_exchange(OTHER, MODBUS_READ_HOLDING_REG, 0, 2);
+    read.req[5] = 3;
+    uint16_t crc = modbus_crc16(read.req, 6);
+    memcpy(read.req + 6, &crc, 2);
+    modbus_sniff_feed(&sniff, read.req, read.req_len, t += T35_NS);
+    assert_int_equal(modbus_sniff_feed(&sniff, read.resp, read.resp_len, t += T35_NS), 0);
+    assert_int_equal(sniff.stats.mismatches, 1);
+
+    // Nor is a write echo for another address
+    exchange_st write = exchange(OTHER, pdu, modbus_pdu_encode_write_single(70, 0x1111, pdu, sizeof(pdu)));
+    write.req[3] = 71;
+    crc = modbus_crc16(write.req, 6);
+    memcpy(write.req + 6, &crc, 2);
+    modbus_sniff_feed(&sniff, write.req, write.req_len, t += T35_NS);
+    assert_int_equal(modbus_sniff_feed(&sniff, write.resp, write.resp_len, t += T35_NS), 0);
+    assert_int_equal(sniff.stats.mismatches, 2);
+    modbus_bank_read(&mirror_holding, 70, 2, regs);
+    assert_int_equal(regs[0], 0);
+    assert_int_equal(regs[1], 0);
+    assert_int_equal(sniff.stats.transactions, 0);
+    modbus_host_free(&line);
+}
+
+static void test_address_filter(void **state) {
+    (void) state;
+    static modbus_sniff_st sniff;
+    uint8_t stream[4 * MODBUS_RTU_MAX_ADU_SIZE];
+    size_t len = 0;
+    setup_line();
+
+    modbus_bank_init(&mirror_holding);
+    modbus_sniff_init(&sniff, 0, 0);
+    modbus_sniff_watch(&sniff, WATCHED, &mirror_holding, NULL);
+
+    // Traffic for another unit, CRC broken on purpose: only its length is looked at
+    exchange_st other = read_exchange(OTHER, MODBUS_READ_HOLDING_REG, 0, 40);
+    other.req[other.req_len - 1] ^= 0xFF;
+    other.resp[other.resp_len - 1] ^= 0xFF;
+    exchange_st mine = read_exchange(WATCHED, MODBUS_READ_HOLDING_REG, 8, 3);
+    memcpy(stream + len, other.req, other.req_len);
+    len += other.req_len;
+    memcpy(stream + len, other.resp, other.resp_len);
+    len += other.resp_len;
+    memcpy(stream + len, mine.req, mine.req_len);
+    len += mine.req_len;
+    memcpy(stream + len, mine.resp, mine.resp_len);
+    len += mine.resp_len;
+
+    // No timing: one coalesced chunk is split on structure alone
+    assert_int_equal(modbus_sniff_feed(&sniff, stream, len, 1), 1);
+    assert_int_equal(sniff.stats.frames, 4);
+    assert_int_equal(sniff.stats.filtered, 2);
+    assert_int_equal(sniff.stats.crc_errors, 0);
+    check_mirror(&mirror_holding, &slave_holding[0], 8, 3);
+
+    // Byte by byte, and behind a garbage byte, the result is the same
+    modbus_sniff_init(&sniff, 0, 0);
+    modbus_sniff_watch(&sniff, WATCHED, &mirror_holding, NULL);
+    uint8_t garbage = 0xEE;
+    modbus_sniff_feed(&sniff, &garbage, 1, 1);
+    int applied = 0;
+    for (size_t i = 0; i < len; i++) {
+        applied += modbus_sniff_feed(&sniff, stream + i, 1, 1);
+    }
+    assert_int_equal(applied, 1);
+    assert_int_equal(sniff.stats.frames, 4);
+    assert_int_equal(sniff.stats.dropped_bytes, 1);
+    modbus_host_free(&line);
+}
+
+static void test_timing(void **state) {
+    (void) state;
+    static modbus_sniff_st sniff;
+    uint64_t t = 1000000000ull;
+    setup_line();
+
+    modbus_bank_init(&mirror_holding);
+    modbus_sniff_init(&sniff, T35_NS, TIMEOUT_US);
+    modbus_sniff_watch(&sniff, WATCHED, &mirror_holding, NULL);
+    exchange_st x = read_exchange(WATCHED, MODBUS_READ_HOLDING_REG, 0, 4);
+
+    // A frame cut short by a silence is thrown away, not glued to the next one
+    modbus_sniff_feed(&sniff, x.req, 3, t += T35_NS);
+    modbus_sniff_feed(&sniff, x.req, x.req_len, t += 2 * T35_NS);
+    assert_int_equal(sniff.stats.dropped_bytes, 3);
+    assert_int_equal(modbus_sniff_feed(&sniff, x.resp, x.resp_len, t += T35_NS), 1);
+
+    // A function code the sniffer cannot frame (0x01 Read Coils) is skipped up to the next silence
+    uint8_t coils[8] = {WATCHED, 0x01, 0x00, 0x00, 0x00, 0x10};
+    uint16_t crc = modbus_crc16(coils, 6);
+    memcpy(coils + 6, &crc, 2);
+    modbus_sniff_feed(&sniff, coils, sizeof(coils), t += T35_NS);
+    modbus_sniff_feed(&sniff, coils, 2, t + 1000);
+    assert_int_equal(sniff.stats.dropped_bytes, 3 + 10);
+    assert_int_equal(modbus_sniff_feed(&sniff, x.req, x.req_len, t += 2 * T35_NS), 0);
+    assert_int_equal(modbus_sniff_feed(&sniff, x.resp, x.resp_len, t += T35_NS), 1);
+
+    // No answer within the response timeout: the request is given up
+    modbus_sniff_feed(&sniff, x.req, x.req_len, t += T35_NS);
+    assert_int_equal(modbus_sniff_feed(&sniff, x.resp, x.resp_len, t += TIMEOUT_US * 1000ull + 1), 0);
+    assert_int_equal(sniff.stats.unanswered, 1);
+    assert_int_equal(sniff.stats.transactions, 2);
+    modbus_host_free(&line);
+}
+
+static void test_poll(void **state) {
+    (void) state;
+    static modbus_sniff_st sniff;
+    int fds[2];
+    setup_line();
+
+    modbus_bank_init(&mirror_holding);
+    modbus_sniff_init(&sniff, T35_NS, TIMEOUT_US);
+    modbus_sniff_watch(&sniff, WATCHED, &mirror_holding, NULL);
+    assert_int_equal(pipe(fds), 0);
+
+    exchange_st x = read_exchange(WATCHED, MODBUS_READ_HOLDING_REG, 12, 10);
+    assert_int_equal(modbus_sniff_poll(&sniff, fds[0], 0), 0);
+    assert_int_equal(write(fds[1], x.req, x.req_len), (ssize_t)x.req_len);
+    assert_int_equal(modbus_sniff_poll(&sniff, fds[0], 1000), 0);
+    assert_int_equal(write(fds[1], x.resp, x.resp_len), (ssize_t)x.resp_len);
+    assert_int_equal(modbus_sniff_poll(&sniff, fds[0], 1000), 1);
+    check_mirror(&mirror_holding, &slave_holding[0], 12, 10);
+
+    close(fds[1]);
+    assert_int_equal(modbus_sniff_poll(&sniff, fds[0], 1000), -2);
+    close(fds[0]);
+    modbus_host_free(&line);
+}
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_init_and_watch),
+        cmocka_unit_test(test_mirror_reads_and_writes),
+        cmocka_unit_test(test_exceptions_and_broadcast),
+        cmocka_unit_test(test_address_filter),
+        cmocka_unit_test(test_timing),
+        cmocka_unit_test(test_poll),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,190 @@
+#define _GNU_SOURCE
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <cmocka.h>
+
+#include "modbus_stats.h"
+
+#define THREADS 4
+#define FRAMES_PER_THREAD 200000
+
+static void test_init(void **state) {
+    (void) state;
+    modbus_stats_st stats;
+
+    assert_int_equal(modbus_stats_init(NULL, 1), -1);
+    assert_int_equal(modbus_stats_init(&stats, 0), -1);
+    assert_int_equal(modbus_stats_init(&stats, 1025), -1);
+    assert_int_equal(modbus_stats_init(&stats, 3), 0);
+
+    // Every shard starts on its own cache lines
+    assert_int_equal(sizeof(modbus_stats_shard_st) % MODBUS_CACHE_LINE_SIZE, 0);
+    for (uint32_t i = 0; i < 3; i++) {
+        modbus_stats_shard_st *shard = modbus_stats_shard(&stats, i);
+        assert_non_null(shard);
+        assert_int_equal((uintptr_t)shard % MODBUS_CACHE_LINE_SIZE, 0);
+    }
+    assert_null(modbus_stats_shard(&stats, 3));
+    assert_null(modbus_stats_shard(NULL, 0));
+
+    // A NULL shard means statistics are off
+    modbus_stats_frame(NULL, 1, 3);
+    modbus_stats_error(NULL, MODBUS_STATS_MASTER, 1, -2);
+    modbus_stats_latency(NULL, 100);
+
+    modbus_stats_free(&stats);
+    assert_null(stats.shards);
+    modbus_stats_free(NULL);
+}
+
+static void test_buckets(void **state) {
+    (void) state;
+
+    // Exact below the first power of two that gets split
+    for (uint64_t v = 0; v < MODBUS_STATS_HIST_SUB_BUCKETS; v++) {
+        assert_int_equal(modbus_stats_bucket(v), v);
+        assert_int_equal(modbus_stats_bucket_floor((uint32_t)v), v);
+    }
+    assert_int_equal(modbus_stats_bucket(16), 16);
+    assert_int_equal(modbus_stats_bucket(31), 31);
+    assert_int_equal(modbus_stats_bucket(32), 32);
+    assert_int_equal(modbus_stats_bucket(33), 32);
+    assert_int_equal(modbus_stats_bucket(34), 33);
+    assert_int_equal(modbus_stats_bucket(UINT64_MAX), MODBUS_STATS_HIST_BUCKETS - 1);
+    assert_int_equal(modbus_stats_bucket((1ull << MODBUS_STATS_HIST_MAX_BITS) - 1), MODBUS_STATS_HIST_BUCKETS - 1);
+
+    // Buckets are ordered, and every value is within 1/16 of its bucket floor
+    uint32_t last = 0;
+    for (uint64_t v = 1; v < (1ull << MODBUS_STATS_HIST_MAX_BITS); v += v / 7 + 1) {
+        uint32_t b = modbus_stats_bucket(v);
+        uint64_t floor = modbus_stats_bucket_floor(b);
+        assert_true(b >= last);
+        assert_true(floor <= v);
+        assert_true(v - floor <= floor / MODBUS_STATS_HIST_SUB_BUCKETS);
+        if (b + 1 < MODBUS_STATS_HIST_BUCKETS) {
+            assert_true(v < modbus_stats_bucket_floor(b + 1));
+        }
+        last = b;
+    }
+}
+
+static void test_counters_and_percentiles(void **state) {
+    (void) state;
+    modbus_stats_st stats;
+    modbus_stats_shard_st total;
+
+    assert_int_equal(modbus_stats_init(&stats, 2), 0);
+    modbus_stats_shard_st *a = modbus_stats_shard(&stats, 0);
+    modbus_stats_shard_st *b = modbus_stats_shard(&stats, 1);
+
+    modbus_stats_frame(a, 1, 0x03);
+    modbus_stats_frame(a, 1, 0x03);
+    modbus_stats_frame(b, 2, 0x83);
+    modbus_stats_error(a, MODBUS_STATS_MASTER, 1, -7);
+    modbus_stats_error(b, MODBUS_STATS_SLAVE, 2, -6);
+    modbus_stats_error(b, MODBUS_STATS_SLAVE, 2, -99); // beyond the table: last slot
+    modbus_stats_error(b, MODBUS_STATS_SLAVE, 2, 0);   // not an error
+
+    // 1..1000 us, split over the two shards
+    for (uint64_t us = 1; us <= 1000; us++) {
+        modbus_stats_latency((us & 1) ? a : b, us * 1000);
+    }
+
+    modbus_stats_aggregate(&stats, &total);
+    assert_int_equal(total.frames_by_function[0x03], 2);
+    assert_int_equal(total.frames_by_function[0x83], 1);
+    assert_int_equal(total.frames_by_unit[1], 2);
+    assert_int_equal(total.frames_by_unit[2], 1);
+    assert_int_equal(total.errors[MODBUS_STATS_MASTER][7], 1);
+    assert_int_equal(total.errors[MODBUS_STATS_SLAVE][6], 1);
+    assert_int_equal(total.errors[MODBUS_STATS_SLAVE][MODBUS_STATS_ERROR_CODES - 1], 1);
+    assert_int_equal(total.errors_by_unit[1], 1);
+    assert_int_equal(total.errors_by_unit[2], 2);
+
+    assert_int_equal(total.latency.count, 1000);
+    assert_int_equal(total.latency.sum_ns, 500500ull * 1000);
+    assert_int_equal(total.latency.max_ns, 1000000);
+
+    // Within one bucket (1/16) of the exact rank
+    static const struct { double q; uint64_t exact; } checks[] = {
+        {0.5, 500000}, {0.9, 900000}, {0.99, 990000}, {0.999, 999000},
+    };
+    for (size_t i = 0; i < sizeof(checks) / sizeof(checks[0]); i++) {
+        uint64_t p = modbus_stats_percentile(&total.latency, checks[i].q);
+        assert_true(p >= checks[i].exact);
+        assert_true(p <= checks[i].exact + checks[i].exact / MODBUS_STATS_HIST_SUB_BUCKETS);
+    }
+    assert_int_equal(modbus_stats_percentile(&total.latency, 1.0), 1000000);
+    assert_true(modbus_stats_percentile(&total.latency, 0.0) <= 1000 + 1000 / MODBUS_STATS_HIST_SUB_BUCKETS);
+
+    modbus_stats_reset(&stats);
+    modbus_stats_aggregate(&stats, &total);
+    assert_int_equal(total.frames_by_function[0x03], 0);
+    assert_int_equal(total.latency.count, 0);
+    assert_int_equal(modbus_stats_percentile(&total.latency, 0.5), 0);
+    assert_int_equal(modbus_stats_percentile(NULL, 0.5), 0);
+
+    modbus_stats_free(&stats);
+}
+
+static void *record_main(void *arg) {
+    modbus_stats_shard_st *shard = arg;
+    for (uint32_t i = 0; i < FRAMES_PER_THREAD; i++) {
+        modbus_stats_frame(shard, (uint8_t)(i % 4), 0x03);
+        modbus_stats_latency(shard, i);
+        if ((i % 100) == 0) {
+            modbus_stats_error(shard, MODBUS_STATS_MASTER, (uint8_t)(i % 4), -2);
+        }
+    }
+    return NULL;
+}
+
+static void test_threads(void **state) {
+    (void) state;
+    modbus_stats_st stats;
+    modbus_stats_shard_st total;
+    pthread_t threads[THREADS];
+
+    assert_int_equal(modbus_stats_init(&stats, THREADS), 0);
+    for (int t = 0; t < THREADS; t++) {
+        assert_int_equal(pthread_create(&threads[t], NULL, record_main, modbus_stats_shard(&stats, t)), 0);
+    }
+
+    // Aggregating while the writers run sees counts that only grow
+    uint64_t seen = 0;
+    for (int i = 0; i < 50; i++) {
+        modbus_stats_aggregate(&stats, &total);
+        assert_true(total.frames_by_function[0x03] >= seen);
+        assert_true(total.frames_by_function[0x03] <= (uint64_t)THREADS * FRAMES_PER_THREAD);
+        seen = total.frames_by_function[0x03];
+    }
+
+    for (int t = 0; t < THREADS; t++) {
+        pthread_join(threads[t], NULL);
+    }
+    modbus_stats_aggregate(&stats, &total);
+    assert_int_equal(total.frames_by_function[0x03], THREADS * FRAMES_PER_THREAD);
+    for (int u = 0; u < 4; u++) {
+        assert_int_equal(total.frames_by_unit[u], THREADS * FRAMES_PER_THREAD / 4);
+    }
+    assert_int_equal(total.errors[MODBUS_STATS_MASTER][2], THREADS * FRAMES_PER_THREAD / 100);
+    assert_int_equal(total.latency.count, THREADS * FRAMES_PER_THREAD);
+    assert_int_equal(total.latency.max_ns, FRAMES_PER_THREAD - 1);
+
+    modbus_stats_free(&stats);
+}
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_init),
+        cmocka_unit_test(test_buckets),
+        cmocka_unit_test(test_counters_and_percentiles),
+        cmocka_unit_test(test_threads),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
@@ -0,0 +1,235 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdint.h>
+#include <string.h>
+#include <cmocka.h>
+
+#include "modbus_stream.h"
+#include "modbus_master.h"
+#include "modbus_slave.h"
+#include "modbus_tcp.h"
+#include "modbus_utils.h"
+
+#define RING_CAPACITY 512
+
+static uint8_t storage[MODBUS_STREAM_STORAGE_SIZE(RING_CAPACITY)];
+
+static void test_init_errors(void **state) {
+    (void) state;
+    modbus_stream_st s;
+    assert_int_equal(modbus_stream_init(NULL, MODBUS_STREAM_TCP, storage, sizeof(storage)), -1);
+    assert_int_equal(modbus_stream_init(&s, MODBUS_STREAM_TCP, NULL, sizeof(storage)), -1);
+    assert_int_equal(modbus_stream_init(&s, MODBUS_STREAM_TCP, storage, MODBUS_STREAM_MIRROR_SIZE), -1);
+    assert_int_equal(modbus_stream_init(&s, (modbus_stream_mode_et)7, storage, sizeof(storage)), -1);
+    assert_int_equal(modbus_stream_init(&s, MODBUS_STREAM_TCP, storage, sizeof(storage)), 0);
+    assert_int_equal(s.capacity, RING_CAPACITY);
+}
+
+static void test_rtu_requests_byte_by_byte(void **state) {
+    (void) state;
+    modbus_stream_st s;
+    modbus_master_ctx_st master;
+    modbus_slave_ctx_st slave;
+    modbus_master_ctx_init(&master);
+    modbus_slave_ctx_init(&slave);
+    set_device_slave_id(&slave, 1);
+    assert_int_equal(modbus_stream_init(&s, MODBUS_STREAM_RTU_REQUEST, storage, sizeof(storage)), 0);
+
+    // 200 requests fed one byte at a time: the ring wraps many times
+    for (int i = 0; i < 200; i++) {
+        uint8_t req[8];
+        assert_int_equal(encode_read_request(&master, 1, (uint16_t)i, 4, req, sizeof(req)), 8);
+
+        const uint8_t *frame = NULL;
+        for (int b = 0; b < 8; b++) {
+            assert_int_equal(modbus_stream_next_frame(&s, &frame), 0);
+            assert_int_equal(modbus_stream_feed(&s, &req[b], 1), 1);
+        }
+        assert_int_equal(modbus_stream_next_frame(&s, &frame), 8);
+
+        uint8_t id;
+        uint16_t addr, qty;
+        assert_int_equal(decode_read_request(&slave, frame, 8, &id, &addr, &qty), 0);
+        assert_int_equal(addr, i);
+    }
+    assert_int_equal(s.dropped_bytes, 0);
+}
+
+static void test_rtu_responses_coalesced(void **state) {
+    (void) state;
+    modbus_stream_st s;
+    modbus_master_ctx_st master;
+    modbus_slave_ctx_st slave;
+    modbus_master_ctx_init(&master);
+    modbus_slave_ctx_init(&slave);
+    assert_int_equal(modbus_stream_init(&s, MODBUS_STREAM_RTU_RESPONSE, storage, sizeof(storage)), 0);
+
+    uint8_t req[8];
+    encode_read_request(&master, 1, 0, 1, req, sizeof(req));
+
+    // Build a batch of responses of varying sizes and deliver it in odd-sized chunks
+    uint8_t batch[4096];
+    size_t batch_len = 0;
+    uint16_t regs[MODBUS_MAX_REGS];
+    for (int i = 0; i < MODBUS_MAX_REGS; i++) {
+        regs[i] = (uint16_t)(i * 3);
+    }
+    int frames = 0;
+    for (uint16_t qty = 1; batch_len + 300 < sizeof(batch); qty = (uint16_t)((qty + 7) % MODBUS_MAX_REGS + 1), frames++) {
+        batch_len += encode_read_response(&slave, 1, regs, qty, batch + batch_len, sizeof(batch) - batch_len);
+    }
+
+    size_t fed = 0;
+    int decoded = 0;
+    while (decoded < frames) {
+        size_t chunk = 37;
+        if (chunk > batch_len - fed) {
+            chunk = batch_len - fed;
+        }
+        fed += modbus_stream_feed(&s, batch + fed, chunk);
+
+        const uint8_t *frame;
+        int len;
+        while ((len = modbus_stream_next_frame(&s, &frame)) > 0) {
+            uint16_t out[MODBUS_MAX_REGS];
+            int ret = decode_read_response(&master, frame, (size_t)len, out, MODBUS_MAX_REGS);
+            assert_true(ret > 0);
+            assert_int_equal(out[ret - 1], (ret - 1) * 3);
+            decoded++;
+        }
+    }
+    assert_int_equal(fed, batch_len);
+    assert_int_equal(s.count, 0);
+}
+
+static void test_tcp_zero_copy_receive(void **state) {
+    (void) state;
+    modbus_stream_st s;
+    modbus_tcp_master_ctx_st master;
+    modbus_slave_ctx_st slave;
+    modbus_tcp_master_ctx_init(&master, MODBUS_TCP_MAX_PIPELINE);
+    modbus_slave_ctx_init(&slave);
+    set_device_slave_id(&slave, 1);
+    assert_int_equal(modbus_stream_init(&s, MODBUS_STREAM_TCP, storage, sizeof(storage)), 0);
+
+    for (int round = 0; round < 50; round++) {
+        uint8_t req[MODBUS_TCP_MAX_ADU_SIZE];
+        uint16_t len = encode_tcp_read_request(&master, 1, (uint16_t)round, 10, req, sizeof(req), NULL);
+
+        // Receive straight into the ring, possibly in two pieces at the wrap point
+        size_t done = 0;
+        while (done < len) {
+            size_t avail;
+            uint8_t *dst = modbus_stream_write_ptr(&s, &avail);
+            assert_non_null(dst);
+            size_t n = (len - done < avail) ? len - done : avail;
+            memcpy(dst, req + done, n);
+            assert_int_equal(modbus_stream_commit(&s, n), 0);
+            done += n;
+        }
+
+        const uint8_t *frame;
+        assert_int_equal(modbus_stream_next_frame(&s, &frame), len);
+        assert_true(frame >= storage && frame + len <= storage + sizeof(storage));
+
+        uint16_t tid, start, qty;
+        uint8_t unit;
+        assert_int_equal(decode_tcp_read_request(&slave, frame, (size_t)len, &tid, &unit, &start, &qty), 0);
+        assert_int_equal(start, round);
+        modbus_tcp_master_cancel(&master, tid);
+    }
+}
+
+static void test_resync_after_garbage(void **state) {
+    (void) state;
+    modbus_stream_st s;
+    modbus_master_ctx_st master;
+    modbus_master_ctx_init(&master);
+    assert_int_equal(modbus_stream_init(&s, MODBUS_STREAM_RTU_REQUEST, storage, sizeof(storage)), 0);
+
+    const uint8_t garbage[] = {0xFF, 0xFE, 0x01, 0x99};
+    uint8_t req[8];
+    encode_read_request(&master, 1, 42, 1, req, sizeof(req));
+
+    modbus_stream_feed(&s, garbage, sizeof(garbage));
+    modbus_stream_feed(&s, req, sizeof(req));
+
+    const uint8_t *frame;
+    assert_int_equal(modbus_stream_next_frame(&s, &frame), 8);
+    assert_memory_equal(frame, req, sizeof(req));
+    assert_int_equal(s.dropped_bytes, sizeof(garbage));
+}
+
+static void test_full_ring(void **state) {
+    (void) state;
+    modbus_stream_st s;
+    uint8_t junk[RING_CAPACITY + 10];
+    memset(junk, 0x01, sizeof(junk));
+    assert_int_equal(modbus_stream_init(&s, MODBUS_STREAM_TCP, storage, sizeof(storage)), 0);
+
+    assert_int_equal(modbus_stream_feed(&s, junk, sizeof(junk)), RING_CAPACITY);
+    size_t avail = 1;
+    assert_null(modbus_stream_write_ptr(&s, &avail));
+    assert_int_equal(avail, 0);
+    assert_int_equal(modbus_stream_commit(&s, 1), -1);
+
+    modbus_stream_reset(&s);
+    assert_int_equal(s.count, 0);
+    assert_non_null(modbus_stream_write_ptr(&s, &avail));
+}
+
+static void test_frame_length(void **state) {
+    (void) state;
+    const uint8_t exception[] = {0x01, 0x83, 0x02};
+    const uint8_t bad_count[] = {0x01, 0x03, 0x03};
+    const uint8_t partial[] = {0x01};
+    assert_int_equal(modbus_frame_length(MODBUS_STREAM_RTU_RESPONSE, exception, sizeof(exception)), 5);
+    assert_int_equal(modbus_frame_length(MODBUS_STREAM_RTU_RESPONSE, bad_count, sizeof(bad_count)), -1);
+    assert_int_equal(modbus_frame_length(MODBUS_STREAM_RTU_RESPONSE, partial, sizeof(partial)), 0);
+    assert_int_equal(modbus_frame_length(MODBUS_STREAM_TCP, partial, sizeof(partial)), 0);
+    assert_int_equal(modbus_frame_length(MODBUS_STREAM_TCP, NULL, 0), -1);
+}
+
+static void test_rtu_write_frames(void **state) {
+    (void) state;
+    modbus_stream_st s;
+    modbus_master_ctx_st master;
+    uint8_t pdu[MODBUS_MAX_PDU_SIZE], req[MODBUS_RTU_MAX_ADU_SIZE];
+    uint16_t values[MODBUS_MAX_RW_WRITE_REGS] = {0};
+    modbus_master_ctx_init(&master);
+    assert_int_equal(modbus_stream_init(&s, MODBUS_STREAM_RTU_REQUEST, storage, sizeof(storage)), 0);
+
+    // Variable-length writes are framed from their byte count
+    uint16_t pdu_len = modbus_pdu_encode_read_write(0, 1, 0, values, MODBUS_MAX_RW_WRITE_REGS, pdu, sizeof(pdu));
+    uint16_t len = encode_rtu_request(&master, 1, pdu, pdu_len, req, sizeof(req));
+    assert_int_equal(modbus_frame_length(MODBUS_STREAM_RTU_REQUEST, req, 10), 0);
+    assert_int_equal(modbus_frame_length(MODBUS_STREAM_RTU_REQUEST, req, 11), len);
+
+    for (uint16_t i = 0; i < len; i++) {
+        modbus_stream_feed(&s, &req[i], 1);
+    }
+    const uint8_t *frame;
+    assert_int_equal(modbus_stream_next_frame(&s, &frame), len);
+    assert_memory_equal(frame, req, len);
+
+    const uint8_t write_echo[] = {0x01, MODBUS_WRITE_MULTIPLE_REGS};
+    const uint8_t read_write[] = {0x01, MODBUS_READ_WRITE_MULTIPLE_REGS, 0x04};
+    assert_int_equal(modbus_frame_length(MODBUS_STREAM_RTU_RESPONSE, write_echo, sizeof(write_echo)), 8);
+    assert_int_equal(modbus_frame_length(MODBUS_STREAM_RTU_RESPONSE, read_write, sizeof(read_write)), 9);
+}
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_init_errors),
+        cmocka_unit_test(test_rtu_requests_byte_by_byte),
+        cmocka_unit_test(test_rtu_responses_coalesced),
+        cmocka_unit_test(test_tcp_zero_copy_receive),
+        cmocka_unit_test(test_resync_after_garbage),
+        cmocka_unit_test(test_full_ring),
+        cmocka_unit_test(test_frame_length),
+        cmocka_unit_test(test_rtu_write_frames),
+    };
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
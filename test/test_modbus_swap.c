@@ -0,0 +1,115 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdint.h>
+#include <string.h>
+#include <cmocka.h>
+
+#include "modbus_swap.h"
+#include "modbus_slave.h"
+#include "modbus_utils.h"
+
+static uint16_t test_regs[MODBUS_MAX_REGS];
+
+static void fill_test_regs(void) {
+    for (int i = 0; i < MODBUS_MAX_REGS; i++) {
+        test_regs[i] = (uint16_t)(0x1234 + i * 0x0101);
+    }
+}
+
+static void test_engines_bit_identical(void **state) {
+    (void) state;
+    fill_test_regs();
+
+    for (int e = MODBUS_SWAP_ENGINE_AUTO; e < MODBUS_SWAP_ENGINE_COUNT; e++) {
+        if (modbus_swap_set_engine((modbus_swap_engine_et)e) != 0) {
+            continue;
+        }
+        for (size_t qty = 0; qty <= MODBUS_MAX_REGS; qty++) {
+            uint8_t wire[MODBUS_MAX_REGS * 2 + 1];
+            uint16_t back[MODBUS_MAX_REGS + 1];
+            memset(wire, 0xAA, sizeof(wire));
+            back[qty] = 0xBEEF;
+
+            // Unaligned destination on purpose
+            modbus_regs_to_be(wire + 1, test_regs, qty);
+            for (size_t i = 0; i < qty; i++) {
+                assert_int_equal(wire[1 + i * 2], test_regs[i] >> 8);
+                assert_int_equal(wire[2 + i * 2], test_regs[i] & 0xFF);
+            }
+            assert_int_equal(wire[0], 0xAA);
+
+            modbus_regs_from_be(back, wire + 1, qty);
+            assert_memory_equal(back, test_regs, qty * sizeof(uint16_t));
+            assert_int_equal(back[qty], 0xBEEF);
+        }
+    }
+    assert_int_equal(modbus_swap_set_engine(MODBUS_SWAP_ENGINE_AUTO), 0);
+}
+
+static void test_fused_crc(void **state) {
+    (void) state;
+    fill_test_regs();
+
+    for (int e = MODBUS_SWAP_ENGINE_AUTO; e < MODBUS_SWAP_ENGINE_COUNT; e++) {
+        if (modbus_swap_set_engine((modbus_swap_engine_et)e) != 0) {
+            continue;
+        }
+        for (size_t qty = 1; qty <= MODBUS_MAX_REGS; qty++) {
+            uint8_t wire[MODBUS_MAX_REGS * 2];
+            uint16_t back[MODBUS_MAX_REGS];
+            modbus_crc16_ctx_st tx;
+            modbus_crc16_ctx_st rx;
+
+            modbus_crc16_init(&tx);
+            modbus_regs_to_be_crc(wire, test_regs, qty, &tx);
+            assert_int_equal(modbus_crc16_final(&tx), modbus_crc16(wire, qty * 2));
+
+            modbus_crc16_init(&rx);
+            modbus_regs_from_be_crc(back, wire, qty, &rx);
+            assert_int_equal(modbus_crc16_final(&rx), modbus_crc16_final(&tx));
+            assert_memory_equal(back, test_regs, qty * sizeof(uint16_t));
+        }
+    }
+    assert_int_equal(modbus_swap_set_engine(MODBUS_SWAP_ENGINE_AUTO), 0);
+}
+
+static void test_encoded_frames_identical(void **state) {
+    (void) state;
+    fill_test_regs();
+    uint8_t reference[256];
+    uint8_t frame[256];
+    modbus_slave_ctx_st ctx;
+    modbus_slave_ctx_init(&ctx);
+
+    assert_int_equal(modbus_swap_set_engine(MODBUS_SWAP_ENGINE_SCALAR), 0);
+    uint16_t ref_len = encode_read_response(&ctx, 1, test_regs, MODBUS_MAX_REGS, reference, sizeof(reference));
+    assert_int_equal(ref_len, 3 + MODBUS_MAX_REGS * 2 + 2);
+
+    for (int e = MODBUS_SWAP_ENGINE_AUTO; e < MODBUS_SWAP_ENGINE_COUNT; e++) {
+        if (modbus_swap_set_engine((modbus_swap_engine_et)e) != 0) {
+            continue;
+        }
+        memset(frame, 0, sizeof(frame));
+        assert_int_equal(encode_read_response(&ctx, 1, test_regs, MODBUS_MAX_REGS, frame, sizeof(frame)), ref_len);
+        assert_memory_equal(frame, reference, ref_len);
+    }
+    assert_int_equal(modbus_swap_set_engine(MODBUS_SWAP_ENGINE_AUTO), 0);
+}
+
+static void test_set_engine_invalid(void **state) {
+    (void) state;
+    assert_int_equal(modbus_swap_set_engine(MODBUS_SWAP_ENGINE_COUNT), -1);
+    assert_true(modbus_swap_engine_supported(MODBUS_SWAP_ENGINE_SCALAR));
+}
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_engines_bit_identical),
+        cmocka_unit_test(test_fused_crc),
+        cmocka_unit_test(test_encoded_frames_identical),
+        cmocka_unit_test(test_set_engine_invalid),
+    };
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
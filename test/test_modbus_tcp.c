@@ -0,0 +1,262 @@
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdint.h>
+#include <string.h>
+#include <cmocka.h>
+
+#include "modbus_tcp.h"
+#include "modbus_utils.h"
+
+static uint8_t test_unit_id = 1;
+static modbus_slave_ctx_st slave_ctx;
+
+// Answer a request ADU the way a slave would, with regs[i] = start + i
+static uint16_t serve(const uint8_t *request, size_t len, uint8_t *response) {
+    uint16_t tid, start, qty;
+    uint8_t unit;
+    uint16_t regs[MODBUS_MAX_REGS];
+
+    assert_int_equal(decode_tcp_read_request(&slave_ctx, request, len, &tid, &unit, &start, &qty), 0);
+    for (uint16_t i = 0; i < qty; i++) {
+        regs[i] = start + i;
+    }
+    return encode_tcp_read_response(&slave_ctx, tid, unit, regs, qty, response, MODBUS_TCP_MAX_ADU_SIZE);
+}
+
+static void test_mbap_header_roundtrip(void **state) {
+    (void) state;
+    uint8_t buffer[16] = {0};
+    assert_int_equal(encode_mbap_header(0x1234, 7, 5, buffer, sizeof(buffer)), MODBUS_MBAP_HEADER_SIZE);
+
+    const uint8_t expected[] = {0x12, 0x34, 0x00, 0x00, 0x00, 0x06, 0x07};
+    assert_memory_equal(buffer, expected, sizeof(expected));
+
+    uint16_t tid = 0, pdu_len = 0;
+    uint8_t unit = 0;
+    assert_int_equal(decode_mbap_header(buffer, sizeof(buffer), &tid, &unit, &pdu_len), 12);
+    assert_int_equal(tid, 0x1234);
+    assert_int_equal(unit, 7);
+    assert_int_equal(pdu_len, 5);
+}
+
+static void test_mbap_header_errors(void **state) {
+    (void) state;
+    uint8_t buffer[16] = {0};
+    assert_int_equal(encode_mbap_header(1, 1, 0, buffer, sizeof(buffer)), 0);
+    assert_int_equal(encode_mbap_header(1, 1, 5, buffer, 6), 0);
+    assert_int_equal(encode_mbap_header(1, 1, 5, NULL, 16), 0);
+
+    encode_mbap_header(1, 1, 5, buffer, sizeof(buffer));
+    assert_int_equal(decode_mbap_header(NULL, sizeof(buffer), NULL, NULL, NULL), -1);
+    assert_int_equal(decode_mbap_header(buffer, 6, NULL, NULL, NULL), -2);
+
+    buffer[3] = 1; // protocol ID
+    assert_int_equal(decode_mbap_header(buffer, sizeof(buffer), NULL, NULL, NULL), -3);
+    buffer[3] = 0;
+
+    buffer[5] = 1; // length below unit ID + function code
+    assert_int_equal(decode_mbap_header(buffer, sizeof(buffer), NULL, NULL, NULL), -4);
+    buffer[4] = 1; // length above 254
+    assert_int_equal(decode_mbap_header(buffer, sizeof(buffer), NULL, NULL, NULL), -4);
+}
+
+static void test_request_response_roundtrip(void **state) {
+    (void) state;
+    modbus_tcp_master_ctx_st ctx;
+    assert_int_equal(modbus_tcp_master_ctx_init(&ctx, 1), 0);
+
+    uint8_t request[MODBUS_TCP_MAX_ADU_SIZE];
+    uint8_t response[MODBUS_TCP_MAX_ADU_SIZE];
+    uint16_t tid = 0xFFFF;
+    uint16_t req_len = encode_tcp_read_request(&ctx, test_unit_id, 0x0258, 3, request, sizeof(request), &tid);
+    assert_int_equal(req_len, 12);
+    assert_int_equal(tid, 0);
+
+    const uint8_t expected[] = {0x00, 0x00, 0x00, 0x00, 0x00, 0x06, 0x01, 0x03, 0x02, 0x58, 0x00, 0x03};
+    assert_memory_equal(request, expected, sizeof(expected));
+
+    uint16_t resp_len = serve(request, req_len, response);
+    assert_int_equal(resp_len, 7 + 2 + 6);
+
+    uint16_t regs[3] = {0};
+    uint16_t resp_tid = 0xFFFF;
+    assert_int_equal(decode_tcp_read_response(&ctx, response, resp_len, regs, 3, &resp_tid), 3);
+    assert_int_equal(resp_tid, tid);
+    assert_int_equal(regs[0], 0x0258);
+    assert_int_equal(regs[2], 0x025A);
+    assert_int_equal(modbus_tcp_master_outstanding(&ctx), 0);
+}
+
+static void test_pipeline_out_of_order(void **state) {
+    (void) state;
+    modbus_tcp_master_ctx_st ctx;
+    assert_int_equal(modbus_tcp_master_ctx_init(&ctx, 4), 0);
+
+    uint8_t requests[4][MODBUS_TCP_MAX_ADU_SIZE];
+    uint16_t lens[4];
+    uint16_t tids[4];
+    for (int i = 0; i < 4; i++) {
+        lens[i] = encode_tcp_read_request(&ctx, test_unit_id, (uint16_t)(i * 100), 2, requests[i], MODBUS_TCP_MAX_ADU_SIZE, &tids[i]);
+        assert_true(lens[i] > 0);
+    }
+    assert_int_equal(modbus_tcp_master_outstanding(&ctx), 4);
+
+    // Pipeline is full
+    uint8_t extra[MODBUS_TCP_MAX_ADU_SIZE];
+    assert_int_equal(encode_tcp_read_request(&ctx, test_unit_id, 0, 2, extra, sizeof(extra), NULL), 0);
+
+    // Answer in reverse order; each response lands on its own request
+    for (int i = 3; i >= 0; i--) {
+        uint8_t response[MODBUS_TCP_MAX_ADU_SIZE];
+        uint16_t resp_len = serve(requests[i], lens[i], response);
+        uint16_t regs[2];
+        uint16_t tid;
+        assert_int_equal(decode_tcp_read_response(&ctx, response, resp_len, regs, 2, &tid), 2);
+        assert_int_equal(tid, tids[i]);
+        assert_int_equal(regs[0], i * 100);
+    }
+    assert_int_equal(modbus_tcp_master_outstanding(&ctx), 0);
+}
+
+static void test_response_errors(void **state) {
+    (void) state;
+    modbus_tcp_master_ctx_st ctx;
+    assert_int_equal(modbus_tcp_master_ctx_init(&ctx, 2), 0);
+    assert_int_equal(modbus_tcp_master_ctx_init(&ctx, 0), -1);
+    assert_int_equal(modbus_tcp_master_ctx_init(&ctx, MODBUS_TCP_MAX_PIPELINE + 1), -1);
+    assert_int_equal(modbus_tcp_master_ctx_init(&ctx, 2), 0);
+
+    uint8_t request[MODBUS_TCP_MAX_ADU_SIZE];
+    uint8_t response[MODBUS_TCP_MAX_ADU_SIZE];
+    uint16_t regs[2];
+    uint16_t tid;
+
+    uint16_t req_len = encode_tcp_read_request(&ctx, test_unit_id, 10, 2, request, sizeof(request), &tid);
+    uint16_t resp_len = serve(request, req_len, response);
+
+    assert_int_equal(decode_tcp_read_response(NULL, response, resp_len, regs, 2, NULL), -1);
+    assert_int_equal(decode_tcp_read_response(&ctx, response, resp_len, NULL, 2, NULL), -1);
+    assert_int_equal(decode_tcp_read_response(&ctx, response, 5, regs, 2, NULL), -5);
+
+    // A partial ADU keeps its transaction for the retry with the whole frame
+    assert_int_equal(decode_tcp_read_response(&ctx, response, 8, regs, 2, NULL), -5);
+    assert_int_equal(decode_tcp_read_response(&ctx, response, resp_len - 3, regs, 2, NULL), -5);
+    assert_int_equal(modbus_tcp_master_outstanding(&ctx), 1);
+
+    // Unknown transaction
+    response[1] ^= 0x55;
+    assert_int_equal(decode_tcp_read_response(&ctx, response, resp_len, regs, 2, NULL), -2);
+    response[1] ^= 0x55;
+
+    // Output array too small: transaction is consumed anyway
+    assert_int_equal(decode_tcp_read_response(&ctx, response, resp_len, regs, 1, NULL), -6);
+    assert_int_equal(modbus_tcp_master_outstanding(&ctx), 0);
+    assert_int_equal(decode_tcp_read_response(&ctx, response, resp_len, regs, 2, NULL), -2);
+
+    // Cancelled transactions are not matched
+    req_len = encode_tcp_read_request(&ctx, test_unit_id, 10, 2, request, sizeof(request), &tid);
+    resp_len = serve(request, req_len, response);
+    assert_int_equal(modbus_tcp_master_cancel(&ctx, tid), 0);
+    assert_int_equal(modbus_tcp_master_cancel(&ctx, tid), -1);
+    assert_int_equal(decode_tcp_read_response(&ctx, response, resp_len, regs, 2, NULL), -2);
+}
+
+static void test_decode_request_errors(void **state) {
+    (void) state;
+    modbus_tcp_master_ctx_st ctx;
+    modbus_tcp_master_ctx_init(&ctx, 1);
+    uint8_t request[MODBUS_TCP_MAX_ADU_SIZE];
+    uint16_t tid, start, qty;
+    uint8_t unit;
+
+    uint16_t len = encode_tcp_read_request(&ctx, 9, 10, 2, request, sizeof(request), NULL);
+    assert_int_equal(decode_tcp_read_request(&slave_ctx, request, len, &tid, &unit, &start, &qty), -4);
+    request[6] = MODBUS_TCP_UNIT_ID_IGNORED;
+    assert_int_equal(decode_tcp_read_request(&slave_ctx, request, len, &tid, &unit, &start, &qty), 0);
+    assert_int_equal(decode_tcp_read_request(&slave_ctx, request, len - 1, &tid, &unit, &start, &qty), -2);
+    assert_int_equal(decode_tcp_read_request(NULL, request, len, &tid, &unit, &start, &qty), -1);
+
+    request[7] = 0x04;
+    assert_int_equal(decode_tcp_read_request(&slave_ctx, request, len, &tid, &unit, &start, &qty), -5);
+    request[7] = MODBUS_READ_HOLDING_REG;
+    request[11] = 0; // qty = 0
+    assert_int_equal(decode_tcp_read_request(&slave_ctx, request, len, &tid, &unit, &start, &qty), -3);
+}
+
+static void test_any_pdu_roundtrip(void **state) {
+    (void) state;
+    modbus_tcp_master_ctx_st ctx;
+    modbus_tcp_master_ctx_init(&ctx, 2);
+    uint8_t pdu[MODBUS_MAX_PDU_SIZE], request[MODBUS_TCP_MAX_ADU_SIZE], response[MODBUS_TCP_MAX_ADU_SIZE];
+    uint16_t setpoint[1] = {500}, regs[3], tid_rw, tid_w;
+
+    uint16_t pdu_len = modbus_pdu_encode_read_write(100, 3, 101, setpoint, 1, pdu, sizeof(pdu));
+    uint16_t len = encode_tcp_request(&ctx, test_unit_id, pdu, pdu_len, request, sizeof(request), &tid_rw);
+    assert_int_equal(len, MODBUS_MBAP_HEADER_SIZE + pdu_len);
+    assert_int_equal(decode_mbap_header(request, len, NULL, NULL, NULL), len);
+    assert_memory_equal(request + MODBUS_MBAP_HEADER_SIZE, pdu, pdu_len);
+
+    pdu_len = modbus_pdu_encode_write_single(7, 1, pdu, sizeof(pdu));
+    assert_int_not_equal(encode_tcp_request(&ctx, test_unit_id, pdu, pdu_len, request, sizeof(request), &tid_w), 0);
+    assert_int_equal(encode_tcp_request(&ctx, test_unit_id, pdu, pdu_len, request, sizeof(request), NULL), 0);
+
+    // Answers arrive out of order; each is matched to its own function code
+    const uint8_t echo[] = {MODBUS_WRITE_SINGLE_REG, 0x00, 0x07, 0x00, 0x01};
+    encode_mbap_header(tid_w, test_unit_id, sizeof(echo), response, sizeof(response));
+    memcpy(response + MODBUS_MBAP_HEADER_SIZE, echo, sizeof(echo));
+    assert_int_equal(decode_tcp_response(&ctx, response, MODBUS_MBAP_HEADER_SIZE + sizeof(echo), NULL, 0, NULL), 0);
+
+    const uint8_t rw[] = {MODBUS_READ_WRITE_MULTIPLE_REGS, 6, 0x00, 0x01, 0x01, 0xF4, 0x00, 0x03};
+    encode_mbap_header(tid_rw, test_unit_id, sizeof(rw), response, sizeof(response));
+    memcpy(response + MODBUS_MBAP_HEADER_SIZE, rw, sizeof(rw));
+    assert_int_equal(decode_tcp_response(&ctx, response, MODBUS_MBAP_HEADER_SIZE + sizeof(rw), regs, 3, NULL), 3);
+    assert_int_equal(regs[1], 500);
+    assert_int_equal(modbus_tcp_master_outstanding(&ctx), 0);
+
+    // A partial ADU keeps its transaction for the retry with the whole frame
+    pdu_len = modbus_pdu_encode_write_single(7, 1, pdu, sizeof(pdu));
+    encode_tcp_request(&ctx, test_unit_id, pdu, pdu_len, request, sizeof(request), &tid_w);
+    encode_mbap_header(tid_w, test_unit_id, sizeof(echo), response, sizeof(response));
+    memcpy(response + MODBUS_MBAP_HEADER_SIZE, echo, sizeof(echo));
+    assert_int_equal(decode_tcp_response(&ctx, response, MODBUS_MBAP_HEADER_SIZE + 2, NULL, 0, NULL), -5);
+    assert_int_equal(modbus_tcp_master_outstanding(&ctx), 1);
+    assert_int_equal(decode_tcp_response(&ctx, response, MODBUS_MBAP_HEADER_SIZE + sizeof(echo), NULL, 0, NULL), 0);
+    assert_int_equal(modbus_tcp_master_outstanding(&ctx), 0);
+
+    // Exception and mismatched answers
+    uint16_t tid;
+    pdu_len = modbus_pdu_encode_read(MODBUS_READ_INPUT_REG, 0, 2, pdu, sizeof(pdu));
+    encode_tcp_request(&ctx, test_unit_id, pdu, pdu_len, request, sizeof(request), &tid);
+    const uint8_t ex[] = {MODBUS_READ_INPUT_REG | MODBUS_EXCEPTION_FLAG, MODBUS_EX_ILLEGAL_FUNCTION};
+    encode_mbap_header(tid, test_unit_id, sizeof(ex), response, sizeof(response));
+    memcpy(response + MODBUS_MBAP_HEADER_SIZE, ex, sizeof(ex));
+    assert_int_equal(decode_tcp_response(&ctx, response, MODBUS_MBAP_HEADER_SIZE + sizeof(ex), regs, 3, NULL), -8);
+
+    encode_tcp_request(&ctx, test_unit_id, pdu, pdu_len, request, sizeof(request), &tid);
+    const uint8_t short_read[] = {MODBUS_READ_INPUT_REG, 2, 0x00, 0x01};
+    encode_mbap_header(tid, test_unit_id, sizeof(short_read), response, sizeof(response));
+    memcpy(response + MODBUS_MBAP_HEADER_SIZE, short_read, sizeof(short_read));
+    assert_int_equal(decode_tcp_response(&ctx, response, MODBUS_MBAP_HEADER_SIZE + sizeof(short_read), regs, 3, NULL), -4);
+    assert_int_equal(decode_tcp_response(&ctx, response, MODBUS_MBAP_HEADER_SIZE + sizeof(short_read), regs, 3, NULL), -2);
+
+    assert_int_equal(encode_tcp_request(&ctx, test_unit_id, pdu, pdu_len - 1, request, sizeof(request), NULL), 0);
+    assert_int_equal(decode_tcp_response(NULL, response, sizeof(response), regs, 3, NULL), -1);
+}
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_mbap_header_roundtrip),
+        cmocka_unit_test(test_mbap_header_errors),
+        cmocka_unit_test(test_request_response_roundtrip),
+        cmocka_unit_test(test_pipeline_out_of_order),
+        cmocka_unit_test(test_response_errors),
+        cmocka_unit_test(test_decode_request_errors),
+        cmocka_unit_test(test_any_pdu_roundtrip),
+    };
+
+    modbus_slave_ctx_init(&slave_ctx);
+    set_device_slave_id(&slave_ctx, test_unit_id);
+
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
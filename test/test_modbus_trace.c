@@ -0,0 +1,241 @@
+#define _GNU_SOURCE
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <stdbool.h>
+#include <setjmp.h>
+#include <stdint.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <cmocka.h>
+
+#include "modbus_trace.h"
+
+#define WRITER_RECORDS 2000000
+
+static modbus_trace_record_st make_record(uint64_t n) {
+    modbus_trace_record_st r = {
+        .transaction_id = (uint16_t)n,
+        .unit_id = (uint8_t)(n >> 16),
+        .function_code = 0x03,
+        .status = (int32_t)(n & 0x7F),
+    };
+    // Every word derived from n, so a record mixed from two writes is easy to spot
+    for (int s = 0; s < MODBUS_TRACE_STAGES; s++) {
+        r.ns[s] = n * MODBUS_TRACE_STAGES + (uint64_t)s + 1;
+    }
+    return r;
+}
+
+static void check_record(const modbus_trace_record_st *r, uint64_t n) {
+    modbus_trace_record_st want = make_record(n);
+    assert_memory_equal(r, &want, sizeof(want));
+}
+
+static void test_init(void **state) {
+    (void) state;
+    modbus_trace_st trace;
+
+    assert_int_equal(modbus_trace_init(NULL, 1, 8), -1);
+    assert_int_equal(modbus_trace_init(&trace, 0, 8), -1);
+    assert_int_equal(modbus_trace_init(&trace, 1025, 8), -1);
+    assert_int_equal(modbus_trace_init(&trace, 1, 1), -1);
+    assert_int_equal(modbus_trace_init(&trace, 1, 12), -1);
+    assert_int_equal(modbus_trace_init(&trace, 1, MODBUS_TRACE_MAX_CAPACITY * 2), -1);
+    assert_int_equal(modbus_trace_init(&trace, 3, 8), 0);
+
+    for (uint32_t i = 0; i < 3; i++) {
+        modbus_trace_ring_st *ring = modbus_trace_ring(&trace, i);
+        assert_non_null(ring);
+        assert_int_equal((uintptr_t)ring % MODBUS_CACHE_LINE_SIZE, 0);
+        assert_int_equal(ring->mask, 7);
+    }
+    assert_null(modbus_trace_ring(&trace, 3));
+
+    // A NULL ring means tracing is off
+    modbus_trace_record_st r = make_record(1);
+    modbus_trace_record(NULL, &r);
+
+    modbus_trace_free(&trace);
+    assert_null(trace.rings);
+    modbus_trace_free(NULL);
+}
+
+static void test_read_and_wrap(void **state) {
+    (void) state;
+    modbus_trace_st trace;
+    modbus_trace_record_st out[16];
+    uint64_t cursor = 0;
+
+    assert_int_equal(modbus_trace_init(&trace, 1, 8), 0);
+    modbus_trace_ring_st *ring = modbus_trace_ring(&trace, 0);
+    assert_int_equal(modbus_trace_read(ring, &cursor, out, 16), 0);
+
+    for (uint64_t n = 0; n < 5; n++) {
+        modbus_trace_record_st r = make_record(n);
+        modbus_trace_record(ring, &r);
+    }
+    assert_int_equal(modbus_trace_read(ring, &cursor, out, 2), 2);
+    assert_int_equal(cursor, 2);
+    assert_int_equal(modbus_trace_read(ring, &cursor, out + 2, 16), 3);
+    assert_int_equal(cursor, 5);
+    for (uint64_t n = 0; n < 5; n++) {
+        check_record(&out[n], n);
+    }
+
+    // 15 more: the ring only holds the last 8, and the cursor skips what was lost
+    for (uint64_t n = 5; n < 20; n++) {
+        modbus_trace_record_st r = make_record(n);
+        modbus_trace_record(ring, &r);
+    }
+    assert_int_equal(modbus_trace_read(ring, &cursor, out, 16), 8);
+    assert_int_equal(cursor, 20);
+    for (uint64_t n = 0; n < 8; n++) {
+        check_record(&out[n], 12 + n);
+    }
+
+    // A cursor ahead of the ring starts at its head
+    cursor = 1000;
+    assert_int_equal(modbus_trace_read(ring, &cursor, out, 16), 0);
+    assert_int_equal(cursor, 20);
+
+    modbus_trace_free(&trace);
+}
+
+static void test_breakdown(void **state) {
+    (void) state;
+    modbus_trace_st trace;
+    modbus_trace_breakdown_st breakdown;
+    uint64_t cursors[2] = {0};
+
+    memset(&breakdown, 0, sizeof(breakdown));
+    assert_int_equal(modbus_trace_init(&trace, 2, 4), 0);
+
+    modbus_trace_record_st full = {.ns = {1000, 1100, 1300, 1600, 2000}};
+    modbus_trace_record_st no_kernel = {.ns = {5000, 5010, 0, 5400, 5500}};
+    modbus_trace_record(modbus_trace_ring(&trace, 0), &full);
+    modbus_trace_record(modbus_trace_ring(&trace, 1), &no_kernel);
+    for (int i = 0; i < 6; i++) {
+        modbus_trace_record(modbus_trace_ring(&trace, 1), &full);
+    }
+
+    // Ring 1 holds 4 of its 7 records
+    assert_int_equal(modbus_trace_collect(&trace, cursors, &breakdown), 5);
+    assert_int_equal(breakdown.records, 5);
+    assert_int_equal(breakdown.lost, 3);
+    assert_int_equal(breakdown.spans[MODBUS_TRACE_SPAN_SUBMIT].count, 5);
+    assert_int_equal(breakdown.spans[MODBUS_TRACE_SPAN_SUBMIT].max_ns, 100);
+    assert_int_equal(breakdown.spans[MODBUS_TRACE_SPAN_WIRE].sum_ns, 5 * 200);
+    assert_int_equal(breakdown.spans[MODBUS_TRACE_SPAN_QUEUE].sum_ns, 5 * 300);
+    assert_int_equal(breakdown.spans[MODBUS_TRACE_SPAN_DECODE].sum_ns, 5 * 400);
+    assert_int_equal(breakdown.spans[MODBUS_TRACE_SPAN_TOTAL].max_ns, 1000);
+
+    // Nothing new: nothing folded. A record without a kernel stamp has no wire or queue span
+    assert_int_equal(modbus_trace_collect(&trace, cursors, &breakdown), 0);
+    memset(&breakdown, 0, sizeof(breakdown));
+    modbus_trace_breakdown_add(&breakdown, &no_kernel);
+    assert_int_equal(breakdown.spans[MODBUS_TRACE_SPAN_SUBMIT].sum_ns, 10);
+    assert_int_equal(breakdown.spans[MODBUS_TRACE_SPAN_WIRE].count, 0);
+    assert_int_equal(breakdown.spans[MODBUS_TRACE_SPAN_QUEUE].count, 0);
+    assert_int_equal(breakdown.spans[MODBUS_TRACE_SPAN_DECODE].sum_ns, 100);
+    assert_int_equal(breakdown.spans[MODBUS_TRACE_SPAN_TOTAL].sum_ns, 500);
+    assert_int_equal(modbus_trace_collect(NULL, cursors, &breakdown), -1);
+
+    modbus_trace_free(&trace);
+}
+
+static void test_rx_timestamp(void **state) {
+    (void) state;
+    struct sockaddr_in addr = {.sin_family = AF_INET};
+    socklen_t addr_len = sizeof(addr);
+    inet_pton(AF_INET, "127.0.0.1", &addr.sin_addr);
+
+    int rx = socket(AF_INET, SOCK_DGRAM, 0);
+    int tx = socket(AF_INET, SOCK_DGRAM, 0);
+    assert_int_equal(bind(rx, (struct sockaddr *)&addr, sizeof(addr)), 0);
+    assert_int_equal(getsockname(rx, (struct sockaddr *)&addr, &addr_len), 0);
+    assert_int_equal(modbus_trace_enable_rx_timestamps(rx), 0);
+    assert_int_equal(modbus_trace_enable_rx_timestamps(-1), -1);
+
+    uint64_t before = modbus_trace_now_ns();
+    assert_int_equal(sendto(tx, "x", 1, 0, (struct sockaddr *)&addr, sizeof(addr)), 1);
+
+    char byte;
+    struct iovec iov = {.iov_base = &byte, .iov_len = 1};
+    union {
+        struct cmsghdr align;
+        uint8_t buf[MODBUS_TRACE_CMSG_SIZE];
+    } control;
+    struct msghdr msg = {.msg_iov = &iov, .msg_iovlen = 1, .msg_control = control.buf,
+                         .msg_controllen = sizeof(control.buf)};
+    assert_int_equal(recvmsg(rx, &msg, 0), 1);
+    uint64_t after = modbus_trace_now_ns();
+
+    uint64_t stamp = modbus_trace_rx_timestamp(&msg);
+    assert_true(stamp >= before);
+    assert_true(stamp <= after);
+
+    msg.msg_control = NULL;
+    assert_int_equal(modbus_trace_rx_timestamp(&msg), 0);
+    assert_int_equal(modbus_trace_rx_timestamp(NULL), 0);
+
+    close(rx);
+    close(tx);
+}
+
+static void *writer_main(void *arg) {
+    modbus_trace_ring_st *ring = arg;
+    for (uint64_t n = 0; n < WRITER_RECORDS; n++) {
+        modbus_trace_record_st r = make_record(n);
+        modbus_trace_record(ring, &r);
+    }
+    return NULL;
+}
+
+static void test_concurrent_reader(void **state) {
+    (void) state;
+    modbus_trace_st trace;
+    static modbus_trace_record_st out[64];
+    pthread_t writer;
+
+    assert_int_equal(modbus_trace_init(&trace, 1, 64), 0);
+    modbus_trace_ring_st *ring = modbus_trace_ring(&trace, 0);
+    assert_int_equal(pthread_create(&writer, NULL, writer_main, ring), 0);
+
+    // Read while the writer laps the small ring: records may be lost, never torn or reordered
+    uint64_t cursor = 0, seen = 0, last = 0;
+    bool running;
+    uint32_t got;
+    do {
+        running = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) < WRITER_RECORDS;
+        got = modbus_trace_read(ring, &cursor, out, 64);
+        for (uint32_t i = 0; i < got; i++) {
+            uint64_t n = out[i].ns[0] / MODBUS_TRACE_STAGES;
+            check_record(&out[i], n);
+            assert_true((seen == 0) || (n > last));
+            last = n;
+            seen++;
+        }
+    } while (running || (got == 64));
+    pthread_join(writer, NULL);
+
+    assert_int_equal(cursor, WRITER_RECORDS);
+    assert_int_equal(last, WRITER_RECORDS - 1);
+    assert_true(seen > 0);
+
+    modbus_trace_free(&trace);
+}
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_init),
+        cmocka_unit_test(test_read_and_wrap),
+        cmocka_unit_test(test_breakdown),
+        cmocka_unit_test(test_rx_timestamp),
+        cmocka_unit_test(test_concurrent_reader),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
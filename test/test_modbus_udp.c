@@ -0,0 +1,402 @@
+#define _GNU_SOURCE
+
+#include <stdarg.h>
+#include <stddef.h>
+#include <setjmp.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <cmocka.h>
+
+#include "modbus_udp.h"
+#include "modbus_pdu.h"
+
+#define QTY 10
+
+static uint16_t holding[256];
+
+static int read_regs(void *arg, uint8_t unit_id, uint16_t start_addr, uint16_t qty, uint16_t *regs) {
+    (void) arg;
+    for (uint16_t i = 0; i < qty; i++) {
+        regs[i] = (uint16_t)(unit_id * 1000 + start_addr + i);
+    }
+    return 0;
+}
+
+static int read_wire(void *arg, uint8_t unit_id, uint16_t start_addr, uint16_t qty, uint8_t *dst) {
+    (void) arg;
+    for (uint16_t i = 0; i < qty; i++) {
+        uint16_t v = (uint16_t)(unit_id * 1000 + start_addr + i);
+        dst[i * 2] = (uint8_t)(v >> 8);
+        dst[i * 2 + 1] = (uint8_t)v;
+    }
+    return 0;
+}
+
+static int write_regs(void *arg, uint8_t unit_id, uint16_t start_addr, uint16_t qty, const uint16_t *values) {
+    (void) arg;
+    (void) unit_id;
+    if (start_addr + qty > 256) {
+        return -1;
+    }
+    memcpy(&holding[start_addr], values, qty * sizeof(*values));
+    return 0;
+}
+
+static void start_server(modbus_udp_server_st *srv, uint8_t slave_id, modbus_server_read_wire_fn wire) {
+    modbus_server_config_st cfg = {
+        .bind_addr = "127.0.0.1",
+        .slave_id = slave_id,
+        .read_cb = read_regs,
+        .read_wire_cb = wire,
+        .write_cb = write_regs,
+    };
+    assert_int_equal(modbus_udp_server_init(srv, &cfg), 0);
+    assert_true(modbus_udp_server_port(srv) != 0);
+}
+
+static void test_init(void **state) {
+    (void) state;
+    modbus_udp_server_st srv;
+    modbus_udp_master_st master;
+    modbus_server_config_st cfg = {.slave_id = 1};
+
+    assert_int_equal(modbus_udp_server_init(NULL, &cfg), -1);
+    assert_int_equal(modbus_udp_server_init(&srv, &cfg), -1);
+    cfg.read_cb = read_regs;
+    cfg.bind_addr = "not an address";
+    assert_int_equal(modbus_udp_server_init(&srv, &cfg), -1);
+
+    assert_int_equal(modbus_udp_master_init(NULL, 4), -1);
+    assert_int_equal(modbus_udp_master_init(&master, 0), -1);
+    assert_int_equal(modbus_udp_master_init(&master, 2), 0);
+
+    assert_int_equal(modbus_udp_master_add_device(&master, "127.0.0.1", 0, 1), -1);
+    assert_int_equal(modbus_udp_master_add_device(&master, "127.0.0.1", 1502, 0), -1);
+    assert_int_equal(modbus_udp_master_add_device(&master, "127.0.0.1", 1502, MODBUS_TCP_MAX_PIPELINE + 1), -1);
+    assert_int_equal(modbus_udp_master_add_device(&master, "localhost", 1502, 1), -1);
+    assert_int_equal(modbus_udp_master_add_device(&master, "127.0.0.1", 1502, 1), 0);
+    assert_int_equal(modbus_udp_master_add_device(&master, "127.0.0.1", 1502, 1), -3);
+    assert_int_equal(modbus_udp_master_add_device(&master, "127.0.0.1", 1503, 1), 1);
+    assert_int_equal(modbus_udp_master_add_device(&master, "127.0.0.1", 1504, 1), -2);
+
+    assert_true(modbus_udp_master_ctx(&master, 1) == &master.devices[1].ctx);
+    assert_true(modbus_udp_master_ctx(&master, 2) == NULL);
+
+    // A context that is not one of the master's devices has no address
+    modbus_batch_st batch;
+    modbus_tcp_master_ctx_st other;
+    uint16_t regs[QTY];
+    modbus_tcp_master_ctx_init(&other, 1);
+    assert_int_equal(modbus_batch_init(&batch, 4, 64), 0);
+    assert_int_equal(modbus_batch_add_read(&batch, &other, 1, 0, QTY, regs), 0);
+    assert_int_equal(modbus_udp_master_send(&master, &batch), -2);
+    assert_int_equal(modbus_udp_master_send(NULL, &batch), -1);
+    assert_int_equal(modbus_udp_master_recv(&master, NULL, 0), -1);
+    assert_int_equal(modbus_udp_master_recv(&master, &batch, 0), 0);
+
+    modbus_batch_free(&batch);
+    modbus_udp_master_deinit(&master);
+}
+
+static void test_round_trip(void **state) {
+    (void) state;
+    modbus_udp_server_st servers[2];
+    modbus_udp_master_st master;
+    modbus_batch_st batch;
+    uint16_t regs[2][4][QTY];
+
+    // One server answers 0x03 from the wire callback, the other through the dispatcher
+    start_server(&servers[0], 1, read_wire);
+    start_server(&servers[1], 2, NULL);
+    assert_int_equal(modbus_udp_master_init(&master, 4), 0);
+    for (int s = 0; s < 2; s++) {
+        assert_int_equal(modbus_udp_master_add_device(&master, "127.0.0.1", modbus_udp_server_port(&servers[s]), 4), s);
+    }
+
+    assert_int_equal(modbus_batch_init(&batch, 8, 8 * 12), 0);
+    for (int r = 0; r < 4; r++) {
+        for (uint8_t s = 0; s < 2; s++) {
+            assert_true(modbus_batch_add_read(&batch, modbus_udp_master_ctx(&master, s), s + 1, r * 100, QTY,
+                                              regs[s][r]) >= 0);
+        }
+    }
+    assert_int_equal(modbus_udp_master_send(&master, &batch), 8);
+    assert_int_equal(master.stats.tx_calls, 1);
+
+    // Each server takes its four requests in one recvmmsg() and answers in one sendmmsg()
+    for (int s = 0; s < 2; s++) {
+        assert_int_equal(modbus_udp_server_poll(&servers[s], 1000), 4);
+        assert_int_equal(servers[s].stats.rx_calls, 1);
+        assert_int_equal(servers[s].stats.tx_calls, 1);
+    }
+
+    int completed = 0;
+    while (completed < 8) {
+        int n = modbus_udp_master_recv(&master, &batch, 1000);
+        assert_true(n > 0);
+        completed += n;
+    }
+    assert_int_equal(batch.answered, 8);
+    for (uint32_t i = 0; i < batch.count; i++) {
+        assert_int_equal(batch.frames[i].status, QTY);
+    }
+    for (int s = 0; s < 2; s++) {
+        assert_int_equal(modbus_tcp_master_outstanding(modbus_udp_master_ctx(&master, s)), 0);
+        for (int r = 0; r < 4; r++) {
+            for (int i = 0; i < QTY; i++) {
+                assert_int_equal(regs[s][r][i], (s + 1) * 1000 + r * 100 + i);
+            }
+        }
+    }
+    assert_int_equal(master.stats.requests, 8);
+    assert_int_equal(master.stats.unknown, 0);
+
+    modbus_batch_free(&batch);
+    modbus_udp_master_deinit(&master);
+    modbus_udp_server_deinit(&servers[0]);
+    modbus_udp_server_deinit(&servers[1]);
+}
+
+static void test_write_and_exception(void **state) {
+    (void) state;
+    modbus_udp_server_st srv;
+    modbus_udp_master_st master;
+    modbus_batch_st batch;
+    uint8_t pdu[MODBUS_MAX_PDU_SIZE];
+    uint16_t in_regs[QTY];
+
+    start_server(&srv, 7, NULL);
+    assert_int_equal(modbus_udp_master_init(&master, 1), 0);
+    assert_int_equal(modbus_udp_master_add_device(&master, "127.0.0.1", modbus_udp_server_port(&srv), 2), 0);
+    modbus_tcp_master_ctx_st *ctx = modbus_udp_master_ctx(&master, 0);
+
+    assert_int_equal(modbus_batch_init(&batch, 2, 64), 0);
+    size_t len = modbus_pdu_encode_write_single(42, 0xBEEF, pdu, sizeof(pdu));
+    assert_int_equal(modbus_batch_add_request(&batch, ctx, 7, pdu, len, NULL, 0), 0);
+    len = modbus_pdu_encode_read(MODBUS_READ_INPUT_REG, 0, QTY, pdu, sizeof(pdu));
+    assert_int_equal(modbus_batch_add_request(&batch, ctx, 7, pdu, len, in_regs, QTY), 1);
+
+    assert_int_equal(modbus_udp_master_send(&master, &batch), 2);
+    assert_int_equal(modbus_udp_server_poll(&srv, 1000), 2);
+    assert_int_equal(srv.stats.exceptions, 1);
+    while (batch.answered < 2) {
+        assert_true(modbus_udp_master_recv(&master, &batch, 1000) > 0);
+    }
+    assert_int_equal(batch.frames[0].status, 0);
+    assert_int_equal(holding[42], 0xBEEF);
+    assert_int_equal(batch.frames[1].status, -8);
+
+    modbus_batch_free(&batch);
+    modbus_udp_master_deinit(&master);
+    modbus_udp_server_deinit(&srv);
+}
+
+static void test_bad_datagrams(void **state) {
+    (void) state;
+    modbus_udp_server_st srv;
+    modbus_udp_master_st master;
+    modbus_batch_st batch;
+    uint16_t regs[QTY];
+    uint8_t frame[MODBUS_TCP_MAX_ADU_SIZE];
+    uint8_t pdu[5];
+
+    start_server(&srv, 1, read_wire);
+    assert_int_equal(modbus_udp_master_init(&master, 1), 0);
+    assert_int_equal(modbus_udp_master_add_device(&master, "127.0.0.1", modbus_udp_server_port(&srv), 1), 0);
+    modbus_tcp_master_ctx_st *ctx = modbus_udp_master_ctx(&master, 0);
+
+    struct sockaddr_in srv_addr = {.sin_family = AF_INET, .sin_port = htons(modbus_udp_server_port(&srv))};
+    srv_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    int raw = socket(AF_INET, SOCK_DGRAM, 0);
+    assert_true(raw >= 0);
+
+    // Server side: a frame with trailing bytes, a cut frame, another unit: dropped
+    modbus_tcp_master_ctx_st raw_ctx;
+    modbus_tcp_master_ctx_init(&raw_ctx, 4);
+    modbus_pdu_encode_read(MODBUS_READ_HOLDING_REG, 0, QTY, pdu, sizeof(pdu));
+    uint16_t len = encode_tcp_request(&raw_ctx, 1, pdu, sizeof(pdu), frame, sizeof(frame), NULL);
+    assert_int_equal(sendto(raw, frame, len + 1, 0, (struct sockaddr *)&srv_addr, sizeof(srv_addr)), len + 1);
+    assert_int_equal(sendto(raw, frame, len - 1, 0, (struct sockaddr *)&srv_addr, sizeof(srv_addr)), len - 1);
+    len = encode_tcp_request(&raw_ctx, 9, pdu, sizeof(pdu), frame, sizeof(frame), NULL);
+    assert_int_equal(sendto(raw, frame, len, 0, (struct sockaddr *)&srv_addr, sizeof(srv_addr)), len);
+    assert_int_equal(modbus_udp_server_poll(&srv, 1000), 0);
+    assert_int_equal(srv.stats.errors, 3);
+    assert_int_equal(srv.stats.tx_datagrams, 0);
+
+    // Master side: a response from an unregistered address completes nothing
+    assert_int_equal(modbus_batch_init(&batch, 1, 16), 0);
+    assert_int_equal(modbus_batch_add_read(&batch, ctx, 1, 0, QTY, regs), 0);
+    assert_int_equal(modbus_udp_master_send(&master, &batch), 1);
+    socklen_t addr_len = sizeof(struct sockaddr_in);
+    struct sockaddr_in master_addr;
+    getsockname(master.fd, (struct sockaddr *)&master_addr, &addr_len);
+    master_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    uint8_t resp_pdu[2 + QTY * 2] = {MODBUS_READ_HOLDING_REG, QTY * 2};
+    len = encode_mbap_header(batch.frames[0].transaction_id, 1, sizeof(resp_pdu), frame, sizeof(frame));
+    memcpy(frame + len, resp_pdu, sizeof(resp_pdu));
+    len += sizeof(resp_pdu);
+    assert_int_equal(sendto(raw, frame, len, 0, (struct sockaddr *)&master_addr, sizeof(master_addr)), len);
+    assert_int_equal(modbus_udp_master_recv(&master, &batch, 1000), 0);
+    assert_int_equal(master.stats.unknown, 1);
+    assert_int_equal(batch.answered, 0);
+
+    // The real answer still completes the request
+    assert_int_equal(modbus_udp_server_poll(&srv, 1000), 1);
+    assert_int_equal(modbus_udp_master_recv(&master, &batch, 1000), 1);
+    assert_int_equal(batch.frames[0].status, QTY);
+    assert_int_equal(regs[QTY - 1], 1000 + QTY - 1);
+
+    close(raw);
+    modbus_batch_free(&batch);
+    modbus_udp_master_deinit(&master);
+    modbus_udp_server_deinit(&srv);
+}
+
+static int failing_wire(void *arg, uint8_t unit_id, uint16_t start_addr, uint16_t qty, uint8_t *dst) {
+    return (start_addr >= 1000) ? -1 : read_wire(arg, unit_id, start_addr, qty, dst);
+}
+
+static void test_read_exceptions(void **state) {
+    (void) state;
+    static const struct {
+        uint16_t addr;
+        uint16_t qty;
+        uint8_t code;
+    } cases[] = {
+        {0, 0, MODBUS_EX_ILLEGAL_DATA_VALUE},
+        {0, MODBUS_MAX_REGS + 1, MODBUS_EX_ILLEGAL_DATA_VALUE},
+        {0xFFF0, MODBUS_MAX_REGS, MODBUS_EX_ILLEGAL_DATA_ADDRESS},
+        {1000, 1, MODBUS_EX_SLAVE_DEVICE_FAILURE},
+    };
+    modbus_udp_server_st srv;
+    modbus_tcp_master_ctx_st ctx;
+    uint8_t frame[MODBUS_TCP_MAX_ADU_SIZE];
+
+    start_server(&srv, 1, failing_wire);
+    modbus_tcp_master_ctx_init(&ctx, 1);
+    struct sockaddr_in srv_addr = {.sin_family = AF_INET, .sin_port = htons(modbus_udp_server_port(&srv))};
+    srv_addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    int raw = socket(AF_INET, SOCK_DGRAM, 0);
+    assert_true(raw >= 0);
+
+    // A bad read is answered, never dropped: the master can tell it from a lost datagram
+    for (size_t i = 0; i < sizeof(cases) / sizeof(cases[0]); i++) {
+        uint8_t pdu[5] = {MODBUS_READ_HOLDING_REG, (uint8_t)(cases[i].addr >> 8), (uint8_t)cases[i].addr,
+                          (uint8_t)(cases[i].qty >> 8), (uint8_t)cases[i].qty};
+        uint16_t len = encode_tcp_request(&ctx, 1, pdu, sizeof(pdu), frame, sizeof(frame), NULL);
+        assert_int_equal(sendto(raw, frame, len, 0, (struct sockaddr *)&srv_addr, sizeof(srv_addr)), len);
+        assert_int_equal(modbus_udp_server_poll(&srv, 1000), 1);
+        assert_int_equal(recv(raw, frame, sizeof(frame), 0), MODBUS_MBAP_HEADER_SIZE + 2);
+        assert_int_equal(decode_tcp_response(&ctx, frame, MODBUS_MBAP_HEADER_SIZE + 2, NULL, 0, NULL), -8);
+        assert_int_equal(frame[MODBUS_MBAP_HEADER_SIZE], MODBUS_READ_HOLDING_REG | MODBUS_EXCEPTION_FLAG);
+        assert_int_equal(frame[MODBUS_MBAP_HEADER_SIZE + 1], cases[i].code);
+    }
+    assert_int_equal(srv.stats.exceptions, 4);
+    assert_int_equal(srv.stats.errors, 0);
+
+    close(raw);
+    modbus_udp_server_deinit(&srv);
+}
+
+static void test_bursts(void **state) {
+    (void) state;
+    enum { DEVICES = 100 };
+    static modbus_udp_server_st servers[DEVICES];
+    static uint16_t regs[DEVICES][QTY];
+    modbus_udp_master_st master;
+    modbus_batch_st batch;
+
+    assert_int_equal(modbus_udp_master_init(&master, DEVICES), 0);
+    assert_int_equal(modbus_batch_init(&batch, DEVICES, DEVICES * 12), 0);
+    for (int d = 0; d < DEVICES; d++) {
+        start_server(&servers[d], 1, read_wire);
+        assert_int_equal(modbus_udp_master_add_device(&master, "127.0.0.1", modbus_udp_server_port(&servers[d]), 1), d);
+        assert_int_equal(modbus_batch_add_read(&batch, modbus_udp_master_ctx(&master, d), 1, d, QTY, regs[d]), d);
+    }
+
+    // 100 datagrams leave in two sendmmsg() calls: 64, then 36
+    assert_int_equal(modbus_udp_master_send(&master, &batch), DEVICES);
+    assert_int_equal(master.stats.tx_calls, 2);
+    for (int d = 0; d < DEVICES; d++) {
+        assert_int_equal(modbus_udp_server_poll(&servers[d], 1000), 1);
+    }
+
+    while (batch.answered < DEVICES) {
+        assert_true(modbus_udp_master_recv(&master, &batch, 1000) > 0);
+    }
+    assert_true(master.stats.rx_calls >= 2);
+    for (int d = 0; d < DEVICES; d++) {
+        assert_int_equal(regs[d][0], 1000 + d);
+        modbus_udp_server_deinit(&servers[d]);
+    }
+
+    modbus_batch_free(&batch);
+    modbus_udp_master_deinit(&master);
+}
+
+static void test_trace(void **state) {
+    (void) state;
+    modbus_udp_server_st srv;
+    modbus_udp_master_st master;
+    modbus_batch_st batch;
+    modbus_trace_st trace;
+    uint16_t regs[4][QTY];
+
+    start_server(&srv, 3, read_wire);
+    assert_int_equal(modbus_udp_master_init(&master, 1), 0);
+    assert_int_equal(modbus_udp_master_add_device(&master, "127.0.0.1", modbus_udp_server_port(&srv), 4), 0);
+    modbus_tcp_master_ctx_st *ctx = modbus_udp_master_ctx(&master, 0);
+    assert_int_equal(modbus_trace_init(&trace, 1, 16), 0);
+    assert_int_equal(modbus_batch_init(&batch, 4, 4 * 12), 0);
+    assert_int_equal(modbus_batch_trace(&batch, modbus_trace_ring(&trace, 0)), 0);
+
+    uint64_t before = modbus_trace_now_ns();
+    for (int r = 0; r < 4; r++) {
+        assert_int_equal(modbus_batch_add_read(&batch, ctx, 3, r * 10, QTY, regs[r]), r);
+    }
+    assert_int_equal(modbus_udp_master_send(&master, &batch), 4);
+    assert_true(master.rx_timestamps);
+    assert_int_equal(modbus_udp_server_poll(&srv, 1000), 4);
+    while (batch.answered < 4) {
+        assert_true(modbus_udp_master_recv(&master, &batch, 1000) > 0);
+    }
+    uint64_t after = modbus_trace_now_ns();
+
+    // Every stage is stamped, in order, with the kernel timestamp between send and read
+    modbus_trace_record_st records[8];
+    uint64_t cursor = 0;
+    assert_int_equal(modbus_trace_read(modbus_trace_ring(&trace, 0), &cursor, records, 8), 4);
+    for (int r = 0; r < 4; r++) {
+        assert_int_equal(records[r].transaction_id, batch.frames[r].transaction_id);
+        assert_int_equal(records[r].unit_id, 3);
+        assert_int_equal(records[r].function_code, MODBUS_READ_HOLDING_REG);
+        assert_int_equal(records[r].status, QTY);
+        assert_true(records[r].ns[MODBUS_TRACE_ENCODED] >= before);
+        for (int stage = 1; stage < MODBUS_TRACE_STAGES; stage++) {
+            assert_true(records[r].ns[stage] >= records[r].ns[stage - 1]);
+        }
+        assert_true(records[r].ns[MODBUS_TRACE_DECODED] <= after);
+    }
+
+    modbus_batch_free(&batch);
+    modbus_trace_free(&trace);
+    modbus_udp_master_deinit(&master);
+    modbus_udp_server_deinit(&srv);
+}
+
+int main(void) {
+    const struct CMUnitTest tests[] = {
+        cmocka_unit_test(test_init),
+        cmocka_unit_test(test_round_trip),
+        cmocka_unit_test(test_write_and_exception),
+        cmocka_unit_test(test_read_exceptions),
+        cmocka_unit_test(test_bad_datagrams),
+        cmocka_unit_test(test_bursts),
+        cmocka_unit_test(test_trace),
+    };
+    return cmocka_run_group_tests(tests, NULL, NULL);
+}
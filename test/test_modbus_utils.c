@@ -41,7 +41,7 @@ static void test_modbus_crc16(void **state) {
     (void) state;
     const uint8_t data1[] = {0x01, 0x03, 0x00, 0x01, 0x00, 0x01};
     uint16_t crc = modbus_crc16(data1, sizeof(data1));
-    assert_int_equal(crc, 0x8409); // Example expected CRC (verify with reference)
+    assert_int_equal(crc, 0xCAD5); // Sent on the wire as D5 CA
 
     const uint8_t empty[] = {};
     assert_int_equal(modbus_crc16(empty, 0), 0xFFFF);